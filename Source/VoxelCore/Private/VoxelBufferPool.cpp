@@ -1,6 +1,7 @@
 ﻿// Copyright Voxel Plugin SAS. All Rights Reserved.
 
 #include "VoxelBufferPool.h"
+#include "VoxelMemoryBudget.h"
 #include "TextureResource.h"
 #include "Engine/Texture2D.h"
 
@@ -15,39 +16,96 @@ VOXEL_CONSOLE_VARIABLE(
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
+FVoxelBufferAllocator::FVoxelBufferAllocator(const int32 BytesPerElement)
+	: BytesPerElement(BytesPerElement)
+{
+	const int32 MaxPoolIndex = NumToPoolIndex(MAX_uint32);
+
+	for (int32 PoolIndex = 0; PoolIndex <= MaxPoolIndex; PoolIndex++)
+	{
+		PoolIndexToPool_RequiresLock.Add(FAllocationPool(PoolIndex));
+	}
+}
+
+TVoxelIntrusiveRef<FVoxelBufferRef> FVoxelBufferAllocator::Allocate(const int64 Num)
+{
+	const int32 PoolIndex = NumToPoolIndex(Num);
+
+	const int64 Index = INLINE_LAMBDA
+	{
+		VOXEL_SCOPE_LOCK(PoolIndexToPool_CriticalSection);
+		return PoolIndexToPool_RequiresLock[PoolIndex].Allocate(*this);
+	};
+
+	return MakeVoxelIntrusive<FVoxelBufferRef>(
+		*this,
+		PoolIndex,
+		Index,
+		Num);
+}
+
+void FVoxelBufferAllocator::Free(const int32 PoolIndex, const int64 Index)
+{
+	VOXEL_SCOPE_LOCK(PoolIndexToPool_CriticalSection);
+	PoolIndexToPool_RequiresLock[PoolIndex].Free(Index);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+int64 FVoxelBufferAllocator::FAllocationPool::Allocate(FVoxelBufferAllocator& Allocator)
+{
+	{
+		VOXEL_SCOPE_LOCK(CriticalSection);
+
+		if (FreeIndices_RequiresLock.Num() > 0)
+		{
+			return FreeIndices_RequiresLock.Pop();
+		}
+	}
+
+	const int64 Index = Allocator.BufferCount.Add_ReturnOld(PoolSize);
+	ensure(Allocator.BufferCount.Get() < MAX_uint32);
+	return Index;
+}
+
+void FVoxelBufferAllocator::FAllocationPool::Free(const int64 Index)
+{
+	VOXEL_SCOPE_LOCK(CriticalSection);
+	FreeIndices_RequiresLock.Add(Index);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
 FVoxelBufferRef::FVoxelBufferRef(
-	FVoxelBufferPoolBase& Pool,
+	FVoxelBufferAllocator& Allocator,
 	const int32 PoolIndex,
 	const int64 Index,
 	const int64 Num)
-	: WeakPool(Pool.AsWeak())
+	: Allocator(Allocator)
 	, PoolIndex(PoolIndex)
 	, Index(Index)
 	, PrivateNum(Num)
 {
-	const int64 UsedMemory = PrivateNum * Pool.BytesPerElement;
-	const int64 PaddingMemory = Pool.GetPoolSize(PoolIndex) * Pool.BytesPerElement - UsedMemory;
+	const int64 UsedMemory = PrivateNum * Allocator.BytesPerElement;
+	const int64 PaddingMemory = Allocator.GetPoolSize(PoolIndex) * Allocator.BytesPerElement - UsedMemory;
 
-	Pool.UsedMemory.Add(UsedMemory);
-	Pool.PaddingMemory.Add(PaddingMemory);
+	Allocator.UsedMemory.Add(UsedMemory);
+	Allocator.PaddingMemory.Add(PaddingMemory);
 }
 
 FVoxelBufferRef::~FVoxelBufferRef()
 {
-	const TSharedPtr<FVoxelBufferPoolBase> Pool = WeakPool.Pin();
-	if (!Pool)
-	{
-		return;
-	}
-
-	const int64 UsedMemory = PrivateNum * Pool->BytesPerElement;
-	const int64 PaddingMemory = Pool->GetPoolSize(PoolIndex) * Pool->BytesPerElement - UsedMemory;
+	const int64 UsedMemory = PrivateNum * Allocator->BytesPerElement;
+	const int64 PaddingMemory = Allocator->GetPoolSize(PoolIndex) * Allocator->BytesPerElement - UsedMemory;
 
-	Pool->UsedMemory.Subtract(UsedMemory);
-	Pool->PaddingMemory.Subtract(PaddingMemory);
+	Allocator->UsedMemory.Subtract(UsedMemory);
+	Allocator->PaddingMemory.Subtract(PaddingMemory);
 
-	VOXEL_SCOPE_LOCK(Pool->PoolIndexToPool_CriticalSection);
-	Pool->PoolIndexToPool_RequiresLock[PoolIndex].Free(Index);
+	Allocator->Free(PoolIndex, Index);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -64,21 +122,29 @@ FVoxelBufferPoolBase::FVoxelBufferPoolBase(
 	, AllocatedMemory_Name(FString(BufferName) + " Allocated Memory")
 	, UsedMemory_Name(FString(BufferName) + " Used Memory")
 	, PaddingMemory_Name(FString(BufferName) + " Padding Memory")
+	, Allocator(MakeVoxelIntrusive<FVoxelBufferAllocator>(BytesPerElement))
 {
 	ensure(BytesPerElement % GPixelFormats[PixelFormat].BlockBytes == 0);
 
-	const int32 MaxPoolIndex = NumToPoolIndex(MAX_uint32);
+	Voxel_AddAmountToDynamicStat(BufferName, AllocatedMemory.Get());
 
-	for (int32 PoolIndex = 0; PoolIndex <= MaxPoolIndex; PoolIndex++)
+	if (GVoxelMemoryBudget)
 	{
-		PoolIndexToPool_RequiresLock.Add(FAllocationPool(PoolIndex));
+		// Capture the allocator and not this: the cost provider might still be running when the pool is destroyed
+		MemoryBudgetHandle = GVoxelMemoryBudget->AddCostProvider("BufferPool", [Allocator = Allocator]
+		{
+			return Allocator->UsedMemory.Get() + Allocator->PaddingMemory.Get();
+		});
 	}
-
-	Voxel_AddAmountToDynamicStat(BufferName, AllocatedMemory.Get());
 }
 
 FVoxelBufferPoolBase::~FVoxelBufferPoolBase()
 {
+	if (GVoxelMemoryBudget)
+	{
+		GVoxelMemoryBudget->Remove(MemoryBudgetHandle);
+	}
+
 	Voxel_AddAmountToDynamicStat(AllocatedMemory_Name, -AllocatedMemory_Reported.Get());
 	Voxel_AddAmountToDynamicStat(UsedMemory_Name, -UsedMemory_Reported.Get());
 	Voxel_AddAmountToDynamicStat(PaddingMemory_Name, -PaddingMemory_Reported.Get());
@@ -91,8 +157,8 @@ FVoxelBufferPoolBase::~FVoxelBufferPoolBase()
 void FVoxelBufferPoolBase::UpdateStats()
 {
 	const int64 AllocatedMemoryNew = AllocatedMemory.Get();
-	const int64 UsedMemoryNew = UsedMemory.Get();
-	const int64 PaddingMemoryNew = PaddingMemory.Get();
+	const int64 UsedMemoryNew = Allocator->UsedMemory.Get();
+	const int64 PaddingMemoryNew = Allocator->PaddingMemory.Get();
 
 	const int64 AllocatedMemoryOld = AllocatedMemory_Reported.Exchange_ReturnOld(AllocatedMemoryNew);
 	const int64 UsedMemoryOld = UsedMemory_Reported.Exchange_ReturnOld(UsedMemoryNew);
@@ -107,50 +173,29 @@ void FVoxelBufferPoolBase::UpdateStats()
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
-TSharedRef<FVoxelBufferRef> FVoxelBufferPoolBase::Allocate_AnyThread(const int64 Num)
+TVoxelIntrusiveRef<FVoxelBufferRef> FVoxelBufferPoolBase::Allocate_AnyThread(const int64 Num)
 {
-	const int32 PoolIndex = NumToPoolIndex(Num);
-
-	const int64 Index = INLINE_LAMBDA
-	{
-		VOXEL_SCOPE_LOCK(PoolIndexToPool_CriticalSection);
-		return PoolIndexToPool_RequiresLock[PoolIndex].Allocate(*this);
-	};
-
-	return MakeShared<FVoxelBufferRef>(
-		*this,
-		PoolIndex,
-		Index,
-		Num);
+	return Allocator->Allocate(Num);
 }
 
-TVoxelFuture<FVoxelBufferRef> FVoxelBufferPoolBase::Upload_AnyThread(
+FVoxelFuture FVoxelBufferPoolBase::Upload_AnyThread(
 	const FSharedVoidPtr& Owner,
 	const TConstVoxelArrayView64<uint8> Data,
-	const TSharedPtr<FVoxelBufferRef>& ExistingBufferRef)
+	const TVoxelIntrusiveRef<FVoxelBufferRef>& BufferRef)
 {
 	ensure(Data.Num() > 0);
 	checkVoxelSlow(Data.Num() % BytesPerElement == 0);
+	checkVoxelSlow(BufferRef->Allocator == Allocator);
+	checkVoxelSlow(BufferRef->Num() == Data.Num() / BytesPerElement);
 
-	const int64 Num = Data.Num() / BytesPerElement;
-
-	checkVoxelSlow(!ExistingBufferRef || ExistingBufferRef->WeakPool == AsWeak());
-	checkVoxelSlow(!ExistingBufferRef || ExistingBufferRef->Num() == Num);
-
-	TSharedPtr<FVoxelBufferRef> BufferRef = ExistingBufferRef;
-	if (!BufferRef)
-	{
-		BufferRef = Allocate_AnyThread(Num);
-	}
-
-	TVoxelPromise<FVoxelBufferRef> Promise;
+	const FVoxelPromise Promise;
 
 	UploadQueue.Enqueue(FUpload
 	{
 		Owner,
 		Data,
 		BufferRef,
-		MakeSharedCopy(Promise)
+		Promise
 	});
 
 	CheckUploadQueue_AnyThread();
@@ -162,32 +207,6 @@ TVoxelFuture<FVoxelBufferRef> FVoxelBufferPoolBase::Upload_AnyThread(
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
-int64 FVoxelBufferPoolBase::FAllocationPool::Allocate(FVoxelBufferPoolBase& Pool)
-{
-	{
-		VOXEL_SCOPE_LOCK(CriticalSection);
-
-		if (FreeIndices_RequiresLock.Num() > 0)
-		{
-			return FreeIndices_RequiresLock.Pop();
-		}
-	}
-
-	const int64 Index = Pool.BufferCount.Add_ReturnOld(PoolSize);
-	ensure(Pool.BufferCount.Get() < MAX_uint32);
-	return Index;
-}
-
-void FVoxelBufferPoolBase::FAllocationPool::Free(const int64 Index)
-{
-	VOXEL_SCOPE_LOCK(CriticalSection);
-	FreeIndices_RequiresLock.Add(Index);
-}
-
-///////////////////////////////////////////////////////////////////////////////
-///////////////////////////////////////////////////////////////////////////////
-///////////////////////////////////////////////////////////////////////////////
-
 void FVoxelBufferPoolBase::CheckUploadQueue_AnyThread()
 {
 	if (UploadQueue.IsEmpty())
@@ -342,13 +361,13 @@ FVoxelFuture FVoxelBufferPool::ProcessUploadsImpl_AnyThread(TVoxelArray<FUpload>
 			checkVoxelSlow(Upload.NumBytes() % BytesPerElement == 0);
 			const int64 Num = Upload.NumBytes() / BytesPerElement;
 
-			checkVoxelSlow(Upload.BufferRef->WeakPool == AsWeak());
+			checkVoxelSlow(Upload.BufferRef->Allocator == Allocator);
 			checkVoxelSlow(Upload.BufferRef->Num() == Num);
 
 			CopyInfos.Add_EnsureNoGrow(FCopyInfo
 			{
 				Upload.BufferRef,
-				Upload.BufferRefPromise,
+				Upload.Promise.GetValue(),
 				UploadBuffer,
 				UploadIndex
 			});
@@ -373,7 +392,7 @@ void FVoxelBufferPool::ProcessCopies_RenderThread(
 	ensure(CopyInfos.Num() > 0);
 
 	// Do this after dequeuing all copies to make sure we allocate a big enough buffer for them
-	const int64 Num = BufferCount.Get();
+	const int64 Num = Allocator->BufferCount.Get();
 
 	int64 AllocatedNum = FMath::RoundUpToPowerOfTwo64(Num);
 
@@ -421,7 +440,7 @@ void FVoxelBufferPool::ProcessCopies_RenderThread(
 	for (const FCopyInfo& CopyInfo : CopyInfos)
 	{
 		VOXEL_SCOPE_COUNTER("CopyBufferRegion");
-		checkVoxelSlow(CopyInfo.BufferRef->WeakPool == AsWeak());
+		checkVoxelSlow(CopyInfo.BufferRef->Allocator == Allocator);
 
 		RHICmdList.CopyBufferRegion(
 			BufferRHI_RenderThread,
@@ -431,7 +450,7 @@ void FVoxelBufferPool::ProcessCopies_RenderThread(
 			CopyInfo.BufferRef->Num() * BytesPerElement);
 
 		// Upload is complete: notify caller
-		CopyInfo.BufferRefPromise->Set(CopyInfo.BufferRef.ToSharedRef());
+		CopyInfo.Promise.Set();
 	}
 }
 
@@ -460,7 +479,7 @@ FVoxelFuture FVoxelTextureBufferPool::ProcessUploadsImpl_AnyThread(TVoxelArray<F
 		UTexture2D* OldTexture = Texture_GameThread;
 		{
 			// Do this after dequeuing all copies to make sure we allocate a big enough buffer for them
-			const int64 Num = BufferCount.Get();
+			const int64 Num = Allocator->BufferCount.Get();
 			const int32 Size = FMath::Max<int32>(1024, FMath::RoundUpToPowerOfTwo(FMath::CeilToInt(FMath::Sqrt(double(Num)))));
 
 			{
@@ -552,7 +571,7 @@ FVoxelFuture FVoxelTextureBufferPool::ProcessUploadsImpl_AnyThread(TVoxelArray<F
 				checkVoxelSlow(Upload.NumBytes() % BytesPerElement == 0);
 				const int64 Num = Upload.NumBytes() / BytesPerElement;
 
-				checkVoxelSlow(Upload.BufferRef->WeakPool == AsWeak());
+				checkVoxelSlow(Upload.BufferRef->Allocator == Allocator);
 				checkVoxelSlow(Upload.BufferRef->Num() == Num);
 
 				int64 Offset = Upload.BufferRef->GetIndex();
@@ -584,7 +603,7 @@ FVoxelFuture FVoxelTextureBufferPool::ProcessUploadsImpl_AnyThread(TVoxelArray<F
 				}
 
 				// Upload is complete: notify caller
-				Upload.BufferRefPromise->Set(Upload.BufferRef.ToSharedRef());
+				Upload.Promise->Set();
 			}
 		}));
 	}));
@@ -1,14 +1,269 @@
 ﻿// Copyright Voxel Plugin SAS. All Rights Reserved.
 
 #include "VoxelChaosTriangleMeshCooker.h"
+#include "VoxelFileCache.h"
 #include "VoxelFastAABBTree.h"
+#include "Chaos/ChaosArchive.h"
 #include "Chaos/TriangleMeshImplicitObject.h"
+#include "Misc/EngineVersion.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "VoxelChaosTriangleMeshCookerImpl.ispc.generated.h"
 
 VOXEL_CONSOLE_VARIABLE(
 	VOXELCORE_API, bool, GVoxelCollisionFastCooking, true,
 	"voxel.collision.FastCooking",
 	"");
 
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, int32, GVoxelCollisionCookCacheSizeMB, 64,
+	"voxel.collision.CookCacheSizeMB",
+	"Max size of the cache of cooked triangle meshes, keyed by their content. Identical chunks (flat ground, repeated stamps) are only cooked once. 0 to disable");
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, bool, GVoxelCollisionFileCache, true,
+	"voxel.collision.FileCache",
+	"If true, cooked triangle meshes are persisted in the voxel file cache so that the next sessions don't cook them again");
+
+VOXEL_CONSOLE_COMMAND(
+	"voxel.collision.ClearCookCache",
+	"Clear the cache of cooked triangle meshes")
+{
+	FVoxelChaosTriangleMeshCooker::ClearCache();
+}
+
+DEFINE_VOXEL_MEMORY_STAT(STAT_VoxelCollisionCookCache);
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Cooked meshes are shared by all the callers cooking identical data: one FTriangleMeshImplicitObject can be used by many bodies at once
+// A singleton so that the cached Chaos objects are released on module shutdown, while Chaos is still alive
+class FVoxelCollisionCookCache : public FVoxelSingleton
+{
+public:
+	virtual ~FVoxelCollisionCookCache() override
+	{
+		Clear();
+	}
+
+	TRefCountPtr<Chaos::FTriangleMeshImplicitObject> Find(
+		const uint64 Hash,
+		const TConstVoxelArrayView<int32> Indices,
+		const TConstVoxelArrayView<FVector3f> Vertices,
+		const TConstVoxelArrayView<uint16> FaceMaterials)
+	{
+		VOXEL_SCOPE_LOCK(CriticalSection);
+
+		FEntry* Entry = Entries_RequiresLock.Find(Hash);
+		if (!Entry ||
+			!Entry->Equals(Indices, Vertices, FaceMaterials))
+		{
+			return nullptr;
+		}
+
+		Entry->LastUsed = ++UseCounter_RequiresLock;
+		return Entry->TriangleMesh;
+	}
+	void Add(
+		const uint64 Hash,
+		const TConstVoxelArrayView<int32> Indices,
+		const TConstVoxelArrayView<FVector3f> Vertices,
+		const TConstVoxelArrayView<uint16> FaceMaterials,
+		const TRefCountPtr<Chaos::FTriangleMeshImplicitObject>& TriangleMesh)
+	{
+		VOXEL_FUNCTION_COUNTER();
+
+		const int64 AllocatedSize =
+			Indices.Num() * sizeof(int32) +
+			Vertices.Num() * sizeof(FVector3f) +
+			FaceMaterials.Num() * sizeof(uint16) +
+			FVoxelChaosTriangleMeshCooker::GetAllocatedSize(*TriangleMesh);
+
+		const int64 MaxSize = int64(GVoxelCollisionCookCacheSizeMB) * 1024 * 1024;
+		if (AllocatedSize > MaxSize / 4)
+		{
+			// Big meshes are unlikely to be duplicated, don't flush the cache for them
+			return;
+		}
+
+		FEntry NewEntry;
+		NewEntry.Indices = TVoxelArray<int32>(Indices);
+		NewEntry.Vertices = TVoxelArray<FVector3f>(Vertices);
+		NewEntry.FaceMaterials = TVoxelArray<uint16>(FaceMaterials);
+		NewEntry.TriangleMesh = TriangleMesh;
+		NewEntry.AllocatedSize = AllocatedSize;
+
+		VOXEL_SCOPE_LOCK(CriticalSection);
+
+		if (FEntry* ExistingEntry = Entries_RequiresLock.Find(Hash))
+		{
+			// Either cooked concurrently or a hash collision, keep the newest one
+			RemoveEntry_RequiresLock(*ExistingEntry);
+			Entries_RequiresLock.Remove(Hash);
+		}
+
+		NewEntry.LastUsed = ++UseCounter_RequiresLock;
+		TotalSize_RequiresLock += NewEntry.AllocatedSize;
+		INC_VOXEL_MEMORY_STAT_BY(STAT_VoxelCollisionCookCache, NewEntry.AllocatedSize);
+
+		Entries_RequiresLock.Add_CheckNew(Hash, MoveTemp(NewEntry));
+
+		if (TotalSize_RequiresLock > MaxSize)
+		{
+			Trim_RequiresLock(MaxSize / 2);
+		}
+	}
+	void Clear()
+	{
+		VOXEL_SCOPE_LOCK(CriticalSection);
+		Trim_RequiresLock(0);
+	}
+
+private:
+	struct FEntry
+	{
+		TVoxelArray<int32> Indices;
+		TVoxelArray<FVector3f> Vertices;
+		TVoxelArray<uint16> FaceMaterials;
+		TRefCountPtr<Chaos::FTriangleMeshImplicitObject> TriangleMesh;
+		int64 AllocatedSize = 0;
+		uint64 LastUsed = 0;
+
+		bool Equals(
+			const TConstVoxelArrayView<int32> OtherIndices,
+			const TConstVoxelArrayView<FVector3f> OtherVertices,
+			const TConstVoxelArrayView<uint16> OtherFaceMaterials) const
+		{
+			return
+				FVoxelUtilities::Equal(Indices, OtherIndices) &&
+				FVoxelUtilities::Equal(Vertices, OtherVertices) &&
+				FVoxelUtilities::Equal(FaceMaterials, OtherFaceMaterials);
+		}
+	};
+
+	FVoxelCriticalSection CriticalSection;
+	uint64 UseCounter_RequiresLock = 0;
+	int64 TotalSize_RequiresLock = 0;
+	TVoxelMap<uint64, FEntry> Entries_RequiresLock;
+
+	void RemoveEntry_RequiresLock(const FEntry& Entry)
+	{
+		checkVoxelSlow(CriticalSection.IsLocked());
+
+		TotalSize_RequiresLock -= Entry.AllocatedSize;
+		DEC_VOXEL_MEMORY_STAT_BY(STAT_VoxelCollisionCookCache, Entry.AllocatedSize);
+	}
+	void Trim_RequiresLock(const int64 TargetSize)
+	{
+		VOXEL_FUNCTION_COUNTER();
+		checkVoxelSlow(CriticalSection.IsLocked());
+
+		TVoxelArray<TPair<uint64, uint64>> LastUsedToHash;
+		LastUsedToHash.Reserve(Entries_RequiresLock.Num());
+
+		for (const auto& It : Entries_RequiresLock)
+		{
+			LastUsedToHash.Add_CheckNoGrow({ It.Value.LastUsed, It.Key });
+		}
+
+		LastUsedToHash.Sort([](const TPair<uint64, uint64>& A, const TPair<uint64, uint64>& B)
+		{
+			return A.Key < B.Key;
+		});
+
+		for (const TPair<uint64, uint64>& Pair : LastUsedToHash)
+		{
+			if (TotalSize_RequiresLock <= TargetSize)
+			{
+				break;
+			}
+
+			RemoveEntry_RequiresLock(Entries_RequiresLock.FindChecked(Pair.Value));
+			Entries_RequiresLock.RemoveChecked(Pair.Value);
+		}
+	}
+};
+FVoxelCollisionCookCache* GVoxelCollisionCookCache = new FVoxelCollisionCookCache();
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+FVoxelHash GetCollisionFileCacheKey(
+	const TConstVoxelArrayView<int32> Indices,
+	const TConstVoxelArrayView<FVector3f> Vertices,
+	const TConstVoxelArrayView<uint16> FaceMaterials)
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	// Bump to invalidate the meshes cooked by previous versions
+	constexpr int32 Version = 1;
+
+	// Chaos serialization isn't stable across engine versions
+	const FEngineVersion& EngineVersion = FEngineVersion::Current();
+
+	FVoxelHashBuilder Builder;
+	Builder << MAKE_TAG_64("VOXEL_CO");
+	Builder << Version;
+	Builder << EngineVersion.GetMajor();
+	Builder << EngineVersion.GetMinor();
+	Builder << EngineVersion.GetPatch();
+	Builder << EngineVersion.GetChangelist();
+	Builder << bool(GVoxelCollisionFastCooking);
+	Builder << Indices.Num();
+	Builder << Vertices.Num();
+	Builder << FaceMaterials.Num();
+	Builder.AppendBytes(Indices.GetData(), Indices.Num() * sizeof(int32));
+	Builder.AppendBytes(Vertices.GetData(), Vertices.Num() * sizeof(FVector3f));
+	Builder.AppendBytes(FaceMaterials.GetData(), FaceMaterials.Num() * sizeof(uint16));
+	return Builder.MakeHash();
+}
+
+TRefCountPtr<Chaos::FTriangleMeshImplicitObject> LoadCollisionFromFileCache(const FVoxelHash& Key)
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	TVoxelArray64<uint8> Data;
+	if (!FVoxelFileCache::Get().Load(Key, Data))
+	{
+		return nullptr;
+	}
+
+	FMemoryReaderView Reader(MakeMemoryView(Data.GetData(), Data.Num()));
+	Chaos::FChaosArchive ChaosArchive(Reader);
+
+	TRefCountPtr<Chaos::FTriangleMeshImplicitObject> TriangleMesh;
+	ChaosArchive << TriangleMesh;
+
+	if (Reader.IsError() ||
+		!TriangleMesh)
+	{
+		LOG_VOXEL(Warning, "Invalid cooked collision in file cache entry %s", *Key.ToString());
+		FVoxelFileCache::Get().Remove(Key);
+		return nullptr;
+	}
+
+	return TriangleMesh;
+}
+
+void StoreCollisionInFileCache(
+	const FVoxelHash& Key,
+	TRefCountPtr<Chaos::FTriangleMeshImplicitObject> TriangleMesh)
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	TArray64<uint8> Data;
+	{
+		FMemoryWriter64 Writer(Data);
+		Chaos::FChaosArchive ChaosArchive(Writer);
+		ChaosArchive << TriangleMesh;
+	}
+
+	FVoxelFileCache::Get().Store(Key, Data);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
@@ -123,23 +378,31 @@ namespace Chaos
 			Elements.SetNum(Triangles.Num());
 			{
 				VOXEL_SCOPE_COUNTER("Build Elements");
+				checkStatic(sizeof(TVector<IndexType, 3>) == 3 * sizeof(IndexType));
 
-				for (int32 Index = 0; Index < Triangles.Num(); Index++)
+				const auto ComputeBounds = [&](auto Function)
 				{
-					const TVector<IndexType, 3>& Triangle = Triangles[Index];
-					const FVector3f VertexA = Vertices[Triangle.X];
-					const FVector3f VertexB = Vertices[Triangle.Y];
-					const FVector3f VertexC = Vertices[Triangle.Z];
-
-					Elements.Payload[Index] = Index;
-
-					Elements.MinX[Index] = FMath::Min3(VertexA.X, VertexB.X, VertexC.X);
-					Elements.MinY[Index] = FMath::Min3(VertexA.Y, VertexB.Y, VertexC.Y);
-					Elements.MinZ[Index] = FMath::Min3(VertexA.Z, VertexB.Z, VertexC.Z);
+					Function(
+						&Vertices.GetData()->X,
+						reinterpret_cast<const IndexType*>(Triangles.GetData()),
+						Triangles.Num(),
+						Elements.Payload.GetData(),
+						Elements.MinX.GetData(),
+						Elements.MinY.GetData(),
+						Elements.MinZ.GetData(),
+						Elements.MaxX.GetData(),
+						Elements.MaxY.GetData(),
+						Elements.MaxZ.GetData());
+				};
 
-					Elements.MaxX[Index] = FMath::Max3(VertexA.X, VertexB.X, VertexC.X);
-					Elements.MaxY[Index] = FMath::Max3(VertexA.Y, VertexB.Y, VertexC.Y);
-					Elements.MaxZ[Index] = FMath::Max3(VertexA.Z, VertexB.Z, VertexC.Z);
+				if constexpr (std::is_same_v<IndexType, uint16>)
+				{
+					ComputeBounds(ispc::ChaosTriangleMeshCooker_ComputeBounds_uint16);
+				}
+				else
+				{
+					checkStatic(std::is_same_v<IndexType, int32>);
+					ComputeBounds(ispc::ChaosTriangleMeshCooker_ComputeBounds_int32);
 				}
 			}
 
@@ -161,12 +424,15 @@ namespace Chaos
 			FVoxelUtilities::SetNum(ConstCast(BVH.GetNodes()), SrcNodes.Num());
 			FVoxelUtilities::SetNum(ConstCast(BVH.GetLeaves()), SrcLeaves.Num());
 
+			// Only worth going wide on big meshes, most chunks only have a few hundred nodes
+			constexpr int32 MinNodesForParallelCopy = 4096;
+
 			{
 				VOXEL_SCOPE_COUNTER("Copy Nodes");
 
 				const TVoxelArrayView<TAABBTreeNode<float>> DestNodes = MakeVoxelArrayView(ConstCast(BVH.GetNodes()));
 
-				for (int32 Index = 0; Index < SrcNodes.Num(); Index++)
+				ParallelFor(SrcNodes.Num(), [&](const int32 Index)
 				{
 					const FVoxelFastAABBTree::FNode& SrcNode = SrcNodes[Index];
 					TAABBTreeNode<float>& DestNode = DestNodes[Index];
@@ -184,7 +450,7 @@ namespace Chaos
 						DestNode.ChildrenBounds[0] = FAABB3f(SrcNode.ChildBounds0_Min, SrcNode.ChildBounds0_Max);
 						DestNode.ChildrenBounds[1] = FAABB3f(SrcNode.ChildBounds1_Min, SrcNode.ChildBounds1_Max);
 					}
-				}
+				}, SrcNodes.Num() < MinNodesForParallelCopy);
 			}
 
 			{
@@ -192,7 +458,7 @@ namespace Chaos
 
 				const TVoxelArrayView<FLeaf> DestLeaves = MakeVoxelArrayView(ConstCast(BVH.GetLeaves()));
 
-				for (int32 Index = 0; Index < SrcLeaves.Num(); Index++)
+				ParallelFor(SrcLeaves.Num(), [&](const int32 Index)
 				{
 					const FVoxelFastAABBTree::FLeaf& SrcLeaf = SrcLeaves[Index];
 					FLeaf& DestLeaf = DestLeaves[Index];
@@ -216,7 +482,7 @@ namespace Chaos
 								SrcLeaf.Elements.MaxY[ElementIndex],
 								SrcLeaf.Elements.MaxZ[ElementIndex]));
 					}
-				}
+				}, SrcNodes.Num() < MinNodesForParallelCopy);
 			}
 
 			VOXEL_SCOPE_COUNTER("FTriangleMeshImplicitObject::FTriangleMeshImplicitObject");
@@ -251,19 +517,76 @@ TRefCountPtr<Chaos::FTriangleMeshImplicitObject> FVoxelChaosTriangleMeshCooker::
 		return nullptr;
 	}
 
+	const bool bUseCache = GVoxelCollisionCookCacheSizeMB > 0;
+
+	uint64 Hash = 0;
+	if (bUseCache)
+	{
+		VOXEL_SCOPE_COUNTER("Hash");
+
+		const uint64 IndicesHash = FVoxelUtilities::MurmurHashBytes(MakeByteVoxelArrayView(Indices), 1);
+		const uint64 VerticesHash = FVoxelUtilities::MurmurHashBytes(MakeByteVoxelArrayView(Vertices), 2);
+		const uint64 FaceMaterialsHash = FVoxelUtilities::MurmurHashBytes(MakeByteVoxelArrayView(FaceMaterials), 3);
+
+		Hash = IndicesHash ^ FVoxelUtilities::MurmurHash64(VerticesHash ^ FVoxelUtilities::MurmurHash64(FaceMaterialsHash));
+
+		if (TRefCountPtr<Chaos::FTriangleMeshImplicitObject> TriangleMesh = GVoxelCollisionCookCache->Find(Hash, Indices, Vertices, FaceMaterials))
+		{
+			return TriangleMesh;
+		}
+	}
+
+	const bool bUseFileCache = GVoxelCollisionFileCache;
+
+	FVoxelHash FileCacheKey;
+	if (bUseFileCache)
+	{
+		FileCacheKey = GetCollisionFileCacheKey(Indices, Vertices, FaceMaterials);
+
+		if (TRefCountPtr<Chaos::FTriangleMeshImplicitObject> TriangleMesh = LoadCollisionFromFileCache(FileCacheKey))
+		{
+			if (bUseCache)
+			{
+				GVoxelCollisionCookCache->Add(Hash, Indices, Vertices, FaceMaterials, TriangleMesh);
+			}
+			return TriangleMesh;
+		}
+	}
+
 	using FCooker = Chaos::FTriangleMeshOverlapVisitorNoMTD<Chaos::FCookTriangleDummy>;
 
+	TRefCountPtr<Chaos::FTriangleMeshImplicitObject> TriangleMesh;
 	if (Vertices.Num() < MAX_uint16)
 	{
-		return FCooker::CookTriangleMesh<uint16>(Indices, Vertices, FaceMaterials);
+		TriangleMesh = FCooker::CookTriangleMesh<uint16>(Indices, Vertices, FaceMaterials);
 	}
 	else
 	{
-		return FCooker::CookTriangleMesh<int32>(Indices, Vertices, FaceMaterials);
+		TriangleMesh = FCooker::CookTriangleMesh<int32>(Indices, Vertices, FaceMaterials);
+	}
+
+	if (bUseCache &&
+		TriangleMesh)
+	{
+		GVoxelCollisionCookCache->Add(Hash, Indices, Vertices, FaceMaterials, TriangleMesh);
 	}
+
+	if (bUseFileCache &&
+		TriangleMesh)
+	{
+		StoreCollisionInFileCache(FileCacheKey, TriangleMesh);
+	}
+
+	return TriangleMesh;
 }
 
 int64 FVoxelChaosTriangleMeshCooker::GetAllocatedSize(const Chaos::FTriangleMeshImplicitObject& TriangleMesh)
 {
 	return Chaos::FTriangleMeshSweepVisitorCCD<void, void>::GetAllocatedSize(TriangleMesh);
+}
+
+void FVoxelChaosTriangleMeshCooker::ClearCache()
+{
+	VOXEL_FUNCTION_COUNTER();
+	GVoxelCollisionCookCache->Clear();
 }
\ No newline at end of file
@@ -0,0 +1,198 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#include "VoxelChromeTraceWriter.h"
+
+FVoxelChromeTraceWriter::FVoxelChromeTraceWriter(
+	const FString& Prefix,
+	const uint64 StartCycles)
+	: StartCycles(StartCycles)
+	, ProcessId(FPlatformProcess::GetCurrentProcessId())
+	, Path(FPaths::ConvertRelativePathToFull(FPaths::ProfilingDir() / Prefix + "-" + FDateTime::Now().ToString(TEXT("%Y%m%d-%H%M%S")) + ".json"))
+	, Archive(IFileManager::Get().CreateFileWriter(*Path))
+{
+	if (!Archive)
+	{
+		LOG_VOXEL(Error, "Failed to open %s", *Path);
+		return;
+	}
+
+	Buffer = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+}
+
+FVoxelChromeTraceWriter::~FVoxelChromeTraceWriter()
+{
+	ensureMsgf(!Archive, TEXT("Finish not called"));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelChromeTraceWriter::AddSlice(
+	const uint32 ThreadId,
+	const TCHAR* Category,
+	const FString& Name,
+	const uint64 SliceStartCycles,
+	const uint64 SliceEndCycles)
+{
+	AddEvent(
+		ThreadId,
+		TEXT("X"),
+		Category,
+		Name,
+		SliceStartCycles,
+		FString::Printf(TEXT(",\"dur\":%.3f"), FPlatformTime::ToMilliseconds64(SliceEndCycles - SliceStartCycles) * 1000.));
+}
+
+void FVoxelChromeTraceWriter::AddInstant(
+	const uint32 ThreadId,
+	const TCHAR* Category,
+	const FString& Name,
+	const uint64 Cycles)
+{
+	AddEvent(ThreadId, TEXT("i"), Category, Name, Cycles, ",\"s\":\"t\"");
+}
+
+void FVoxelChromeTraceWriter::AddAsyncBegin(
+	const uint32 ThreadId,
+	const TCHAR* Category,
+	const TCHAR* Name,
+	const uint64 Id,
+	const uint64 Cycles)
+{
+	AddEvent(ThreadId, TEXT("b"), Category, Name, Cycles, FString::Printf(TEXT(",\"id\":\"0x%llx\""), Id));
+}
+
+void FVoxelChromeTraceWriter::AddAsyncEnd(
+	const uint32 ThreadId,
+	const TCHAR* Category,
+	const TCHAR* Name,
+	const uint64 Id,
+	const uint64 Cycles)
+{
+	AddEvent(ThreadId, TEXT("e"), Category, Name, Cycles, FString::Printf(TEXT(",\"id\":\"0x%llx\""), Id));
+}
+
+void FVoxelChromeTraceWriter::AddFlowStart(
+	const uint32 ThreadId,
+	const TCHAR* Category,
+	const uint64 Id,
+	const uint64 Cycles)
+{
+	AddEvent(ThreadId, TEXT("s"), Category, "Flow", Cycles, FString::Printf(TEXT(",\"id\":%llu"), Id));
+}
+
+void FVoxelChromeTraceWriter::AddFlowEnd(
+	const uint32 ThreadId,
+	const TCHAR* Category,
+	const uint64 Id,
+	const uint64 Cycles)
+{
+	AddEvent(ThreadId, TEXT("f"), Category, "Flow", Cycles, FString::Printf(TEXT(",\"id\":%llu,\"bp\":\"e\""), Id));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+FString FVoxelChromeTraceWriter::Finish()
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	if (!Archive)
+	{
+		return {};
+	}
+
+	for (const uint32 ThreadId : ThreadIds)
+	{
+		FString ThreadName;
+		if (ThreadId == GGameThreadId)
+		{
+			ThreadName = "GameThread";
+		}
+		else
+		{
+			ThreadName = FThreadManager::GetThreadName(ThreadId);
+		}
+
+		if (ThreadName.IsEmpty())
+		{
+			ThreadName = FString::Printf(TEXT("Thread %u"), ThreadId);
+		}
+
+		Buffer += FString::Printf(
+			TEXT("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}},\n"),
+			ProcessId,
+			ThreadId,
+			*ThreadName.ReplaceCharWithEscapedChar());
+	}
+
+	// Trailing comma, if any events: always in Buffer as thread names are written last
+	Buffer.RemoveFromEnd(",\n");
+	Buffer += "\n]}\n";
+
+	Flush();
+
+	const bool bSuccess =
+		!Archive->IsError() &&
+		Archive->Close();
+
+	Archive.Reset();
+
+	if (!bSuccess)
+	{
+		LOG_VOXEL(Error, "Failed to write %s", *Path);
+		return {};
+	}
+
+	return Path;
+}
+
+void FVoxelChromeTraceWriter::Flush()
+{
+	checkVoxelSlow(Archive);
+
+	const FTCHARToUTF8 UTF8String(*Buffer, Buffer.Len());
+	Archive->Serialize(ConstCast(UTF8String.Get()), UTF8String.Length());
+
+	Buffer.Reset();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelChromeTraceWriter::AddEvent(
+	const uint32 ThreadId,
+	const TCHAR* Phase,
+	const TCHAR* Category,
+	const FString& Name,
+	const uint64 Cycles,
+	const FString& Extra)
+{
+	if (!Archive)
+	{
+		return;
+	}
+
+	ThreadIds.Add(ThreadId);
+
+	// Events recorded before the trace started, eg a task dispatched before and running after
+	const double Time = Cycles > StartCycles ? FPlatformTime::ToMilliseconds64(Cycles - StartCycles) * 1000. : 0.;
+
+	Buffer += FString::Printf(
+		TEXT("{\"ph\":\"%s\",\"cat\":\"%s\",\"name\":\"%s\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f%s},\n"),
+		Phase,
+		Category,
+		*Name.ReplaceCharWithEscapedChar(),
+		ProcessId,
+		ThreadId,
+		Time,
+		*Extra);
+
+	if (Buffer.Len() >= 1024 * 1024)
+	{
+		Flush();
+	}
+}
@@ -0,0 +1,81 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#pragma once
+
+#include "VoxelMinimal.h"
+
+// Writes events in the Chrome trace event JSON format, to open in ui.perfetto.dev or chrome://tracing
+// Events are streamed to Saved/Profiling/{Prefix}-{Date}.json as they are added, traces can be too big to fit in a single string
+// Times are FPlatformTime::Cycles64, relative to StartCycles
+class FVoxelChromeTraceWriter
+{
+public:
+	FVoxelChromeTraceWriter(
+		const FString& Prefix,
+		uint64 StartCycles);
+	~FVoxelChromeTraceWriter();
+	UE_NONCOPYABLE(FVoxelChromeTraceWriter);
+
+	// Slice on a thread, EndCycles can be equal to StartCycles
+	void AddSlice(
+		uint32 ThreadId,
+		const TCHAR* Category,
+		const FString& Name,
+		uint64 StartCycles,
+		uint64 EndCycles);
+
+	void AddInstant(
+		uint32 ThreadId,
+		const TCHAR* Category,
+		const FString& Name,
+		uint64 Cycles);
+
+	// Async slices are matched by Category, Name and Id, they can begin and end on different threads
+	void AddAsyncBegin(
+		uint32 ThreadId,
+		const TCHAR* Category,
+		const TCHAR* Name,
+		uint64 Id,
+		uint64 Cycles);
+	void AddAsyncEnd(
+		uint32 ThreadId,
+		const TCHAR* Category,
+		const TCHAR* Name,
+		uint64 Id,
+		uint64 Cycles);
+
+	// Flow arrows bind to the innermost slice enclosing Cycles on their thread
+	void AddFlowStart(
+		uint32 ThreadId,
+		const TCHAR* Category,
+		uint64 Id,
+		uint64 Cycles);
+	void AddFlowEnd(
+		uint32 ThreadId,
+		const TCHAR* Category,
+		uint64 Id,
+		uint64 Cycles);
+
+	// Names the threads that had events and closes the file
+	// Returns the full path, empty on failure
+	FString Finish();
+
+private:
+	const uint64 StartCycles;
+	const uint32 ProcessId;
+	const FString Path;
+	TUniquePtr<FArchive> Archive;
+	// Flushed to Archive once big enough
+	FString Buffer;
+	TVoxelSet<uint32> ThreadIds;
+
+	void Flush();
+
+	void AddEvent(
+		uint32 ThreadId,
+		const TCHAR* Phase,
+		const TCHAR* Category,
+		const FString& Name,
+		uint64 Cycles,
+		const FString& Extra);
+};
@@ -1,6 +1,8 @@
 ﻿// Copyright Voxel Plugin SAS. All Rights Reserved.
 
 #include "VoxelCoreBenchmark.h"
+#include "VoxelTaskContext.h"
+#include "VoxelBufferPool.h"
 #include "VoxelWelfordVariance.h"
 #include "Misc/OutputDeviceConsole.h"
 #include "Framework/Application/SlateApplication.h"
@@ -533,6 +535,194 @@ void FVoxelCoreBenchmark::Run()
 				});
 		}
 
+		{
+			int32 Value = 0;
+
+			RunBenchmark(
+				"TVoxelArray<FVoxelArenaAllocator>",
+				10000,
+				nullptr,
+				nullptr,
+				[&](const int32 NumRuns)
+				{
+					for (int32 Run = 0; Run < NumRuns; Run++)
+					{
+						TVoxelArray<int32> Array;
+						for (int32 Index = 0; Index < 64; Index++)
+						{
+							Array.Add(Index);
+						}
+						Value += Array.Last();
+					}
+				},
+				[&](const int32 NumRuns)
+				{
+					FVoxelArenaScope Scope;
+
+					for (int32 Run = 0; Run < NumRuns; Run++)
+					{
+						TVoxelArray<int32, FVoxelArenaAllocator> Array;
+						for (int32 Index = 0; Index < 64; Index++)
+						{
+							Array.Add(Index);
+						}
+						Value += Array.Last();
+					}
+				});
+		}
+
+		{
+			constexpr int32 NumInnerRuns = 100;
+
+			using FArray = TVoxelChunkedArray<int32>;
+			const bool bPoolWasEnabled = GVoxelChunkPoolEnabled;
+
+			int32 Value = 0;
+			const auto Execute = [&](const int32 NumRuns)
+			{
+				for (int32 Run = 0; Run < NumRuns; Run++)
+				{
+					FArray Array;
+					for (int32 Index = 0; Index < 4 * FArray::NumPerChunk; Index++)
+					{
+						Array.Add(Index);
+					}
+
+					while (Array.Num() > 0)
+					{
+						Value += Array.PopFirstChunk()[0];
+					}
+				}
+			};
+
+			RunBenchmark(
+				"TVoxelChunkedArray::Add/PopFirstChunk (pool)",
+				NumInnerRuns,
+				[&]
+				{
+					GVoxelChunkPoolEnabled = false;
+				},
+				[&]
+				{
+					GVoxelChunkPoolEnabled = true;
+				},
+				Execute,
+				Execute);
+
+			GVoxelChunkPoolEnabled = bPoolWasEnabled;
+		}
+
+		{
+			struct FSharedObject
+			{
+				int32 Value = 0;
+			};
+			struct FRefCountObject : TVoxelRefCountBase<FRefCountObject>
+			{
+				int32 Value = 0;
+			};
+			struct FRefCountObject_NotThreadSafe : TVoxelRefCountBase<FRefCountObject_NotThreadSafe, ESPMode::NotThreadSafe>
+			{
+				int32 Value = 0;
+			};
+
+			constexpr int32 NumInnerRuns = 100000;
+			int32 Value = 0;
+
+			const TSharedRef<FSharedObject> SharedObject = MakeShared<FSharedObject>();
+			const TVoxelIntrusiveRef<FRefCountObject> RefCountObject = MakeVoxelIntrusive<FRefCountObject>();
+
+			RunBenchmark(
+				"TSharedPtr/TVoxelRefCountPtr copy",
+				NumInnerRuns,
+				nullptr,
+				nullptr,
+				[&](const int32 NumRuns)
+				{
+					for (int32 Run = 0; Run < NumRuns; Run++)
+					{
+						const TSharedPtr<FSharedObject> Copy = SharedObject;
+						Value += Copy->Value;
+					}
+				},
+				[&](const int32 NumRuns)
+				{
+					for (int32 Run = 0; Run < NumRuns; Run++)
+					{
+						const TVoxelRefCountPtr<FRefCountObject> Copy = RefCountObject;
+						Value += Copy->Value;
+					}
+				});
+
+			const TSharedRef<FSharedObject, ESPMode::NotThreadSafe> SharedObject_NotThreadSafe = MakeShared<FSharedObject, ESPMode::NotThreadSafe>();
+			const TVoxelIntrusiveRef<FRefCountObject_NotThreadSafe> RefCountObject_NotThreadSafe = MakeVoxelIntrusive<FRefCountObject_NotThreadSafe>();
+
+			RunBenchmark(
+				"TSharedPtr/TVoxelRefCountPtr copy (not thread safe)",
+				NumInnerRuns,
+				nullptr,
+				nullptr,
+				[&](const int32 NumRuns)
+				{
+					for (int32 Run = 0; Run < NumRuns; Run++)
+					{
+						const TSharedPtr<FSharedObject, ESPMode::NotThreadSafe> Copy = SharedObject_NotThreadSafe;
+						Value += Copy->Value;
+					}
+				},
+				[&](const int32 NumRuns)
+				{
+					for (int32 Run = 0; Run < NumRuns; Run++)
+					{
+						const TVoxelRefCountPtr<FRefCountObject_NotThreadSafe> Copy = RefCountObject_NotThreadSafe;
+						Value += Copy->Value;
+					}
+				});
+		}
+
+		{
+			constexpr int32 NumRuns = 1000;
+
+			const double PromiseAllocations = CountAllocations(NumRuns, []
+			{
+				const FVoxelPromise Promise;
+				Promise.Set();
+			});
+
+			const double ThenAllocations = CountAllocations(NumRuns, []
+			{
+				const FVoxelPromise Promise;
+				const FVoxelFuture Future = Promise.Then_AnyThread([] {});
+				Promise.Set();
+			});
+
+			LOG("Allocations per future: FVoxelPromise: %.2f FVoxelFuture::Then_AnyThread: %.2f",
+				PromiseAllocations,
+				ThenAllocations);
+
+			// Uploads are processed by the RHI
+			if (GDynamicRHI)
+			{
+				// Never destroyed, uploads are processed asynchronously
+				static const TSharedRef<FVoxelBufferPool>& BufferPool = *new TSharedRef<FVoxelBufferPool>(MakeShared<FVoxelBufferPool>(
+					sizeof(uint32),
+					PF_R32_UINT,
+					TEXT("VoxelCoreBenchmark")));
+
+				const TSharedRef<TVoxelArray<uint32>> Data = MakeSharedCopy(TVoxelArray<uint32>());
+				FVoxelUtilities::SetNumZeroed(*Data, 64);
+
+				const double UploadAllocations = CountAllocations(NumRuns, [&]
+				{
+					const TVoxelIntrusiveRef<FVoxelBufferRef> BufferRef = BufferPool->Allocate_AnyThread(Data->Num());
+					BufferPool->Upload_AnyThread(MakeSharedVoidRef(Data), MakeByteVoxelArrayView(*Data), BufferRef);
+				});
+
+				LOG("Allocations per upload on the calling thread: Allocate_AnyThread + Upload_AnyThread: %.2f",
+					UploadAllocations);
+			}
+		}
+
 		{
 			TMap<uint16, uint16> EngineMap;
 			TVoxelMap<uint16, uint16> VoxelMap;
@@ -634,4 +824,104 @@ FORCENOINLINE void FVoxelCoreBenchmark::RunInnerBenchmark(
 	Lambda(NumRuns);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+thread_local int64 GVoxelBenchmarkNumAllocations = 0;
+
+// Forwards everything to the original GMalloc, counting the allocations of each thread
+class FVoxelBenchmarkCountingMalloc final : public FMalloc
+{
+public:
+	FMalloc& Inner;
+
+	explicit FVoxelBenchmarkCountingMalloc(FMalloc& Inner)
+		: Inner(Inner)
+	{
+	}
+
+	//~ Begin FMalloc Interface
+	virtual void* Malloc(const SIZE_T Count, const uint32 Alignment) override
+	{
+		GVoxelBenchmarkNumAllocations++;
+		return Inner.Malloc(Count, Alignment);
+	}
+	virtual void* TryMalloc(const SIZE_T Count, const uint32 Alignment) override
+	{
+		GVoxelBenchmarkNumAllocations++;
+		return Inner.TryMalloc(Count, Alignment);
+	}
+	virtual void* Realloc(void* Original, const SIZE_T Count, const uint32 Alignment) override
+	{
+		GVoxelBenchmarkNumAllocations += Count > 0;
+		return Inner.Realloc(Original, Count, Alignment);
+	}
+	virtual void* TryRealloc(void* Original, const SIZE_T Count, const uint32 Alignment) override
+	{
+		GVoxelBenchmarkNumAllocations += Count > 0;
+		return Inner.TryRealloc(Original, Count, Alignment);
+	}
+	virtual void Free(void* Original) override
+	{
+		Inner.Free(Original);
+	}
+	virtual SIZE_T QuantizeSize(const SIZE_T Count, const uint32 Alignment) override
+	{
+		return Inner.QuantizeSize(Count, Alignment);
+	}
+	virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override
+	{
+		return Inner.GetAllocationSize(Original, SizeOut);
+	}
+	virtual void Trim(const bool bTrimThreadCaches) override
+	{
+		Inner.Trim(bTrimThreadCaches);
+	}
+	virtual void SetupTLSCachesOnCurrentThread() override
+	{
+		Inner.SetupTLSCachesOnCurrentThread();
+	}
+	virtual void ClearAndDisableTLSCachesOnCurrentThread() override
+	{
+		Inner.ClearAndDisableTLSCachesOnCurrentThread();
+	}
+	virtual bool IsInternallyThreadSafe() const override
+	{
+		return Inner.IsInternallyThreadSafe();
+	}
+	virtual const TCHAR* GetDescriptiveName() override
+	{
+		return TEXT("VoxelBenchmarkCountingMalloc");
+	}
+	//~ End FMalloc Interface
+};
+
+double FVoxelCoreBenchmark::CountAllocations(
+	const int32 NumRuns,
+	const TFunctionRef<void()> Lambda)
+{
+	// Never freed: other threads might still be calling it after it's uninstalled
+	static FVoxelBenchmarkCountingMalloc* CountingMalloc = new FVoxelBenchmarkCountingMalloc(*GMalloc);
+
+	FMalloc* PreviousMalloc = GMalloc;
+	if (!ensure(PreviousMalloc == &CountingMalloc->Inner))
+	{
+		return 0.;
+	}
+
+	GMalloc = CountingMalloc;
+	const int64 StartNumAllocations = GVoxelBenchmarkNumAllocations;
+
+	for (int32 Run = 0; Run < NumRuns; Run++)
+	{
+		Lambda();
+	}
+
+	const int64 NumAllocations = GVoxelBenchmarkNumAllocations - StartNumAllocations;
+	GMalloc = PreviousMalloc;
+
+	return double(NumAllocations) / NumRuns;
+}
+
 #undef LOG
\ No newline at end of file
@@ -1,6 +1,76 @@
 // Copyright Voxel Plugin SAS. All Rights Reserved.
 
 #include "VoxelDistanceFieldWrapper.h"
+#include "VoxelFileCache.h"
+#include "Misc/EngineVersion.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, bool, GVoxelDistanceFieldFileCache, true,
+	"voxel.DistanceField.FileCache",
+	"If true, distance fields built with a file cache key are persisted in the voxel file cache");
+
+FVoxelHash GetDistanceFieldFileCacheKey(const FVoxelHash& Key)
+{
+	// Bump to invalidate the distance fields built by previous versions
+	constexpr int32 Version = 1;
+
+	// The distance field layout depends on the engine version
+	const FEngineVersion& EngineVersion = FEngineVersion::Current();
+
+	FVoxelHashBuilder Builder;
+	Builder << MAKE_TAG_64("VOXEL_DF");
+	Builder << Version;
+	Builder << EngineVersion.GetMajor();
+	Builder << EngineVersion.GetMinor();
+	Builder << EngineVersion.GetPatch();
+	Builder << EngineVersion.GetChangelist();
+	Builder << Key;
+	return Builder.MakeHash();
+}
+
+// Only the fields set by FVoxelDistanceFieldWrapper::Build
+void SerializeDistanceField(
+	FArchive& Ar,
+	FDistanceFieldVolumeData& Data,
+	TArray<uint8>& StreamableMipData)
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	for (FSparseDistanceFieldMip& Mip : Data.Mips)
+	{
+		Ar << Mip.IndirectionDimensions;
+		Ar << Mip.NumDistanceFieldBricks;
+		Ar << Mip.VolumeToVirtualUVScale;
+		Ar << Mip.VolumeToVirtualUVAdd;
+		Ar << Mip.DistanceFieldToVolumeScaleBias;
+		Ar << Mip.BulkOffset;
+		Ar << Mip.BulkSize;
+	}
+
+	Ar << Data.AlwaysLoadedMip;
+	Ar << StreamableMipData;
+	Ar << Data.LocalSpaceMeshBounds;
+	Ar << Data.bMostlyTwoSided;
+}
+
+void SetStreamableMips(
+	FDistanceFieldVolumeData& Data,
+	const TArray<uint8>& StreamableMipData)
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	Data.StreamableMips.Lock(LOCK_READ_WRITE);
+	uint8* Ptr = static_cast<uint8*>(Data.StreamableMips.Realloc(StreamableMipData.Num()));
+	FMemory::Memcpy(Ptr, StreamableMipData.GetData(), StreamableMipData.Num());
+	Data.StreamableMips.Unlock();
+	Data.StreamableMips.SetBulkDataFlags(BULKDATA_Force_NOT_InlinePayload);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
 
 void FVoxelDistanceFieldWrapper::FMip::Initialize(const FVoxelDistanceFieldWrapper& Wrapper)
 {
@@ -22,26 +92,148 @@ void FVoxelDistanceFieldWrapper::FMip::Initialize(const FVoxelDistanceFieldWrapp
 
 FVoxelDistanceFieldWrapper::FBrick* FVoxelDistanceFieldWrapper::FMip::FindBrick(const FIntVector& Position)
 {
-	return Bricks[FVoxelUtilities::Get3DIndex<int32>(IndirectionSize, Position)].Get();
+	const int32 BrickIndex = BrickIndices[FVoxelUtilities::Get3DIndex<int32>(IndirectionSize, Position)].Get(std::memory_order_acquire);
+	if (BrickIndex < 0)
+	{
+		return nullptr;
+	}
+
+	return &GetBrick(BrickIndex);
 }
 
 FVoxelDistanceFieldWrapper::FBrick& FVoxelDistanceFieldWrapper::FMip::FindOrAddBrick(const FIntVector& Position)
 {
-	TSharedPtr<FBrick>& Ptr = Bricks[FVoxelUtilities::Get3DIndex<int32>(IndirectionSize, Position)];
-	if (!Ptr)
+	TVoxelAtomic<int32>& BrickIndex = BrickIndices[FVoxelUtilities::Get3DIndex<int32>(IndirectionSize, Position)];
+
+	int32 Index = BrickIndex.Get(std::memory_order_acquire);
+	if (Index >= 0)
+	{
+		return GetBrick(Index);
+	}
+
+	if (Index == -1 &&
+		BrickIndex.CompareExchangeStrong(Index, PendingBrickIndex, std::memory_order_acquire))
 	{
-		Ptr = MakeShared<FBrick>(NoInit);
+		const int32 NewIndex = AllocateBrick();
+		BrickIndex.Set(NewIndex, std::memory_order_release);
+		return GetBrick(NewIndex);
 	}
-	return *Ptr;
+
+	// Another thread is allocating this brick
+	while (Index == PendingBrickIndex)
+	{
+		FPlatformProcess::Yield();
+		Index = BrickIndex.Get(std::memory_order_acquire);
+	}
+	return GetBrick(Index);
 }
 
 void FVoxelDistanceFieldWrapper::FMip::AddBrick(
 	const FIntVector& Position,
-	const TSharedRef<FBrick>& Brick)
+	FBrick&& Brick)
 {
-	TSharedPtr<FBrick>& Ptr = Bricks[FVoxelUtilities::Get3DIndex<int32>(IndirectionSize, Position)];
-	ensure(!Ptr);
-	Ptr = Brick;
+	TVoxelAtomic<int32>& BrickIndex = BrickIndices[FVoxelUtilities::Get3DIndex<int32>(IndirectionSize, Position)];
+
+	int32 Expected = -1;
+	if (!ensure(BrickIndex.CompareExchangeStrong(Expected, PendingBrickIndex, std::memory_order_acquire)))
+	{
+		return;
+	}
+
+	const int32 NewIndex = AllocateBrick();
+	GetBrick(NewIndex) = MoveTemp(Brick);
+	BrickIndex.Set(NewIndex, std::memory_order_release);
+}
+
+FVoxelDistanceFieldWrapper::FMip::~FMip()
+{
+	Reset(0);
+}
+
+void FVoxelDistanceFieldWrapper::FMip::Reset(const int32 NumCells)
+{
+	for (const TVoxelAtomic<FBrickChunk*>& Chunk : BrickChunks)
+	{
+		delete Chunk.Get();
+	}
+
+	NumBricks.Set(0);
+	BrickIndices.Init(-1, NumCells);
+	BrickChunks.Init(nullptr, FVoxelUtilities::DivideCeil_Positive(NumCells, NumBricksPerChunk));
+}
+
+int32 FVoxelDistanceFieldWrapper::FMip::AllocateBrick()
+{
+	// At most one brick per cell as cells are claimed before allocating
+	const int32 BrickIndex = NumBricks.Increment_ReturnOld();
+	checkVoxelSlow(BrickIndex < BrickIndices.Num());
+
+	TVoxelAtomic<FBrickChunk*>& Chunk = BrickChunks[BrickIndex / NumBricksPerChunk];
+	if (!Chunk.Get(std::memory_order_acquire))
+	{
+		FBrickChunk* NewChunk = new FBrickChunk(NoInit);
+
+		FBrickChunk* ExpectedChunk = nullptr;
+		if (!Chunk.CompareExchangeStrong(ExpectedChunk, NewChunk, std::memory_order_acq_rel))
+		{
+			// Allocated by another thread
+			delete NewChunk;
+		}
+	}
+
+	return BrickIndex;
+}
+
+void FVoxelDistanceFieldWrapper::FMip::Build(
+	TVoxelArray<uint32>& OutIndirectionTable,
+	TVoxelArray<uint8>& OutBrickData) const
+{
+	VOXEL_FUNCTION_COUNTER();
+	checkStatic(DistanceField::DistanceFieldFormat == PF_G8);
+
+	FVoxelUtilities::SetNumFast(OutIndirectionTable, BrickIndices.Num());
+
+	OutBrickData.Reset();
+	OutBrickData.Reserve(NumBricks.Get() * sizeof(FBrick));
+
+	// Bricks entirely 0 are fully inside the mesh, they all share the same brick
+	int32 InsideBrickIndex = -1;
+
+	for (int32 IndirectionIndex = 0; IndirectionIndex < BrickIndices.Num(); IndirectionIndex++)
+	{
+		const int32 StorageIndex = BrickIndices[IndirectionIndex].Get(std::memory_order_acquire);
+		if (StorageIndex < 0)
+		{
+			OutIndirectionTable[IndirectionIndex] = DistanceField::InvalidBrickIndex;
+			continue;
+		}
+
+		const FBrick& Brick = GetBrick(StorageIndex);
+
+		// Bricks entirely 255 are further than the encoding band, same as no brick at all
+		if (FVoxelUtilities::AllEqual(MakeVoxelArrayView(Brick), 255))
+		{
+			OutIndirectionTable[IndirectionIndex] = DistanceField::InvalidBrickIndex;
+			continue;
+		}
+
+		const bool bIsInside = FVoxelUtilities::AllEqual(MakeVoxelArrayView(Brick), 0);
+		if (bIsInside &&
+			InsideBrickIndex != -1)
+		{
+			OutIndirectionTable[IndirectionIndex] = InsideBrickIndex;
+			continue;
+		}
+
+		const int32 BrickIndex = OutBrickData.Num() / sizeof(FBrick);
+		OutBrickData.Append(Brick.GetData(), Brick.Num());
+		OutIndirectionTable[IndirectionIndex] = BrickIndex;
+
+		if (bIsInside)
+		{
+			InsideBrickIndex = BrickIndex;
+		}
+	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -57,19 +249,32 @@ void FVoxelDistanceFieldWrapper::SetSize(const FIntVector& Mip0IndirectionSize)
 			FVoxelUtilities::DivideCeil_Positive(Mip0IndirectionSize.Y, 1 << MipIndex),
 			FVoxelUtilities::DivideCeil_Positive(Mip0IndirectionSize.Z, 1 << MipIndex));
 
-		Mips[MipIndex].Bricks.Reset();
-		Mips[MipIndex].Bricks.SetNum(Mips[MipIndex].IndirectionSize.X * Mips[MipIndex].IndirectionSize.Y * Mips[MipIndex].IndirectionSize.Z);
+		Mips[MipIndex].Reset(Mips[MipIndex].IndirectionSize.X * Mips[MipIndex].IndirectionSize.Y * Mips[MipIndex].IndirectionSize.Z);
 
 		Mips[MipIndex].Initialize(*this);
 	}
 }
 
-TSharedRef<FDistanceFieldVolumeData> FVoxelDistanceFieldWrapper::Build() const
+TSharedRef<FDistanceFieldVolumeData> FVoxelDistanceFieldWrapper::Build(const TOptional<FVoxelHash>& FileCacheKey) const
 {
 	VOXEL_FUNCTION_COUNTER();
 
 	const TSharedRef<FDistanceFieldVolumeData> OutData = MakeShared<FDistanceFieldVolumeData>();
 
+	struct FMipData
+	{
+		TVoxelArray<uint32> IndirectionTable;
+		TVoxelArray<uint8> DistanceFieldBrickData;
+	};
+	TVoxelStaticArray<FMipData, DistanceField::NumMips> MipDatas;
+
+	ParallelFor(DistanceField::NumMips, [&](const int32 MipIndex)
+	{
+		Mips[MipIndex].Build(
+			MipDatas[MipIndex].IndirectionTable,
+			MipDatas[MipIndex].DistanceFieldBrickData);
+	});
+
 	TArray<uint8> StreamableMipData;
 
 	for (int32 MipIndex = 0; MipIndex < DistanceField::NumMips; MipIndex++)
@@ -77,56 +282,14 @@ TSharedRef<FDistanceFieldVolumeData> FVoxelDistanceFieldWrapper::Build() const
 		VOXEL_SCOPE_COUNTER("Mip");
 
 		const FMip& Mip = Mips[MipIndex];
+		const TVoxelArray<uint32>& IndirectionTable = MipDatas[MipIndex].IndirectionTable;
+		const TVoxelArray<uint8>& DistanceFieldBrickData = MipDatas[MipIndex].DistanceFieldBrickData;
 
 		FSparseDistanceFieldMip& OutMip = OutData->Mips[MipIndex];
-		TVoxelArray<uint32> IndirectionTable;
-		IndirectionTable.Empty(Mip.IndirectionSize.X * Mip.IndirectionSize.Y * Mip.IndirectionSize.Z);
-		IndirectionTable.AddUninitialized(Mip.IndirectionSize.X * Mip.IndirectionSize.Y * Mip.IndirectionSize.Z);
-
-		for (int32 i = 0; i < IndirectionTable.Num(); i++)
-		{
-			IndirectionTable[i] = DistanceField::InvalidBrickIndex;
-		}
-
-		uint32 NumBricks = 0;
-		for (const TSharedPtr<FBrick>& Brick : Mip.Bricks)
-		{
-			if (Brick)
-			{
-				NumBricks++;
-			}
-		}
 
 		const uint32 BrickSizeBytes = DistanceField::BrickSize * DistanceField::BrickSize * DistanceField::BrickSize * GPixelFormats[DistanceField::DistanceFieldFormat].BlockBytes;
-
-		TVoxelArray<uint8> DistanceFieldBrickData;
-		DistanceFieldBrickData.Empty(BrickSizeBytes * NumBricks);
-		DistanceFieldBrickData.AddUninitialized(BrickSizeBytes * NumBricks);
-
-		int32 BrickIndex = 0;
-		for (int32 X = 0; X < Mip.IndirectionSize.X; X++)
-		{
-			for (int32 Y = 0; Y < Mip.IndirectionSize.X; Y++)
-			{
-				for (int32 Z = 0; Z < Mip.IndirectionSize.X; Z++)
-				{
-					const int32 IndirectionIndex = FVoxelUtilities::Get3DIndex<int32>(Mip.IndirectionSize, X, Y, Z);
-					const TSharedPtr<FBrick>& Brick = Mip.Bricks[IndirectionIndex];
-
-					if (!Brick)
-					{
-						IndirectionTable[IndirectionIndex] = DistanceField::InvalidBrickIndex;
-						continue;
-					}
-
-					IndirectionTable[IndirectionIndex] = BrickIndex;
-					FMemory::Memcpy(&DistanceFieldBrickData[BrickIndex * BrickSizeBytes], Brick->GetData(), Brick->Num() * Brick->GetTypeSize());
-
-					BrickIndex++;
-				}
-			}
-		}
-		check(BrickIndex == NumBricks);
+		check(DistanceFieldBrickData.Num() % BrickSizeBytes == 0);
+		const uint32 NumBricks = DistanceFieldBrickData.Num() / BrickSizeBytes;
 
 		const int32 IndirectionTableBytes = IndirectionTable.Num() * IndirectionTable.GetTypeSize();
 		const int32 MipDataBytes = IndirectionTableBytes + DistanceFieldBrickData.Num();
@@ -181,12 +344,57 @@ TSharedRef<FDistanceFieldVolumeData> FVoxelDistanceFieldWrapper::Build() const
 	OutData->LocalSpaceMeshBounds = FBox3f(LocalSpaceMeshBounds);
 	OutData->bMostlyTwoSided = true;
 
-	VOXEL_SCOPE_COUNTER("Final copy");
-	OutData->StreamableMips.Lock(LOCK_READ_WRITE);
-	uint8* Ptr = static_cast<uint8*>(OutData->StreamableMips.Realloc(StreamableMipData.Num()));
-	FMemory::Memcpy(Ptr, StreamableMipData.GetData(), StreamableMipData.Num());
-	OutData->StreamableMips.Unlock();
-	OutData->StreamableMips.SetBulkDataFlags(BULKDATA_Force_NOT_InlinePayload);
+	if (FileCacheKey.IsSet() &&
+		GVoxelDistanceFieldFileCache)
+	{
+		VOXEL_SCOPE_COUNTER("Store in file cache");
+
+		TArray64<uint8> Data;
+		{
+			FMemoryWriter64 Writer(Data);
+			SerializeDistanceField(Writer, *OutData, StreamableMipData);
+		}
+
+		FVoxelFileCache::Get().Store(GetDistanceFieldFileCacheKey(FileCacheKey.GetValue()), Data);
+	}
+
+	SetStreamableMips(*OutData, StreamableMipData);
+
+	return OutData;
+}
+
+TSharedPtr<FDistanceFieldVolumeData> FVoxelDistanceFieldWrapper::LoadFromFileCache(const FVoxelHash& FileCacheKey)
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	if (!GVoxelDistanceFieldFileCache)
+	{
+		return nullptr;
+	}
+
+	const FVoxelHash Key = GetDistanceFieldFileCacheKey(FileCacheKey);
+
+	TVoxelArray64<uint8> Data;
+	if (!FVoxelFileCache::Get().Load(Key, Data))
+	{
+		return nullptr;
+	}
+
+	const TSharedRef<FDistanceFieldVolumeData> OutData = MakeShared<FDistanceFieldVolumeData>();
+	TArray<uint8> StreamableMipData;
+
+	FMemoryReaderView Reader(MakeMemoryView(Data.GetData(), Data.Num()));
+	SerializeDistanceField(Reader, *OutData, StreamableMipData);
+
+	if (Reader.IsError() ||
+		Reader.Tell() != Reader.TotalSize())
+	{
+		LOG_VOXEL(Warning, "Invalid distance field in file cache entry %s", *Key.ToString());
+		FVoxelFileCache::Get().Remove(Key);
+		return nullptr;
+	}
+
+	SetStreamableMips(*OutData, StreamableMipData);
 
 	return OutData;
 }
\ No newline at end of file
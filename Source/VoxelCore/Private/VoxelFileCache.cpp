@@ -0,0 +1,703 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#include "VoxelFileCache.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, int32, GVoxelFileCacheMaxSizeMB, 2048,
+	"voxel.FileCache.MaxSizeMB",
+	"Max size of the persistent file cache in MB. Least recently used entries are deleted in the background when it is exceeded");
+
+VOXEL_CONSOLE_COMMAND(
+	"voxel.FileCache.Clear",
+	"Delete all the entries of the persistent file cache")
+{
+	FVoxelFileCache::Get().Clear();
+}
+
+// Compact the journal into a new snapshot once it has this many records
+constexpr int32 GVoxelFileCacheMaxJournalRecords = 4096;
+// Flush the index in the background once this many updates are pending, LRU updates from loads included
+constexpr int32 GVoxelFileCacheMaxPendingRecords = 256;
+
+// Set once Get is first called
+TVoxelAtomic<FVoxelFileCache*> GVoxelFileCache;
+
+VOXEL_CONSOLE_SINK()
+{
+	FVoxelFileCache* Cache = GVoxelFileCache.Get();
+	if (!Cache)
+	{
+		return;
+	}
+
+	const int64 MaxSize = int64(GVoxelFileCacheMaxSizeMB) * 1024 * 1024;
+	if (Cache->GetMaxSize() == MaxSize)
+	{
+		return;
+	}
+
+	Cache->SetMaxSize(MaxSize);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+FVoxelFileCache& FVoxelFileCache::Get()
+{
+	static FVoxelFileCache* Cache = INLINE_LAMBDA
+	{
+		FVoxelFileCache* Result = new FVoxelFileCache(
+			FVoxelUtilities::GetAppDataCache() / "FileCache",
+			int64(GVoxelFileCacheMaxSizeMB) * 1024 * 1024);
+
+		FCoreDelegates::OnPreExit.AddLambda([=]
+		{
+			Result->Flush();
+		});
+
+		GVoxelFileCache.Set(Result);
+		return Result;
+	};
+	return *Cache;
+}
+
+FVoxelFileCache::FVoxelFileCache(
+	const FString& Directory,
+	const int64 MaxSize)
+	: Directory(Directory)
+	, MaxSize(MaxSize)
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	IFileManager::Get().MakeDirectory(*Directory, true);
+
+	LoadIndex();
+	EnforceSizeAsync();
+}
+
+FVoxelFileCache::~FVoxelFileCache()
+{
+	while (IsEnforcingSize.Get())
+	{
+		FPlatformProcess::Yield();
+	}
+
+	Flush();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+bool FVoxelFileCache::Load(const FVoxelHash& Key, TVoxelArray64<uint8>& OutData)
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	int64 Size;
+	bool bFlush;
+	{
+		VOXEL_SCOPE_LOCK(CriticalSection);
+
+		FEntry* Entry = Entries_RequiresLock.Find(Key);
+		if (!Entry)
+		{
+			return false;
+		}
+
+		Size = Entry->Size;
+
+		FEntry NewEntry = *Entry;
+		NewEntry.LastAccessTime = FDateTime::UtcNow().GetTicks();
+		SetEntry_RequiresLock(Key, NewEntry);
+
+		bFlush = PendingRecords_RequiresLock.Num() >= GVoxelFileCacheMaxPendingRecords;
+	}
+
+	if (bFlush)
+	{
+		// Don't let access time updates pile up in a read-only session
+		EnforceSizeAsync();
+	}
+
+	const TUniquePtr<IFileHandle> FileHandle(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*GetEntryPath(Key)));
+	if (!FileHandle ||
+		FileHandle->Size() != Size)
+	{
+		LOG_VOXEL(Warning, "File cache entry %s is missing or corrupted", *Key.ToString());
+		Remove(Key);
+		return false;
+	}
+
+	FVoxelUtilities::SetNumFast(OutData, Size);
+
+	VOXEL_SCOPE_COUNTER_FORMAT("Read %lldB", Size);
+
+	if (!FileHandle->Read(OutData.GetData(), Size))
+	{
+		OutData.Reset();
+		Remove(Key);
+		return false;
+	}
+
+	return true;
+}
+
+void FVoxelFileCache::Store(const FVoxelHash& Key, const TConstVoxelArrayView64<uint8> Data)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Data.Num(), 0);
+
+	{
+		VOXEL_SCOPE_LOCK(CriticalSection);
+
+		if (Entries_RequiresLock.Contains(Key))
+		{
+			return;
+		}
+	}
+
+	// Write to a unique temp file then rename it, so that a concurrent reader or a crash never sees a partial entry
+	const FString Path = GetEntryPath(Key);
+	const FString TempPath = Path + "." + FGuid::NewGuid().ToString() + ".tmp";
+
+	{
+		VOXEL_SCOPE_COUNTER_FORMAT("Write %lldB", Data.Num());
+
+		const TUniquePtr<IFileHandle> FileHandle(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*TempPath));
+		if (!FileHandle ||
+			!FileHandle->Write(Data.GetData(), Data.Num()))
+		{
+			LOG_VOXEL(Warning, "Failed to write %s", *TempPath);
+			IFileManager::Get().Delete(*TempPath, false, false, true);
+			return;
+		}
+	}
+
+	if (!IFileManager::Get().Move(*Path, *TempPath, true, true, false, true))
+	{
+		// Most likely stored concurrently and opened by a reader
+		IFileManager::Get().Delete(*TempPath, false, false, true);
+
+		if (IFileManager::Get().FileSize(*Path) != Data.Num())
+		{
+			return;
+		}
+	}
+
+	{
+		VOXEL_SCOPE_LOCK(CriticalSection);
+
+		FEntry Entry;
+		Entry.Size = Data.Num();
+		Entry.LastAccessTime = FDateTime::UtcNow().GetTicks();
+		SetEntry_RequiresLock(Key, Entry);
+
+		if (TotalSize_RequiresLock <= MaxSize.Get() &&
+			PendingRecords_RequiresLock.Num() < GVoxelFileCacheMaxPendingRecords)
+		{
+			return;
+		}
+	}
+
+	EnforceSizeAsync();
+}
+
+void FVoxelFileCache::Remove(const FVoxelHash& Key)
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	{
+		VOXEL_SCOPE_LOCK(CriticalSection);
+
+		if (!Entries_RequiresLock.Contains(Key))
+		{
+			return;
+		}
+
+		RemoveEntry_RequiresLock(Key);
+	}
+
+	IFileManager::Get().Delete(*GetEntryPath(Key), false, false, true);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelFileCache::Clear()
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	TVoxelArray<FVoxelHash> Keys;
+	{
+		VOXEL_SCOPE_LOCK(CriticalSection);
+
+		Keys.Reserve(Entries_RequiresLock.Num());
+		for (const auto& It : Entries_RequiresLock)
+		{
+			Keys.Add_CheckNoGrow(It.Key);
+		}
+	}
+
+	for (const FVoxelHash& Key : Keys)
+	{
+		Remove(Key);
+	}
+
+	WriteSnapshot();
+}
+
+void FVoxelFileCache::Flush()
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	{
+		VOXEL_SCOPE_LOCK(IndexCriticalSection);
+
+		TVoxelArray<FRecord> Records;
+		{
+			VOXEL_SCOPE_LOCK(CriticalSection);
+			Records = MoveTemp(PendingRecords_RequiresLock);
+		}
+
+		if (Records.Num() == 0 &&
+			NumJournalRecords_RequiresLock <= GVoxelFileCacheMaxJournalRecords)
+		{
+			return;
+		}
+
+		if (NumJournalRecords_RequiresLock + Records.Num() <= GVoxelFileCacheMaxJournalRecords)
+		{
+			const TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*GetJournalPath(), FILEWRITE_Append | FILEWRITE_Silent));
+			if (Writer)
+			{
+				for (FRecord& Record : Records)
+				{
+					*Writer << Record;
+				}
+			}
+
+			if (!Writer ||
+				!Writer->Close())
+			{
+				LOG_VOXEL(Warning, "Failed to write %s", *GetJournalPath());
+
+				// Keep the records for the next flush, before any record added since
+				{
+					VOXEL_SCOPE_LOCK(CriticalSection);
+					Records.Append(PendingRecords_RequiresLock);
+					PendingRecords_RequiresLock = MoveTemp(Records);
+				}
+
+				if (Writer)
+				{
+					// The journal might end with a partial record now, write a snapshot next time
+					NumJournalRecords_RequiresLock = MAX_int32 / 2;
+				}
+				return;
+			}
+
+			NumJournalRecords_RequiresLock += Records.Num();
+			return;
+		}
+	}
+
+	// Journal is too big, compact it. Records are already applied to the entries so the snapshot includes them
+	WriteSnapshot();
+}
+
+void FVoxelFileCache::SetMaxSize(const int64 NewMaxSize)
+{
+	MaxSize.Set(NewMaxSize);
+	EnforceSizeAsync();
+}
+
+int64 FVoxelFileCache::GetMaxSize() const
+{
+	return MaxSize.Get();
+}
+
+int64 FVoxelFileCache::GetTotalSize() const
+{
+	VOXEL_SCOPE_LOCK(CriticalSection);
+	return TotalSize_RequiresLock;
+}
+
+int32 FVoxelFileCache::NumEntries() const
+{
+	VOXEL_SCOPE_LOCK(CriticalSection);
+	return Entries_RequiresLock.Num();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+FString FVoxelFileCache::GetEntryPath(const FVoxelHash& Key) const
+{
+	return Directory / Key.ToString() + ".bin";
+}
+
+FString FVoxelFileCache::GetIndexPath() const
+{
+	return Directory / "Index.dat";
+}
+
+FString FVoxelFileCache::GetJournalPath() const
+{
+	return Directory / "Journal.dat";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelFileCache::LoadIndex()
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	const auto LoadRecords = [&]
+	{
+		TArray64<uint8> IndexData;
+		if (!FFileHelper::LoadFileToArray(IndexData, *GetIndexPath(), FILEREAD_Silent))
+		{
+			LOG_VOXEL(Log, "No file cache index in %s, rebuilding it", *Directory);
+			return false;
+		}
+
+		FMemoryReaderView IndexReader(MakeMemoryView(IndexData.GetData(), IndexData.Num()));
+
+		FIndexHeader Header;
+		if (IndexData.Num() >= FIndexHeader::SerializedSize)
+		{
+			IndexReader << Header;
+		}
+
+		if (IndexData.Num() < FIndexHeader::SerializedSize ||
+			Header.Tag != FIndexHeader().Tag ||
+			Header.Version != FIndexHeader().Version ||
+			Header.NumRecords < 0 ||
+			IndexData.Num() != FIndexHeader::SerializedSize + Header.NumRecords * FRecord::SerializedSize)
+		{
+			LOG_VOXEL(Warning, "Invalid file cache index in %s, rebuilding it", *Directory);
+			return false;
+		}
+
+		TArray64<uint8> JournalData;
+		FFileHelper::LoadFileToArray(JournalData, *GetJournalPath(), FILEREAD_Silent);
+
+		FMemoryReaderView JournalReader(MakeMemoryView(JournalData.GetData(), JournalData.Num()));
+
+		const auto ApplyRecords = [&](FArchive& Reader, const int64 NumRecords)
+		{
+			for (int64 Index = 0; Index < NumRecords; Index++)
+			{
+				FRecord Record;
+				Reader << Record;
+
+				if (Record.Size < 0)
+				{
+					if (Entries_RequiresLock.Contains(Record.Key))
+					{
+						RemoveEntry_RequiresLock(Record.Key);
+					}
+					continue;
+				}
+
+				FEntry Entry;
+				Entry.Size = Record.Size;
+				Entry.LastAccessTime = Record.LastAccessTime;
+				SetEntry_RequiresLock(Record.Key, Entry);
+			}
+		};
+
+		VOXEL_SCOPE_LOCK(CriticalSection);
+
+		Entries_RequiresLock.Reserve(Header.NumRecords);
+
+		ApplyRecords(IndexReader, Header.NumRecords);
+		// A trailing partial record is a write interrupted by a crash, ignore it
+		ApplyRecords(JournalReader, JournalData.Num() / FRecord::SerializedSize);
+
+		// Already persisted, unless the journal has to be compacted
+		PendingRecords_RequiresLock.Reset();
+
+		return JournalData.Num() == 0;
+	};
+
+	const bool bSnapshotIsUpToDate = LoadRecords();
+
+	if (!ReconcileIndex() &&
+		bSnapshotIsUpToDate)
+	{
+		return;
+	}
+
+	WriteSnapshot();
+}
+
+bool FVoxelFileCache::ReconcileIndex()
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	// Store journals an entry after writing its file: a crash in between leaves a file the index doesn't know about,
+	// which would never be counted nor evicted. Only list names here, stat-ing every file is what the index avoids
+	TVoxelSet<FVoxelHash> FoundKeys;
+	TVoxelArray<TPair<FVoxelHash, FString>> FoundFiles;
+	TVoxelArray<FString> FilesToDelete;
+
+	IFileManager::Get().IterateDirectory(*Directory, [&](const TCHAR* Path, const bool bIsDirectory)
+	{
+		if (bIsDirectory)
+		{
+			return true;
+		}
+
+		const FString Filename = FPaths::GetCleanFilename(Path);
+		if (Filename.EndsWith(".tmp"))
+		{
+			// Leftover from an interrupted store
+			FilesToDelete.Add(Path);
+			return true;
+		}
+
+		if (!Filename.EndsWith(".bin"))
+		{
+			return true;
+		}
+
+		FVoxelHash Key;
+		const FString KeyString = FPaths::GetBaseFilename(Filename);
+		if (KeyString.Len() != 40 ||
+			HexToBytes(KeyString, ReinterpretCastPtr<uint8>(&Key)) != 20)
+		{
+			FilesToDelete.Add(Path);
+			return true;
+		}
+
+		FoundKeys.Add(Key);
+		FoundFiles.Add({ Key, Path });
+		return true;
+	});
+
+	for (const FString& File : FilesToDelete)
+	{
+		IFileManager::Get().Delete(*File, false, false, true);
+	}
+
+	TVoxelArray<TPair<FVoxelHash, FString>> UnknownFiles;
+	{
+		VOXEL_SCOPE_LOCK(CriticalSection);
+
+		for (const TPair<FVoxelHash, FString>& FoundFile : FoundFiles)
+		{
+			if (!Entries_RequiresLock.Contains(FoundFile.Key))
+			{
+				UnknownFiles.Add(FoundFile);
+			}
+		}
+	}
+
+	TVoxelArray<TPair<FVoxelHash, FEntry>> NewEntries;
+	for (const TPair<FVoxelHash, FString>& UnknownFile : UnknownFiles)
+	{
+		const FFileStatData StatData = IFileManager::Get().GetStatData(*UnknownFile.Value);
+		if (!StatData.bIsValid)
+		{
+			continue;
+		}
+
+		FEntry Entry;
+		Entry.Size = StatData.FileSize;
+		Entry.LastAccessTime = StatData.ModificationTime.GetTicks();
+		NewEntries.Add({ UnknownFile.Key, Entry });
+	}
+
+	VOXEL_SCOPE_LOCK(CriticalSection);
+
+	TVoxelArray<FVoxelHash> MissingKeys;
+	for (const auto& It : Entries_RequiresLock)
+	{
+		if (!FoundKeys.Contains(It.Key))
+		{
+			MissingKeys.Add(It.Key);
+		}
+	}
+
+	for (const FVoxelHash& Key : MissingKeys)
+	{
+		RemoveEntry_RequiresLock(Key);
+	}
+
+	for (const TPair<FVoxelHash, FEntry>& NewEntry : NewEntries)
+	{
+		SetEntry_RequiresLock(NewEntry.Key, NewEntry.Value);
+	}
+
+	if (MissingKeys.Num() > 0 ||
+		NewEntries.Num() > 0)
+	{
+		LOG_VOXEL(Log, "File cache: added %d files missing from the index, removed %d entries without a file", NewEntries.Num(), MissingKeys.Num());
+	}
+
+	return PendingRecords_RequiresLock.Num() > 0;
+}
+
+void FVoxelFileCache::WriteSnapshot()
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	VOXEL_SCOPE_LOCK(IndexCriticalSection);
+
+	TArray64<uint8> Data;
+	{
+		VOXEL_SCOPE_LOCK(CriticalSection);
+
+		FIndexHeader Header;
+		Header.NumRecords = Entries_RequiresLock.Num();
+
+		Data.Reserve(FIndexHeader::SerializedSize + Header.NumRecords * FRecord::SerializedSize);
+
+		FMemoryWriter64 Writer(Data);
+		Writer << Header;
+
+		for (const auto& It : Entries_RequiresLock)
+		{
+			FRecord Record;
+			Record.Key = It.Key;
+			Record.Size = It.Value.Size;
+			Record.LastAccessTime = It.Value.LastAccessTime;
+			Writer << Record;
+		}
+		ensure(Data.Num() == FIndexHeader::SerializedSize + Header.NumRecords * FRecord::SerializedSize);
+
+		// Included in the snapshot
+		PendingRecords_RequiresLock.Reset();
+	}
+
+	const FString TempPath = GetIndexPath() + ".tmp";
+	if (!FFileHelper::SaveArrayToFile(Data, *TempPath) ||
+		!IFileManager::Get().Move(*GetIndexPath(), *TempPath, true, true))
+	{
+		LOG_VOXEL(Warning, "Failed to write %s", *GetIndexPath());
+
+		// The records we just reset are only in memory now, write a snapshot again on the next flush
+		NumJournalRecords_RequiresLock = MAX_int32 / 2;
+		return;
+	}
+
+	IFileManager::Get().Delete(*GetJournalPath(), false, false, true);
+	NumJournalRecords_RequiresLock = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelFileCache::SetEntry_RequiresLock(const FVoxelHash& Key, const FEntry& Entry)
+{
+	checkVoxelSlow(CriticalSection.IsLocked());
+
+	FEntry& ExistingEntry = Entries_RequiresLock.FindOrAdd(Key);
+	TotalSize_RequiresLock += Entry.Size - ExistingEntry.Size;
+	ExistingEntry = Entry;
+
+	FRecord& Record = PendingRecords_RequiresLock.Emplace_GetRef();
+	Record.Key = Key;
+	Record.Size = Entry.Size;
+	Record.LastAccessTime = Entry.LastAccessTime;
+}
+
+void FVoxelFileCache::RemoveEntry_RequiresLock(const FVoxelHash& Key)
+{
+	checkVoxelSlow(CriticalSection.IsLocked());
+
+	TotalSize_RequiresLock -= Entries_RequiresLock.FindChecked(Key).Size;
+	Entries_RequiresLock.RemoveChecked(Key);
+
+	FRecord& Record = PendingRecords_RequiresLock.Emplace_GetRef();
+	Record.Key = Key;
+	Record.Size = -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelFileCache::EnforceSizeAsync()
+{
+	if (IsEnforcingSize.Exchange_ReturnOld(1) != 0)
+	{
+		return;
+	}
+
+	Voxel::AsyncTask([this]
+	{
+		EnforceSize();
+		Flush();
+
+		ensure(IsEnforcingSize.Exchange_ReturnOld(0) == 1);
+	});
+}
+
+void FVoxelFileCache::EnforceSize()
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	TVoxelArray<TPair<int64, FVoxelHash>> LastAccessTimeToKey;
+	int64 SizeToFree;
+	{
+		VOXEL_SCOPE_LOCK(CriticalSection);
+
+		// Free a bit more than needed so that we don't run for every new entry
+		SizeToFree = TotalSize_RequiresLock - MaxSize.Get() * 9 / 10;
+		if (TotalSize_RequiresLock <= MaxSize.Get() ||
+			SizeToFree <= 0)
+		{
+			return;
+		}
+
+		LastAccessTimeToKey.Reserve(Entries_RequiresLock.Num());
+		for (const auto& It : Entries_RequiresLock)
+		{
+			LastAccessTimeToKey.Add_CheckNoGrow({ It.Value.LastAccessTime, It.Key });
+		}
+	}
+
+	LastAccessTimeToKey.Sort([](const TPair<int64, FVoxelHash>& A, const TPair<int64, FVoxelHash>& B)
+	{
+		return A.Key < B.Key;
+	});
+
+	int32 NumDeleted = 0;
+	for (const TPair<int64, FVoxelHash>& Pair : LastAccessTimeToKey)
+	{
+		if (SizeToFree <= 0)
+		{
+			break;
+		}
+
+		int64 Size;
+		{
+			VOXEL_SCOPE_LOCK(CriticalSection);
+
+			const FEntry* Entry = Entries_RequiresLock.Find(Pair.Value);
+			if (!Entry ||
+				Entry->LastAccessTime != Pair.Key)
+			{
+				// Removed or accessed since we started
+				continue;
+			}
+
+			Size = Entry->Size;
+		}
+
+		Remove(Pair.Value);
+		SizeToFree -= Size;
+		NumDeleted++;
+	}
+
+	LOG_VOXEL(Log, "File cache: deleted %d least recently used entries", NumDeleted);
+}
\ No newline at end of file
@@ -4,6 +4,10 @@
 #include "IImageWrapper.h"
 #include "IImageWrapperModule.h"
 
+THIRD_PARTY_INCLUDES_START
+#include "png.h"
+THIRD_PARTY_INCLUDES_END
+
 TSharedPtr<FVoxelHeightmapImporter> FVoxelHeightmapImporter::MakeImporter(const FString& Path)
 {
 	const FString Extension = FPaths::GetExtension(Path);
@@ -20,6 +24,37 @@ TSharedPtr<FVoxelHeightmapImporter> FVoxelHeightmapImporter::MakeImporter(const
 	return nullptr;
 }
 
+bool FVoxelHeightmapImporter::Import()
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	if (!ReadHeader())
+	{
+		return false;
+	}
+
+	const int32 BytesPerPixel = GetBytesPerPixel();
+	const FIntPoint HeaderSize = Size;
+
+	FVoxelUtilities::SetNumFast(Data, int64(Size.X) * int64(Size.Y) * BytesPerPixel);
+
+	// Tiles are disjoint, they can be copied concurrently
+	return ImportTiles(512, [&](FVoxelHeightmapTile&& Tile)
+	{
+		VOXEL_SCOPE_COUNTER("Copy tile");
+		check(Size == HeaderSize);
+
+		const int64 TileRowSize = int64(Tile.Size.X) * BytesPerPixel;
+		for (int32 Y = 0; Y < Tile.Size.Y; Y++)
+		{
+			FMemory::Memcpy(
+				&Data[(int64(Tile.Start.Y + Y) * Size.X + Tile.Start.X) * BytesPerPixel],
+				&Tile.Data[Y * TileRowSize],
+				TileRowSize);
+		}
+	});
+}
+
 bool FVoxelHeightmapImporter::Import(const FString& Path, FString& OutError, FIntPoint& OutSize, int32& OutBitDepth, TArray64<uint8>& OutData)
 {
 	const TSharedPtr<FVoxelHeightmapImporter> Importer = MakeImporter(Path);
@@ -43,11 +78,266 @@ bool FVoxelHeightmapImporter::Import(const FString& Path, FString& OutError, FIn
 	return true;
 }
 
+void FVoxelHeightmapImporter::EmitBandTiles(
+	const int32 TileSize,
+	const int32 StartY,
+	const int32 NumRows,
+	const TConstVoxelArrayView<uint8> BandData,
+	const bool bSwapBytes,
+	const FOnTile& OnTile) const
+{
+	VOXEL_FUNCTION_COUNTER_NUM(BandData.Num(), 1024);
+
+	const int32 BytesPerPixel = GetBytesPerPixel();
+	check(BandData.Num() == int64(Size.X) * NumRows * BytesPerPixel);
+	check(NumRows <= TileSize);
+
+	const int32 NumTiles = FMath::DivideAndRoundUp(Size.X, TileSize);
+
+	ParallelFor(NumTiles, [&](const int32 TileIndex)
+	{
+		FVoxelHeightmapTile Tile;
+		Tile.Start = FIntPoint(TileIndex * TileSize, StartY);
+		Tile.Size = FIntPoint(FMath::Min(TileSize, Size.X - Tile.Start.X), NumRows);
+
+		const int32 TileRowSize = Tile.Size.X * BytesPerPixel;
+		FVoxelUtilities::SetNumFast(Tile.Data, TileRowSize * NumRows);
+
+		for (int32 Y = 0; Y < NumRows; Y++)
+		{
+			FMemory::Memcpy(
+				&Tile.Data[Y * TileRowSize],
+				&BandData[(int64(Y) * Size.X + Tile.Start.X) * BytesPerPixel],
+				TileRowSize);
+		}
+
+		FInt32Interval MinMax;
+		if (BytesPerPixel == 1)
+		{
+			MinMax = FVoxelUtilities::GetMinMax(TConstVoxelArrayView<uint8>(Tile.Data));
+		}
+		else
+		{
+			const TVoxelArrayView<uint16> Values = MakeVoxelArrayView(Tile.Data).ReinterpretAs<uint16>();
+			if (bSwapBytes)
+			{
+				FVoxelUtilities::ByteSwap(Values);
+			}
+			MinMax = FVoxelUtilities::GetMinMax(Values);
+		}
+
+		Tile.Min = MinMax.Min;
+		Tile.Max = MinMax.Max;
+
+		OnTile(MoveTemp(Tile));
+	});
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
-bool FVoxelHeightmapImporter_PNG::Import()
+// Decodes a png row by row straight from the file
+// libpng reports errors through longjmp: setjmp is only called in small functions without any non-trivial local
+struct FVoxelPngReader
+{
+	const FString Path;
+	TUniquePtr<IFileHandle> FileHandle;
+	png_structp PngStruct = nullptr;
+	png_infop PngInfo = nullptr;
+	FString PngError;
+
+	FIntPoint Size{ ForceInit };
+	int32 BitDepth = 0;
+	bool bIsInterlaced = false;
+
+	explicit FVoxelPngReader(const FString& Path)
+		: Path(Path)
+	{
+	}
+	~FVoxelPngReader()
+	{
+		if (PngStruct)
+		{
+			png_destroy_read_struct(&PngStruct, PngInfo ? &PngInfo : nullptr, nullptr);
+		}
+	}
+
+	bool Initialize(FString& OutError)
+	{
+		VOXEL_FUNCTION_COUNTER();
+
+		FileHandle = TUniquePtr<IFileHandle>(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*Path));
+		if (!FileHandle)
+		{
+			OutError = "Failed to load " + Path;
+			return false;
+		}
+
+		PngStruct = png_create_read_struct(PNG_LIBPNG_VER_STRING, this, &OnError, &OnWarning);
+		if (!ensure(PngStruct))
+		{
+			return false;
+		}
+
+		PngInfo = png_create_info_struct(PngStruct);
+		if (!ensure(PngInfo))
+		{
+			return false;
+		}
+
+		png_set_read_fn(PngStruct, this, &OnRead);
+
+		if (!ReadInfo())
+		{
+			OutError = "Failed to decode " + Path + " as a png";
+			return false;
+		}
+
+		const png_uint_32 Width = png_get_image_width(PngStruct, PngInfo);
+		const png_uint_32 Height = png_get_image_height(PngStruct, PngInfo);
+		const int32 ColorType = png_get_color_type(PngStruct, PngInfo);
+
+		if (ColorType != PNG_COLOR_TYPE_GRAY)
+		{
+			OutError = Path + " needs to be a grayscale png";
+			return false;
+		}
+
+		BitDepth = png_get_bit_depth(PngStruct, PngInfo);
+		if (BitDepth != 8 && BitDepth != 16)
+		{
+			OutError = Path + " needs to be an 8 bit or 16 bit png";
+			return false;
+		}
+
+		if (Width > MAX_int32 ||
+			Height > MAX_int32)
+		{
+			OutError = Path + " is too large";
+			return false;
+		}
+
+		Size.X = Width;
+		Size.Y = Height;
+		bIsInterlaced = png_get_interlace_type(PngStruct, PngInfo) != PNG_INTERLACE_NONE;
+
+		return true;
+	}
+
+	bool ReadInfo()
+	{
+		if (setjmp(png_jmpbuf(PngStruct)))
+		{
+			return false;
+		}
+
+		png_read_info(PngStruct, PngInfo);
+		return true;
+	}
+	bool ReadRow(uint8* Row)
+	{
+		if (setjmp(png_jmpbuf(PngStruct)))
+		{
+			return false;
+		}
+
+		png_read_row(PngStruct, Row, nullptr);
+		return true;
+	}
+
+private:
+	static void OnRead(const png_structp PngStruct, const png_bytep Data, const png_size_t Length)
+	{
+		const FVoxelPngReader& Reader = *static_cast<FVoxelPngReader*>(png_get_io_ptr(PngStruct));
+		if (!Reader.FileHandle->Read(Data, Length))
+		{
+			png_error(PngStruct, "Unexpected end of file");
+		}
+	}
+	static void OnError(const png_structp PngStruct, const png_const_charp Message)
+	{
+		// libpng will longjmp once we return
+		FVoxelPngReader& Reader = *static_cast<FVoxelPngReader*>(png_get_error_ptr(PngStruct));
+		Reader.PngError = UTF8_TO_TCHAR(Message);
+	}
+	static void OnWarning(const png_structp PngStruct, const png_const_charp Message)
+	{
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+bool FVoxelHeightmapImporter_PNG::ReadHeader()
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	FVoxelPngReader Reader(Path);
+	if (!Reader.Initialize(Error))
+	{
+		return false;
+	}
+
+	Size = Reader.Size;
+	BitDepth = Reader.BitDepth;
+	return true;
+}
+
+bool FVoxelHeightmapImporter_PNG::ImportTiles(const int32 TileSize, const FOnTile& OnTile)
+{
+	VOXEL_FUNCTION_COUNTER();
+	check(TileSize > 0 && TileSize <= 16384);
+
+	FVoxelPngReader Reader(Path);
+	if (!Reader.Initialize(Error))
+	{
+		return false;
+	}
+
+	if (Reader.bIsInterlaced)
+	{
+		return ImportTiles_ImageWrapper(TileSize, OnTile);
+	}
+
+	Size = Reader.Size;
+	BitDepth = Reader.BitDepth;
+
+	const int64 RowSize = int64(Size.X) * GetBytesPerPixel();
+	if (RowSize * TileSize > MAX_int32)
+	{
+		Error = Path + " is too large";
+		return false;
+	}
+
+	TVoxelArray<uint8> BandData;
+	for (int32 StartY = 0; StartY < Size.Y; StartY += TileSize)
+	{
+		const int32 NumRows = FMath::Min(TileSize, Size.Y - StartY);
+		FVoxelUtilities::SetNumFast(BandData, int32(RowSize * NumRows));
+
+		{
+			VOXEL_SCOPE_COUNTER("Decode rows");
+
+			for (int32 Row = 0; Row < NumRows; Row++)
+			{
+				if (!Reader.ReadRow(&BandData[int32(Row * RowSize)]))
+				{
+					Error = Path + ": failed to decompress png data: " + Reader.PngError;
+					return false;
+				}
+			}
+		}
+
+		// Png stores 16 bit values as big-endian
+		EmitBandTiles(TileSize, StartY, NumRows, BandData, BitDepth == 16 && PLATFORM_LITTLE_ENDIAN, OnTile);
+	}
+
+	return true;
+}
+
+bool FVoxelHeightmapImporter_PNG::ImportTiles_ImageWrapper(const int32 TileSize, const FOnTile& OnTile)
 {
 	VOXEL_FUNCTION_COUNTER();
 
@@ -89,11 +379,33 @@ bool FVoxelHeightmapImporter_PNG::Import()
 
 	BitDepth = ImageWrapper->GetBitDepth();
 
-	if (!ImageWrapper->GetRaw(ERGBFormat::Gray, BitDepth, Data))
+	TArray64<uint8> ImageData;
+	if (!ImageWrapper->GetRaw(ERGBFormat::Gray, BitDepth, ImageData))
 	{
 		Error = Path + ": failed to decompress png data";
 		return false;
 	}
+	RawData.Empty();
+
+	const int64 RowSize = int64(Size.X) * GetBytesPerPixel();
+	if (RowSize * TileSize > MAX_int32)
+	{
+		Error = Path + " is too large";
+		return false;
+	}
+
+	for (int32 StartY = 0; StartY < Size.Y; StartY += TileSize)
+	{
+		const int32 NumRows = FMath::Min(TileSize, Size.Y - StartY);
+
+		EmitBandTiles(
+			TileSize,
+			StartY,
+			NumRows,
+			MakeVoxelArrayView(ImageData.GetData() + StartY * RowSize, int32(RowSize * NumRows)),
+			false,
+			OnTile);
+	}
 
 	return true;
 }
@@ -102,26 +414,26 @@ bool FVoxelHeightmapImporter_PNG::Import()
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
-bool FVoxelHeightmapImporter_Raw::Import()
+bool FVoxelHeightmapImporter_Raw::ReadHeader()
 {
 	VOXEL_FUNCTION_COUNTER();
 
-	TArray64<uint8> RawData;
-	if (!FFileHelper::LoadFileToArray(RawData, *Path))
+	const int64 FileSize = IFileManager::Get().FileSize(*Path);
+	if (FileSize < 0)
 	{
 		Error = "Failed to load " + Path;
 		return false;
 	}
 
-	if (RawData.Num() % 2 != 0)
+	if (FileSize % 2 != 0)
 	{
 		Error = "Invalid file size " + Path + ": possibly not 16 bit?";
 		return false;
 	}
 
-	const int64 NumPixels = RawData.Num() / 2;
+	const int64 NumPixels = FileSize / 2;
 	const int32 SquareSize = FMath::TruncToInt(FMath::Sqrt(double(NumPixels)));
-	if (NumPixels != SquareSize * SquareSize)
+	if (NumPixels != int64(SquareSize) * SquareSize)
 	{
 		Error = "Invalid file size " + Path + ": is it a 16 bit raw with the same height and width?";
 		return false;
@@ -130,7 +442,77 @@ bool FVoxelHeightmapImporter_Raw::Import()
 	Size.X = SquareSize;
 	Size.Y = SquareSize;
 	BitDepth = 16;
-	Data = RawData;
+
+	return true;
+}
+
+bool FVoxelHeightmapImporter_Raw::ImportTiles(const int32 TileSize, const FOnTile& OnTile)
+{
+	VOXEL_FUNCTION_COUNTER();
+	check(TileSize > 0 && TileSize <= 16384);
+
+	if (!ReadHeader())
+	{
+		return false;
+	}
+
+	const int64 RowSize = int64(Size.X) * GetBytesPerPixel();
+	if (RowSize * TileSize > MAX_int32)
+	{
+		Error = Path + " is too large";
+		return false;
+	}
+
+	const int32 NumBands = FMath::DivideAndRoundUp(Size.Y, TileSize);
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	// Raw files are little-endian, no need to swap
+	const TUniquePtr<IMappedFileHandle> MappedHandle(PlatformFile.OpenMapped(*Path));
+	const TUniquePtr<IMappedFileRegion> MappedRegion(MappedHandle ? MappedHandle->MapRegion(0, RowSize * Size.Y) : nullptr);
+	if (MappedRegion)
+	{
+		const uint8* MappedData = MappedRegion->GetMappedPtr();
+
+		// Bands are independent when the file is mapped
+		ParallelFor(NumBands, [&](const int32 BandIndex)
+		{
+			const int32 StartY = BandIndex * TileSize;
+			const int32 NumRows = FMath::Min(TileSize, Size.Y - StartY);
+
+			EmitBandTiles(
+				TileSize,
+				StartY,
+				NumRows,
+				MakeVoxelArrayView(MappedData + StartY * RowSize, int32(RowSize * NumRows)),
+				!PLATFORM_LITTLE_ENDIAN,
+				OnTile);
+		});
+
+		return true;
+	}
+
+	const TUniquePtr<IFileHandle> FileHandle(PlatformFile.OpenRead(*Path));
+	if (!FileHandle)
+	{
+		Error = "Failed to load " + Path;
+		return false;
+	}
+
+	TVoxelArray<uint8> BandData;
+	for (int32 BandIndex = 0; BandIndex < NumBands; BandIndex++)
+	{
+		const int32 StartY = BandIndex * TileSize;
+		const int32 NumRows = FMath::Min(TileSize, Size.Y - StartY);
+		FVoxelUtilities::SetNumFast(BandData, int32(RowSize * NumRows));
+
+		if (!FileHandle->Read(BandData.GetData(), BandData.Num()))
+		{
+			Error = "Failed to read " + Path;
+			return false;
+		}
+
+		EmitBandTiles(TileSize, StartY, NumRows, BandData, !PLATFORM_LITTLE_ENDIAN, OnTile);
+	}
 
 	return true;
 }
\ No newline at end of file
@@ -0,0 +1,451 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#include "VoxelInvokerChunkTracker.h"
+#include "Algo/BinarySearch.h"
+
+template<typename LambdaType>
+void FVoxelInvokerChunkTracker::SubtractRuns(
+	const TConstVoxelArrayView<FRun> Runs,
+	const TConstVoxelArrayView<FRun> RunsToSubtract,
+	LambdaType&& Lambda)
+{
+	int32 FirstIndexToSubtract = 0;
+
+	for (const FRun& Run : Runs)
+	{
+		while (
+			FirstIndexToSubtract < RunsToSubtract.Num() &&
+			RunsToSubtract[FirstIndexToSubtract].MaxX < Run.MinX)
+		{
+			FirstIndexToSubtract++;
+		}
+
+		FRun Remaining = Run;
+
+		for (int32 Index = FirstIndexToSubtract; Index < RunsToSubtract.Num(); Index++)
+		{
+			const FRun& RunToSubtract = RunsToSubtract[Index];
+			if (RunToSubtract.MinX > Remaining.MaxX)
+			{
+				break;
+			}
+
+			if (RunToSubtract.MinX > Remaining.MinX)
+			{
+				FRun Part = Remaining;
+				Part.MaxX = RunToSubtract.MinX - 1;
+				Lambda(Part);
+			}
+
+			if (RunToSubtract.MaxX >= Remaining.MaxX)
+			{
+				Remaining.MinX = Remaining.MaxX + 1;
+				break;
+			}
+
+			Remaining.MinX = FMath::Max(Remaining.MinX, RunToSubtract.MaxX + 1);
+		}
+
+		if (Remaining.MinX <= Remaining.MaxX)
+		{
+			Lambda(Remaining);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+bool FVoxelInvokerChunkTracker::Update(
+	const TConstVoxelArrayView<FSphere> Invokers,
+	const FMatrix& LocalToWorld,
+	const double ChunkSize,
+	const int32 MaxNumChunks,
+	TVoxelArray<FIntVector>& OutAddedChunks,
+	TVoxelArray<FIntVector>& OutRemovedChunks)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Invokers.Num(), 1);
+
+	OutAddedChunks.Reset();
+	OutRemovedChunks.Reset();
+
+	TVoxelArray<FChunkedInvoker> ChunkedInvokers;
+	{
+		VOXEL_SCOPE_COUNTER("Make ChunkedInvokers");
+
+		const FMatrix WorldToLocal = LocalToWorld.Inverse();
+		const float WorldToLocalScale = WorldToLocal.GetMaximumAxisScale();
+
+		ChunkedInvokers.Reserve(Invokers.Num());
+
+		for (const FSphere& Invoker : Invokers)
+		{
+			const FVector LocalPosition = WorldToLocal.TransformPosition(Invoker.Center);
+			const double LocalRadius = Invoker.W * WorldToLocalScale;
+
+			FChunkedInvoker ChunkedInvoker;
+			ChunkedInvoker.Center = LocalPosition / ChunkSize;
+			ChunkedInvoker.RadiusInChunks = LocalRadius / ChunkSize;
+			ChunkedInvokers.Add(ChunkedInvoker);
+		}
+
+		ChunkedInvokers.Sort([](const FChunkedInvoker& A, const FChunkedInvoker& B)
+		{
+			if (A.RadiusInChunks != B.RadiusInChunks)
+			{
+				return A.RadiusInChunks > B.RadiusInChunks;
+			}
+			if (A.Center.X != B.Center.X)
+			{
+				return A.Center.X < B.Center.X;
+			}
+			if (A.Center.Y != B.Center.Y)
+			{
+				return A.Center.Y < B.Center.Y;
+			}
+			return A.Center.Z < B.Center.Z;
+		});
+	}
+
+	if (ChunkedInvokers == LastInvokers)
+	{
+		// Nothing moved
+		return true;
+	}
+
+	TVoxelArray<FChunkedInvoker> UniqueInvokers = ChunkedInvokers;
+	RemoveContainedInvokers(UniqueInvokers);
+
+	TVoxelArray<FRun> NewRuns;
+	{
+		VOXEL_SCOPE_COUNTER("Rasterize");
+
+		for (const FChunkedInvoker& Invoker : UniqueInvokers)
+		{
+			if (!RasterizeInvoker(Invoker, MaxNumChunks, NewRuns))
+			{
+				return false;
+			}
+		}
+	}
+
+	const int64 NewNumChunks = SortAndMergeRuns(NewRuns);
+	if (NewNumChunks > MaxNumChunks)
+	{
+		return false;
+	}
+
+	{
+		VOXEL_SCOPE_COUNTER("Diff");
+
+		int32 OldIndex = 0;
+		int32 NewIndex = 0;
+		while (
+			OldIndex < Runs.Num() ||
+			NewIndex < NewRuns.Num())
+		{
+			const int64 OldKey = OldIndex < Runs.Num() ? Runs[OldIndex].GetRowKey() : MAX_int64;
+			const int64 NewKey = NewIndex < NewRuns.Num() ? NewRuns[NewIndex].GetRowKey() : MAX_int64;
+			const int64 RowKey = FMath::Min(OldKey, NewKey);
+
+			int32 OldEndIndex = OldIndex;
+			while (
+				OldEndIndex < Runs.Num() &&
+				Runs[OldEndIndex].GetRowKey() == RowKey)
+			{
+				OldEndIndex++;
+			}
+
+			int32 NewEndIndex = NewIndex;
+			while (
+				NewEndIndex < NewRuns.Num() &&
+				NewRuns[NewEndIndex].GetRowKey() == RowKey)
+			{
+				NewEndIndex++;
+			}
+
+			const TConstVoxelArrayView<FRun> OldRow = MakeVoxelArrayView(Runs).Slice(OldIndex, OldEndIndex - OldIndex);
+			const TConstVoxelArrayView<FRun> NewRow = MakeVoxelArrayView(NewRuns).Slice(NewIndex, NewEndIndex - NewIndex);
+
+			SubtractRuns(NewRow, OldRow, [&](const FRun& Run)
+			{
+				for (int32 X = Run.MinX; X <= Run.MaxX; X++)
+				{
+					OutAddedChunks.Add(FIntVector(X, Run.Y, Run.Z));
+				}
+			});
+			SubtractRuns(OldRow, NewRow, [&](const FRun& Run)
+			{
+				for (int32 X = Run.MinX; X <= Run.MaxX; X++)
+				{
+					OutRemovedChunks.Add(FIntVector(X, Run.Y, Run.Z));
+				}
+			});
+
+			OldIndex = OldEndIndex;
+			NewIndex = NewEndIndex;
+		}
+	}
+
+	LastInvokers = MoveTemp(ChunkedInvokers);
+	Runs = MoveTemp(NewRuns);
+	PrivateNumChunks = NewNumChunks;
+
+	return true;
+}
+
+void FVoxelInvokerChunkTracker::Reset()
+{
+	LastInvokers.Empty();
+	Runs.Empty();
+	PrivateNumChunks = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+bool FVoxelInvokerChunkTracker::Contains(const FIntVector& Chunk) const
+{
+	FRun Key;
+	Key.Y = Chunk.Y;
+	Key.Z = Chunk.Z;
+	const int64 RowKey = Key.GetRowKey();
+
+	// First run past the chunk
+	const int32 Index = Algo::UpperBound(Runs, Chunk.X, [&](const int32 X, const FRun& Run)
+	{
+		if (RowKey != Run.GetRowKey())
+		{
+			return RowKey < Run.GetRowKey();
+		}
+		return X < Run.MinX;
+	});
+
+	if (Index == 0)
+	{
+		return false;
+	}
+
+	const FRun& Run = Runs[Index - 1];
+	return
+		Run.GetRowKey() == RowKey &&
+		Run.MinX <= Chunk.X &&
+		Chunk.X <= Run.MaxX;
+}
+
+void FVoxelInvokerChunkTracker::GetChunks(TVoxelSet<FIntVector>& OutChunks) const
+{
+	VOXEL_FUNCTION_COUNTER_NUM(PrivateNumChunks, 1024);
+
+	OutChunks.Reset();
+	OutChunks.Reserve(int32(PrivateNumChunks));
+
+	ForeachChunk([&](const FIntVector& Chunk)
+	{
+		OutChunks.Add_CheckNew(Chunk);
+	});
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelInvokerChunkTracker::RemoveContainedInvokers(TVoxelArray<FChunkedInvoker>& Invokers)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Invokers.Num(), 1);
+
+	// Invokers are sorted by decreasing radius: any invoker that can contain another one is processed before it
+	// Kept invokers are bucketed in one grid per radius level, with a cell size of 2^Level chunks
+	// B can only contain A if |A - B| <= B.Radius - A.Radius <= 2^Level,
+	// so we only need to look at the 27 cells around A in each level
+	const auto GetLevel = [](const double Radius)
+	{
+		return FMath::Clamp(FMath::CeilToInt(FMath::Log2(FMath::Max(Radius, 1.))), 0, 62);
+	};
+	const auto GetCell = [](const FVector& Center, const int32 Level)
+	{
+		return FVoxelUtilities::FloorToInt(Center / double(int64(1) << Level));
+	};
+
+	TVoxelArray<TVoxelMap<FIntVector, TVoxelInlineArray<int32, 4>>> LevelToCellToInvokers;
+	TVoxelArray<FChunkedInvoker> UniqueInvokers;
+	UniqueInvokers.Reserve(Invokers.Num());
+
+	for (const FChunkedInvoker& Invoker : Invokers)
+	{
+		const bool bIsContained = INLINE_LAMBDA
+		{
+			for (int32 Level = GetLevel(Invoker.RadiusInChunks); Level < LevelToCellToInvokers.Num(); Level++)
+			{
+				const TVoxelMap<FIntVector, TVoxelInlineArray<int32, 4>>& CellToInvokers = LevelToCellToInvokers[Level];
+				if (CellToInvokers.Num() == 0)
+				{
+					continue;
+				}
+
+				const FIntVector Cell = GetCell(Invoker.Center, Level);
+
+				for (int32 Z = -1; Z <= 1; Z++)
+				{
+					for (int32 Y = -1; Y <= 1; Y++)
+					{
+						for (int32 X = -1; X <= 1; X++)
+						{
+							const TVoxelInlineArray<int32, 4>* InvokerIndices = CellToInvokers.Find(Cell + FIntVector(X, Y, Z));
+							if (!InvokerIndices)
+							{
+								continue;
+							}
+
+							for (const int32 InvokerIndex : *InvokerIndices)
+							{
+								const FChunkedInvoker& OtherInvoker = UniqueInvokers[InvokerIndex];
+
+								const double RadiusDelta = OtherInvoker.RadiusInChunks - Invoker.RadiusInChunks;
+								ensureVoxelSlow(RadiusDelta >= 0);
+
+								// If distance between two centers is less than the difference of radius, then Invoker is fully contained in OtherInvoker
+								if (FVector::DistSquared(Invoker.Center, OtherInvoker.Center) <= FMath::Square(RadiusDelta))
+								{
+									return true;
+								}
+							}
+						}
+					}
+				}
+			}
+
+			return false;
+		};
+
+		if (bIsContained)
+		{
+			continue;
+		}
+
+		const int32 Level = GetLevel(Invoker.RadiusInChunks);
+		if (LevelToCellToInvokers.Num() <= Level)
+		{
+			LevelToCellToInvokers.SetNum(Level + 1);
+		}
+
+		const int32 InvokerIndex = UniqueInvokers.Add(Invoker);
+		LevelToCellToInvokers[Level].FindOrAdd(GetCell(Invoker.Center, Level)).Add(InvokerIndex);
+	}
+
+	Invokers = MoveTemp(UniqueInvokers);
+}
+
+bool FVoxelInvokerChunkTracker::RasterizeInvoker(
+	const FChunkedInvoker& Invoker,
+	const int32 MaxNumChunks,
+	TVoxelArray<FRun>& OutRuns)
+{
+	VOXEL_SCOPE_COUNTER_FORMAT("RasterizeInvoker Radius=%f chunks", Invoker.RadiusInChunks);
+
+	// Offset due to chunk position being the chunk lower corner
+	constexpr double ChunkOffset = 0.5;
+	// We want to check the chunk against invoker, not the chunk center
+	// To avoid a somewhat expensive box-to-point distance, we offset the invoker radius by the chunk diagonal
+	// (from chunk center to any chunk corner)
+	constexpr double ChunkHalfDiagonal = UE_SQRT_3 / 2.;
+
+	const FIntVector Min = FVoxelUtilities::FloorToInt(Invoker.Center - Invoker.RadiusInChunks - ChunkOffset);
+	const FIntVector Max = FVoxelUtilities::CeilToInt(Invoker.Center + Invoker.RadiusInChunks - ChunkOffset);
+	const double RadiusSquared = FMath::Square(Invoker.RadiusInChunks + ChunkHalfDiagonal);
+
+	int64 NumChunks = 0;
+
+	// Walk Z slabs and Y rows, and solve the sphere equation for the X extent of each row
+	// instead of testing every chunk in the bounding box
+	for (int32 Z = Min.Z; Z <= Max.Z; Z++)
+	{
+		const double RadiusSquaredZ = RadiusSquared - FMath::Square(Z + ChunkOffset - Invoker.Center.Z);
+		if (RadiusSquaredZ < 0)
+		{
+			continue;
+		}
+
+		for (int32 Y = Min.Y; Y <= Max.Y; Y++)
+		{
+			const double RadiusSquaredY = RadiusSquaredZ - FMath::Square(Y + ChunkOffset - Invoker.Center.Y);
+			if (RadiusSquaredY < 0)
+			{
+				continue;
+			}
+
+			const double HalfWidth = FMath::Sqrt(RadiusSquaredY);
+
+			FRun Run;
+			Run.Y = Y;
+			Run.Z = Z;
+			Run.MinX = FMath::Max(Min.X, FMath::CeilToInt(Invoker.Center.X - HalfWidth - ChunkOffset));
+			Run.MaxX = FMath::Min(Max.X, FMath::FloorToInt(Invoker.Center.X + HalfWidth - ChunkOffset));
+
+			if (Run.MinX > Run.MaxX)
+			{
+				continue;
+			}
+
+			NumChunks += Run.Num();
+			OutRuns.Add(Run);
+		}
+
+		// The union of all invokers is at least as big as any of them
+		if (NumChunks > MaxNumChunks)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int64 FVoxelInvokerChunkTracker::SortAndMergeRuns(TVoxelArray<FRun>& InOutRuns)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(InOutRuns.Num(), 1024);
+
+	InOutRuns.Sort([](const FRun& A, const FRun& B)
+	{
+		if (A.GetRowKey() != B.GetRowKey())
+		{
+			return A.GetRowKey() < B.GetRowKey();
+		}
+		return A.MinX < B.MinX;
+	});
+
+	int64 NumChunks = 0;
+	int32 WriteIndex = -1;
+
+	for (int32 ReadIndex = 0; ReadIndex < InOutRuns.Num(); ReadIndex++)
+	{
+		const FRun Run = InOutRuns[ReadIndex];
+
+		if (WriteIndex != -1)
+		{
+			FRun& LastRun = InOutRuns[WriteIndex];
+
+			if (LastRun.GetRowKey() == Run.GetRowKey() &&
+				int64(Run.MinX) <= int64(LastRun.MaxX) + 1)
+			{
+				LastRun.MaxX = FMath::Max(LastRun.MaxX, Run.MaxX);
+				continue;
+			}
+
+			NumChunks += LastRun.Num();
+		}
+
+		InOutRuns[++WriteIndex] = Run;
+	}
+
+	if (WriteIndex != -1)
+	{
+		NumChunks += InOutRuns[WriteIndex].Num();
+	}
+
+	InOutRuns.SetNum(WriteIndex + 1, UE_505_SWITCH(false, EAllowShrinking::No));
+
+	return NumChunks;
+}
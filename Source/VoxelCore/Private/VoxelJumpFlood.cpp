@@ -5,7 +5,7 @@
 #include "Misc/ScopedSlowTask.h"
 #endif
 
-void FVoxelJumpFlood::JumpFlood2D(
+bool FVoxelJumpFlood::JumpFlood2D(
 	const FIntPoint& Size,
 	const TVoxelArrayView<FIntPoint> InOutClosestPosition)
 {
@@ -15,6 +15,8 @@ void FVoxelJumpFlood::JumpFlood2D(
 	TVoxelArray<FIntPoint> Temp;
 	FVoxelUtilities::SetNumFast(Temp, Size.X * Size.Y);
 
+	const FVoxelCancellationToken CancellationToken = FVoxelCancellationToken::Get();
+
 	bool bSourceIsTemp = false;
 
 	const int32 NumPasses = FMath::CeilLogTwo(Size.GetMax());
@@ -29,11 +31,15 @@ void FVoxelJumpFlood::JumpFlood2D(
 		// -1: we want to start with half the size
 		const int32 Step = 1 << (NumPasses - 1 - Pass);
 
-		JumpFlood2DImpl(
+		if (!JumpFlood2DImpl(
 			Size,
 			bSourceIsTemp ? Temp : InOutClosestPosition,
 			bSourceIsTemp ? InOutClosestPosition : Temp,
-			Step);
+			Step,
+			CancellationToken))
+		{
+			return false;
+		}
 
 		bSourceIsTemp = !bSourceIsTemp;
 
@@ -47,13 +53,16 @@ void FVoxelJumpFlood::JumpFlood2D(
 		VOXEL_SCOPE_COUNTER("Memcpy");
 		FVoxelUtilities::Memcpy(InOutClosestPosition, Temp);
 	}
+
+	return true;
 }
 
-void FVoxelJumpFlood::JumpFlood2DImpl(
+bool FVoxelJumpFlood::JumpFlood2DImpl(
 	const FIntPoint& Size,
 	const TConstVoxelArrayView<FIntPoint> InData,
 	const TVoxelArrayView<FIntPoint> OutData,
-	const int32 Step)
+	const int32 Step,
+	const FVoxelCancellationToken& CancellationToken)
 {
 	VOXEL_FUNCTION_COUNTER();
 
@@ -66,6 +75,11 @@ void FVoxelJumpFlood::JumpFlood2DImpl(
 
 	for (int32 Y = 0; Y < Size.Y; Y++)
 	{
+		if (CancellationToken.IsCancelled())
+		{
+			return false;
+		}
+
 #if WITH_EDITOR
 		if (Y % 10 == 9)
 		{
@@ -140,4 +154,6 @@ void FVoxelJumpFlood::JumpFlood2DImpl(
 			Index++;
 		}
 	}
+
+	return true;
 }
\ No newline at end of file
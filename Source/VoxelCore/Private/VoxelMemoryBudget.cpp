@@ -0,0 +1,350 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#include "VoxelMemoryBudget.h"
+
+FVoxelMemoryBudget* GVoxelMemoryBudget = new FVoxelMemoryBudget();
+
+DECLARE_VOXEL_COUNTER(VOXELCORE_API, STAT_VoxelMemoryBudgetEvicted, "Memory Budget Evicted Bytes");
+DEFINE_VOXEL_COUNTER(STAT_VoxelMemoryBudgetEvicted);
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, int32, GVoxelMemoryBudgetSoftLimitMB, 0,
+	"voxel.MemoryBudget.SoftLimitMB",
+	"Total memory budget in MB above which evictors are called. 0 to disable");
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, int32, GVoxelMemoryBudgetHardLimitMB, 0,
+	"voxel.MemoryBudget.HardLimitMB",
+	"Total memory budget in MB above which producers should stop allocating. 0 to disable");
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, float, GVoxelMemoryBudgetUpdateInterval, 0.25f,
+	"voxel.MemoryBudget.UpdateInterval",
+	"Interval in seconds between two memory budget updates");
+
+VOXEL_CONSOLE_COMMAND(
+	"voxel.MemoryBudget.Print",
+	"Log the usage of all the memory budgets")
+{
+	GVoxelMemoryBudget->Update();
+	GVoxelMemoryBudget->LogUsage();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+FVoxelMemoryBudget::~FVoxelMemoryBudget()
+{
+	ensure(GVoxelMemoryBudget == this);
+	GVoxelMemoryBudget = nullptr;
+}
+
+FDelegateHandle FVoxelMemoryBudget::AddCostProvider(
+	const FName Budget,
+	FCostProvider CostProvider)
+{
+	VOXEL_FUNCTION_COUNTER();
+	VOXEL_SCOPE_LOCK(CriticalSection);
+
+	FindOrAddBudget_RequiresLock(Budget);
+
+	FCostProviderInfo& Info = CostProviders_RequiresLock.Emplace_GetRef();
+	Info.Handle = FDelegateHandle(FDelegateHandle::GenerateNewHandle);
+	Info.Budget = Budget;
+	Info.CostProvider = MakeSharedCopy(MoveTemp(CostProvider));
+	return Info.Handle;
+}
+
+FDelegateHandle FVoxelMemoryBudget::AddEvictor(
+	const FName Budget,
+	const int32 Priority,
+	FEvictor Evictor)
+{
+	VOXEL_FUNCTION_COUNTER();
+	VOXEL_SCOPE_LOCK(CriticalSection);
+
+	FindOrAddBudget_RequiresLock(Budget);
+
+	FEvictorInfo Info;
+	Info.Handle = FDelegateHandle(FDelegateHandle::GenerateNewHandle);
+	Info.Budget = Budget;
+	Info.Priority = Priority;
+	Info.Evictor = MakeSharedCopy(MoveTemp(Evictor));
+
+	// Keep registration order for evictors with the same priority
+	int32 Index = 0;
+	while (
+		Index < Evictors_RequiresLock.Num() &&
+		Evictors_RequiresLock[Index].Priority <= Priority)
+	{
+		Index++;
+	}
+	Evictors_RequiresLock.Insert(Info, Index);
+
+	return Info.Handle;
+}
+
+void FVoxelMemoryBudget::Remove(const FDelegateHandle Handle)
+{
+	VOXEL_FUNCTION_COUNTER();
+	VOXEL_SCOPE_LOCK(CriticalSection);
+
+	CostProviders_RequiresLock.RemoveAll([&](const FCostProviderInfo& Info)
+	{
+		return Info.Handle == Handle;
+	});
+	Evictors_RequiresLock.RemoveAll([&](const FEvictorInfo& Info)
+	{
+		return Info.Handle == Handle;
+	});
+}
+
+void FVoxelMemoryBudget::SetLimits(
+	const FName Budget,
+	const int64 SoftLimit,
+	const int64 HardLimit)
+{
+	VOXEL_SCOPE_LOCK(CriticalSection);
+
+	FBudget& BudgetRef = FindOrAddBudget_RequiresLock(Budget);
+	BudgetRef.SoftLimit.Set(SoftLimit);
+	BudgetRef.HardLimit.Set(HardLimit);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+int64 FVoxelMemoryBudget::GetUsage(const FName Budget) const
+{
+	VOXEL_SCOPE_LOCK(CriticalSection);
+
+	const TSharedPtr<FBudget> BudgetPtr = Budgets_RequiresLock.FindRef(Budget);
+	if (!BudgetPtr)
+	{
+		return 0;
+	}
+	return BudgetPtr->Usage.Get();
+}
+
+int64 FVoxelMemoryBudget::GetTotalUsage() const
+{
+	return TotalUsage.Get();
+}
+
+int64 FVoxelMemoryBudget::GetHeadroom(const FName Budget) const
+{
+	int64 Headroom = MAX_int64;
+
+	const int64 TotalHardLimit = int64(GVoxelMemoryBudgetHardLimitMB) * 1024 * 1024;
+	if (TotalHardLimit > 0)
+	{
+		Headroom = TotalHardLimit - TotalUsage.Get();
+	}
+
+	VOXEL_SCOPE_LOCK(CriticalSection);
+
+	const TSharedPtr<FBudget> BudgetPtr = Budgets_RequiresLock.FindRef(Budget);
+	if (BudgetPtr &&
+		BudgetPtr->HardLimit.Get() > 0)
+	{
+		Headroom = FMath::Min(Headroom, BudgetPtr->HardLimit.Get() - BudgetPtr->Usage.Get());
+	}
+
+	return Headroom;
+}
+
+void FVoxelMemoryBudget::LogUsage() const
+{
+	VOXEL_FUNCTION_COUNTER();
+	VOXEL_SCOPE_LOCK(CriticalSection);
+
+	for (const auto& It : Budgets_RequiresLock)
+	{
+		LOG_VOXEL(Log, "%s: %lldMB (soft limit: %lldMB, hard limit: %lldMB)",
+			*It.Key.ToString(),
+			It.Value->Usage.Get() / 1024 / 1024,
+			It.Value->SoftLimit.Get() / 1024 / 1024,
+			It.Value->HardLimit.Get() / 1024 / 1024);
+	}
+
+	LOG_VOXEL(Log, "Total: %lldMB (soft limit: %dMB, hard limit: %dMB)",
+		TotalUsage.Get() / 1024 / 1024,
+		GVoxelMemoryBudgetSoftLimitMB,
+		GVoxelMemoryBudgetHardLimitMB);
+}
+
+void FVoxelMemoryBudget::Update()
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	if (IsUpdating.Exchange_ReturnOld(1) != 0)
+	{
+		// Already updating on another thread
+		return;
+	}
+	ON_SCOPE_EXIT
+	{
+		IsUpdating.Set(0);
+	};
+
+	// Cost providers and evictors are called without the lock, they might register new ones
+	TVoxelMap<FName, TSharedPtr<FBudget>> Budgets;
+	TVoxelArray<FCostProviderInfo> CostProviders;
+	TVoxelArray<FEvictorInfo> Evictors;
+	{
+		VOXEL_SCOPE_LOCK(CriticalSection);
+		Budgets = Budgets_RequiresLock;
+		CostProviders = CostProviders_RequiresLock;
+		Evictors = Evictors_RequiresLock;
+	}
+
+	const auto UpdateUsage = [&]
+	{
+		VOXEL_SCOPE_COUNTER_NUM("UpdateUsage", CostProviders.Num(), 1);
+
+		TVoxelMap<FName, int64> BudgetToUsage;
+		BudgetToUsage.Reserve(Budgets.Num());
+
+		for (const auto& It : Budgets)
+		{
+			BudgetToUsage.Add_CheckNew(It.Key, 0);
+		}
+
+		int64 NewTotalUsage = 0;
+		for (const FCostProviderInfo& Info : CostProviders)
+		{
+			const int64 Usage = (*Info.CostProvider)();
+			BudgetToUsage.FindChecked(Info.Budget) += Usage;
+			NewTotalUsage += Usage;
+		}
+
+		for (const auto& It : Budgets)
+		{
+			It.Value->Usage.Set(BudgetToUsage.FindChecked(It.Key));
+		}
+		TotalUsage.Set(NewTotalUsage);
+	};
+
+	UpdateUsage();
+
+	bool bEvicted = false;
+	for (const auto& It : Budgets)
+	{
+		const int64 SoftLimit = It.Value->SoftLimit.Get();
+		const int64 Usage = It.Value->Usage.Get();
+		if (SoftLimit <= 0 ||
+			Usage <= SoftLimit)
+		{
+			continue;
+		}
+
+		TVoxelArray<FEvictorInfo> BudgetEvictors;
+		for (const FEvictorInfo& Info : Evictors)
+		{
+			if (Info.Budget == It.Key)
+			{
+				BudgetEvictors.Add(Info);
+			}
+		}
+
+		const int64 BytesFreed = Evict(BudgetEvictors, Usage - SoftLimit);
+		LOG_VOXEL(Verbose, "Memory budget %s: %lld bytes over soft limit, %lld bytes evicted",
+			*It.Key.ToString(),
+			Usage - SoftLimit,
+			BytesFreed);
+
+		bEvicted = true;
+	}
+
+	if (bEvicted)
+	{
+		UpdateUsage();
+	}
+
+	const int64 TotalSoftLimit = int64(GVoxelMemoryBudgetSoftLimitMB) * 1024 * 1024;
+	if (TotalSoftLimit > 0 &&
+		TotalUsage.Get() > TotalSoftLimit)
+	{
+		const int64 BytesFreed = Evict(Evictors, TotalUsage.Get() - TotalSoftLimit);
+		LOG_VOXEL(Verbose, "Memory budget: %lld bytes over total soft limit, %lld bytes evicted",
+			TotalUsage.Get() - TotalSoftLimit,
+			BytesFreed);
+
+		UpdateUsage();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelMemoryBudget::Initialize()
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	AddCostProvider("ChunkPool", []
+	{
+		return FVoxelChunkPool::GetRetainedSize();
+	});
+
+	// Free chunks are the cheapest memory to reclaim
+	AddEvictor("ChunkPool", MIN_int32, [](int64)
+	{
+		const int64 OldSize = FVoxelChunkPool::GetRetainedSize();
+		FVoxelChunkPool::TrimAll();
+		return OldSize - FVoxelChunkPool::GetRetainedSize();
+	});
+}
+
+void FVoxelMemoryBudget::Tick_Async()
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	const double Time = FPlatformTime::Seconds();
+	if (LastUpdateTime + GVoxelMemoryBudgetUpdateInterval > Time)
+	{
+		return;
+	}
+	LastUpdateTime = Time;
+
+	Update();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+FVoxelMemoryBudget::FBudget& FVoxelMemoryBudget::FindOrAddBudget_RequiresLock(const FName Budget)
+{
+	checkVoxelSlow(CriticalSection.IsLocked());
+
+	TSharedPtr<FBudget>& BudgetPtr = Budgets_RequiresLock.FindOrAdd(Budget);
+	if (!BudgetPtr)
+	{
+		BudgetPtr = MakeShared<FBudget>();
+	}
+	return *BudgetPtr;
+}
+
+int64 FVoxelMemoryBudget::Evict(
+	const TConstVoxelArrayView<FEvictorInfo> Evictors,
+	const int64 BytesToFree)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Evictors.Num(), 1);
+
+	int64 BytesFreed = 0;
+	for (const FEvictorInfo& Info : Evictors)
+	{
+		if (BytesFreed >= BytesToFree)
+		{
+			break;
+		}
+
+		BytesFreed += FMath::Max<int64>(0, (*Info.Evictor)(BytesToFree - BytesFreed));
+	}
+
+	INC_VOXEL_COUNTER_BY(STAT_VoxelMemoryBudgetEvicted, BytesFreed);
+	return BytesFreed;
+}
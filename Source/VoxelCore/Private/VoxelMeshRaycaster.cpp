@@ -0,0 +1,433 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#include "VoxelMeshRaycaster.h"
+#include "VoxelTriangleTracer.h"
+#include "VoxelMeshRaycasterImpl.ispc.generated.h"
+
+VOXEL_CONSOLE_COMMAND(
+	"voxel.MeshRaycaster.Benchmark",
+	"Raycast a 1M triangles mesh and log build time and rays per second")
+{
+	VOXEL_SCOPE_COUNTER("voxel.MeshRaycaster.Benchmark");
+
+	// Noisy heightmap, 1M triangles
+	constexpr int32 Size = 708;
+	constexpr int32 NumRays = 1024 * 1024;
+
+	TVoxelArray<FVector3f> Vertices;
+	TVoxelArray<int32> Indices;
+	{
+		const FRandomStream Stream(42);
+
+		FVoxelUtilities::SetNumFast(Vertices, Size * Size);
+		for (int32 Y = 0; Y < Size; Y++)
+		{
+			for (int32 X = 0; X < Size; X++)
+			{
+				Vertices[X + Size * Y] = FVector3f(X, Y, 10.f * FMath::Sin(X / 20.f) * FMath::Cos(Y / 30.f) + Stream.FRand());
+			}
+		}
+
+		Indices.Reserve(6 * (Size - 1) * (Size - 1));
+		for (int32 Y = 0; Y < Size - 1; Y++)
+		{
+			for (int32 X = 0; X < Size - 1; X++)
+			{
+				const int32 Index00 = (X + 0) + Size * (Y + 0);
+				const int32 Index10 = (X + 1) + Size * (Y + 0);
+				const int32 Index01 = (X + 0) + Size * (Y + 1);
+				const int32 Index11 = (X + 1) + Size * (Y + 1);
+
+				Indices.Append({ Index00, Index11, Index10 });
+				Indices.Append({ Index00, Index01, Index11 });
+			}
+		}
+	}
+
+	FVoxelMeshRaycaster Raycaster;
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		Raycaster.Initialize(Vertices, Indices);
+		const double EndTime = FPlatformTime::Seconds();
+
+		LOG_VOXEL(Log, "Mesh raycaster: %d triangles, built in %.1fms, %s",
+			Raycaster.NumTriangles(),
+			(EndTime - StartTime) * 1000,
+			*FVoxelUtilities::BytesToString(Raycaster.GetAllocatedSize()));
+	}
+
+	// Rays starting above the terrain in random directions, like AO or line of sight rays
+	TVoxelArray<FVector3f> Origins;
+	TVoxelArray<FVector3f> Directions;
+	FVoxelUtilities::SetNumFast(Origins, NumRays);
+	FVoxelUtilities::SetNumFast(Directions, NumRays);
+	{
+		const FRandomStream Stream(1337);
+		for (int32 Index = 0; Index < NumRays; Index++)
+		{
+			Origins[Index] = FVector3f(Stream.FRandRange(0, Size - 1), Stream.FRandRange(0, Size - 1), 15.f);
+			Directions[Index] = FVector3f(Stream.GetUnitVector());
+		}
+	}
+
+	constexpr float MaxDistance = 1000.f;
+
+	const auto Benchmark = [&](const TCHAR* Name, const int32 Num, const TFunctionRef<void()> Lambda)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		Lambda();
+		const double Time = FPlatformTime::Seconds() - StartTime;
+
+		LOG_VOXEL(Log, "%-30s %8.1fms (%.2fM rays/s)",
+			Name,
+			Time * 1000.,
+			Num / Time / 1.e6);
+	};
+
+	TVoxelArray<FVoxelMeshRaycastHit> Hits;
+	TVoxelArray<bool> AnyHits;
+	FVoxelUtilities::SetNumFast(Hits, NumRays);
+	FVoxelUtilities::SetNumFast(AnyHits, NumRays);
+
+	Benchmark(TEXT("Raycast single thread"), NumRays / 16, [&]
+	{
+		for (int32 Index = 0; Index < NumRays / 16; Index++)
+		{
+			Raycaster.Raycast(Origins[Index], Directions[Index], MaxDistance, Hits[Index]);
+		}
+	});
+	Benchmark(TEXT("RaycastBulk"), NumRays, [&]
+	{
+		Raycaster.RaycastBulk(Origins, Directions, MaxDistance, Hits);
+	});
+	Benchmark(TEXT("AnyHitBulk"), NumRays, [&]
+	{
+		Raycaster.AnyHitBulk(Origins, Directions, MaxDistance, AnyHits);
+	});
+
+	// Check a few rays against brute force
+	for (int32 Index = 0; Index < 16; Index++)
+	{
+		float BestTime = MaxDistance;
+		int32 BestTriangle = -1;
+		for (int32 Triangle = 0; Triangle < Indices.Num() / 3; Triangle++)
+		{
+			const FVoxelTriangleTracer Tracer(
+				Vertices[Indices[3 * Triangle + 0]],
+				Vertices[Indices[3 * Triangle + 1]],
+				Vertices[Indices[3 * Triangle + 2]]);
+
+			float Time;
+			if (Tracer.Trace(Origins[Index], Directions[Index], false, Time) &&
+				Time < BestTime)
+			{
+				BestTime = Time;
+				BestTriangle = Triangle;
+			}
+		}
+
+		// Compare distances as rays going through an edge can hit either triangle
+		ensure(Hits[Index].IsValid() == (BestTriangle != -1));
+		ensure(!Hits[Index].IsValid() || FMath::IsNearlyEqual(Hits[Index].Distance, BestTime, 1.e-3f));
+		ensure(AnyHits[Index] == (BestTriangle != -1));
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelMeshRaycaster::Initialize(
+	const TConstVoxelArrayView<FVector3f> Vertices,
+	const TConstVoxelArrayView<int32> Indices)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Indices.Num(), 1024);
+	check(Indices.Num() % 3 == 0);
+	check(Nodes.Num() == 0);
+
+	const int32 NumTriangles = Indices.Num() / 3;
+	if (NumTriangles == 0)
+	{
+		return;
+	}
+
+	FVoxelFastAABBTree::FElementArray Elements;
+	Elements.SetNum(NumTriangles);
+	{
+		VOXEL_SCOPE_COUNTER_NUM("Compute bounds", NumTriangles, 1024);
+
+		ParallelFor(Elements.Payload, [&](int32& Payload, const int32 Index)
+		{
+			const FVector3f A = Vertices[Indices[3 * Index + 0]];
+			const FVector3f B = Vertices[Indices[3 * Index + 1]];
+			const FVector3f C = Vertices[Indices[3 * Index + 2]];
+
+			Payload = Index;
+			Elements.MinX[Index] = FMath::Min3(A.X, B.X, C.X);
+			Elements.MinY[Index] = FMath::Min3(A.Y, B.Y, C.Y);
+			Elements.MinZ[Index] = FMath::Min3(A.Z, B.Z, C.Z);
+			Elements.MaxX[Index] = FMath::Max3(A.X, B.X, C.X);
+			Elements.MaxY[Index] = FMath::Max3(A.Y, B.Y, C.Y);
+			Elements.MaxZ[Index] = FMath::Max3(A.Z, B.Z, C.Z);
+		});
+	}
+
+	// Leaves are small enough to be intersected in one or two ISPC iterations
+	// Deep enough to not hit the max depth on multi-million triangles meshes
+	FVoxelFastAABBTree Tree(8, 32);
+	Tree.Initialize(MoveTemp(Elements));
+
+	Nodes = TVoxelArray<FVoxelFastAABBTree::FNode>(Tree.GetNodes());
+
+	const TConstVoxelArrayView<FVoxelFastAABBTree::FLeaf> TreeLeaves = Tree.GetLeaves();
+	FVoxelUtilities::SetNumFast(Leaves, TreeLeaves.Num());
+	FVoxelUtilities::SetNumFast(TriangleIndices, NumTriangles);
+	FVoxelUtilities::SetNumFast(TriangleData, 12 * NumTriangles);
+
+	int32 NumTrianglesInLeaves = 0;
+	for (int32 LeafIndex = 0; LeafIndex < TreeLeaves.Num(); LeafIndex++)
+	{
+		Leaves[LeafIndex].Start = NumTrianglesInLeaves;
+		Leaves[LeafIndex].Num = TreeLeaves[LeafIndex].Elements.Num();
+		NumTrianglesInLeaves += Leaves[LeafIndex].Num;
+	}
+	check(NumTrianglesInLeaves == NumTriangles);
+
+	VOXEL_SCOPE_COUNTER_NUM("Build leaves", NumTriangles, 1024);
+
+	ParallelFor(Leaves, [&](const FLeaf& Leaf, const int32 LeafIndex)
+	{
+		const TConstVoxelArrayView<int32> Payload = TreeLeaves[LeafIndex].Elements.Payload;
+		float* RESTRICT Data = &TriangleData[12 * Leaf.Start];
+
+		for (int32 Index = 0; Index < Leaf.Num; Index++)
+		{
+			const int32 Triangle = Payload[Index];
+			TriangleIndices[Leaf.Start + Index] = Triangle;
+
+			const FVector3f A = Vertices[Indices[3 * Triangle + 0]];
+			const FVector3f B = Vertices[Indices[3 * Triangle + 1]];
+			const FVector3f C = Vertices[Indices[3 * Triangle + 2]];
+
+			const FVector3f Edge1 = B - A;
+			const FVector3f Edge2 = C - A;
+			const FVector3f Normal = FVector3f::CrossProduct(Edge1, Edge2);
+
+			for (int32 Axis = 0; Axis < 3; Axis++)
+			{
+				Data[(0 + Axis) * Leaf.Num + Index] = A[Axis];
+				Data[(3 + Axis) * Leaf.Num + Index] = Edge1[Axis];
+				Data[(6 + Axis) * Leaf.Num + Index] = Edge2[Axis];
+				Data[(9 + Axis) * Leaf.Num + Index] = Normal[Axis];
+			}
+		}
+	});
+}
+
+int64 FVoxelMeshRaycaster::GetAllocatedSize() const
+{
+	return
+		Nodes.GetAllocatedSize() +
+		Leaves.GetAllocatedSize() +
+		TriangleData.GetAllocatedSize() +
+		TriangleIndices.GetAllocatedSize();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+template<bool bAnyHit>
+bool FVoxelMeshRaycaster::Trace(
+	const FVector3f& Origin,
+	const FVector3f& Direction,
+	const float MaxDistance,
+	FVoxelMeshRaycastHit& OutHit) const
+{
+	ensureVoxelSlowNoSideEffects(Direction.IsNormalized());
+
+	OutHit = {};
+
+	if (Nodes.Num() == 0)
+	{
+		return false;
+	}
+
+	// Infinite when Direction is 0 along an axis, which the slab test below handles
+	const FVector3f InvDirection = FVector3f(1.f) / Direction;
+
+	float BestTime = MaxDistance;
+	int32 BestIndex = -1;
+	float BestB1 = 0.f;
+	float BestB2 = 0.f;
+
+	const auto IntersectBox = [&](const FVector3f& Min, const FVector3f& Max, float& OutTime)
+	{
+		const FVector3f Time0 = (Min - Origin) * InvDirection;
+		const FVector3f Time1 = (Max - Origin) * InvDirection;
+
+		const float EnterTime = FMath::Max(
+			FMath::Max3(
+				FMath::Min(Time0.X, Time1.X),
+				FMath::Min(Time0.Y, Time1.Y),
+				FMath::Min(Time0.Z, Time1.Z)),
+			0.f);
+
+		const float ExitTime = FMath::Min3(
+			FMath::Max(Time0.X, Time1.X),
+			FMath::Max(Time0.Y, Time1.Y),
+			FMath::Max(Time0.Z, Time1.Z));
+
+		OutTime = EnterTime;
+		return
+			EnterTime <= ExitTime &&
+			EnterTime <= BestTime;
+	};
+
+	struct FQueuedNode
+	{
+		int32 NodeIndex;
+		float Time;
+	};
+	TVoxelInlineArray<FQueuedNode, 64> QueuedNodes;
+	QueuedNodes.Add({ 0, 0.f });
+
+	while (QueuedNodes.Num() > 0)
+	{
+		const FQueuedNode QueuedNode = QueuedNodes.Pop();
+		if (QueuedNode.Time > BestTime)
+		{
+			// A closer triangle was hit since this node was queued
+			continue;
+		}
+
+		const FVoxelFastAABBTree::FNode& Node = Nodes[QueuedNode.NodeIndex];
+		if (Node.bLeaf)
+		{
+			const FLeaf& Leaf = Leaves[Node.LeafIndex];
+
+			float B1 = 0.f;
+			float B2 = 0.f;
+			const int32 Index = ispc::MeshRaycaster_TraceLeaf(
+				&TriangleData[12 * Leaf.Start],
+				Leaf.Num,
+				Origin.X,
+				Origin.Y,
+				Origin.Z,
+				Direction.X,
+				Direction.Y,
+				Direction.Z,
+				BestTime,
+				B1,
+				B2);
+
+			if (Index == -1)
+			{
+				continue;
+			}
+
+			BestIndex = Leaf.Start + Index;
+			BestB1 = B1;
+			BestB2 = B2;
+
+			if (bAnyHit)
+			{
+				break;
+			}
+			continue;
+		}
+
+		float Time0;
+		float Time1;
+		const bool bHit0 = IntersectBox(Node.ChildBounds0_Min, Node.ChildBounds0_Max, Time0);
+		const bool bHit1 = IntersectBox(Node.ChildBounds1_Min, Node.ChildBounds1_Max, Time1);
+
+		// Push the closest child last so that it's visited first
+		if (bHit0 && bHit1)
+		{
+			if (Time0 <= Time1)
+			{
+				QueuedNodes.Add({ Node.ChildIndex1, Time1 });
+				QueuedNodes.Add({ Node.ChildIndex0, Time0 });
+			}
+			else
+			{
+				QueuedNodes.Add({ Node.ChildIndex0, Time0 });
+				QueuedNodes.Add({ Node.ChildIndex1, Time1 });
+			}
+		}
+		else if (bHit0)
+		{
+			QueuedNodes.Add({ Node.ChildIndex0, Time0 });
+		}
+		else if (bHit1)
+		{
+			QueuedNodes.Add({ Node.ChildIndex1, Time1 });
+		}
+	}
+
+	if (BestIndex == -1)
+	{
+		return false;
+	}
+
+	OutHit.TriangleIndex = TriangleIndices[BestIndex];
+	OutHit.Distance = BestTime;
+	OutHit.Barycentrics = FVector3f(1.f - BestB1 - BestB2, BestB1, BestB2);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+bool FVoxelMeshRaycaster::Raycast(
+	const FVector3f& Origin,
+	const FVector3f& Direction,
+	const float MaxDistance,
+	FVoxelMeshRaycastHit& OutHit) const
+{
+	return this->Trace<false>(Origin, Direction, MaxDistance, OutHit);
+}
+
+bool FVoxelMeshRaycaster::AnyHit(
+	const FVector3f& Origin,
+	const FVector3f& Direction,
+	const float MaxDistance) const
+{
+	FVoxelMeshRaycastHit Hit;
+	return this->Trace<true>(Origin, Direction, MaxDistance, Hit);
+}
+
+void FVoxelMeshRaycaster::RaycastBulk(
+	const TConstVoxelArrayView<FVector3f> Origins,
+	const TConstVoxelArrayView<FVector3f> Directions,
+	const float MaxDistance,
+	const TVoxelArrayView<FVoxelMeshRaycastHit> OutHits) const
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Origins.Num(), 16);
+	check(Origins.Num() == Directions.Num());
+	check(Origins.Num() == OutHits.Num());
+
+	ParallelFor(OutHits, [&](FVoxelMeshRaycastHit& Hit, const int32 Index)
+	{
+		this->Trace<false>(Origins[Index], Directions[Index], MaxDistance, Hit);
+	});
+}
+
+void FVoxelMeshRaycaster::AnyHitBulk(
+	const TConstVoxelArrayView<FVector3f> Origins,
+	const TConstVoxelArrayView<FVector3f> Directions,
+	const float MaxDistance,
+	const TVoxelArrayView<bool> OutHits) const
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Origins.Num(), 16);
+	check(Origins.Num() == Directions.Num());
+	check(Origins.Num() == OutHits.Num());
+
+	ParallelFor(OutHits, [&](bool& bHit, const int32 Index)
+	{
+		FVoxelMeshRaycastHit Hit;
+		bHit = this->Trace<true>(Origins[Index], Directions[Index], MaxDistance, Hit);
+	});
+}
@@ -0,0 +1,256 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#include "VoxelMinimal.h"
+#include "VoxelMemoryBudget.h"
+
+DEFINE_VOXEL_MEMORY_STAT(STAT_VoxelChunkPoolMemory);
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, bool, GVoxelChunkPoolEnabled, true,
+	"voxel.ChunkPool.Enabled",
+	"If true, TVoxelChunkedArray chunks will be recycled through a global free list instead of going through the allocator");
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, int32, GVoxelChunkPoolMaxRetainedSizeMB, 64,
+	"voxel.ChunkPool.MaxRetainedSizeMB",
+	"Max size of the free chunks retained by the chunk pool, in MB");
+
+VOXEL_CONSOLE_COMMAND(
+	"voxel.ChunkPool.Trim",
+	"Free all the chunks retained by the chunk pool")
+{
+	FVoxelChunkPool::TrimAll();
+}
+
+constexpr int32 GVoxelChunkPoolMaxPools = 64;
+constexpr int32 GVoxelChunkPoolThreadCacheSize = 16;
+
+FVoxelCounter64 GVoxelChunkPoolRetainedSize;
+
+struct FVoxelChunkPoolArray
+{
+	FVoxelCriticalSection CriticalSection;
+	FVoxelChunkPool* Pools_RequiresLock[GVoxelChunkPoolMaxPools] = {};
+	int32 NumPools_RequiresLock = 0;
+
+	// Chunked arrays can be used by static initializers, don't rely on initialization order
+	static FVoxelChunkPoolArray& Get()
+	{
+		static FVoxelChunkPoolArray* Array = new FVoxelChunkPoolArray();
+		return *Array;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+struct FVoxelChunkPoolThreadCache
+{
+	struct FCache
+	{
+		int32 Num = 0;
+		void* Chunks[GVoxelChunkPoolThreadCacheSize];
+	};
+	FCache Caches[GVoxelChunkPoolMaxPools];
+
+	~FVoxelChunkPoolThreadCache()
+	{
+		FVoxelChunkPoolArray& PoolArray = FVoxelChunkPoolArray::Get();
+		VOXEL_SCOPE_LOCK(PoolArray.CriticalSection);
+
+		for (int32 PoolIndex = 0; PoolIndex < PoolArray.NumPools_RequiresLock; PoolIndex++)
+		{
+			FVoxelChunkPool& Pool = *PoolArray.Pools_RequiresLock[PoolIndex];
+			FCache& Cache = Caches[PoolIndex];
+
+			VOXEL_SCOPE_LOCK(Pool.CriticalSection);
+			for (int32 Index = 0; Index < Cache.Num; Index++)
+			{
+				Pool.Chunks_RequiresLock.Add(Cache.Chunks[Index]);
+			}
+			Cache.Num = 0;
+		}
+	}
+};
+thread_local FVoxelChunkPoolThreadCache GVoxelChunkPoolThreadCache;
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+FVoxelChunkPool& FVoxelChunkPool::Get(const int64 ChunkSize, const int32 Alignment)
+{
+	FVoxelChunkPoolArray& PoolArray = FVoxelChunkPoolArray::Get();
+	VOXEL_SCOPE_LOCK(PoolArray.CriticalSection);
+
+	for (int32 Index = 0; Index < PoolArray.NumPools_RequiresLock; Index++)
+	{
+		FVoxelChunkPool& Pool = *PoolArray.Pools_RequiresLock[Index];
+		if (Pool.ChunkSize == ChunkSize &&
+			Pool.Alignment == Alignment)
+		{
+			return Pool;
+		}
+	}
+
+	if (PoolArray.NumPools_RequiresLock == GVoxelChunkPoolMaxPools)
+	{
+		// Too many different chunk sizes, use a pool that is never cached
+		return *new FVoxelChunkPool(ChunkSize, Alignment, -1);
+	}
+
+	const int32 PoolIndex = PoolArray.NumPools_RequiresLock++;
+	FVoxelChunkPool* Pool = new FVoxelChunkPool(ChunkSize, Alignment, PoolIndex);
+	PoolArray.Pools_RequiresLock[PoolIndex] = Pool;
+	return *Pool;
+}
+
+void FVoxelChunkPool::TrimAll()
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	FVoxelChunkPoolArray& PoolArray = FVoxelChunkPoolArray::Get();
+	VOXEL_SCOPE_LOCK(PoolArray.CriticalSection);
+
+	for (int32 Index = 0; Index < PoolArray.NumPools_RequiresLock; Index++)
+	{
+		PoolArray.Pools_RequiresLock[Index]->Trim();
+	}
+}
+
+int64 FVoxelChunkPool::GetRetainedSize()
+{
+	return GVoxelChunkPoolRetainedSize.Get();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void* FVoxelChunkPool::Allocate()
+{
+	if (PoolIndex == -1 ||
+		!GVoxelChunkPoolEnabled)
+	{
+		return FMemory::Malloc(ChunkSize, Alignment);
+	}
+
+	FVoxelChunkPoolThreadCache::FCache& Cache = GVoxelChunkPoolThreadCache.Caches[PoolIndex];
+
+	if (Cache.Num == 0)
+	{
+		// Refill half the thread cache from the global free list
+		VOXEL_SCOPE_LOCK(CriticalSection);
+
+		while (
+			Cache.Num < GVoxelChunkPoolThreadCacheSize / 2 &&
+			Chunks_RequiresLock.Num() > 0)
+		{
+			Cache.Chunks[Cache.Num++] = Chunks_RequiresLock.Pop();
+		}
+	}
+
+	if (Cache.Num == 0)
+	{
+		return FMemory::Malloc(ChunkSize, Alignment);
+	}
+
+	GVoxelChunkPoolRetainedSize.Subtract(ChunkSize);
+	DEC_VOXEL_MEMORY_STAT_BY(STAT_VoxelChunkPoolMemory, ChunkSize);
+
+	return Cache.Chunks[--Cache.Num];
+}
+
+void FVoxelChunkPool::Free(void* Chunk)
+{
+	if (!Chunk)
+	{
+		return;
+	}
+
+	if (PoolIndex == -1 ||
+		!GVoxelChunkPoolEnabled)
+	{
+		FMemory::Free(Chunk);
+		return;
+	}
+
+	// Reserve the retained size before caching the chunk so that concurrent frees can't overshoot the limit
+	const int64 MaxRetainedSize = int64(GVoxelChunkPoolMaxRetainedSizeMB) * 1024 * 1024;
+	int64 RetainedSize = GVoxelChunkPoolRetainedSize.Get(std::memory_order_relaxed);
+	do
+	{
+		if (RetainedSize + ChunkSize > MaxRetainedSize)
+		{
+			FMemory::Free(Chunk);
+			return;
+		}
+	}
+	while (!GVoxelChunkPoolRetainedSize.CompareExchangeWeak(RetainedSize, RetainedSize + ChunkSize));
+
+	INC_VOXEL_MEMORY_STAT_BY(STAT_VoxelChunkPoolMemory, ChunkSize);
+
+	FVoxelChunkPoolThreadCache::FCache& Cache = GVoxelChunkPoolThreadCache.Caches[PoolIndex];
+
+	if (Cache.Num == GVoxelChunkPoolThreadCacheSize)
+	{
+		static const FName BudgetName = "ChunkPool";
+		const int64 FlushSize = (GVoxelChunkPoolThreadCacheSize / 2) * ChunkSize;
+
+		// Only checked when flushing to amortize the budget lock
+		if (GVoxelMemoryBudget &&
+			!GVoxelMemoryBudget->CanAllocate(BudgetName, FlushSize))
+		{
+			// Out of headroom, free half the thread cache instead of retaining it
+			while (Cache.Num > GVoxelChunkPoolThreadCacheSize / 2)
+			{
+				FMemory::Free(Cache.Chunks[--Cache.Num]);
+			}
+
+			GVoxelChunkPoolRetainedSize.Subtract(FlushSize);
+			DEC_VOXEL_MEMORY_STAT_BY(STAT_VoxelChunkPoolMemory, FlushSize);
+		}
+		else
+		{
+			// Move half the thread cache to the global free list
+			VOXEL_SCOPE_LOCK(CriticalSection);
+
+			while (Cache.Num > GVoxelChunkPoolThreadCacheSize / 2)
+			{
+				Chunks_RequiresLock.Add(Cache.Chunks[--Cache.Num]);
+			}
+		}
+	}
+
+	Cache.Chunks[Cache.Num++] = Chunk;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+FVoxelChunkPool::FVoxelChunkPool(
+	const int64 ChunkSize,
+	const int32 Alignment,
+	const int32 PoolIndex)
+	: ChunkSize(ChunkSize)
+	, Alignment(Alignment)
+	, PoolIndex(PoolIndex)
+{
+}
+
+void FVoxelChunkPool::Trim()
+{
+	VOXEL_SCOPE_LOCK(CriticalSection);
+
+	for (void* Chunk : Chunks_RequiresLock)
+	{
+		FMemory::Free(Chunk);
+	}
+
+	GVoxelChunkPoolRetainedSize.Subtract(Chunks_RequiresLock.Num() * ChunkSize);
+	DEC_VOXEL_MEMORY_STAT_BY(STAT_VoxelChunkPoolMemory, Chunks_RequiresLock.Num() * ChunkSize);
+
+	Chunks_RequiresLock.Empty();
+}
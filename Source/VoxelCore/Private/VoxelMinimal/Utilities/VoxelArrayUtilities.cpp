@@ -3,6 +3,314 @@
 #include "VoxelMinimal.h"
 #include "VoxelArrayUtilitiesImpl.ispc.generated.h"
 
+VOXEL_CONSOLE_COMMAND(
+	"voxel.Compression.BenchmarkFilters",
+	"Compress voxel-like densities, materials and normals with and without compression filters and log ratio and decompression speed")
+{
+	VOXEL_SCOPE_COUNTER("voxel.Compression.BenchmarkFilters");
+
+	// 64 bricks of 32^3 voxels of a noisy terrain
+	constexpr int32 BrickSize = 32;
+	constexpr int32 NumBricks = 64;
+	constexpr int32 NumVoxels = BrickSize * BrickSize * BrickSize * NumBricks;
+
+	TVoxelArray<float> Densities;
+	TVoxelArray<uint16> Materials;
+	TVoxelArray<FVoxelOctahedron> Normals;
+	FVoxelUtilities::SetNumFast(Densities, NumVoxels);
+	FVoxelUtilities::SetNumFast(Materials, NumVoxels);
+	FVoxelUtilities::SetNumFast(Normals, NumVoxels);
+
+	const FRandomStream Stream(42);
+	for (int32 Index = 0; Index < NumVoxels; Index++)
+	{
+		const int32 Brick = Index / (BrickSize * BrickSize * BrickSize);
+		const int32 X = Index % BrickSize + Brick % 4 * BrickSize;
+		const int32 Y = Index / BrickSize % BrickSize + Brick / 4 % 4 * BrickSize;
+		const int32 Z = Index / (BrickSize * BrickSize) % BrickSize + Brick / 16 * BrickSize;
+
+		const float Height = 40.f + 10.f * FMath::Sin(X / 13.f) * FMath::Cos(Y / 17.f);
+		const FVector3f Normal = FVector3f(-FMath::Cos(X / 13.f) / 13.f, FMath::Sin(Y / 17.f) / 17.f, 0.1f).GetSafeNormal();
+
+		Densities[Index] = Z - Height + 0.01f * Stream.FRand();
+		Materials[Index] = Z < Height - 4 ? 2 : (Z < Height ? 1 : 0);
+		Normals[Index] = FVoxelOctahedron(Normal);
+	}
+
+	const auto Benchmark = [&](const TCHAR* Name, const TConstVoxelArrayView64<uint8> Data, const FVoxelCompressionFilters& Filters)
+	{
+		const double CompressStartTime = FPlatformTime::Seconds();
+		const TVoxelArray64<uint8> CompressedData = FVoxelUtilities::Compress(
+			Data,
+			Filters,
+			true,
+			FOodleDataCompression::ECompressor::Kraken,
+			FOodleDataCompression::ECompressionLevel::Normal);
+		const double CompressTime = FPlatformTime::Seconds() - CompressStartTime;
+
+		const double DecompressStartTime = FPlatformTime::Seconds();
+		TVoxelArray64<uint8> DecompressedData;
+		ensure(FVoxelUtilities::Decompress(CompressedData, DecompressedData));
+		const double DecompressTime = FPlatformTime::Seconds() - DecompressStartTime;
+
+		ensure(FVoxelUtilities::Equal(MakeVoxelArrayView(DecompressedData), Data));
+
+		LOG_VOXEL(Log, "%-40s %s -> %s (%.2fx) Compress: %.1fms Decompress: %.1fms (%.0fMB/s)",
+			Name,
+			*FVoxelUtilities::BytesToString(Data.Num()),
+			*FVoxelUtilities::BytesToString(CompressedData.Num()),
+			double(Data.Num()) / CompressedData.Num(),
+			CompressTime * 1000.,
+			DecompressTime * 1000.,
+			Data.Num() / DecompressTime / 1024. / 1024.);
+	};
+
+	using EFilter = EVoxelCompressionFilter;
+
+	Benchmark(TEXT("Densities"), MakeByteVoxelArrayView(Densities), { EFilter::None, 4 });
+	Benchmark(TEXT("Densities ByteShuffle"), MakeByteVoxelArrayView(Densities), { EFilter::ByteShuffle, 4 });
+	Benchmark(TEXT("Densities Sortable ByteShuffle"), MakeByteVoxelArrayView(Densities), { EFilter::FloatToSortable | EFilter::ByteShuffle, 4 });
+	Benchmark(TEXT("Densities Sortable Delta ByteShuffle"), MakeByteVoxelArrayView(Densities), { EFilter::FloatToSortable | EFilter::Delta | EFilter::ByteShuffle, 4, BrickSize });
+
+	Benchmark(TEXT("Materials"), MakeByteVoxelArrayView(Materials), { EFilter::None, 2 });
+	Benchmark(TEXT("Materials ByteShuffle"), MakeByteVoxelArrayView(Materials), { EFilter::ByteShuffle, 2 });
+	Benchmark(TEXT("Materials Delta ByteShuffle"), MakeByteVoxelArrayView(Materials), { EFilter::Delta | EFilter::ByteShuffle, 2, BrickSize });
+
+	Benchmark(TEXT("Normals"), MakeByteVoxelArrayView(Normals), { EFilter::None, 2 });
+	Benchmark(TEXT("Normals ByteShuffle"), MakeByteVoxelArrayView(Normals), { EFilter::ByteShuffle, 2 });
+	Benchmark(TEXT("Normals ByteShuffle Delta"), MakeByteVoxelArrayView(Normals), { EFilter::ByteShuffle | EFilter::Delta, 2, BrickSize });
+}
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, int32, GVoxelConversionParallelThreshold, 256 * 1024,
+	"voxel.Conversion.ParallelThreshold",
+	"Number of elements above which bulk conversions are split across threads");
+
+VOXEL_CONSOLE_COMMAND(
+	"voxel.Conversion.Benchmark",
+	"Benchmark the bulk conversion kernels against scalar loops")
+{
+	VOXEL_SCOPE_COUNTER("voxel.Conversion.Benchmark");
+
+	constexpr int32 Num = 4 * 1024 * 1024;
+
+	TVoxelArray<float> Floats;
+	TVoxelArray<FLinearColor> LinearColors;
+	TVoxelArray<FVector3f> UnitVectors;
+	FVoxelUtilities::SetNumFast(Floats, Num);
+	FVoxelUtilities::SetNumFast(LinearColors, Num);
+	FVoxelUtilities::SetNumFast(UnitVectors, Num);
+
+	const FRandomStream Stream(42);
+	for (int32 Index = 0; Index < Num; Index++)
+	{
+		Floats[Index] = Stream.FRandRange(-2.f, 2.f);
+		LinearColors[Index] = FLinearColor(Stream.FRand(), Stream.FRand(), Stream.FRand(), Stream.FRand());
+		UnitVectors[Index] = FVector3f(Stream.GetUnitVector());
+	}
+
+	const auto Benchmark = [&](const TCHAR* Name, const TFunctionRef<void()> Lambda)
+	{
+		double BestTime = MAX_dbl;
+		for (int32 Run = 0; Run < 5; Run++)
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			Lambda();
+			BestTime = FMath::Min(BestTime, FPlatformTime::Seconds() - StartTime);
+		}
+
+		LOG_VOXEL(Log, "%-40s %6.2fms (%.0fM/s)",
+			Name,
+			BestTime * 1000.,
+			Num / BestTime / 1.e6);
+	};
+
+	{
+		TVoxelArray<FFloat16> Scalar;
+		TVoxelArray<FFloat16> Halves;
+		FVoxelUtilities::SetNumFast(Scalar, Num);
+		FVoxelUtilities::SetNumFast(Halves, Num);
+
+		Benchmark(TEXT("FloatToHalf scalar"), [&]
+		{
+			for (int32 Index = 0; Index < Num; Index++)
+			{
+				Scalar[Index] = Floats[Index];
+			}
+		});
+		Benchmark(TEXT("FloatToHalf"), [&]
+		{
+			FVoxelUtilities::Memcpy_Convert(Halves, Floats);
+		});
+
+		TVoxelArray<float> Result;
+		FVoxelUtilities::SetNumFast(Result, Num);
+
+		Benchmark(TEXT("HalfToFloat"), [&]
+		{
+			FVoxelUtilities::Memcpy_Convert(Result, Halves);
+		});
+
+		ensure(FVoxelUtilities::Equal(MakeByteVoxelArrayView(Scalar), MakeByteVoxelArrayView(Halves)));
+	}
+
+	{
+		TVoxelArray<uint8> Scalar;
+		TVoxelArray<uint8> Bytes;
+		FVoxelUtilities::SetNumFast(Scalar, Num);
+		FVoxelUtilities::SetNumFast(Bytes, Num);
+
+		Benchmark(TEXT("FloatToUnorm8 scalar"), [&]
+		{
+			for (int32 Index = 0; Index < Num; Index++)
+			{
+				// ISPC round rounds ties to even, RoundToInt would round them up
+				Scalar[Index] = int32(FMath::RoundHalfToEven(FMath::Clamp(Floats[Index], 0.f, 1.f) * 255.f));
+			}
+		});
+		Benchmark(TEXT("FloatToUnorm8"), [&]
+		{
+			FVoxelUtilities::FloatToUnorm(Bytes, Floats);
+		});
+
+		ensure(FVoxelUtilities::Equal(Scalar, Bytes));
+	}
+
+	{
+		TVoxelArray<FColor> Scalar;
+		TVoxelArray<FColor> Colors;
+		FVoxelUtilities::SetNumFast(Scalar, Num);
+		FVoxelUtilities::SetNumFast(Colors, Num);
+
+		Benchmark(TEXT("LinearColorToColor scalar"), [&]
+		{
+			for (int32 Index = 0; Index < Num; Index++)
+			{
+				Scalar[Index] = LinearColors[Index].ToFColor(false);
+			}
+		});
+		Benchmark(TEXT("LinearColorToColor"), [&]
+		{
+			FVoxelUtilities::ConvertColors(Colors, LinearColors, false);
+		});
+
+		ensure(FVoxelUtilities::Equal(MakeByteVoxelArrayView(Scalar), MakeByteVoxelArrayView(Colors)));
+
+		Benchmark(TEXT("LinearColorToColor sRGB scalar"), [&]
+		{
+			for (int32 Index = 0; Index < Num; Index++)
+			{
+				Scalar[Index] = LinearColors[Index].ToFColorSRGB();
+			}
+		});
+		Benchmark(TEXT("LinearColorToColor sRGB"), [&]
+		{
+			FVoxelUtilities::ConvertColors(Colors, LinearColors, true);
+		});
+
+		ensure(FVoxelUtilities::Equal(MakeByteVoxelArrayView(Scalar), MakeByteVoxelArrayView(Colors)));
+	}
+
+	{
+		TVoxelArray<FVoxelOctahedron> Scalar;
+		TVoxelArray<FVoxelOctahedron> Octahedrons;
+		FVoxelUtilities::SetNumFast(Scalar, Num);
+		FVoxelUtilities::SetNumFast(Octahedrons, Num);
+
+		Benchmark(TEXT("UnitVectorsToOctahedrons scalar"), [&]
+		{
+			for (int32 Index = 0; Index < Num; Index++)
+			{
+				Scalar[Index] = FVoxelOctahedron(UnitVectors[Index]);
+			}
+		});
+		Benchmark(TEXT("UnitVectorsToOctahedrons"), [&]
+		{
+			FVoxelUtilities::UnitVectorsToOctahedrons(UnitVectors, Octahedrons);
+		});
+
+		TVoxelArray<FVector3f> Result;
+		FVoxelUtilities::SetNumFast(Result, Num);
+
+		Benchmark(TEXT("OctahedronsToUnitVectors"), [&]
+		{
+			FVoxelUtilities::OctahedronsToUnitVectors(Octahedrons, Result);
+		});
+
+		ensure(FVoxelUtilities::Equal(MakeByteVoxelArrayView(Scalar), MakeByteVoxelArrayView(Octahedrons)));
+
+		const auto LogError = [&](const TCHAR* Name)
+		{
+			double MaxError = 0;
+			for (int32 Index = 0; Index < Num; Index++)
+			{
+				const double Dot = FMath::Clamp(FVector3f::DotProduct(Result[Index], UnitVectors[Index]), -1.f, 1.f);
+				MaxError = FMath::Max(MaxError, FMath::RadiansToDegrees(FMath::Acos(Dot)));
+			}
+			LOG_VOXEL(Log, "%-40s max error %.4f degrees", Name, MaxError);
+		};
+
+		LogError(TEXT("Octahedron"));
+
+		Benchmark(TEXT("UnitVectorsToOctahedrons precise"), [&]
+		{
+			FVoxelUtilities::UnitVectorsToOctahedrons(UnitVectors, Octahedrons, true);
+		});
+
+		FVoxelUtilities::OctahedronsToUnitVectors(Octahedrons, Result);
+		LogError(TEXT("Octahedron precise"));
+
+		TVoxelArray<FVoxelOctahedron16> Octahedrons16;
+		FVoxelUtilities::SetNumFast(Octahedrons16, Num);
+
+		Benchmark(TEXT("UnitVectorsToOctahedrons16 precise"), [&]
+		{
+			FVoxelUtilities::UnitVectorsToOctahedrons(UnitVectors, Octahedrons16, true);
+		});
+		Benchmark(TEXT("OctahedronsToUnitVectors16"), [&]
+		{
+			FVoxelUtilities::OctahedronsToUnitVectors(Octahedrons16, Result);
+		});
+
+		LogError(TEXT("Octahedron16 precise"));
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+namespace FVoxelArrayUtilities
+{
+	template<typename LambdaType>
+	void ConvertInChunks(const int32 Num, LambdaType Lambda)
+	{
+		if (Num == 0)
+		{
+			return;
+		}
+
+		if (Num < GVoxelConversionParallelThreshold)
+		{
+			Lambda(0, Num);
+			return;
+		}
+
+		const int32 NumChunks = FMath::Clamp(
+			Num / FMath::Max(GVoxelConversionParallelThreshold / 4, 1024),
+			1,
+			FPlatformMisc::NumberOfCoresIncludingHyperthreads());
+
+		ParallelFor(NumChunks, [&](const int32 ChunkIndex)
+		{
+			const int32 Start = int64(Num) * ChunkIndex / NumChunks;
+			const int32 End = int64(Num) * (ChunkIndex + 1) / NumChunks;
+
+			Lambda(Start, End - Start);
+		});
+	}
+}
+
 void FVoxelUtilities::Memcpy_Convert(
 	const TVoxelArrayView<double> Dest,
 	const TConstVoxelArrayView<float> Src)
@@ -10,15 +318,402 @@ void FVoxelUtilities::Memcpy_Convert(
 	VOXEL_FUNCTION_COUNTER_NUM(Dest.Num(), 4096);
 	checkVoxelSlow(Dest.Num() == Src.Num());
 
-	if (Dest.Num() == 0)
+	FVoxelArrayUtilities::ConvertInChunks(Dest.Num(), [&](const int32 Start, const int32 Num)
 	{
-		return;
-	}
+		ispc::ArrayUtilities_FloatToDouble(
+			Dest.GetData() + Start,
+			Src.GetData() + Start,
+			Num);
+	});
+}
+
+void FVoxelUtilities::Memcpy_Convert(
+	const TVoxelArrayView<float> Dest,
+	const TConstVoxelArrayView<double> Src)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Dest.Num(), 4096);
+	checkVoxelSlow(Dest.Num() == Src.Num());
+
+	FVoxelArrayUtilities::ConvertInChunks(Dest.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_DoubleToFloat(
+			Dest.GetData() + Start,
+			Src.GetData() + Start,
+			Num);
+	});
+}
+
+void FVoxelUtilities::Memcpy_Convert(
+	const TVoxelArrayView<FFloat16> Dest,
+	const TConstVoxelArrayView<float> Src)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Dest.Num(), 4096);
+	checkVoxelSlow(Dest.Num() == Src.Num());
+	checkStatic(sizeof(FFloat16) == sizeof(uint16));
+
+	FVoxelArrayUtilities::ConvertInChunks(Dest.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_FloatToHalf(
+			reinterpret_cast<uint16*>(Dest.GetData() + Start),
+			Src.GetData() + Start,
+			Num);
+	});
+}
+
+void FVoxelUtilities::Memcpy_Convert(
+	const TVoxelArrayView<float> Dest,
+	const TConstVoxelArrayView<FFloat16> Src)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Dest.Num(), 4096);
+	checkVoxelSlow(Dest.Num() == Src.Num());
+
+	FVoxelArrayUtilities::ConvertInChunks(Dest.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_HalfToFloat(
+			Dest.GetData() + Start,
+			reinterpret_cast<const uint16*>(Src.GetData() + Start),
+			Num);
+	});
+}
+
+void FVoxelUtilities::Memcpy_Convert(
+	const TVoxelArrayView<float> Dest,
+	const TConstVoxelArrayView<int32> Src)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Dest.Num(), 4096);
+	checkVoxelSlow(Dest.Num() == Src.Num());
+
+	FVoxelArrayUtilities::ConvertInChunks(Dest.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_IntToFloat(
+			Dest.GetData() + Start,
+			Src.GetData() + Start,
+			Num);
+	});
+}
+
+void FVoxelUtilities::Memcpy_Convert(
+	const TVoxelArrayView<int32> Dest,
+	const TConstVoxelArrayView<float> Src)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Dest.Num(), 4096);
+	checkVoxelSlow(Dest.Num() == Src.Num());
+
+	FVoxelArrayUtilities::ConvertInChunks(Dest.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_FloatToInt(
+			Dest.GetData() + Start,
+			Src.GetData() + Start,
+			Num);
+	});
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelUtilities::FloatToUnorm(
+	const TVoxelArrayView<uint8> Dest,
+	const TConstVoxelArrayView<float> Src)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Dest.Num(), 4096);
+	checkVoxelSlow(Dest.Num() == Src.Num());
+
+	FVoxelArrayUtilities::ConvertInChunks(Dest.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_FloatToUnorm8(
+			Dest.GetData() + Start,
+			Src.GetData() + Start,
+			Num);
+	});
+}
+
+void FVoxelUtilities::FloatToUnorm(
+	const TVoxelArrayView<uint16> Dest,
+	const TConstVoxelArrayView<float> Src)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Dest.Num(), 4096);
+	checkVoxelSlow(Dest.Num() == Src.Num());
+
+	FVoxelArrayUtilities::ConvertInChunks(Dest.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_FloatToUnorm16(
+			Dest.GetData() + Start,
+			Src.GetData() + Start,
+			Num);
+	});
+}
+
+void FVoxelUtilities::FloatToSnorm(
+	const TVoxelArrayView<int8> Dest,
+	const TConstVoxelArrayView<float> Src)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Dest.Num(), 4096);
+	checkVoxelSlow(Dest.Num() == Src.Num());
+
+	FVoxelArrayUtilities::ConvertInChunks(Dest.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_FloatToSnorm8(
+			Dest.GetData() + Start,
+			Src.GetData() + Start,
+			Num);
+	});
+}
+
+void FVoxelUtilities::FloatToSnorm(
+	const TVoxelArrayView<int16> Dest,
+	const TConstVoxelArrayView<float> Src)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Dest.Num(), 4096);
+	checkVoxelSlow(Dest.Num() == Src.Num());
+
+	FVoxelArrayUtilities::ConvertInChunks(Dest.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_FloatToSnorm16(
+			Dest.GetData() + Start,
+			Src.GetData() + Start,
+			Num);
+	});
+}
+
+void FVoxelUtilities::UnormToFloat(
+	const TVoxelArrayView<float> Dest,
+	const TConstVoxelArrayView<uint8> Src)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Dest.Num(), 4096);
+	checkVoxelSlow(Dest.Num() == Src.Num());
+
+	FVoxelArrayUtilities::ConvertInChunks(Dest.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_Unorm8ToFloat(
+			Dest.GetData() + Start,
+			Src.GetData() + Start,
+			Num);
+	});
+}
+
+void FVoxelUtilities::UnormToFloat(
+	const TVoxelArrayView<float> Dest,
+	const TConstVoxelArrayView<uint16> Src)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Dest.Num(), 4096);
+	checkVoxelSlow(Dest.Num() == Src.Num());
+
+	FVoxelArrayUtilities::ConvertInChunks(Dest.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_Unorm16ToFloat(
+			Dest.GetData() + Start,
+			Src.GetData() + Start,
+			Num);
+	});
+}
+
+void FVoxelUtilities::SnormToFloat(
+	const TVoxelArrayView<float> Dest,
+	const TConstVoxelArrayView<int8> Src)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Dest.Num(), 4096);
+	checkVoxelSlow(Dest.Num() == Src.Num());
+
+	FVoxelArrayUtilities::ConvertInChunks(Dest.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_Snorm8ToFloat(
+			Dest.GetData() + Start,
+			Src.GetData() + Start,
+			Num);
+	});
+}
+
+void FVoxelUtilities::SnormToFloat(
+	const TVoxelArrayView<float> Dest,
+	const TConstVoxelArrayView<int16> Src)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Dest.Num(), 4096);
+	checkVoxelSlow(Dest.Num() == Src.Num());
+
+	FVoxelArrayUtilities::ConvertInChunks(Dest.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_Snorm16ToFloat(
+			Dest.GetData() + Start,
+			Src.GetData() + Start,
+			Num);
+	});
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelUtilities::ConvertColors(
+	const TVoxelArrayView<FColor> Dest,
+	const TConstVoxelArrayView<FLinearColor> Src,
+	const bool bSRGB)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Dest.Num(), 4096);
+	checkVoxelSlow(Dest.Num() == Src.Num());
+
+	// FLinearColor::ToFColorSRGB only depends on the top 20 bits of the clamped float: tabulate it
+	// Min is the float below which the result is 0, max is the float right below 1
+	// Must match LINEAR_TO_SRGB_MIN_BITS & LINEAR_TO_SRGB_MAX_BITS in VoxelArrayUtilitiesImpl.ispc
+	static const TVoxelArray<uint8> LinearToSRGBTable = []
+	{
+		constexpr uint32 MinBits = 0x39000000;
+		constexpr uint32 MaxBits = 0x3F7FFFFF;
+
+		TVoxelArray<uint8> Table;
+		FVoxelUtilities::SetNumFast(Table, ((MaxBits - MinBits) >> 12) + 1);
+
+		for (int32 Index = 0; Index < Table.Num(); Index++)
+		{
+			const uint32 Bits = MinBits + (uint32(Index) << 12);
+			const float Value = ReinterpretCastRef<float>(Bits);
+			Table[Index] = FLinearColor(Value, Value, Value).ToFColorSRGB().R;
+		}
+		return Table;
+	}();
+
+	FVoxelArrayUtilities::ConvertInChunks(Dest.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_LinearColorToColor(
+			reinterpret_cast<uint8*>(Dest.GetData() + Start),
+			reinterpret_cast<const float*>(Src.GetData() + Start),
+			Num,
+			bSRGB ? LinearToSRGBTable.GetData() : nullptr);
+	});
+}
+
+void FVoxelUtilities::ConvertColors(
+	const TVoxelArrayView<FLinearColor> Dest,
+	const TConstVoxelArrayView<FColor> Src,
+	const bool bSRGB)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Dest.Num(), 4096);
+	checkVoxelSlow(Dest.Num() == Src.Num());
+
+	FVoxelArrayUtilities::ConvertInChunks(Dest.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_ColorToLinearColor(
+			reinterpret_cast<float*>(Dest.GetData() + Start),
+			reinterpret_cast<const uint8*>(Src.GetData() + Start),
+			Num,
+			bSRGB ? FLinearColor::sRGBToLinearTable : nullptr);
+	});
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelUtilities::SplitVectors(
+	const TConstVoxelArrayView<FVector3f> Vectors,
+	const TVoxelArrayView<float> OutX,
+	const TVoxelArrayView<float> OutY,
+	const TVoxelArrayView<float> OutZ)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Vectors.Num(), 4096);
+	checkVoxelSlow(Vectors.Num() == OutX.Num());
+	checkVoxelSlow(Vectors.Num() == OutY.Num());
+	checkVoxelSlow(Vectors.Num() == OutZ.Num());
+
+	FVoxelArrayUtilities::ConvertInChunks(Vectors.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_SplitVectors(
+			&Vectors[Start].X,
+			OutX.GetData() + Start,
+			OutY.GetData() + Start,
+			OutZ.GetData() + Start,
+			Num);
+	});
+}
+
+void FVoxelUtilities::MergeVectors(
+	const TConstVoxelArrayView<float> X,
+	const TConstVoxelArrayView<float> Y,
+	const TConstVoxelArrayView<float> Z,
+	const TVoxelArrayView<FVector3f> OutVectors)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(OutVectors.Num(), 4096);
+	checkVoxelSlow(OutVectors.Num() == X.Num());
+	checkVoxelSlow(OutVectors.Num() == Y.Num());
+	checkVoxelSlow(OutVectors.Num() == Z.Num());
+
+	FVoxelArrayUtilities::ConvertInChunks(OutVectors.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_MergeVectors(
+			X.GetData() + Start,
+			Y.GetData() + Start,
+			Z.GetData() + Start,
+			&OutVectors[Start].X,
+			Num);
+	});
+}
+
+void FVoxelUtilities::UnitVectorsToOctahedrons(
+	const TConstVoxelArrayView<FVector3f> UnitVectors,
+	const TVoxelArrayView<FVoxelOctahedron> OutOctahedrons,
+	const bool bPrecise)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(UnitVectors.Num(), 4096);
+	checkVoxelSlow(UnitVectors.Num() == OutOctahedrons.Num());
+
+	FVoxelArrayUtilities::ConvertInChunks(UnitVectors.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_UnitVectorsToOctahedrons(
+			&UnitVectors[Start].X,
+			OutOctahedrons.GetData() + Start,
+			Num,
+			bPrecise);
+	});
+}
 
-	return ispc::ArrayUtilities_FloatToDouble(
-		Dest.GetData(),
-		Src.GetData(),
-		Dest.Num());
+void FVoxelUtilities::UnitVectorsToOctahedrons(
+	const TConstVoxelArrayView<FVector3f> UnitVectors,
+	const TVoxelArrayView<FVoxelOctahedron16> OutOctahedrons,
+	const bool bPrecise)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(UnitVectors.Num(), 4096);
+	checkVoxelSlow(UnitVectors.Num() == OutOctahedrons.Num());
+
+	FVoxelArrayUtilities::ConvertInChunks(UnitVectors.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_UnitVectorsToOctahedrons16(
+			&UnitVectors[Start].X,
+			OutOctahedrons.GetData() + Start,
+			Num,
+			bPrecise);
+	});
+}
+
+void FVoxelUtilities::OctahedronsToUnitVectors(
+	const TConstVoxelArrayView<FVoxelOctahedron> Octahedrons,
+	const TVoxelArrayView<FVector3f> OutUnitVectors)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Octahedrons.Num(), 4096);
+	checkVoxelSlow(Octahedrons.Num() == OutUnitVectors.Num());
+
+	FVoxelArrayUtilities::ConvertInChunks(Octahedrons.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_OctahedronsToUnitVectors(
+			Octahedrons.GetData() + Start,
+			&OutUnitVectors[Start].X,
+			Num);
+	});
+}
+
+void FVoxelUtilities::OctahedronsToUnitVectors(
+	const TConstVoxelArrayView<FVoxelOctahedron16> Octahedrons,
+	const TVoxelArrayView<FVector3f> OutUnitVectors)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Octahedrons.Num(), 4096);
+	checkVoxelSlow(Octahedrons.Num() == OutUnitVectors.Num());
+
+	FVoxelArrayUtilities::ConvertInChunks(Octahedrons.Num(), [&](const int32 Start, const int32 Num)
+	{
+		ispc::ArrayUtilities_OctahedronsToUnitVectors16(
+			Octahedrons.GetData() + Start,
+			&OutUnitVectors[Start].X,
+			Num);
+	});
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -355,10 +1050,22 @@ void FVoxelUtilities::FixupSignBit(const TVoxelArrayView<float> Data)
 	ispc::ArrayUtilities_FixupSignBit(Data.GetData(), Data.Num());
 }
 
-int64 FVoxelUtilities::CountSetBits(const TConstVoxelArrayView<uint32> Data)
+void FVoxelUtilities::ByteSwap(const TVoxelArrayView<uint16> Data)
 {
-	return FVoxelBitArrayHelpers::CountSetBits(Data.GetData(), Data.Num());
-}
+	VOXEL_FUNCTION_COUNTER_NUM(Data.Num(), 1024);
+
+	if (Data.Num() == 0)
+	{
+		return;
+	}
+
+	ispc::ArrayUtilities_ByteSwap_uint16(Data.GetData(), Data.Num());
+}
+
+int64 FVoxelUtilities::CountSetBits(const TConstVoxelArrayView<uint32> Data)
+{
+	return FVoxelBitArrayHelpers::CountSetBits(Data.GetData(), Data.Num());
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
@@ -371,6 +1078,218 @@ struct FVoxelOodleHeader
 	int64 CompressedSize = 0;
 };
 
+// Followed by a FVoxelOodleHeader compressed blob of the filtered data
+struct FVoxelOodleFilteredHeader
+{
+	uint64 Tag = MAKE_TAG_64("OODLE_VX");
+	uint32 Filters = 0;
+	int32 ElementSize = 0;
+	int32 RowSize = 0;
+	int32 Padding = 0;
+};
+
+bool CanUseCompressionFilters(const FVoxelCompressionFilters& Filters, const int64 Num)
+{
+	if (Filters.ElementSize <= 0 ||
+		Filters.RowSize < 0 ||
+		Num >= MAX_int32)
+	{
+		return false;
+	}
+
+	if (EnumHasAnyFlags(Filters.Filters, EVoxelCompressionFilter::FloatToSortable) &&
+		Filters.ElementSize != 4)
+	{
+		return false;
+	}
+
+	if (EnumHasAnyFlags(Filters.Filters, EVoxelCompressionFilter::Delta) &&
+		Filters.ElementSize != 1 &&
+		Filters.ElementSize != 2 &&
+		Filters.ElementSize != 4)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+// Trailing bytes that don't make a full element or a full row are left untouched
+void ApplyCompressionFilters(const FVoxelCompressionFilters& Filters, TVoxelArray64<uint8>& Data)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Data.Num(), 1024);
+	checkVoxelSlow(CanUseCompressionFilters(Filters, Data.Num()));
+
+	const int32 ElementSize = Filters.ElementSize;
+	const int32 NumElements = int32(Data.Num() / ElementSize);
+	const int32 RowSize = Filters.RowSize > 0 ? FMath::Min(Filters.RowSize, NumElements) : NumElements;
+	const int32 NumRows = RowSize > 0 ? NumElements / RowSize : 0;
+
+	if (NumElements == 0)
+	{
+		return;
+	}
+
+	if (EnumHasAnyFlags(Filters.Filters, EVoxelCompressionFilter::FloatToSortable))
+	{
+		ispc::ArrayUtilities_FloatToSortable(ReinterpretCastPtr<uint32>(Data.GetData()), NumElements);
+	}
+
+	if (EnumHasAnyFlags(Filters.Filters, EVoxelCompressionFilter::Delta))
+	{
+		TVoxelArray64<uint8> FilteredData = Data;
+
+		switch (ElementSize)
+		{
+		default: VOXEL_ASSUME(false);
+		case 1: ispc::ArrayUtilities_DeltaEncode_uint8(Data.GetData(), FilteredData.GetData(), NumRows, RowSize); break;
+		case 2: ispc::ArrayUtilities_DeltaEncode_uint16(ReinterpretCastPtr<uint16>(Data.GetData()), ReinterpretCastPtr<uint16>(FilteredData.GetData()), NumRows, RowSize); break;
+		case 4: ispc::ArrayUtilities_DeltaEncode_uint32(ReinterpretCastPtr<uint32>(Data.GetData()), ReinterpretCastPtr<uint32>(FilteredData.GetData()), NumRows, RowSize); break;
+		}
+
+		Data = MoveTemp(FilteredData);
+	}
+
+	if (EnumHasAnyFlags(Filters.Filters, EVoxelCompressionFilter::ByteShuffle) &&
+		ElementSize > 1)
+	{
+		TVoxelArray64<uint8> FilteredData = Data;
+		ispc::ArrayUtilities_ShuffleBytes(Data.GetData(), FilteredData.GetData(), NumElements, ElementSize);
+		Data = MoveTemp(FilteredData);
+	}
+}
+
+void UndoCompressionFilters(const FVoxelCompressionFilters& Filters, TVoxelArray64<uint8>& Data)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Data.Num(), 1024);
+	checkVoxelSlow(CanUseCompressionFilters(Filters, Data.Num()));
+
+	const int32 ElementSize = Filters.ElementSize;
+	const int32 NumElements = int32(Data.Num() / ElementSize);
+	const int32 RowSize = Filters.RowSize > 0 ? FMath::Min(Filters.RowSize, NumElements) : NumElements;
+	const int32 NumRows = RowSize > 0 ? NumElements / RowSize : 0;
+
+	if (NumElements == 0)
+	{
+		return;
+	}
+
+	if (EnumHasAnyFlags(Filters.Filters, EVoxelCompressionFilter::ByteShuffle) &&
+		ElementSize > 1)
+	{
+		TVoxelArray64<uint8> UnfilteredData = Data;
+		ispc::ArrayUtilities_UnshuffleBytes(Data.GetData(), UnfilteredData.GetData(), NumElements, ElementSize);
+		Data = MoveTemp(UnfilteredData);
+	}
+
+	if (EnumHasAnyFlags(Filters.Filters, EVoxelCompressionFilter::Delta))
+	{
+		switch (ElementSize)
+		{
+		default: VOXEL_ASSUME(false);
+		case 1: ispc::ArrayUtilities_DeltaDecode_uint8(Data.GetData(), NumRows, RowSize); break;
+		case 2: ispc::ArrayUtilities_DeltaDecode_uint16(ReinterpretCastPtr<uint16>(Data.GetData()), NumRows, RowSize); break;
+		case 4: ispc::ArrayUtilities_DeltaDecode_uint32(ReinterpretCastPtr<uint32>(Data.GetData()), NumRows, RowSize); break;
+		}
+	}
+
+	if (EnumHasAnyFlags(Filters.Filters, EVoxelCompressionFilter::FloatToSortable))
+	{
+		ispc::ArrayUtilities_SortableToFloat(ReinterpretCastPtr<uint32>(Data.GetData()), NumElements);
+	}
+}
+
+// Followed by NumBlocks + 1 int64 offsets relative to the end of the offset table, then by the blocks
+struct FVoxelOodleFramedHeader
+{
+	uint64 Tag = MAKE_TAG_64("OODLE_VF");
+	int64 UncompressedSize = 0;
+	int32 BlockSize = 0;
+	int32 NumBlocks = 0;
+};
+
+struct FVoxelOodleFramedLayout
+{
+	FVoxelOodleFramedHeader Header;
+	TConstVoxelArrayView64<uint8> OffsetBytes;
+	TConstVoxelArrayView64<uint8> Payload;
+
+	FORCEINLINE int64 GetOffset(const int32 Index) const
+	{
+		int64 Offset;
+		FMemory::Memcpy(&Offset, &OffsetBytes[Index * sizeof(int64)], sizeof(int64));
+		return Offset;
+	}
+	FORCEINLINE int64 GetBlockUncompressedSize(const int32 BlockIndex) const
+	{
+		return FMath::Min<int64>(Header.BlockSize, Header.UncompressedSize - int64(BlockIndex) * Header.BlockSize);
+	}
+
+	bool Initialize(const TConstVoxelArrayView64<uint8> CompressedData)
+	{
+		if (CompressedData.Num() < sizeof(FVoxelOodleFramedHeader))
+		{
+			return false;
+		}
+
+		FMemory::Memcpy(&Header, CompressedData.GetData(), sizeof(FVoxelOodleFramedHeader));
+
+		if (Header.Tag != FVoxelOodleFramedHeader().Tag)
+		{
+			return false;
+		}
+
+		// Validate NumBlocks against the data size before using it, it's read from untrusted data
+		const int64 MaxNumBlocks = (CompressedData.Num() - int64(sizeof(FVoxelOodleFramedHeader))) / int64(sizeof(int64)) - 1;
+		if (!ensureVoxelSlow(Header.NumBlocks >= 0) ||
+			!ensureVoxelSlow(Header.NumBlocks <= MaxNumBlocks))
+		{
+			return false;
+		}
+
+		if (!ensureVoxelSlow(Header.BlockSize > 0) ||
+			!ensureVoxelSlow(Header.UncompressedSize >= 0) ||
+			!ensureVoxelSlow(Header.NumBlocks == FMath::DivideAndRoundUp<int64>(Header.UncompressedSize, Header.BlockSize)))
+		{
+			return false;
+		}
+
+		const int64 TableSize = (int64(Header.NumBlocks) + 1) * int64(sizeof(int64));
+		checkVoxelSlow(CompressedData.Num() >= int64(sizeof(FVoxelOodleFramedHeader)) + TableSize);
+
+		OffsetBytes = CompressedData.Slice(sizeof(FVoxelOodleFramedHeader), TableSize);
+		Payload = CompressedData.RightOf(sizeof(FVoxelOodleFramedHeader) + TableSize);
+
+		if (!ensureVoxelSlow(GetOffset(0) == 0) ||
+			!ensureVoxelSlow(GetOffset(Header.NumBlocks) == Payload.Num()))
+		{
+			return false;
+		}
+
+		for (int32 Index = 0; Index < Header.NumBlocks; Index++)
+		{
+			if (!ensureVoxelSlow(GetOffset(Index) < GetOffset(Index + 1)))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool DecompressBlock(const int32 BlockIndex, uint8* OutData) const
+	{
+		const int64 Start = GetOffset(BlockIndex);
+		const int64 End = GetOffset(BlockIndex + 1);
+
+		return ensure(FOodleDataCompression::Decompress(
+			OutData,
+			GetBlockUncompressedSize(BlockIndex),
+			Payload.GetData() + Start,
+			End - Start));
+	}
+};
+
 bool FVoxelUtilities::IsCompressedData(const TConstVoxelArrayView64<uint8> CompressedData)
 {
 	if (CompressedData.Num() < sizeof(FVoxelOodleHeader))
@@ -381,7 +1300,9 @@ bool FVoxelUtilities::IsCompressedData(const TConstVoxelArrayView64<uint8> Compr
 	const TConstVoxelArrayView<uint8> HeaderBytes = MakeVoxelArrayView(CompressedData).LeftOf(sizeof(FVoxelOodleHeader));
 	const FVoxelOodleHeader Header = FromByteVoxelArrayView<FVoxelOodleHeader>(HeaderBytes);
 
-	if (Header.Tag != FVoxelOodleHeader().Tag)
+	if (Header.Tag != FVoxelOodleHeader().Tag &&
+		Header.Tag != FVoxelOodleFramedHeader().Tag &&
+		Header.Tag != FVoxelOodleFilteredHeader().Tag)
 	{
 		return false;
 	}
@@ -472,6 +1393,47 @@ bool FVoxelUtilities::Decompress(
 		return false;
 	}
 
+	FVoxelOodleFramedLayout Layout;
+	if (Layout.Initialize(CompressedData))
+	{
+		TVoxelArray64<uint8> UncompressedData;
+		FVoxelUtilities::SetNumFast(UncompressedData, Layout.Header.UncompressedSize);
+
+		if (!DecompressRange(CompressedData, 0, UncompressedData, bAllowParallel))
+		{
+			return false;
+		}
+
+		OutData = MoveTemp(UncompressedData);
+		return true;
+	}
+
+	if (CompressedData.Num() >= sizeof(FVoxelOodleFilteredHeader))
+	{
+		FVoxelOodleFilteredHeader FilteredHeader;
+		FMemory::Memcpy(&FilteredHeader, CompressedData.GetData(), sizeof(FVoxelOodleFilteredHeader));
+
+		if (FilteredHeader.Tag == FVoxelOodleFilteredHeader().Tag)
+		{
+			FVoxelCompressionFilters Filters;
+			Filters.Filters = EVoxelCompressionFilter(FilteredHeader.Filters);
+			Filters.ElementSize = FilteredHeader.ElementSize;
+			Filters.RowSize = FilteredHeader.RowSize;
+
+			TVoxelArray64<uint8> UncompressedData;
+			if (!Decompress(CompressedData.RightOf(sizeof(FVoxelOodleFilteredHeader)), UncompressedData, bAllowParallel) ||
+				!ensureVoxelSlow(CanUseCompressionFilters(Filters, UncompressedData.Num())))
+			{
+				return false;
+			}
+
+			UndoCompressionFilters(Filters, UncompressedData);
+
+			OutData = MoveTemp(UncompressedData);
+			return true;
+		}
+	}
+
 	const TConstVoxelArrayView<uint8> HeaderBytes = MakeVoxelArrayView(CompressedData).LeftOf(sizeof(FVoxelOodleHeader));
 	const FVoxelOodleHeader Header = FromByteVoxelArrayView<FVoxelOodleHeader>(HeaderBytes);
 
@@ -515,4 +1477,259 @@ bool FVoxelUtilities::Decompress(
 
 	OutData = MoveTemp(UncompressedData);
 	return true;
+}
+
+TVoxelArray64<uint8> FVoxelUtilities::Compress(
+	const TConstVoxelArrayView64<uint8> Data,
+	const FVoxelCompressionFilters& Filters,
+	const bool bAllowParallel,
+	const FOodleDataCompression::ECompressor Compressor,
+	const FOodleDataCompression::ECompressionLevel CompressionLevel)
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	if (Data.Num() == 0 ||
+		Filters.Filters == EVoxelCompressionFilter::None ||
+		!ensure(CanUseCompressionFilters(Filters, Data.Num())))
+	{
+		return Compress(Data, bAllowParallel, Compressor, CompressionLevel);
+	}
+
+	TVoxelArray64<uint8> FilteredData;
+	SetNumFast(FilteredData, Data.Num());
+	FMemory::Memcpy(FilteredData.GetData(), Data.GetData(), Data.Num());
+
+	ApplyCompressionFilters(Filters, FilteredData);
+
+	const TVoxelArray64<uint8> FilteredCompressedData = Compress(FilteredData, bAllowParallel, Compressor, CompressionLevel);
+
+	FVoxelOodleFilteredHeader Header;
+	Header.Filters = uint32(Filters.Filters);
+	Header.ElementSize = Filters.ElementSize;
+	Header.RowSize = Filters.RowSize;
+
+	TVoxelArray64<uint8> CompressedData;
+	SetNumFast(CompressedData, sizeof(FVoxelOodleFilteredHeader) + FilteredCompressedData.Num());
+	FMemory::Memcpy(CompressedData.GetData(), &Header, sizeof(FVoxelOodleFilteredHeader));
+	FMemory::Memcpy(CompressedData.GetData() + sizeof(FVoxelOodleFilteredHeader), FilteredCompressedData.GetData(), FilteredCompressedData.Num());
+
+	return CompressedData;
+}
+
+bool FVoxelUtilities::CompressFramed(
+	const TConstVoxelArrayView64<uint8> Data,
+	TVoxelArray64<uint8>& OutCompressedData,
+	const int32 BlockSize,
+	const bool bAllowParallel,
+	const FOodleDataCompression::ECompressor Compressor,
+	const FOodleDataCompression::ECompressionLevel CompressionLevel)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Data.Num(), 1024);
+	check(BlockSize > 0);
+
+	OutCompressedData.Reset();
+
+	if (Data.Num() == 0)
+	{
+		return true;
+	}
+
+	const int64 NumBlocks64 = FMath::DivideAndRoundUp<int64>(Data.Num(), BlockSize);
+	if (!ensure(NumBlocks64 < MAX_int32))
+	{
+		return false;
+	}
+	const int32 NumBlocks = int32(NumBlocks64);
+
+	TVoxelArray<TVoxelArray64<uint8>> CompressedBlocks;
+	CompressedBlocks.SetNum(NumBlocks);
+
+	const FVoxelCancellationToken CancellationToken = FVoxelCancellationToken::Get();
+
+	ParallelFor(NumBlocks, [&](const int32 BlockIndex)
+	{
+		if (CancellationToken.IsCancelled())
+		{
+			return;
+		}
+
+		VOXEL_SCOPE_COUNTER_FORMAT("Compress block %s %s",
+			ECompressorToString(Compressor),
+			ECompressionLevelToString(CompressionLevel));
+
+		const TConstVoxelArrayView64<uint8> BlockData = Data.Slice(
+			int64(BlockIndex) * BlockSize,
+			FMath::Min<int64>(BlockSize, Data.Num() - int64(BlockIndex) * BlockSize));
+
+		const int64 WorkingSizeNeeded = FOodleDataCompression::CompressedBufferSizeNeeded(BlockData.Num());
+
+		TVoxelArray64<uint8>& CompressedBlock = CompressedBlocks[BlockIndex];
+		SetNumFast(CompressedBlock, WorkingSizeNeeded);
+
+		const int64 CompressedSize = FOodleDataCompression::Compress(
+			CompressedBlock.GetData(),
+			WorkingSizeNeeded,
+			BlockData.GetData(),
+			BlockData.Num(),
+			Compressor,
+			CompressionLevel);
+		check(CompressedSize > 0);
+
+		CompressedBlock.SetNum(CompressedSize, UE_505_SWITCH(false, EAllowShrinking::No));
+	}, !bAllowParallel);
+
+	if (CancellationToken.IsCancelled())
+	{
+		return false;
+	}
+
+	const int64 TableSize = (NumBlocks + 1) * sizeof(int64);
+
+	int64 PayloadSize = 0;
+	for (const TVoxelArray64<uint8>& CompressedBlock : CompressedBlocks)
+	{
+		PayloadSize += CompressedBlock.Num();
+	}
+
+	SetNumFast(OutCompressedData, sizeof(FVoxelOodleFramedHeader) + TableSize + PayloadSize);
+
+	FVoxelOodleFramedHeader Header;
+	Header.UncompressedSize = Data.Num();
+	Header.BlockSize = BlockSize;
+	Header.NumBlocks = NumBlocks;
+	FMemory::Memcpy(OutCompressedData.GetData(), &Header, sizeof(FVoxelOodleFramedHeader));
+
+	uint8* Table = OutCompressedData.GetData() + sizeof(FVoxelOodleFramedHeader);
+	uint8* Payload = Table + TableSize;
+
+	int64 Offset = 0;
+	for (int32 BlockIndex = 0; BlockIndex <= NumBlocks; BlockIndex++)
+	{
+		FMemory::Memcpy(Table + BlockIndex * sizeof(int64), &Offset, sizeof(int64));
+
+		if (BlockIndex == NumBlocks)
+		{
+			break;
+		}
+
+		const TVoxelArray64<uint8>& CompressedBlock = CompressedBlocks[BlockIndex];
+		FMemory::Memcpy(Payload + Offset, CompressedBlock.GetData(), CompressedBlock.Num());
+		Offset += CompressedBlock.Num();
+	}
+	check(Offset == PayloadSize);
+
+	return true;
+}
+
+bool FVoxelUtilities::GetUncompressedSize(
+	const TConstVoxelArrayView64<uint8> CompressedData,
+	int64& OutUncompressedSize)
+{
+	OutUncompressedSize = 0;
+
+	if (CompressedData.Num() == 0)
+	{
+		return true;
+	}
+
+	FVoxelOodleFramedLayout Layout;
+	if (Layout.Initialize(CompressedData))
+	{
+		OutUncompressedSize = Layout.Header.UncompressedSize;
+		return true;
+	}
+
+	if (!IsCompressedData(CompressedData))
+	{
+		return false;
+	}
+
+	if (FromByteVoxelArrayView<FVoxelOodleHeader>(MakeVoxelArrayView(CompressedData).LeftOf(sizeof(FVoxelOodleHeader))).Tag == FVoxelOodleFilteredHeader().Tag)
+	{
+		return GetUncompressedSize(CompressedData.RightOf(sizeof(FVoxelOodleFilteredHeader)), OutUncompressedSize);
+	}
+
+	const TConstVoxelArrayView<uint8> HeaderBytes = MakeVoxelArrayView(CompressedData).LeftOf(sizeof(FVoxelOodleHeader));
+	OutUncompressedSize = FromByteVoxelArrayView<FVoxelOodleHeader>(HeaderBytes).UncompressedSize;
+	return true;
+}
+
+bool FVoxelUtilities::DecompressRange(
+	const TConstVoxelArrayView64<uint8> CompressedData,
+	const int64 Offset,
+	const TVoxelArrayView64<uint8> OutData,
+	const bool bAllowParallel)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(OutData.Num(), 1024);
+
+	if (OutData.Num() == 0)
+	{
+		return true;
+	}
+
+	FVoxelOodleFramedLayout Layout;
+	if (!Layout.Initialize(CompressedData))
+	{
+		// Not framed, decompress everything
+		TVoxelArray64<uint8> UncompressedData;
+		if (!Decompress(CompressedData, UncompressedData, bAllowParallel) ||
+			!ensure(0 <= Offset && Offset + OutData.Num() <= UncompressedData.Num()))
+		{
+			return false;
+		}
+
+		FMemory::Memcpy(OutData.GetData(), UncompressedData.GetData() + Offset, OutData.Num());
+		return true;
+	}
+
+	const int64 BlockSize = Layout.Header.BlockSize;
+
+	if (!ensure(0 <= Offset && Offset + OutData.Num() <= Layout.Header.UncompressedSize))
+	{
+		return false;
+	}
+
+	const int32 FirstBlock = int32(Offset / BlockSize);
+	const int32 LastBlock = int32((Offset + OutData.Num() - 1) / BlockSize);
+
+	FVoxelCounter32 NumFailed;
+
+	ParallelFor(LastBlock - FirstBlock + 1, [&](const int32 Index)
+	{
+		VOXEL_SCOPE_COUNTER("Decompress block");
+
+		const int32 BlockIndex = FirstBlock + Index;
+		const int64 BlockStart = BlockIndex * BlockSize;
+		const int64 BlockUncompressedSize = Layout.GetBlockUncompressedSize(BlockIndex);
+
+		const int64 CopyStart = FMath::Max(BlockStart, Offset);
+		const int64 CopyEnd = FMath::Min(BlockStart + BlockUncompressedSize, Offset + OutData.Num());
+
+		if (CopyStart == BlockStart &&
+			CopyEnd == BlockStart + BlockUncompressedSize)
+		{
+			// Block is fully inside the range, decompress in-place
+			if (!Layout.DecompressBlock(BlockIndex, OutData.GetData() + (BlockStart - Offset)))
+			{
+				NumFailed.Increment();
+			}
+			return;
+		}
+
+		TVoxelArray64<uint8> BlockData;
+		SetNumFast(BlockData, BlockUncompressedSize);
+
+		if (!Layout.DecompressBlock(BlockIndex, BlockData.GetData()))
+		{
+			NumFailed.Increment();
+			return;
+		}
+
+		FMemory::Memcpy(
+			OutData.GetData() + (CopyStart - Offset),
+			BlockData.GetData() + (CopyStart - BlockStart),
+			CopyEnd - CopyStart);
+	}, !bAllowParallel);
+
+	return NumFailed.Get() == 0;
 }
\ No newline at end of file
@@ -0,0 +1,737 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#include "VoxelMinimal.h"
+#include "VoxelSortUtilitiesImpl.ispc.generated.h"
+
+VOXEL_CONSOLE_COMMAND(
+	"voxel.Sort.Benchmark",
+	"Benchmark scan, compaction, histogram and radix sort against scalar loops and std::sort")
+{
+	VOXEL_SCOPE_COUNTER("voxel.Sort.Benchmark");
+
+	constexpr int32 Num = 4 * 1024 * 1024;
+
+	TVoxelArray<uint32> Keys32;
+	TVoxelArray<uint64> Keys64;
+	TVoxelArray<uint8> Bytes;
+	TVoxelArray<int32> Counts;
+	FVoxelUtilities::SetNumFast(Keys32, Num);
+	FVoxelUtilities::SetNumFast(Keys64, Num);
+	FVoxelUtilities::SetNumFast(Bytes, Num);
+	FVoxelUtilities::SetNumFast(Counts, Num);
+
+	const FRandomStream Stream(42);
+	for (int32 Index = 0; Index < Num; Index++)
+	{
+		Keys32[Index] = Stream.GetUnsignedInt();
+		Keys64[Index] = (uint64(Stream.GetUnsignedInt()) << 32) | Stream.GetUnsignedInt();
+		Bytes[Index] = Stream.RandRange(0, 255);
+		Counts[Index] = Stream.RandRange(0, 16);
+	}
+
+	const auto Benchmark = [&](const TCHAR* Name, const TFunctionRef<void()> Lambda)
+	{
+		double BestTime = MAX_dbl;
+		for (int32 Run = 0; Run < 5; Run++)
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			Lambda();
+			BestTime = FMath::Min(BestTime, FPlatformTime::Seconds() - StartTime);
+		}
+
+		LOG_VOXEL(Log, "%-40s %6.2fms (%.0fM/s)",
+			Name,
+			BestTime * 1000.,
+			Num / BestTime / 1.e6);
+	};
+
+	{
+		TVoxelArray<int32> Scalar;
+		TVoxelArray<int32> Scan;
+		FVoxelUtilities::SetNumFast(Scalar, Num);
+		FVoxelUtilities::SetNumFast(Scan, Num);
+
+		Benchmark(TEXT("ExclusiveScan scalar"), [&]
+		{
+			int32 Sum = 0;
+			for (int32 Index = 0; Index < Num; Index++)
+			{
+				Scalar[Index] = Sum;
+				Sum += Counts[Index];
+			}
+		});
+		Benchmark(TEXT("ExclusiveScan"), [&]
+		{
+			FVoxelUtilities::ExclusiveScan(Counts, Scan, false);
+		});
+		Benchmark(TEXT("ExclusiveScan parallel"), [&]
+		{
+			FVoxelUtilities::ExclusiveScan(Counts, Scan, true);
+		});
+
+		ensure(FVoxelUtilities::Equal(Scalar, Scan));
+	}
+
+	{
+		TVoxelArray<uint32> Scalar;
+		TVoxelArray<uint32> Compacted;
+
+		const auto Predicate = [](const uint32 Key)
+		{
+			return Key % 3 == 0;
+		};
+
+		Benchmark(TEXT("CompactIf scalar"), [&]
+		{
+			Scalar.Reset();
+			for (const uint32 Key : Keys32)
+			{
+				if (Predicate(Key))
+				{
+					Scalar.Add(Key);
+				}
+			}
+		});
+		Benchmark(TEXT("CompactIf"), [&]
+		{
+			Compacted = FVoxelUtilities::CompactIf<uint32>(Keys32, Predicate, false);
+		});
+		Benchmark(TEXT("CompactIf parallel"), [&]
+		{
+			Compacted = FVoxelUtilities::CompactIf<uint32>(Keys32, Predicate, true);
+		});
+
+		ensure(FVoxelUtilities::Equal(Scalar, Compacted));
+	}
+
+	{
+		TVoxelArray<int32> Scalar;
+		TVoxelArray<int32> Histogram;
+		FVoxelUtilities::SetNumFast(Scalar, 256);
+		FVoxelUtilities::SetNumFast(Histogram, 256);
+
+		Benchmark(TEXT("Histogram scalar"), [&]
+		{
+			FVoxelUtilities::Memzero(Scalar);
+			for (const uint8 Byte : Bytes)
+			{
+				Scalar[Byte]++;
+			}
+		});
+		Benchmark(TEXT("Histogram"), [&]
+		{
+			FVoxelUtilities::Histogram(Bytes, Histogram, false);
+		});
+		Benchmark(TEXT("Histogram parallel"), [&]
+		{
+			FVoxelUtilities::Histogram(Bytes, Histogram, true);
+		});
+
+		ensure(FVoxelUtilities::Equal(Scalar, Histogram));
+	}
+
+	{
+		TVoxelArray<uint32> Sorted;
+		TVoxelArray<uint32> RadixSorted;
+
+		Benchmark(TEXT("std::sort uint32"), [&]
+		{
+			Sorted = Keys32;
+			std::sort(Sorted.GetData(), Sorted.GetData() + Sorted.Num());
+		});
+		Benchmark(TEXT("RadixSort uint32"), [&]
+		{
+			RadixSorted = Keys32;
+			FVoxelUtilities::RadixSort(RadixSorted, false);
+		});
+		Benchmark(TEXT("RadixSort uint32 parallel"), [&]
+		{
+			RadixSorted = Keys32;
+			FVoxelUtilities::RadixSort(RadixSorted, true);
+		});
+
+		ensure(FVoxelUtilities::Equal(Sorted, RadixSorted));
+	}
+
+	{
+		TVoxelArray<uint64> Sorted;
+		TVoxelArray<uint64> RadixSorted;
+
+		Benchmark(TEXT("std::sort uint64"), [&]
+		{
+			Sorted = Keys64;
+			std::sort(Sorted.GetData(), Sorted.GetData() + Sorted.Num());
+		});
+		Benchmark(TEXT("RadixSort uint64 parallel"), [&]
+		{
+			RadixSorted = Keys64;
+			FVoxelUtilities::RadixSort(RadixSorted, true);
+		});
+
+		ensure(FVoxelUtilities::Equal(Sorted, RadixSorted));
+	}
+
+	{
+		TVoxelArray<uint32> SortedKeys;
+		TVoxelArray<uint32> SortedIndices;
+
+		Benchmark(TEXT("std::stable_sort uint32 + index"), [&]
+		{
+			TVoxelArray<TPair<uint32, uint32>> Pairs;
+			FVoxelUtilities::SetNumFast(Pairs, Num);
+			for (int32 Index = 0; Index < Num; Index++)
+			{
+				Pairs[Index] = { Keys32[Index], uint32(Index) };
+			}
+
+			std::stable_sort(Pairs.GetData(), Pairs.GetData() + Num, [](const TPair<uint32, uint32>& A, const TPair<uint32, uint32>& B)
+			{
+				return A.Key < B.Key;
+			});
+		});
+		Benchmark(TEXT("RadixSort uint32 + index parallel"), [&]
+		{
+			SortedKeys = Keys32;
+			FVoxelUtilities::SetNumFast(SortedIndices, Num);
+			for (int32 Index = 0; Index < Num; Index++)
+			{
+				SortedIndices[Index] = Index;
+			}
+
+			FVoxelUtilities::RadixSort(SortedKeys, SortedIndices, true);
+		});
+
+		for (int32 Index = 0; Index < Num; Index++)
+		{
+			ensure(Keys32[SortedIndices[Index]] == SortedKeys[Index]);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+namespace FVoxelSortUtilities
+{
+	constexpr int32 MinChunkSize = 64 * 1024;
+
+	int32 GetNumChunks(const int32 Num, const bool bAllowParallel)
+	{
+		if (!bAllowParallel)
+		{
+			return 1;
+		}
+
+		return FMath::Clamp(Num / MinChunkSize, 1, FPlatformMisc::NumberOfCoresIncludingHyperthreads());
+	}
+
+	FORCEINLINE int32 GetChunkStart(const int32 Num, const int32 NumChunks, const int32 ChunkIndex)
+	{
+		return int64(Num) * ChunkIndex / NumChunks;
+	}
+
+	template<typename T, typename SumType, typename ScanType>
+	T ExclusiveScan(
+		const TConstVoxelArrayView<T> Data,
+		const TVoxelArrayView<T> OutData,
+		const bool bAllowParallel,
+		SumType Sum,
+		ScanType Scan)
+	{
+		VOXEL_FUNCTION_COUNTER_NUM(Data.Num(), 1024);
+		check(Data.Num() == OutData.Num());
+
+		const int32 NumChunks = GetNumChunks(Data.Num(), bAllowParallel);
+		if (NumChunks == 1)
+		{
+			return Scan(Data.GetData(), OutData.GetData(), Data.Num(), 0);
+		}
+
+		TVoxelArray<T> ChunkOffsets;
+		FVoxelUtilities::SetNumFast(ChunkOffsets, NumChunks);
+
+		ParallelFor(NumChunks, [&](const int32 ChunkIndex)
+		{
+			const int32 Start = GetChunkStart(Data.Num(), NumChunks, ChunkIndex);
+			const int32 End = GetChunkStart(Data.Num(), NumChunks, ChunkIndex + 1);
+
+			ChunkOffsets[ChunkIndex] = Sum(Data.GetData() + Start, End - Start);
+		});
+
+		const T Total = Scan(ChunkOffsets.GetData(), ChunkOffsets.GetData(), NumChunks, 0);
+
+		ParallelFor(NumChunks, [&](const int32 ChunkIndex)
+		{
+			const int32 Start = GetChunkStart(Data.Num(), NumChunks, ChunkIndex);
+			const int32 End = GetChunkStart(Data.Num(), NumChunks, ChunkIndex + 1);
+
+			Scan(Data.GetData() + Start, OutData.GetData() + Start, End - Start, ChunkOffsets[ChunkIndex]);
+		});
+
+		return Total;
+	}
+
+	template<typename T>
+	void Histogram(
+		const TConstVoxelArrayView<T> Data,
+		const TVoxelArrayView<int32> OutCounts,
+		const bool bAllowParallel)
+	{
+		VOXEL_FUNCTION_COUNTER_NUM(Data.Num(), 1024);
+
+		const int32 NumBins = OutCounts.Num();
+
+		const auto Count = [&](const int32 Start, const int32 End, int32* RESTRICT Counts)
+		{
+			for (int32 Index = Start; Index < End; Index++)
+			{
+				const T Value = Data[Index];
+				checkVoxelSlow(Value < NumBins);
+				Counts[Value]++;
+			}
+		};
+
+		FVoxelUtilities::Memzero(OutCounts);
+
+		if (NumBins == 0)
+		{
+			check(Data.Num() == 0);
+			return;
+		}
+
+		// Merging per-chunk histograms is only worth it if they are small compared to the data
+		const int32 NumChunks = FMath::Min(
+			GetNumChunks(Data.Num(), bAllowParallel),
+			FMath::Max(1, Data.Num() / (4 * NumBins)));
+
+		if (NumChunks == 1)
+		{
+			Count(0, Data.Num(), OutCounts.GetData());
+			return;
+		}
+
+		TVoxelArray<int32> ChunkCounts;
+		FVoxelUtilities::SetNumZeroed(ChunkCounts, int64(NumChunks) * NumBins);
+
+		ParallelFor(NumChunks, [&](const int32 ChunkIndex)
+		{
+			Count(
+				GetChunkStart(Data.Num(), NumChunks, ChunkIndex),
+				GetChunkStart(Data.Num(), NumChunks, ChunkIndex + 1),
+				ChunkCounts.GetData() + int64(ChunkIndex) * NumBins);
+		});
+
+		for (int32 ChunkIndex = 0; ChunkIndex < NumChunks; ChunkIndex++)
+		{
+			const int32* RESTRICT Counts = ChunkCounts.GetData() + int64(ChunkIndex) * NumBins;
+			for (int32 Bin = 0; Bin < NumBins; Bin++)
+			{
+				OutCounts[Bin] += Counts[Bin];
+			}
+		}
+	}
+
+	template<typename KeyType>
+	void RadixSort(
+		const TVoxelArrayView<KeyType> Keys,
+		const TVoxelArrayView<uint32> Values,
+		const bool bAllowParallel)
+	{
+		VOXEL_FUNCTION_COUNTER_NUM(Keys.Num(), 1024);
+
+		constexpr int32 NumPasses = sizeof(KeyType);
+		const int32 Num = Keys.Num();
+		const bool bHasValues = Values.Num() > 0;
+		check(!bHasValues || Values.Num() == Num);
+
+		if (Num <= 1)
+		{
+			return;
+		}
+
+		const int32 NumChunks = GetNumChunks(Num, bAllowParallel);
+
+		// Digit counts for all the passes, computed in a single read of the keys
+		// They don't depend on the order of the keys, so they stay valid after each pass
+		TVoxelArray<int32> Counts;
+		{
+			VOXEL_SCOPE_COUNTER("Count digits");
+
+			TVoxelArray<int32> ChunkCounts;
+			FVoxelUtilities::SetNumZeroed(ChunkCounts, NumChunks * NumPasses * 256);
+
+			ParallelFor(NumChunks, [&](const int32 ChunkIndex)
+			{
+				const int32 Start = GetChunkStart(Num, NumChunks, ChunkIndex);
+				const int32 End = GetChunkStart(Num, NumChunks, ChunkIndex + 1);
+				int32* RESTRICT ChunkCountsPtr = ChunkCounts.GetData() + ChunkIndex * NumPasses * 256;
+
+				for (int32 Index = Start; Index < End; Index++)
+				{
+					const KeyType Key = Keys[Index];
+					for (int32 Pass = 0; Pass < NumPasses; Pass++)
+					{
+						ChunkCountsPtr[Pass * 256 + ((Key >> (8 * Pass)) & 0xFF)]++;
+					}
+				}
+			});
+
+			FVoxelUtilities::SetNumZeroed(Counts, NumPasses * 256);
+			for (int32 ChunkIndex = 0; ChunkIndex < NumChunks; ChunkIndex++)
+			{
+				for (int32 Index = 0; Index < NumPasses * 256; Index++)
+				{
+					Counts[Index] += ChunkCounts[ChunkIndex * NumPasses * 256 + Index];
+				}
+			}
+		}
+
+		TVoxelArray<KeyType> TempKeys;
+		TVoxelArray<uint32> TempValues;
+		FVoxelUtilities::SetNumFast(TempKeys, Num);
+		if (bHasValues)
+		{
+			FVoxelUtilities::SetNumFast(TempValues, Num);
+		}
+
+		TVoxelArrayView<KeyType> SrcKeys = Keys;
+		TVoxelArrayView<KeyType> DstKeys = TempKeys;
+		TVoxelArrayView<uint32> SrcValues = Values;
+		TVoxelArrayView<uint32> DstValues = TempValues;
+
+		// Offsets[ChunkIndex * 256 + Digit]: where the chunk writes its next key with this digit
+		TVoxelArray<int32> Offsets;
+		FVoxelUtilities::SetNumFast(Offsets, NumChunks * 256);
+
+		for (int32 Pass = 0; Pass < NumPasses; Pass++)
+		{
+			const int32 Shift = 8 * Pass;
+			const int32* PassCounts = Counts.GetData() + Pass * 256;
+
+			if (PassCounts[(SrcKeys[0] >> Shift) & 0xFF] == Num)
+			{
+				// All the keys have the same digit
+				continue;
+			}
+
+			VOXEL_SCOPE_COUNTER_FORMAT("Pass %d", Pass);
+
+			if (NumChunks == 1)
+			{
+				int32 Offset = 0;
+				for (int32 Digit = 0; Digit < 256; Digit++)
+				{
+					Offsets[Digit] = Offset;
+					Offset += PassCounts[Digit];
+				}
+			}
+			else
+			{
+				ParallelFor(NumChunks, [&](const int32 ChunkIndex)
+				{
+					const int32 Start = GetChunkStart(Num, NumChunks, ChunkIndex);
+					const int32 End = GetChunkStart(Num, NumChunks, ChunkIndex + 1);
+					int32* RESTRICT ChunkCounts = Offsets.GetData() + ChunkIndex * 256;
+
+					FMemory::Memzero(ChunkCounts, 256 * sizeof(int32));
+
+					for (int32 Index = Start; Index < End; Index++)
+					{
+						ChunkCounts[(SrcKeys[Index] >> Shift) & 0xFF]++;
+					}
+				});
+
+				// Digits first, then chunks, to keep the sort stable
+				int32 Offset = 0;
+				for (int32 Digit = 0; Digit < 256; Digit++)
+				{
+					for (int32 ChunkIndex = 0; ChunkIndex < NumChunks; ChunkIndex++)
+					{
+						const int32 Count = Offsets[ChunkIndex * 256 + Digit];
+						Offsets[ChunkIndex * 256 + Digit] = Offset;
+						Offset += Count;
+					}
+				}
+				checkVoxelSlow(Offset == Num);
+			}
+
+			ParallelFor(NumChunks, [&](const int32 ChunkIndex)
+			{
+				const int32 Start = GetChunkStart(Num, NumChunks, ChunkIndex);
+				const int32 End = GetChunkStart(Num, NumChunks, ChunkIndex + 1);
+				int32* RESTRICT ChunkOffsets = Offsets.GetData() + ChunkIndex * 256;
+
+				if (bHasValues)
+				{
+					for (int32 Index = Start; Index < End; Index++)
+					{
+						const KeyType Key = SrcKeys[Index];
+						const int32 Target = ChunkOffsets[(Key >> Shift) & 0xFF]++;
+						DstKeys[Target] = Key;
+						DstValues[Target] = SrcValues[Index];
+					}
+				}
+				else
+				{
+					for (int32 Index = Start; Index < End; Index++)
+					{
+						const KeyType Key = SrcKeys[Index];
+						DstKeys[ChunkOffsets[(Key >> Shift) & 0xFF]++] = Key;
+					}
+				}
+			});
+
+			Swap(SrcKeys, DstKeys);
+			Swap(SrcValues, DstValues);
+		}
+
+		if (SrcKeys.GetData() != Keys.GetData())
+		{
+			FVoxelUtilities::Memcpy(Keys, SrcKeys);
+
+			if (bHasValues)
+			{
+				FVoxelUtilities::Memcpy(Values, SrcValues);
+			}
+		}
+	}
+
+	FORCEINLINE int32 CompactByMask(
+		const uint8* RESTRICT Data,
+		const int32 TypeSize,
+		const uint32* RESTRICT MaskWords,
+		const int32 NumWords,
+		uint8* RESTRICT OutData)
+	{
+		uint8* RESTRICT Out = OutData;
+		for (int32 WordIndex = 0; WordIndex < NumWords; WordIndex++)
+		{
+			uint32 Word = MaskWords[WordIndex];
+			while (Word)
+			{
+				const int32 Index = WordIndex * 32 + FMath::CountTrailingZeros(Word);
+				checkVoxelSlow(Index < NumWords * 32);
+				FMemory::Memcpy(Out, Data + int64(Index) * TypeSize, TypeSize);
+				Out += TypeSize;
+				Word &= Word - 1;
+			}
+		}
+		return (Out - OutData) / TypeSize;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+int32 FVoxelUtilities::ExclusiveScan(
+	const TConstVoxelArrayView<int32> Data,
+	const TVoxelArrayView<int32> OutData,
+	const bool bAllowParallel)
+{
+	return FVoxelSortUtilities::ExclusiveScan<int32>(
+		Data,
+		OutData,
+		bAllowParallel,
+		[](const int32* ChunkData, const int32 Num)
+		{
+			return ispc::SortUtilities_Sum_int32(ChunkData, Num);
+		},
+		[](const int32* ChunkData, int32* ChunkOutData, const int32 Num, const int32 Offset)
+		{
+			return ispc::SortUtilities_ExclusiveScan_int32(ChunkData, ChunkOutData, Num, Offset);
+		});
+}
+
+int64 FVoxelUtilities::ExclusiveScan(
+	const TConstVoxelArrayView<int64> Data,
+	const TVoxelArrayView<int64> OutData,
+	const bool bAllowParallel)
+{
+	return FVoxelSortUtilities::ExclusiveScan<int64>(
+		Data,
+		OutData,
+		bAllowParallel,
+		[](const int64* ChunkData, const int32 Num)
+		{
+			return ispc::SortUtilities_Sum_int64(ChunkData, Num);
+		},
+		[](const int64* ChunkData, int64* ChunkOutData, const int32 Num, const int64 Offset)
+		{
+			return ispc::SortUtilities_ExclusiveScan_int64(ChunkData, ChunkOutData, Num, Offset);
+		});
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelUtilities::Histogram(
+	const TConstVoxelArrayView<uint8> Data,
+	const TVoxelArrayView<int32> OutCounts,
+	const bool bAllowParallel)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Data.Num(), 1024);
+
+	const int32 NumChunks = FVoxelSortUtilities::GetNumChunks(Data.Num(), bAllowParallel);
+
+	TVoxelArray<int32> ChunkCounts;
+	FVoxelUtilities::SetNumZeroed(ChunkCounts, NumChunks * 256);
+
+	ParallelFor(NumChunks, [&](const int32 ChunkIndex)
+	{
+		const int32 Start = FVoxelSortUtilities::GetChunkStart(Data.Num(), NumChunks, ChunkIndex);
+		const int32 End = FVoxelSortUtilities::GetChunkStart(Data.Num(), NumChunks, ChunkIndex + 1);
+
+		ispc::SortUtilities_Histogram_uint8(
+			Data.GetData() + Start,
+			End - Start,
+			ChunkCounts.GetData() + ChunkIndex * 256);
+	});
+
+	FVoxelUtilities::Memzero(OutCounts);
+
+	for (int32 ChunkIndex = 1; ChunkIndex < NumChunks; ChunkIndex++)
+	{
+		for (int32 Value = 0; Value < 256; Value++)
+		{
+			ChunkCounts[Value] += ChunkCounts[ChunkIndex * 256 + Value];
+		}
+	}
+
+	for (int32 Value = 0; Value < 256; Value++)
+	{
+		if (ChunkCounts[Value] == 0)
+		{
+			continue;
+		}
+
+		check(Value < OutCounts.Num());
+		OutCounts[Value] = ChunkCounts[Value];
+	}
+}
+
+void FVoxelUtilities::Histogram(
+	const TConstVoxelArrayView<uint16> Data,
+	const TVoxelArrayView<int32> OutCounts,
+	const bool bAllowParallel)
+{
+	FVoxelSortUtilities::Histogram(Data, OutCounts, bAllowParallel);
+}
+
+void FVoxelUtilities::Histogram(
+	const TConstVoxelArrayView<uint32> Data,
+	const TVoxelArrayView<int32> OutCounts,
+	const bool bAllowParallel)
+{
+	FVoxelSortUtilities::Histogram(Data, OutCounts, bAllowParallel);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelUtilities::RadixSort(
+	const TVoxelArrayView<uint32> Keys,
+	const bool bAllowParallel)
+{
+	FVoxelSortUtilities::RadixSort<uint32>(Keys, {}, bAllowParallel);
+}
+
+void FVoxelUtilities::RadixSort(
+	const TVoxelArrayView<uint64> Keys,
+	const bool bAllowParallel)
+{
+	FVoxelSortUtilities::RadixSort<uint64>(Keys, {}, bAllowParallel);
+}
+
+void FVoxelUtilities::RadixSort(
+	const TVoxelArrayView<uint32> Keys,
+	const TVoxelArrayView<uint32> Values,
+	const bool bAllowParallel)
+{
+	check(Keys.Num() == Values.Num());
+	FVoxelSortUtilities::RadixSort<uint32>(Keys, Values, bAllowParallel);
+}
+
+void FVoxelUtilities::RadixSort(
+	const TVoxelArrayView<uint64> Keys,
+	const TVoxelArrayView<uint32> Values,
+	const bool bAllowParallel)
+{
+	check(Keys.Num() == Values.Num());
+	FVoxelSortUtilities::RadixSort<uint64>(Keys, Values, bAllowParallel);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+int32 FVoxelUtilities::CompactByMaskImpl(
+	const void* Data,
+	const int32 TypeSize,
+	const int32 Num,
+	const TConstVoxelArrayView<uint32> MaskWords,
+	void* OutData,
+	const bool bAllowParallel)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Num, 1024);
+	check(MaskWords.Num() == FVoxelUtilities::DivideCeil_Positive(Num, 32));
+
+	const auto Compact = [&](const int32 StartWord, const int32 EndWord, uint8* ChunkOutData) -> int32
+	{
+		const uint8* ChunkData = static_cast<const uint8*>(Data) + int64(StartWord) * 32 * TypeSize;
+		const uint32* ChunkMaskWords = MaskWords.GetData() + StartWord;
+		const int32 NumWords = EndWord - StartWord;
+
+		// Constant sizes let the compiler inline the copies
+		switch (TypeSize)
+		{
+		case 1: return FVoxelSortUtilities::CompactByMask(ChunkData, 1, ChunkMaskWords, NumWords, ChunkOutData);
+		case 2: return FVoxelSortUtilities::CompactByMask(ChunkData, 2, ChunkMaskWords, NumWords, ChunkOutData);
+		case 4: return ispc::SortUtilities_CompactByMask_uint32(
+			reinterpret_cast<const uint32*>(ChunkData),
+			ChunkMaskWords,
+			NumWords,
+			reinterpret_cast<uint32*>(ChunkOutData));
+		case 8: return ispc::SortUtilities_CompactByMask_uint64(
+			reinterpret_cast<const uint64*>(ChunkData),
+			ChunkMaskWords,
+			NumWords,
+			reinterpret_cast<uint64*>(ChunkOutData));
+		case 12: return FVoxelSortUtilities::CompactByMask(ChunkData, 12, ChunkMaskWords, NumWords, ChunkOutData);
+		case 16: return FVoxelSortUtilities::CompactByMask(ChunkData, 16, ChunkMaskWords, NumWords, ChunkOutData);
+		default: return FVoxelSortUtilities::CompactByMask(ChunkData, TypeSize, ChunkMaskWords, NumWords, ChunkOutData);
+		}
+	};
+
+	const int32 NumChunks = FVoxelSortUtilities::GetNumChunks(Num, bAllowParallel);
+	if (NumChunks == 1)
+	{
+		return Compact(0, MaskWords.Num(), static_cast<uint8*>(OutData));
+	}
+
+	TVoxelArray<int32> ChunkOffsets;
+	FVoxelUtilities::SetNumFast(ChunkOffsets, NumChunks);
+
+	ParallelFor(NumChunks, [&](const int32 ChunkIndex)
+	{
+		const int32 StartWord = FVoxelSortUtilities::GetChunkStart(MaskWords.Num(), NumChunks, ChunkIndex);
+		const int32 EndWord = FVoxelSortUtilities::GetChunkStart(MaskWords.Num(), NumChunks, ChunkIndex + 1);
+
+		ChunkOffsets[ChunkIndex] = FVoxelBitArrayHelpers::CountSetBits(MaskWords.GetData() + StartWord, EndWord - StartWord);
+	});
+
+	const int32 Total = FVoxelUtilities::ExclusiveScan(ChunkOffsets, ChunkOffsets, false);
+
+	ParallelFor(NumChunks, [&](const int32 ChunkIndex)
+	{
+		const int32 StartWord = FVoxelSortUtilities::GetChunkStart(MaskWords.Num(), NumChunks, ChunkIndex);
+		const int32 EndWord = FVoxelSortUtilities::GetChunkStart(MaskWords.Num(), NumChunks, ChunkIndex + 1);
+
+		Compact(StartWord, EndWord, static_cast<uint8*>(OutData) + int64(ChunkOffsets[ChunkIndex]) * TypeSize);
+	});
+
+	return Total;
+}
@@ -214,37 +214,49 @@ void FVoxelUtilities::CleanupFileCache(const FString& Path, const int64 MaxSize)
 {
 	VOXEL_FUNCTION_COUNTER();
 
-	TArray<FString> Files;
-	IFileManager::Get().FindFilesRecursive(Files, *Path, TEXT("*"), true, false);
-
+	struct FFile
+	{
+		FString Path;
+		int64 Size = 0;
+		FDateTime Timestamp;
+	};
+	TVoxelArray<FFile> Files;
 	int64 TotalSize = 0;
-	for (const FString& File : Files)
+
+	// Single pass, stats come with the directory listing
+	IFileManager::Get().IterateDirectoryStatRecursively(*Path, [&](const TCHAR* FilePath, const FFileStatData& StatData)
+	{
+		if (StatData.bIsDirectory)
+		{
+			return true;
+		}
+
+		Files.Add(FFile{ FilePath, StatData.FileSize, StatData.ModificationTime });
+		TotalSize += StatData.FileSize;
+		return true;
+	});
+
+	if (TotalSize <= MaxSize)
 	{
-		TotalSize += IFileManager::Get().FileSize(*File);
+		return;
 	}
 
-	while (
-		TotalSize > MaxSize &&
-		ensure(Files.Num() > 0))
+	Files.Sort([](const FFile& A, const FFile& B)
 	{
-		FString OldestFile;
-		FDateTime OldestFileTimestamp;
-		for (const FString& File : Files)
-		{
-			const FDateTime Timestamp = IFileManager::Get().GetTimeStamp(*File);
+		return A.Timestamp < B.Timestamp;
+	});
 
-			if (OldestFile.IsEmpty() ||
-				Timestamp < OldestFileTimestamp)
-			{
-				OldestFile = File;
-				OldestFileTimestamp = Timestamp;
-			}
+	for (const FFile& File : Files)
+	{
+		if (TotalSize <= MaxSize)
+		{
+			break;
 		}
-		LOG_VOXEL(Log, "Deleting %s", *OldestFile);
 
-		TotalSize -= IFileManager::Get().FileSize(*OldestFile);
-		ensure(IFileManager::Get().Delete(*OldestFile));
-		ensure(Files.Remove(OldestFile));
+		LOG_VOXEL(Log, "Deleting %s", *File.Path);
+
+		TotalSize -= File.Size;
+		ensure(IFileManager::Get().Delete(*File.Path));
 	}
 }
 
@@ -0,0 +1,307 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#include "VoxelMinimal.h"
+
+DEFINE_VOXEL_MEMORY_STAT(STAT_VoxelArenaMemory);
+DEFINE_VOXEL_MEMORY_STAT(STAT_VoxelArenaPeakUsage);
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, int32, GVoxelArenaBlockSize, 64 * 1024,
+	"voxel.arena.BlockSize",
+	"Size in bytes of the blocks allocated by the per-thread arenas");
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, int32, GVoxelArenaMaxRetainedSize, 1024 * 1024,
+	"voxel.arena.MaxRetainedSize",
+	"Max number of bytes each thread arena keeps allocated once its outermost FVoxelArenaScope exits");
+
+const uint32 FVoxelArena::TLSSlot = FPlatformTLS::AllocTlsSlot();
+
+FVoxelCounter64 GVoxelArenaGlobalPeakUsage;
+
+#if VOXEL_DEBUG
+constexpr int64 GVoxelArenaGuardSize = 16;
+constexpr uint8 GVoxelArenaGuardByte = 0xFD;
+constexpr uint8 GVoxelArenaAllocatedByte = 0xCD;
+constexpr uint8 GVoxelArenaFreedByte = 0xDD;
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+struct FVoxelArenaThreadData
+{
+	FVoxelArena* Arena = nullptr;
+
+	~FVoxelArenaThreadData()
+	{
+		if (!Arena)
+		{
+			return;
+		}
+
+		ensure(!Arena->IsInScope());
+		FPlatformTLS::SetTlsValue(FVoxelArena::TLSSlot, nullptr);
+		delete Arena;
+	}
+};
+thread_local FVoxelArenaThreadData GVoxelArenaThreadData;
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelArena::EnterScope()
+{
+	FVoxelArena* Arena = static_cast<FVoxelArena*>(FPlatformTLS::GetTlsValue(TLSSlot));
+	if (!Arena)
+	{
+		Arena = new FVoxelArena();
+		GVoxelArenaThreadData.Arena = Arena;
+		FPlatformTLS::SetTlsValue(TLSSlot, Arena);
+	}
+
+	Arena->ScopeDepth++;
+}
+
+void FVoxelArena::ExitScope()
+{
+	FVoxelArena* Arena = static_cast<FVoxelArena*>(FPlatformTLS::GetTlsValue(TLSSlot));
+	checkVoxelSlow(Arena);
+	checkVoxelSlow(Arena->ScopeDepth > 0);
+
+	Arena->ScopeDepth--;
+
+	if (Arena->ScopeDepth == 0)
+	{
+		Arena->Reset();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+FVoxelArena::~FVoxelArena()
+{
+	for (const FBlock& Block : Blocks)
+	{
+		DEC_VOXEL_MEMORY_STAT_BY(STAT_VoxelArenaMemory, Block.Size);
+		FMemory::Free(Block.Data);
+	}
+}
+
+void* FVoxelArena::AllocateSlow(const int64 Size, const uint32 Alignment)
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	UpdatePeakUsage();
+
+	if (BlockIndex != -1)
+	{
+		PreviousBlocksUsage += FMath::Max(Current, HighWater) - Blocks[BlockIndex].Data;
+	}
+
+	// Try to reuse a block retained from a previous scope
+	for (int32 Index = BlockIndex + 1; Index < Blocks.Num(); Index++)
+	{
+		const FBlock& Block = Blocks[Index];
+		if (Block.Size < Size + Alignment)
+		{
+			continue;
+		}
+
+		BlockIndex = Index;
+		Current = Block.Data;
+		HighWater = Block.Data;
+		End = Block.Data + Block.Size;
+
+		return AllocateImpl(Size, Alignment);
+	}
+
+	FBlock NewBlock;
+	NewBlock.Size = FMath::Max<int64>(GVoxelArenaBlockSize, Align(Size + Alignment, 4096));
+	NewBlock.Data = static_cast<uint8*>(FMemory::Malloc(NewBlock.Size, 64));
+	INC_VOXEL_MEMORY_STAT_BY(STAT_VoxelArenaMemory, NewBlock.Size);
+
+	// Keep the blocks we skipped after the new one so they can still be reused
+	BlockIndex++;
+	Blocks.Insert(NewBlock, BlockIndex);
+
+	Current = NewBlock.Data;
+	HighWater = NewBlock.Data;
+	End = NewBlock.Data + NewBlock.Size;
+
+	return AllocateImpl(Size, Alignment);
+}
+
+int64 FVoxelArena::GetUsage() const
+{
+	if (BlockIndex == -1)
+	{
+		return 0;
+	}
+
+	return PreviousBlocksUsage + (FMath::Max(Current, HighWater) - Blocks[BlockIndex].Data);
+}
+
+void FVoxelArena::UpdatePeakUsage()
+{
+	const int64 Usage = GetUsage();
+	if (Usage <= PeakUsage)
+	{
+		return;
+	}
+	PeakUsage = Usage;
+
+	const int64 OldGlobalPeakUsage = GVoxelArenaGlobalPeakUsage.Apply_ReturnOld([&](const int64 Value)
+	{
+		return FMath::Max(Value, Usage);
+	});
+
+	if (Usage > OldGlobalPeakUsage)
+	{
+		INC_VOXEL_MEMORY_STAT_BY(STAT_VoxelArenaPeakUsage, Usage - OldGlobalPeakUsage);
+	}
+}
+
+void FVoxelArena::Reset()
+{
+	if (BlockIndex == -1)
+	{
+		checkVoxelSlow(Blocks.Num() == 0);
+		return;
+	}
+
+	UpdatePeakUsage();
+
+#if VOXEL_DEBUG
+	ensureMsgf(DebugAllocations.Num() == 0, TEXT("%d arena allocations outlived their scope"), DebugAllocations.Num());
+
+	for (const FDebugAllocation& Allocation : DebugAllocations)
+	{
+		CheckGuard(Allocation);
+	}
+	DebugAllocations.Reset();
+
+	for (int32 Index = 0; Index <= BlockIndex; Index++)
+	{
+		FMemory::Memset(Blocks[Index].Data, GVoxelArenaFreedByte, Blocks[Index].Size);
+	}
+#endif
+
+	// Keep the first blocks, free the others
+	int64 RetainedSize = 0;
+	int32 NumBlocksToKeep = 0;
+	for (const FBlock& Block : Blocks)
+	{
+		if (NumBlocksToKeep > 0 &&
+			RetainedSize + Block.Size > GVoxelArenaMaxRetainedSize)
+		{
+			break;
+		}
+
+		RetainedSize += Block.Size;
+		NumBlocksToKeep++;
+	}
+
+	for (int32 Index = NumBlocksToKeep; Index < Blocks.Num(); Index++)
+	{
+		DEC_VOXEL_MEMORY_STAT_BY(STAT_VoxelArenaMemory, Blocks[Index].Size);
+		FMemory::Free(Blocks[Index].Data);
+	}
+	Blocks.SetNum(NumBlocksToKeep);
+
+	BlockIndex = 0;
+	PreviousBlocksUsage = 0;
+	Current = Blocks[0].Data;
+	HighWater = Blocks[0].Data;
+	End = Blocks[0].Data + Blocks[0].Size;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+#if VOXEL_DEBUG
+void* FVoxelArena::Allocate_Debug(const int64 Size, const uint32 Alignment)
+{
+	FDebugAllocation Allocation;
+	Allocation.Data = static_cast<uint8*>(AllocateImpl(Size + GVoxelArenaGuardSize, Alignment));
+	Allocation.Size = Size;
+
+	FMemory::Memset(Allocation.Data, GVoxelArenaAllocatedByte, Size);
+	WriteGuard(Allocation);
+
+	DebugAllocations.Add(Allocation);
+	return Allocation.Data;
+}
+
+bool FVoxelArena::TryResize_Debug(void* Data, const int64 OldSize, const int64 NewSize)
+{
+	const int32 Index = FindDebugAllocation(Data);
+	check(Index != -1);
+
+	FDebugAllocation& Allocation = DebugAllocations[Index];
+	check(Allocation.Size == OldSize);
+	CheckGuard(Allocation);
+
+	if (!TryResizeImpl(Data, OldSize + GVoxelArenaGuardSize, NewSize + GVoxelArenaGuardSize))
+	{
+		return false;
+	}
+
+	if (NewSize > OldSize)
+	{
+		FMemory::Memset(Allocation.Data + OldSize, GVoxelArenaAllocatedByte, NewSize - OldSize);
+	}
+
+	Allocation.Size = NewSize;
+	WriteGuard(Allocation);
+	return true;
+}
+
+void FVoxelArena::Free_Debug(void* Data, const int64 Size)
+{
+	const int32 Index = FindDebugAllocation(Data);
+	check(Index != -1);
+
+	const FDebugAllocation Allocation = DebugAllocations[Index];
+	check(Allocation.Size == Size);
+	CheckGuard(Allocation);
+
+	DebugAllocations.RemoveAtSwap(Index);
+
+	FMemory::Memset(Allocation.Data, GVoxelArenaFreedByte, Size + GVoxelArenaGuardSize);
+	FreeImpl(Data, Size + GVoxelArenaGuardSize);
+}
+
+int32 FVoxelArena::FindDebugAllocation(const void* Data) const
+{
+	for (int32 Index = DebugAllocations.Num() - 1; Index >= 0; Index--)
+	{
+		if (DebugAllocations[Index].Data == Data)
+		{
+			return Index;
+		}
+	}
+	return -1;
+}
+
+void FVoxelArena::WriteGuard(const FDebugAllocation& Allocation)
+{
+	FMemory::Memset(Allocation.Data + Allocation.Size, GVoxelArenaGuardByte, GVoxelArenaGuardSize);
+}
+
+void FVoxelArena::CheckGuard(const FDebugAllocation& Allocation)
+{
+	for (int64 Index = 0; Index < GVoxelArenaGuardSize; Index++)
+	{
+		checkf(Allocation.Data[Allocation.Size + Index] == GVoxelArenaGuardByte,
+			TEXT("Arena allocation overflow: %lld bytes allocated, byte %lld past the end was overwritten"),
+			Allocation.Size,
+			Index);
+	}
+}
+#endif
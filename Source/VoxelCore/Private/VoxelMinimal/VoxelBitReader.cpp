@@ -0,0 +1,165 @@
+﻿// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#include "VoxelMinimal.h"
+#include "VoxelBitReaderImpl.ispc.generated.h"
+
+VOXEL_CONSOLE_COMMAND(
+	"voxel.BitStream.Benchmark",
+	"Write and read 4M values with FVoxelBitWriter and FVoxelBitReader for every field width from 1 to 32 bits and log throughput")
+{
+	VOXEL_SCOPE_COUNTER("voxel.BitStream.Benchmark");
+
+	constexpr int32 NumValues = 4 * 1024 * 1024;
+
+	const FRandomStream Stream(42);
+
+	TVoxelArray<uint32> RandomValues;
+	FVoxelUtilities::SetNumFast(RandomValues, NumValues);
+	for (uint32& Value : RandomValues)
+	{
+		Value = uint32(Stream.GetUnsignedInt());
+	}
+
+	TVoxelArray<uint32> Values;
+	TVoxelArray<uint32> ReadValues;
+	FVoxelUtilities::SetNumFast(Values, NumValues);
+	FVoxelUtilities::SetNumFast(ReadValues, NumValues);
+
+	for (uint32 NumBits = 1; NumBits <= 32; NumBits++)
+	{
+		const uint32 Mask = NumBits == 32 ? MAX_uint32 : (1u << NumBits) - 1;
+		for (int32 Index = 0; Index < NumValues; Index++)
+		{
+			Values[Index] = RandomValues[Index] & Mask;
+		}
+
+		FVoxelBitWriter Writer;
+
+		const double WriteStartTime = FPlatformTime::Seconds();
+		Writer.AppendN(Values, NumBits);
+		Writer.Flush(sizeof(uint64));
+		const double WriteTime = FPlatformTime::Seconds() - WriteStartTime;
+
+		const double ReadStartTime = FPlatformTime::Seconds();
+		{
+			FVoxelBitReader Reader(Writer.GetByteData());
+			for (int32 Index = 0; Index < NumValues; Index++)
+			{
+				ReadValues[Index] = Reader.Read(NumBits);
+			}
+		}
+		const double ReadTime = FPlatformTime::Seconds() - ReadStartTime;
+
+		ensure(FVoxelUtilities::Equal(Values, ReadValues));
+		FVoxelUtilities::SetAll(ReadValues, 0);
+
+		const double ReadNStartTime = FPlatformTime::Seconds();
+		{
+			FVoxelBitReader Reader(Writer.GetByteData());
+			Reader.ReadN(ReadValues, NumBits);
+		}
+		const double ReadNTime = FPlatformTime::Seconds() - ReadNStartTime;
+
+		ensure(FVoxelUtilities::Equal(Values, ReadValues));
+
+		const auto ToString = [&](const double Time)
+		{
+			return FString::Printf(TEXT("%6.1fms %6.0fM values/s"), Time * 1000., NumValues / Time / 1.e6);
+		};
+
+		LOG_VOXEL(Log, "%2d bits: Write %s Read %s ReadN %s",
+			NumBits,
+			*ToString(WriteTime),
+			*ToString(ReadTime),
+			*ToString(ReadNTime));
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelBitReader::ReadN(const TVoxelArrayView<uint32> OutValues, const uint32 NumBits)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(OutValues.Num(), 1024);
+	check(NumBits <= 32);
+
+	if (OutValues.Num() == 0)
+	{
+		return;
+	}
+
+	if (NumBits == 0)
+	{
+		FVoxelUtilities::SetAll(OutValues, 0);
+		return;
+	}
+
+	const int64 StartBit = GetBitOffset();
+
+	// The kernel does an 8 byte load per value, values too close to the end are read one by one
+	const int64 LastFastBit = int64(Data.Num() - 7) * 8 - 1;
+
+	int32 NumFast = 0;
+	if (LastFastBit >= StartBit)
+	{
+		NumFast = int32(FMath::Min<int64>(OutValues.Num(), (LastFastBit - StartBit) / NumBits + 1));
+	}
+
+	if (NumFast > 0)
+	{
+		ispc::BitReader_Unpack(
+			Data.GetData(),
+			StartBit,
+			NumBits,
+			OutValues.GetData(),
+			NumFast);
+
+		Seek(StartBit + int64(NumFast) * NumBits);
+	}
+
+	for (int32 Index = NumFast; Index < OutValues.Num(); Index++)
+	{
+		OutValues[Index] = Read(NumBits);
+	}
+}
+
+void FVoxelBitReader::Seek(const int64 BitOffset)
+{
+	checkVoxelSlow(0 <= BitOffset && BitOffset <= MAX_int32 * int64(8));
+
+	ByteOffset = int32(BitOffset / 8);
+	BufferedBits = 0;
+	NumBufferedBits = 0;
+
+	const int32 NumBitsToSkip = int32(BitOffset % 8);
+	if (NumBitsToSkip == 0)
+	{
+		return;
+	}
+
+	Refill();
+
+	BufferedBits >>= NumBitsToSkip;
+	NumBufferedBits -= NumBitsToSkip;
+}
+
+void FVoxelBitReader::Align(const uint32 Alignment)
+{
+	Seek(::Align(GetBitOffset(), int64(Alignment) * 8));
+}
+
+void FVoxelBitReader::RefillSlow()
+{
+	while (NumBufferedBits <= 56)
+	{
+		// Past the end, pretend we're reading 0s
+		if (ByteOffset < Data.Num())
+		{
+			BufferedBits |= uint64(Data[ByteOffset]) << NumBufferedBits;
+		}
+
+		ByteOffset++;
+		NumBufferedBits += 8;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+﻿// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#include "VoxelMinimal.h"
+
+void FVoxelBitWriter::AppendN(const TConstVoxelArrayView<uint32> Values, const uint32 NumBits)
+{
+	VOXEL_FUNCTION_COUNTER_NUM(Values.Num(), 1024);
+
+	Reserve(GetNumBits() + int64(Values.Num()) * NumBits);
+
+	for (const uint32 Value : Values)
+	{
+		Append(Value, NumBits);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#include "VoxelMinimal.h"
+#include "VoxelJumpFlood.h"
+#include "VoxelTaskContext.h"
+
+FVoxelCancellationToken FVoxelCancellationToken::Get()
+{
+	// Don't go through FVoxelTaskScope::GetContext, this can be called before the global context is created
+	// The global context cannot be cancelled anyway
+	const FVoxelTaskContext* Context = static_cast<FVoxelTaskContext*>(FPlatformTLS::GetTlsValue(GVoxelTaskScopeTLS));
+	if (!Context)
+	{
+		return {};
+	}
+	return Context->GetCancellationToken();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+VOXEL_CONSOLE_COMMAND(
+	"voxel.Tasks.MeasureCancellationLatency",
+	"Run a jump flood in a task, destroy its task context halfway through and log how long the destructor blocked. Optional argument: size, default 2048")
+{
+	int32 Size = 2048;
+	if (Args.Num() > 0)
+	{
+		LexFromString(Size, *Args[0]);
+	}
+	Size = FMath::Clamp(Size, 16, 8192);
+
+	TVoxelArray<FIntPoint> Seeds;
+	FVoxelUtilities::SetNumFast(Seeds, Size * Size);
+	for (int32 Y = 0; Y < Size; Y++)
+	{
+		for (int32 X = 0; X < Size; X++)
+		{
+			// Sparse seeds, other pixels are far away from everything
+			Seeds[X + Size * Y] = (X * 31 + Y * 17) % 1021 == 0 ? FIntPoint(X, Y) : FIntPoint(MAX_int32 / 2);
+		}
+	}
+
+	double FullTime;
+	{
+		VOXEL_SCOPE_COUNTER("Uncancelled run");
+
+		TVoxelArray<FIntPoint> Data = Seeds;
+
+		const double StartTime = FPlatformTime::Seconds();
+		ensure(FVoxelJumpFlood::JumpFlood2D(FIntPoint(Size), Data));
+		FullTime = FPlatformTime::Seconds() - StartTime;
+	}
+
+	struct FState
+	{
+		TVoxelArray<FIntPoint> Data;
+		TVoxelAtomic<bool> bStarted = false;
+		TVoxelAtomic<bool> bCompleted = false;
+		FVoxelCounter64 EndCycles;
+	};
+	const TSharedRef<FState> State = MakeShared<FState>();
+	State->Data = MoveTemp(Seeds);
+
+	FVoxelTaskContext* Context = new FVoxelTaskContext(true, false);
+	Context->Dispatch(EVoxelFutureThread::AsyncThread, [=]
+	{
+		State->bStarted.Set(true);
+		State->bCompleted.Set(FVoxelJumpFlood::JumpFlood2D(FIntPoint(Size), State->Data));
+		State->EndCycles.Set(FPlatformTime::Cycles64());
+	});
+
+	const double WaitStartTime = FPlatformTime::Seconds();
+	while (!State->bStarted.Get())
+	{
+		if (FPlatformTime::Seconds() - WaitStartTime > 10.)
+		{
+			LOG_VOXEL(Error, "Task didn't start after 10s");
+			break;
+		}
+
+		FPlatformProcess::Yield();
+	}
+
+	FPlatformProcess::Sleep(float(FullTime / 2));
+
+	const uint64 CancelCycles = FPlatformTime::Cycles64();
+	delete Context;
+	const uint64 DestroyedCycles = FPlatformTime::Cycles64();
+
+	const uint64 EndCycles = State->EndCycles.Get();
+	if (State->bCompleted.Get())
+	{
+		LOG_VOXEL(Warning, "Task finished before being cancelled, try a bigger size");
+		return;
+	}
+	if (EndCycles == 0)
+	{
+		LOG_VOXEL(Warning, "Task was cancelled before starting");
+		return;
+	}
+
+	LOG_VOXEL(Log, "JumpFlood2D %dx%d: uncancelled run took %.3fms. Cancelled halfway: task returned %.3fms after cancel, context destructor blocked %.3fms",
+		Size,
+		Size,
+		FullTime * 1000.,
+		FPlatformTime::ToMilliseconds64(EndCycles - CancelCycles),
+		FPlatformTime::ToMilliseconds64(DestroyedCycles - CancelCycles));
+}
@@ -0,0 +1,464 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#include "VoxelMinimal.h"
+#include "VoxelChromeTraceWriter.h"
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, bool, GVoxelFlightRecorderEnabled, true,
+	"voxel.FlightRecorder.Enabled",
+	"If true, the last scopes, lock waits & task dispatches of every thread are kept in a ring buffer, dumped on hitches");
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, int32, GVoxelFlightRecorderEventsPerThread, 16384,
+	"voxel.FlightRecorder.EventsPerThread",
+	"Size of the ring buffer of each thread, rounded up to a power of 2. Each event is 16 bytes. Only applies to threads recording their first event afterwards");
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, float, GVoxelFlightRecorderHitchThresholdMs, 100.f,
+	"voxel.FlightRecorder.HitchThresholdMs",
+	"Game thread frame time in milliseconds above which the flight recorder is dumped. 0 to disable");
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, float, GVoxelFlightRecorderMinTimeBetweenDumps, 30.f,
+	"voxel.FlightRecorder.MinTimeBetweenDumps",
+	"Min time in seconds between two hitch dumps");
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, float, GVoxelFlightRecorderDumpDuration, 2.f,
+	"voxel.FlightRecorder.DumpDuration",
+	"Seconds of events to save when dumping");
+
+VOXEL_CONSOLE_COMMAND(
+	"voxel.FlightRecorder.Dump",
+	"Save the last voxel.FlightRecorder.DumpDuration seconds of events of all threads to Saved/Profiling")
+{
+	FVoxelFlightRecorder::Dump("Manual dump");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+struct FVoxelFlightRecorderEvent
+{
+	enum class EType : uint8
+	{
+		BeginScope,
+		EndScope,
+		Dispatch
+	};
+
+	// Type is stored in the top 8 bits
+	uint64 CyclesAndType;
+	// Type + 1 is stored in the low 2 bits, the payload in the others:
+	// FVoxelFlightRecorderSite* for BeginScope, EVoxelFutureThread << 2 for Dispatch
+	// Dumps check both types match before using the payload
+	uint64 Data;
+
+	static constexpr uint64 TypeMask = 3;
+
+	FORCEINLINE static uint64 MakeData(const EType Type, const uint64 Payload)
+	{
+		checkVoxelSlow(!(Payload & TypeMask));
+		return Payload | (uint64(Type) + 1);
+	}
+
+	FORCEINLINE uint64 GetCycles() const
+	{
+		return CyclesAndType & ((uint64(1) << 56) - 1);
+	}
+	FORCEINLINE EType GetType() const
+	{
+		return EType(CyclesAndType >> 56);
+	}
+	FORCEINLINE uint64 GetPayload() const
+	{
+		return Data & ~TypeMask;
+	}
+	// False if the two words are from different events, or for garbage
+	FORCEINLINE bool IsValid() const
+	{
+		return (Data & TypeMask) == uint64(GetType()) + 1;
+	}
+};
+checkStatic(sizeof(FVoxelFlightRecorderEvent) == 16);
+checkStatic(alignof(FVoxelFlightRecorderSite) > FVoxelFlightRecorderEvent::TypeMask);
+
+// Only written to by its thread
+// Rings are never freed as dumps might be reading them: when a thread exits its ring is recycled by the next new thread
+struct FVoxelFlightRecorderThread
+{
+	const uint64 Mask;
+	TVoxelArray<FVoxelFlightRecorderEvent> Events;
+	// Number of events ever written, the last Events.Num() are in the ring
+	TVoxelAtomic<uint64> WriteIndex;
+
+	// Written when the ring is (re)assigned to a thread, requires the registry lock
+	uint32 ThreadId_RequiresLock = 0;
+	// Events before this index were written by the previous owner of the ring
+	uint64 FirstWriteIndex_RequiresLock = 0;
+
+	explicit FVoxelFlightRecorderThread(const int32 NumEvents)
+		: Mask(NumEvents - 1)
+	{
+		checkVoxelSlow(FMath::IsPowerOfTwo(NumEvents));
+		FVoxelUtilities::SetNumZeroed(Events, NumEvents);
+	}
+
+	FORCEINLINE void Add(
+		const FVoxelFlightRecorderEvent::EType Type,
+		const uint64 Data)
+	{
+		const uint64 Index = WriteIndex.Get(std::memory_order_relaxed);
+
+		// Pairs with the acquire fence in Copy: the slot writes below cannot become visible before the previous WriteIndex store,
+		// so a reader seeing any of them also sees WriteIndex >= Index and discards the slot
+		std::atomic_thread_fence(std::memory_order_release);
+
+		FVoxelFlightRecorderEvent& Event = Events[Index & Mask];
+		Event.CyclesAndType = FPlatformTime::Cycles64() | (uint64(Type) << 56);
+		Event.Data = FVoxelFlightRecorderEvent::MakeData(Type, Data);
+
+		WriteIndex.Set(Index + 1, std::memory_order_release);
+	}
+
+	// Copy the events in [FirstIndex, EndIndex), EndIndex having been read with acquire semantics
+	// The owning thread might be writing concurrently: like a seqlock, events that might have been overwritten while copying are discarded
+	TVoxelArray<FVoxelFlightRecorderEvent> Copy(
+		const uint64 FirstIndex,
+		const uint64 EndIndex) const
+	{
+		const uint64 NumEvents = Mask + 1;
+		const uint64 StartIndex = FMath::Max(FirstIndex, EndIndex > NumEvents ? EndIndex - NumEvents : 0);
+		if (StartIndex >= EndIndex)
+		{
+			return {};
+		}
+
+		const int32 Num = int32(EndIndex - StartIndex);
+		const int32 StartSlot = int32(StartIndex & Mask);
+		const int32 NumBeforeWrap = FMath::Min(Num, int32(NumEvents) - StartSlot);
+
+		TVoxelArray<FVoxelFlightRecorderEvent> Result;
+		FVoxelUtilities::SetNumFast(Result, Num);
+		FMemory::Memcpy(Result.GetData(), &Events[StartSlot], NumBeforeWrap * sizeof(FVoxelFlightRecorderEvent));
+		FMemory::Memcpy(Result.GetData() + NumBeforeWrap, Events.GetData(), (Num - NumBeforeWrap) * sizeof(FVoxelFlightRecorderEvent));
+
+		// Pairs with the release fence in Add
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const uint64 CurrentWriteIndex = WriteIndex.Get(std::memory_order_relaxed);
+
+		// Slot i is overwritten when writing event i + NumEvents, which might be in progress for CurrentWriteIndex
+		const uint64 FirstValidIndex = CurrentWriteIndex + 1 > NumEvents ? CurrentWriteIndex + 1 - NumEvents : 0;
+		if (FirstValidIndex > StartIndex)
+		{
+			Result.RemoveAt(0, int32(FMath::Min(FirstValidIndex - StartIndex, uint64(Num))));
+		}
+		return Result;
+	}
+};
+
+struct FVoxelFlightRecorderRegistry
+{
+	// Not using VOXEL_SCOPE_LOCK as it would record itself
+	FVoxelCriticalSection CriticalSection;
+	// Never freed, includes the free rings: the events of exited threads are still dumped until their ring is reused
+	TVoxelArray<FVoxelFlightRecorderThread*> Threads_RequiresLock;
+	// Rings of exited threads, reused by new threads
+	TVoxelArray<FVoxelFlightRecorderThread*> FreeThreads_RequiresLock;
+};
+
+// Allocated on first use as scopes can be recorded during static initialization
+FVoxelFlightRecorderRegistry& GetVoxelFlightRecorderRegistry()
+{
+	static FVoxelFlightRecorderRegistry* Registry = new FVoxelFlightRecorderRegistry();
+	return *Registry;
+}
+
+// Set once the thread local below is destroyed, scopes in other thread local destructors are then not recorded
+thread_local bool GVoxelFlightRecorderThreadExited = false;
+
+struct FVoxelFlightRecorderThreadLocal
+{
+	FVoxelFlightRecorderThread* Thread = nullptr;
+
+	~FVoxelFlightRecorderThreadLocal()
+	{
+		GVoxelFlightRecorderThreadExited = true;
+
+		if (!Thread)
+		{
+			return;
+		}
+
+		FVoxelFlightRecorderRegistry& Registry = GetVoxelFlightRecorderRegistry();
+		Registry.CriticalSection.Lock();
+		Registry.FreeThreads_RequiresLock.Add(Thread);
+		Registry.CriticalSection.Unlock();
+	}
+};
+thread_local FVoxelFlightRecorderThreadLocal GVoxelFlightRecorderThread;
+
+FORCENOINLINE FVoxelFlightRecorderThread* AllocateVoxelFlightRecorderThread()
+{
+	if (GVoxelFlightRecorderThreadExited)
+	{
+		return nullptr;
+	}
+
+	const int32 NumEvents = FMath::RoundUpToPowerOfTwo(FMath::Max(GVoxelFlightRecorderEventsPerThread, 16));
+
+	FVoxelFlightRecorderRegistry& Registry = GetVoxelFlightRecorderRegistry();
+	Registry.CriticalSection.Lock();
+
+	FVoxelFlightRecorderThread* Thread = nullptr;
+	for (int32 Index = 0; Index < Registry.FreeThreads_RequiresLock.Num(); Index++)
+	{
+		if (Registry.FreeThreads_RequiresLock[Index]->Mask + 1 == uint64(NumEvents))
+		{
+			Thread = Registry.FreeThreads_RequiresLock[Index];
+			Registry.FreeThreads_RequiresLock.RemoveAtSwap(Index);
+			break;
+		}
+	}
+
+	if (!Thread)
+	{
+		Thread = new FVoxelFlightRecorderThread(NumEvents);
+		Registry.Threads_RequiresLock.Add(Thread);
+	}
+
+	Thread->ThreadId_RequiresLock = FPlatformTLS::GetCurrentThreadId();
+	Thread->FirstWriteIndex_RequiresLock = Thread->WriteIndex.Get();
+
+	Registry.CriticalSection.Unlock();
+
+	GVoxelFlightRecorderThread.Thread = Thread;
+	return Thread;
+}
+
+FORCEINLINE void AddVoxelFlightRecorderEvent(
+	const FVoxelFlightRecorderEvent::EType Type,
+	const uint64 Data)
+{
+	FVoxelFlightRecorderThread* Thread = GVoxelFlightRecorderThread.Thread;
+	if (!Thread)
+	{
+		Thread = AllocateVoxelFlightRecorderThread();
+
+		if (!Thread)
+		{
+			return;
+		}
+	}
+	Thread->Add(Type, Data);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelFlightRecorder::BeginScope(const FVoxelFlightRecorderSite& Site)
+{
+	AddVoxelFlightRecorderEvent(FVoxelFlightRecorderEvent::EType::BeginScope, uint64(&Site));
+}
+
+void FVoxelFlightRecorder::EndScope()
+{
+	AddVoxelFlightRecorderEvent(FVoxelFlightRecorderEvent::EType::EndScope, 0);
+}
+
+void FVoxelFlightRecorder::RecordDispatch(const EVoxelFutureThread Thread)
+{
+	if (!GVoxelFlightRecorderEnabled)
+	{
+		return;
+	}
+
+	AddVoxelFlightRecorderEvent(FVoxelFlightRecorderEvent::EType::Dispatch, uint64(Thread) << 2);
+}
+
+void FVoxelFlightRecorder::Dump(const FString& Reason)
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	const uint64 DumpCycles = FPlatformTime::Cycles64();
+	const uint64 StartCycles = DumpCycles - FMath::Min<uint64>(DumpCycles, uint64(GVoxelFlightRecorderDumpDuration / FPlatformTime::GetSecondsPerCycle64()));
+
+	struct FThreadSnapshot
+	{
+		const FVoxelFlightRecorderThread* Thread;
+		uint32 ThreadId;
+		uint64 FirstIndex;
+		uint64 EndIndex;
+	};
+
+	// Only snapshot the write indices on the calling thread, the rings are copied async
+	// Events written after the snapshot are ignored, events overwritten before the copy are lost
+	TVoxelArray<FThreadSnapshot> Snapshots;
+	{
+		FVoxelFlightRecorderRegistry& Registry = GetVoxelFlightRecorderRegistry();
+		Registry.CriticalSection.Lock();
+
+		Snapshots.Reserve(Registry.Threads_RequiresLock.Num());
+
+		for (const FVoxelFlightRecorderThread* Thread : Registry.Threads_RequiresLock)
+		{
+			Snapshots.Add(FThreadSnapshot
+			{
+				Thread,
+				Thread->ThreadId_RequiresLock,
+				Thread->FirstWriteIndex_RequiresLock,
+				Thread->WriteIndex.Get(std::memory_order_acquire)
+			});
+		}
+
+		Registry.CriticalSection.Unlock();
+	}
+
+	Voxel::AsyncTask([Reason, StartCycles, DumpCycles, Snapshots = MoveTemp(Snapshots)]
+	{
+		VOXEL_SCOPE_COUNTER("FVoxelFlightRecorder::Dump Write");
+
+		TVoxelArray<TPair<uint32, TVoxelArray<FVoxelFlightRecorderEvent>>> ThreadEvents;
+		{
+			VOXEL_SCOPE_COUNTER("Copy");
+
+			ThreadEvents.Reserve(Snapshots.Num());
+
+			for (const FThreadSnapshot& Snapshot : Snapshots)
+			{
+				ThreadEvents.Add({ Snapshot.ThreadId, Snapshot.Thread->Copy(Snapshot.FirstIndex, Snapshot.EndIndex) });
+			}
+		}
+
+		FVoxelChromeTraceWriter Writer("VoxelFlightRecorder", StartCycles);
+
+		const auto GetName = [](const FVoxelFlightRecorderSite& Site)
+		{
+			if (Site.Name)
+			{
+				return *Site.Name;
+			}
+			return FString::Printf(TEXT("%s:%d"), *FPaths::GetCleanFilename(ANSI_TO_TCHAR(Site.File)), Site.Line);
+		};
+
+		for (const auto& It : ThreadEvents)
+		{
+			const uint32 ThreadId = It.Key;
+
+			struct FOpenScope
+			{
+				const FVoxelFlightRecorderSite* Site;
+				uint64 StartCycles;
+			};
+			TVoxelArray<FOpenScope> OpenScopes;
+
+			for (const FVoxelFlightRecorderEvent& Event : It.Value)
+			{
+				if (!Event.IsValid())
+				{
+					// Torn by a concurrent write the seqlock check missed, never interpret its payload
+					ensureVoxelSlow(false);
+					continue;
+				}
+
+				switch (Event.GetType())
+				{
+				default: ensureVoxelSlow(false);
+				break;
+				case FVoxelFlightRecorderEvent::EType::BeginScope:
+				{
+					OpenScopes.Add(FOpenScope
+					{
+						reinterpret_cast<const FVoxelFlightRecorderSite*>(Event.GetPayload()),
+						Event.GetCycles()
+					});
+				}
+				break;
+				case FVoxelFlightRecorderEvent::EType::EndScope:
+				{
+					// Begin was overwritten
+					if (OpenScopes.Num() == 0)
+					{
+						break;
+					}
+
+					const FOpenScope Scope = OpenScopes.Pop();
+					if (Event.GetCycles() < StartCycles)
+					{
+						break;
+					}
+
+					Writer.AddSlice(ThreadId, TEXT("Scope"), GetName(*Scope.Site), FMath::Max(Scope.StartCycles, StartCycles), Event.GetCycles());
+				}
+				break;
+				case FVoxelFlightRecorderEvent::EType::Dispatch:
+				{
+					if (Event.GetCycles() < StartCycles)
+					{
+						break;
+					}
+
+					Writer.AddInstant(ThreadId, TEXT("Task"), FString("Dispatch to ") + LexToString(EVoxelFutureThread(Event.GetPayload() >> 2)), Event.GetCycles());
+				}
+				break;
+				}
+			}
+
+			// Scopes still running when dumping, typically the hitch itself
+			for (const FOpenScope& Scope : OpenScopes)
+			{
+				Writer.AddSlice(ThreadId, TEXT("Scope"), GetName(*Scope.Site) + " (running)", FMath::Max(Scope.StartCycles, StartCycles), DumpCycles);
+			}
+		}
+
+		const FString Path = Writer.Finish();
+		if (Path.IsEmpty())
+		{
+			return;
+		}
+
+		LOG_VOXEL(Log, "Flight recorder dumped to %s: %s", *Path, *Reason);
+	});
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+class FVoxelFlightRecorderHitchDetector : public FVoxelSingleton
+{
+public:
+	//~ Begin FVoxelSingleton Interface
+	virtual void Tick() override
+	{
+		const double Time = FPlatformTime::Seconds();
+		const double PreviousTickTime = LastTickTime;
+		LastTickTime = Time;
+
+		if (PreviousTickTime == 0.)
+		{
+			return;
+		}
+
+		const double FrameTime = Time - PreviousTickTime;
+
+		if (!GVoxelFlightRecorderEnabled ||
+			GVoxelFlightRecorderHitchThresholdMs <= 0.f ||
+			FrameTime * 1000. < GVoxelFlightRecorderHitchThresholdMs ||
+			Time - LastDumpTime < GVoxelFlightRecorderMinTimeBetweenDumps)
+		{
+			return;
+		}
+
+		LastDumpTime = Time;
+		FVoxelFlightRecorder::Dump(FString::Printf(TEXT("%.1fms game thread frame"), FrameTime * 1000.));
+	}
+	//~ End FVoxelSingleton Interface
+
+private:
+	double LastTickTime = 0.;
+	double LastDumpTime = 0.;
+};
+FVoxelFlightRecorderHitchDetector* GVoxelFlightRecorderHitchDetector = new FVoxelFlightRecorderHitchDetector();
@@ -13,16 +13,21 @@ VOXEL_CONSOLE_VARIABLE(
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
-TSharedRef<IVoxelPromiseState> IVoxelPromiseState::New(
+TVoxelIntrusiveRef<IVoxelPromiseState> IVoxelPromiseState::New(
 	FVoxelTaskContext* ContextOverride,
 	const bool bWithValue)
 {
-	return MakeShared<FVoxelPromiseState>(ContextOverride, bWithValue);
+	return MakeVoxelIntrusive<FVoxelPromiseState>(ContextOverride, bWithValue);
 }
 
-TSharedRef<IVoxelPromiseState> IVoxelPromiseState::New(const FSharedVoidRef& Value)
+TVoxelIntrusiveRef<IVoxelPromiseState> IVoxelPromiseState::New(const FSharedVoidRef& Value)
 {
-	return MakeShared<FVoxelPromiseState>(Value);
+	return MakeVoxelIntrusive<FVoxelPromiseState>(Value);
+}
+
+void IVoxelPromiseState::Destroy() const
+{
+	delete static_cast<const FVoxelPromiseState*>(this);
 }
 
 void IVoxelPromiseState::Set()
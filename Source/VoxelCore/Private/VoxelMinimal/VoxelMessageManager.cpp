@@ -10,6 +10,30 @@
 
 FVoxelMessageManager* GVoxelMessageManager = new FVoxelMessageManager();
 
+DEFINE_VOXEL_COUNTER(STAT_VoxelNumMessagesCoalesced);
+DEFINE_VOXEL_COUNTER(STAT_VoxelNumMessagesDropped);
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, float, GVoxelMessagesRateLimit, 2.f,
+	"voxel.messages.RateLimit",
+	"Max number of times per second an identical message is displayed");
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, int32, GVoxelMessagesBurstSize, 1,
+	"voxel.messages.BurstSize",
+	"Number of identical messages that can be displayed at once before the rate limit kicks in");
+
+struct FVoxelMessageRateLimit
+{
+	double NumTokens = 0;
+	double LastUpdateTime = 0;
+	int32 NumSuppressed = 0;
+	// Displayed with the suppressed count if no occurrence is displayed before this is cleaned up
+	TSharedPtr<FVoxelMessage> LastSuppressedMessage;
+};
+TVoxelMap<uint64, FVoxelMessageRateLimit> GVoxelMessageRateLimits_GameThread;
+double GVoxelMessageLastRateLimitCleanupTime_GameThread = 0;
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
@@ -64,73 +88,200 @@ FVoxelScopedMessageConsumer::~FVoxelScopedMessageConsumer()
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
-void FVoxelMessageManager::LogMessage(const TSharedRef<FVoxelMessage>& Message) const
+void FVoxelMessageManager::LogMessage(const TSharedRef<FVoxelMessage>& Message)
 {
 	VOXEL_FUNCTION_COUNTER();
 
-	for (const FGatherCallstack& GatherCallstack : GatherCallstacks)
+	// Hash before gathering callstacks so that the same error from different tasks has the same key
+	const uint64 Hash = Message->GetHash();
+
+	// Tokens only refill until the drain: if one is available now this occurrence might be displayed
+	const FRateLimitedHash& RateLimitedHash = RateLimitedHashes[Hash % NumRateLimitedHashes];
+	const bool bRateLimited =
+		RateLimitedHash.Hash.Get(std::memory_order_relaxed) == Hash &&
+		FPlatformTime::Seconds() < RateLimitedHash.EndTime.Get(std::memory_order_relaxed);
+
+	if (!bRateLimited)
 	{
-		GatherCallstack(Message);
+		for (const FGatherCallstack& GatherCallstack : GatherCallstacks)
+		{
+			GatherCallstack(Message);
+		}
 	}
 
-	const TSharedPtr<IVoxelMessageConsumer> MessageConsumer = FVoxelMessagesThreadSingleton::Get().GetTop().Pin();
+	FQueuedMessage QueuedMessage;
+	QueuedMessage.Message = Message;
+	QueuedMessage.MessageConsumer = FVoxelMessagesThreadSingleton::Get().GetTop().Pin();
+	QueuedMessage.Hash = Hash;
+	QueuedMessage.bGatheredCallstacks = !bRateLimited;
+	Queue.Enqueue(MoveTemp(QueuedMessage));
 
-	Voxel::GameTask([=]
+	if (IsDrainScheduled.Exchange_ReturnOld(1) != 0)
 	{
-		VOXEL_SCOPE_COUNTER("Log");
+		return;
+	}
 
-		if (MessageConsumer)
-		{
-			MessageConsumer->LogMessage(Message);
-		}
-		else
-		{
-			GVoxelMessageManager->LogMessage_GameThread(Message);
-		}
+	// Also drain outside of ticks, eg during loading or in commandlets
+	Voxel::GameTask([this]
+	{
+		DrainQueue_GameThread();
 	});
 }
 
-void FVoxelMessageManager::LogMessage_GameThread(const TSharedRef<FVoxelMessage>& Message) const
+void FVoxelMessageManager::Tick()
 {
 	VOXEL_FUNCTION_COUNTER();
 
-	if (NO_LOGGING)
+	DrainQueue_GameThread();
+}
+
+void FVoxelMessageManager::DrainQueue_GameThread()
+{
+	VOXEL_FUNCTION_COUNTER();
+	check(IsInGameThread());
+
+	IsDrainScheduled.Set(0);
+
+	struct FPendingMessage
 	{
-		return;
+		TSharedRef<FVoxelMessage> Message;
+		uint64 Hash = 0;
+		int32 NumOccurrences = 1;
+		bool bGatheredCallstacks = false;
+	};
+	TVoxelArray<FPendingMessage> PendingMessages;
+	TVoxelMap<uint64, int32> HashToPendingMessage;
+
+	FQueuedMessage QueuedMessage;
+	while (Queue.Dequeue(QueuedMessage))
+	{
+		const TSharedRef<FVoxelMessage> Message = QueuedMessage.Message.ToSharedRef();
+
+		if (QueuedMessage.MessageConsumer)
+		{
+			// Scoped consumers expect to receive all the messages
+			QueuedMessage.MessageConsumer->LogMessage(Message);
+			continue;
+		}
+
+		if (const int32* Index = HashToPendingMessage.Find(QueuedMessage.Hash))
+		{
+			FPendingMessage& PendingMessage = PendingMessages[*Index];
+			PendingMessage.NumOccurrences++;
+
+			// Prefer displaying an occurrence with callstacks
+			if (!PendingMessage.bGatheredCallstacks &&
+				QueuedMessage.bGatheredCallstacks)
+			{
+				PendingMessage.Message = Message;
+				PendingMessage.bGatheredCallstacks = true;
+			}
+
+			NumCoalescedMessages.Increment();
+			INC_VOXEL_COUNTER(STAT_VoxelNumMessagesCoalesced);
+			continue;
+		}
+
+		HashToPendingMessage.Add_CheckNew(QueuedMessage.Hash, PendingMessages.Num());
+		PendingMessages.Add(FPendingMessage{ Message, QueuedMessage.Hash, 1, QueuedMessage.bGatheredCallstacks });
 	}
 
+	const double Time = FPlatformTime::Seconds();
+	const double BurstSize = FMath::Max(1, GVoxelMessagesBurstSize);
+
+	for (const FPendingMessage& PendingMessage : PendingMessages)
 	{
-		VOXEL_SCOPE_COUNTER("Check recent messages");
+		FVoxelMessageRateLimit* RateLimit = GVoxelMessageRateLimits_GameThread.Find(PendingMessage.Hash);
+		if (!RateLimit)
+		{
+			RateLimit = &GVoxelMessageRateLimits_GameThread.Add_CheckNew(PendingMessage.Hash);
+			RateLimit->NumTokens = BurstSize;
+			RateLimit->LastUpdateTime = Time;
+		}
+
+		RateLimit->NumTokens = FMath::Min(BurstSize, RateLimit->NumTokens + (Time - RateLimit->LastUpdateTime) * GVoxelMessagesRateLimit);
+		RateLimit->LastUpdateTime = Time;
 
-		struct FRecentMessage
+		const bool bDisplay = RateLimit->NumTokens >= 1.;
+		if (bDisplay)
 		{
-			uint64 Hash = 0;
-			double Time = 0;
-		};
-		static TVoxelArray<FRecentMessage> RecentMessages;
+			RateLimit->NumTokens -= 1.;
+		}
 
-		const uint64 Hash = Message->GetHash();
-		const double Time = FPlatformTime::Seconds();
+		FRateLimitedHash& RateLimitedHash = RateLimitedHashes[PendingMessage.Hash % NumRateLimitedHashes];
+		if (RateLimit->NumTokens < 1.)
+		{
+			// Next occurrences will be suppressed until a token is available
+			RateLimitedHash.EndTime.Set(Time + (1. - RateLimit->NumTokens) / FMath::Max(GVoxelMessagesRateLimit, 1.e-3f), std::memory_order_relaxed);
+			RateLimitedHash.Hash.Set(PendingMessage.Hash, std::memory_order_relaxed);
+		}
+		else if (RateLimitedHash.Hash.Get(std::memory_order_relaxed) == PendingMessage.Hash)
+		{
+			RateLimitedHash.Hash.Set(0, std::memory_order_relaxed);
+		}
 
-		RecentMessages.RemoveAllSwap([&](const FRecentMessage& RecentMessage)
+		if (!bDisplay)
 		{
-			return RecentMessage.Time + 0.5 < Time;
-		}, UE_505_SWITCH(false, EAllowShrinking::No));
+			RateLimit->NumSuppressed += PendingMessage.NumOccurrences;
+			RateLimit->LastSuppressedMessage = PendingMessage.Message;
 
-		if (RecentMessages.FindByPredicate([&](const FRecentMessage& RecentMessage)
-			{
-				return RecentMessage.Hash == Hash;
-			}))
+			NumDroppedMessages.Add(PendingMessage.NumOccurrences);
+			INC_VOXEL_COUNTER_BY(STAT_VoxelNumMessagesDropped, PendingMessage.NumOccurrences);
+			continue;
+		}
+
+		const int32 NumRepeats = RateLimit->NumSuppressed + PendingMessage.NumOccurrences - 1;
+		RateLimit->NumSuppressed = 0;
+		RateLimit->LastSuppressedMessage.Reset();
+
+		if (NumRepeats > 0)
 		{
-			// A message with the same hash was displayed recently, don't log this one again
-			return;
+			PendingMessage.Message->AddText(FString::Printf(TEXT(" (repeated %d times)"), NumRepeats + 1));
 		}
 
-		RecentMessages.Add(FRecentMessage
+		LogMessage_GameThread(PendingMessage.Message);
+	}
+
+	if (GVoxelMessageLastRateLimitCleanupTime_GameThread + 1. < Time)
+	{
+		VOXEL_SCOPE_COUNTER("Cleanup rate limits");
+
+		GVoxelMessageLastRateLimitCleanupTime_GameThread = Time;
+
+		// Forget messages not seen for a while
+		for (auto It = GVoxelMessageRateLimits_GameThread.CreateIterator(); It; ++It)
 		{
-			Hash,
-			Time
-		});
+			FVoxelMessageRateLimit& RateLimit = It.Value();
+			if (RateLimit.LastUpdateTime + 10. > Time)
+			{
+				continue;
+			}
+
+			if (RateLimit.NumSuppressed > 0)
+			{
+				// Don't lose the last occurrences
+				RateLimit.LastSuppressedMessage->AddText(FString::Printf(TEXT(" (%d suppressed)"), RateLimit.NumSuppressed));
+				LogMessage_GameThread(RateLimit.LastSuppressedMessage.ToSharedRef());
+			}
+
+			FRateLimitedHash& RateLimitedHash = RateLimitedHashes[It.Key() % NumRateLimitedHashes];
+			if (RateLimitedHash.Hash.Get() == It.Key())
+			{
+				RateLimitedHash.Hash.Set(0);
+			}
+
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void FVoxelMessageManager::LogMessage_GameThread(const TSharedRef<FVoxelMessage>& Message) const
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	if (NO_LOGGING)
+	{
+		return;
 	}
 
 	if (!GIsEditor)
@@ -217,7 +368,7 @@ void FVoxelMessageManager::LogMessageFormat(const EVoxelMessageSeverity Severity
 void FVoxelMessageManager::InternalLogMessageFormat(
 	const EVoxelMessageSeverity Severity,
 	const TCHAR* Format,
-	const TConstVoxelArrayView<TSharedRef<FVoxelMessageToken>> Tokens) const
+	const TConstVoxelArrayView<TSharedRef<FVoxelMessageToken>> Tokens)
 {
 	VOXEL_FUNCTION_COUNTER();
 
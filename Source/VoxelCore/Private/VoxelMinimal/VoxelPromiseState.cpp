@@ -1,6 +1,7 @@
 ﻿// Copyright Voxel Plugin SAS. All Rights Reserved.
 
 #include "VoxelPromiseState.h"
+#include "VoxelTaskTracer.h"
 
 DEFINE_VOXEL_INSTANCE_COUNTER(FVoxelPromiseState);
 
@@ -55,10 +56,14 @@ FVoxelPromiseState::FVoxelPromiseState(
 
 	Context.NumPromises.Increment();
 
-	if (Context.bTrackPromisesCallstacks)
+	if (GVoxelTaskTracer->ShouldTrace(Context))
 	{
-		VOXEL_SCOPE_LOCK(Context.CriticalSection);
-		StackIndex = Context.StackFrames_RequiresLock.Add(FVoxelUtilities::GetStackFrames(4));
+		GVoxelTaskTracer->RecordPromiseCreated(this);
+	}
+
+	if (Context.ShouldSamplePromiseCallstack())
+	{
+		StackIndex = Context.AddPromiseStackFrames(FVoxelUtilities::GetStackFrames(4));
 	}
 }
 
@@ -154,7 +159,7 @@ void FVoxelPromiseState::AddContinuation(TUniquePtr<FContinuation> Continuation)
 	if (KeepAliveIndex == -1)
 	{
 		VOXEL_SCOPE_LOCK(Context.CriticalSection);
-		KeepAliveIndex = Context.PromisesToKeepAlive_RequiresLock.Add(AsShared());
+		KeepAliveIndex = Context.PromisesToKeepAlive_RequiresLock.Add(TVoxelRefCountPtr<FVoxelPromiseState>(this));
 	}
 
 	checkVoxelSlow(!Continuation->NextContinuation);
@@ -173,6 +178,8 @@ void FVoxelPromiseState::SetImpl(FVoxelTaskContext& Context)
 	checkVoxelSlow(!bIsComplete.Get());
 	bIsComplete.Set(true);
 
+	const uint64 TraceStartCycles = GVoxelTaskTracer->ShouldTrace(Context) ? FPlatformTime::Cycles64() : 0;
+
 	ON_SCOPE_EXIT
 	{
 		Context.NumPromises.Decrement();
@@ -187,9 +194,7 @@ void FVoxelPromiseState::SetImpl(FVoxelTaskContext& Context)
 
 		if (StackIndex != -1)
 		{
-			VOXEL_SCOPE_LOCK(Context.CriticalSection);
-			Context.StackFrames_RequiresLock.RemoveAt(StackIndex);
-
+			Context.RemovePromiseStackFrames(StackIndex);
 			StackIndex = -1;
 		}
 	};
@@ -202,4 +207,9 @@ void FVoxelPromiseState::SetImpl(FVoxelTaskContext& Context)
 		Continuation->Execute(Context, *this);
 		Continuation = MoveTemp(Continuation->NextContinuation);
 	}
+
+	if (TraceStartCycles)
+	{
+		GVoxelTaskTracer->RecordPromiseSet(this, TraceStartCycles, FPlatformTime::Cycles64());
+	}
 }
\ No newline at end of file
@@ -5,9 +5,7 @@
 #include "VoxelMinimal.h"
 #include "VoxelTaskContext.h"
 
-class FVoxelPromiseState
-	: public IVoxelPromiseState
-	, public TSharedFromThis<FVoxelPromiseState>
+class FVoxelPromiseState : public IVoxelPromiseState
 {
 public:
 	struct FContinuation
@@ -31,7 +29,7 @@ public:
 			: Thread(EVoxelFutureThread::AnyThread)
 			, Type(EType::Future)
 		{
-			new(&Storage) TSharedRef<FVoxelPromiseState>(StaticCastSharedRef<FVoxelPromiseState>(Future.PromiseState.ToSharedRef()));
+			new(&Storage) TVoxelIntrusiveRef<FVoxelPromiseState>(StaticCastIntrusiveRef<FVoxelPromiseState>(Future.PromiseState.ToIntrusiveRef()));
 		}
 		FORCEINLINE FContinuation(
 			const EVoxelFutureThread Thread,
@@ -54,7 +52,7 @@ public:
 			switch (Type)
 			{
 			default: VOXEL_ASSUME(false);
-			case EType::Future: GetFuture().~TSharedRef();
+			case EType::Future: GetFuture().~TVoxelIntrusiveRef();
 				break;
 			case EType::VoidLambda: GetVoidLambda().~TVoxelUniqueFunction();
 				break;
@@ -64,10 +62,10 @@ public:
 		}
 
 	public:
-		FORCEINLINE TSharedRef<FVoxelPromiseState>& GetFuture()
+		FORCEINLINE TVoxelIntrusiveRef<FVoxelPromiseState>& GetFuture()
 		{
 			checkVoxelSlow(Type == EType::Future);
-			return ReinterpretCastRef<TSharedRef<FVoxelPromiseState>>(Storage);
+			return ReinterpretCastRef<TVoxelIntrusiveRef<FVoxelPromiseState>>(Storage);
 		}
 		FORCEINLINE TVoxelUniqueFunction<void()>& GetVoidLambda()
 		{
@@ -117,5 +115,5 @@ private:
 
 	void SetImpl(FVoxelTaskContext& Context);
 };
-checkStatic(sizeof(FVoxelPromiseState) == 64);
+checkStatic(sizeof(FVoxelPromiseState) == 56);
 checkStatic(sizeof(FVoxelPromiseState::FContinuation) == 32);
\ No newline at end of file
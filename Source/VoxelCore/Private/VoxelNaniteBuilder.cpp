@@ -2,8 +2,111 @@
 
 #include "VoxelNaniteBuilder.h"
 #include "VoxelNanite.h"
+#include "VoxelFileCache.h"
+#include "VoxelTaskContext.h"
 #include "Engine/StaticMesh.h"
+#include "Misc/EngineVersion.h"
 #include "Rendering/NaniteResources.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, bool, GVoxelNaniteFileCache, true,
+	"voxel.Nanite.FileCache",
+	"If true, nanite render data is persisted in the voxel file cache so that the next sessions don't build it again");
+
+VOXEL_CONSOLE_COMMAND(
+	"voxel.Nanite.BenchmarkBuilder",
+	"Build a 1M triangles nanite mesh with and without triangle sorting and log build time, cluster size and output size")
+{
+	VOXEL_SCOPE_COUNTER("voxel.Nanite.BenchmarkBuilder");
+
+	// Noisy heightmap with its triangles shuffled, like a triangle soup coming out of a mesher
+	constexpr int32 Size = 708;
+
+	TVoxelArray<FVector3f> Positions;
+	TVoxelArray<FVoxelOctahedron> Normals;
+	{
+		TVoxelArray<FVector3f> UnitNormals;
+
+		const FRandomStream Stream(42);
+
+		TVoxelArray<FVector3f> Grid;
+		FVoxelUtilities::SetNumFast(Grid, Size * Size);
+		for (int32 Y = 0; Y < Size; Y++)
+		{
+			for (int32 X = 0; X < Size; X++)
+			{
+				Grid[X + Size * Y] = FVector3f(X, Y, 10.f * FMath::Sin(X / 20.f) * FMath::Cos(Y / 30.f) + Stream.FRand());
+			}
+		}
+
+		TVoxelArray<FIntVector> Triangles;
+		for (int32 Y = 0; Y < Size - 1; Y++)
+		{
+			for (int32 X = 0; X < Size - 1; X++)
+			{
+				const int32 Index00 = (X + 0) + Size * (Y + 0);
+				const int32 Index10 = (X + 1) + Size * (Y + 0);
+				const int32 Index01 = (X + 0) + Size * (Y + 1);
+				const int32 Index11 = (X + 1) + Size * (Y + 1);
+
+				Triangles.Add(FIntVector(Index00, Index11, Index10));
+				Triangles.Add(FIntVector(Index00, Index01, Index11));
+			}
+		}
+
+		for (int32 Index = Triangles.Num() - 1; Index > 0; Index--)
+		{
+			Triangles.Swap(Index, Stream.RandRange(0, Index));
+		}
+
+		for (const FIntVector& Triangle : Triangles)
+		{
+			const FVector3f A = Grid[Triangle.X];
+			const FVector3f B = Grid[Triangle.Y];
+			const FVector3f C = Grid[Triangle.Z];
+			const FVector3f Normal = FVector3f::CrossProduct(C - A, B - A).GetSafeNormal();
+
+			Positions.Add(A);
+			Positions.Add(B);
+			Positions.Add(C);
+
+			UnitNormals.Add(Normal);
+			UnitNormals.Add(Normal);
+			UnitNormals.Add(Normal);
+		}
+
+		// Normals are stored with 8 bits per axis, precise encoding lowers their error at no size cost
+		FVoxelUtilities::SetNumFast(Normals, UnitNormals.Num());
+		FVoxelUtilities::UnitVectorsToOctahedrons(UnitNormals, Normals, true);
+	}
+
+	for (const bool bSortTriangles : { false, true })
+	{
+		FVoxelNaniteBuilder Builder;
+		Builder.Mesh.Positions = Positions;
+		Builder.Mesh.Normals = Normals;
+		Builder.bSortTriangles = bSortTriangles;
+		Builder.bUseFileCache = false;
+
+		const double StartTime = FPlatformTime::Seconds();
+		const TUniquePtr<FStaticMeshRenderData> RenderData = Builder.CreateRenderData();
+		const double EndTime = FPlatformTime::Seconds();
+
+		LOG_VOXEL(Log, "Nanite builder, %d triangles, sorting %s: %.1fms, %d clusters, average cluster bounds size %.2f, root data %s",
+			Positions.Num() / 3,
+			bSortTriangles ? TEXT("on") : TEXT("off"),
+			(EndTime - StartTime) * 1000,
+			Builder.Stats.NumClusters,
+			Builder.Stats.AverageClusterBoundsSize,
+			*FVoxelUtilities::BytesToString(Builder.Stats.RootDataSize));
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
 
 TUniquePtr<FStaticMeshRenderData> FVoxelNaniteBuilder::CreateRenderData()
 {
@@ -16,55 +119,169 @@ TUniquePtr<FStaticMeshRenderData> FVoxelNaniteBuilder::CreateRenderData()
 		return nullptr;
 	}
 
-	using namespace Voxel::Nanite;
-
 	const FVoxelBox Bounds = FVoxelBox::FromPositions(Mesh.Positions);
 
 	Nanite::FResources Resources;
 
-	TVoxelArray<FCluster> AllClusters;
-	for (int32 TriangleIndex = 0; TriangleIndex < Mesh.Positions.Num() / 3; TriangleIndex++)
+	const bool bFileCache = bUseFileCache && GVoxelNaniteFileCache;
+	const FVoxelHash FileCacheKey = bFileCache ? GetFileCacheKey() : FVoxelHash();
+
+	if (!bFileCache ||
+		!LoadFromFileCache(FileCacheKey, Resources))
 	{
-		if (AllClusters.Num() == 0 ||
-			AllClusters.Last().NumTriangles() == NANITE_MAX_CLUSTER_TRIANGLES ||
-			AllClusters.Last().Positions.Num() + 3 > NANITE_MAX_CLUSTER_VERTICES)
+		if (!BuildResources(Bounds, Resources))
 		{
-			FCluster& Cluster = AllClusters.Emplace_GetRef();
-			Cluster.TextureCoordinates.SetNum(Mesh.TextureCoordinates.Num());
+			return nullptr;
+		}
 
-			for (TVoxelArray<FVector2f>& TextureCoordinate : Cluster.TextureCoordinates)
-			{
-				TextureCoordinate.Reserve(128);
-			}
+		if (bFileCache)
+		{
+			StoreInFileCache(FileCacheKey, Resources);
 		}
+	}
+
+	Resources.PositionPrecision = -1;
+	Resources.NormalPrecision = -1;
+	Resources.NumInputTriangles = 0;
+	Resources.NumInputVertices = Mesh.Positions.Num();
+	Resources.NumInputMeshes = 1;
+	Resources.NumInputTexCoords = Mesh.TextureCoordinates.Num();
+	Resources.NumClusters = Stats.NumClusters;
+	Resources.NumRootPages = Resources.PageStreamingStates.Num();
+	Resources.HierarchyRootOffsets.Add(0);
+
+	TUniquePtr<FStaticMeshRenderData> RenderData = MakeUnique<FStaticMeshRenderData>();
+	RenderData->Bounds = Bounds.ToFBox();
+	RenderData->NumInlinedLODs = 1;
+	RenderData->NaniteResourcesPtr = MakePimpl<Nanite::FResources>(MoveTemp(Resources));
+
+	FStaticMeshLODResources* LODResource = new FStaticMeshLODResources();
+	LODResource->bBuffersInlined = true;
+	LODResource->Sections.Emplace();
+
+	// Ensure UStaticMesh::HasValidRenderData returns true
+	LODResource->VertexBuffers.StaticMeshVertexBuffer.Init(1, 1);
+	LODResource->VertexBuffers.PositionVertexBuffer.Init(1);
+	LODResource->VertexBuffers.ColorVertexBuffer.Init(1);
+
+	RenderData->LODResources.Add(LODResource);
+
+	RenderData->LODVertexFactories.Emplace_GetRef(GMaxRHIFeatureLevel);
+
+	return RenderData;
+}
+
+UStaticMesh* FVoxelNaniteBuilder::CreateStaticMesh()
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	return CreateStaticMesh(CreateRenderData());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+bool FVoxelNaniteBuilder::BuildResources(
+	const FVoxelBox& Bounds,
+	Nanite::FResources& Resources)
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	using namespace Voxel::Nanite;
+
+	// Workers don't inherit the task scope, get the token here
+	const FVoxelCancellationToken CancellationToken = FVoxelTaskScope::GetCancellationToken();
+
+	FEncodingSettings EncodingSettings;
+	EncodingSettings.PositionPrecision = PositionPrecision;
+	checkStatic(FEncodingSettings::NormalBits == NormalBits);
 
-		FCluster& Cluster = AllClusters.Last();
+	const int32 NumTriangles = Mesh.Positions.Num() / 3;
 
-		const int32 IndexA = 3 * TriangleIndex + 0;
-		const int32 IndexB = 3 * TriangleIndex + 1;
-		const int32 IndexC = 3 * TriangleIndex + 2;
+	TVoxelArray<int32> SortedTriangles;
+	if (!SortTriangles(Bounds, CancellationToken, SortedTriangles))
+	{
+		return false;
+	}
+
+	// We don't reuse vertices, so clusters are limited by their vertex count first
+	constexpr int32 TrianglesPerCluster = FMath::Min(NANITE_MAX_CLUSTER_TRIANGLES, NANITE_MAX_CLUSTER_VERTICES / 3);
+
+	TVoxelArray<FCluster> AllClusters;
+	AllClusters.SetNum(FMath::DivideAndRoundUp(NumTriangles, TrianglesPerCluster));
 
-		Cluster.Positions.Add(Mesh.Positions[IndexA]);
-		Cluster.Positions.Add(Mesh.Positions[IndexB]);
-		Cluster.Positions.Add(Mesh.Positions[IndexC]);
+	const bool bClustersBuilt = ParallelFor_Cancellable(MakeVoxelArrayView(AllClusters), CancellationToken, [&](FCluster& Cluster, const int32 ClusterIndex)
+	{
+		const int32 StartTriangle = ClusterIndex * TrianglesPerCluster;
+		const int32 EndTriangle = FMath::Min(StartTriangle + TrianglesPerCluster, NumTriangles);
+		const int32 NumVertices = 3 * (EndTriangle - StartTriangle);
 
-		Cluster.Normals.Add(Mesh.Normals[IndexA]);
-		Cluster.Normals.Add(Mesh.Normals[IndexB]);
-		Cluster.Normals.Add(Mesh.Normals[IndexC]);
+		Cluster.Positions.Reserve(NumVertices);
+		Cluster.Normals.Reserve(NumVertices);
 
 		if (Mesh.Colors.Num() > 0)
 		{
-			Cluster.Colors.Add(Mesh.Colors[IndexA]);
-			Cluster.Colors.Add(Mesh.Colors[IndexB]);
-			Cluster.Colors.Add(Mesh.Colors[IndexC]);
+			Cluster.Colors.Reserve(NumVertices);
 		}
 
-		for (int32 UVIndex = 0; UVIndex < Cluster.TextureCoordinates.Num(); UVIndex++)
+		Cluster.TextureCoordinates.SetNum(Mesh.TextureCoordinates.Num());
+		for (TVoxelArray<FVector2f>& TextureCoordinate : Cluster.TextureCoordinates)
 		{
-			Cluster.TextureCoordinates[UVIndex].Add(Mesh.TextureCoordinates[UVIndex][IndexA]);
-			Cluster.TextureCoordinates[UVIndex].Add(Mesh.TextureCoordinates[UVIndex][IndexB]);
-			Cluster.TextureCoordinates[UVIndex].Add(Mesh.TextureCoordinates[UVIndex][IndexC]);
+			TextureCoordinate.Reserve(NumVertices);
 		}
+
+		for (int32 Index = StartTriangle; Index < EndTriangle; Index++)
+		{
+			const int32 TriangleIndex = SortedTriangles[Index];
+
+			const int32 IndexA = 3 * TriangleIndex + 0;
+			const int32 IndexB = 3 * TriangleIndex + 1;
+			const int32 IndexC = 3 * TriangleIndex + 2;
+
+			Cluster.Positions.Add_CheckNoGrow(Mesh.Positions[IndexA]);
+			Cluster.Positions.Add_CheckNoGrow(Mesh.Positions[IndexB]);
+			Cluster.Positions.Add_CheckNoGrow(Mesh.Positions[IndexC]);
+
+			Cluster.Normals.Add_CheckNoGrow(Mesh.Normals[IndexA]);
+			Cluster.Normals.Add_CheckNoGrow(Mesh.Normals[IndexB]);
+			Cluster.Normals.Add_CheckNoGrow(Mesh.Normals[IndexC]);
+
+			if (Mesh.Colors.Num() > 0)
+			{
+				Cluster.Colors.Add_CheckNoGrow(Mesh.Colors[IndexA]);
+				Cluster.Colors.Add_CheckNoGrow(Mesh.Colors[IndexB]);
+				Cluster.Colors.Add_CheckNoGrow(Mesh.Colors[IndexC]);
+			}
+
+			for (int32 UVIndex = 0; UVIndex < Cluster.TextureCoordinates.Num(); UVIndex++)
+			{
+				Cluster.TextureCoordinates[UVIndex].Add_CheckNoGrow(Mesh.TextureCoordinates[UVIndex][IndexA]);
+				Cluster.TextureCoordinates[UVIndex].Add_CheckNoGrow(Mesh.TextureCoordinates[UVIndex][IndexB]);
+				Cluster.TextureCoordinates[UVIndex].Add_CheckNoGrow(Mesh.TextureCoordinates[UVIndex][IndexC]);
+			}
+		}
+
+		// Cache the encoding info now so that page packing doesn't compute it serially
+		(void)Cluster.GetEncodingInfo(EncodingSettings);
+	});
+
+	if (!bClustersBuilt)
+	{
+		return false;
+	}
+
+	// Clusters are moved into pages below
+	TVoxelArray<FVoxelBox> ClusterBounds;
+	ClusterBounds.Reserve(AllClusters.Num());
+
+	Stats = {};
+	Stats.NumClusters = AllClusters.Num();
+
+	for (const FCluster& Cluster : AllClusters)
+	{
+		ClusterBounds.Add_CheckNoGrow(Cluster.GetBounds());
+		Stats.AverageClusterBoundsSize += Cluster.GetBounds().Size().Length() / AllClusters.Num();
 	}
 
 	const int32 TreeDepth = FMath::CeilToInt(FMath::LogX(4.f, AllClusters.Num()));
@@ -137,10 +354,6 @@ TUniquePtr<FStaticMeshRenderData> FVoxelNaniteBuilder::CreateRenderData()
 		HierarchyNode.Misc2[0].ResourcePageIndex_NumPages_GroupPartSize = 0xFFFFFFFF;
 	}
 
-	FEncodingSettings EncodingSettings;
-	EncodingSettings.PositionPrecision = PositionPrecision;
-	checkStatic(FEncodingSettings::NormalBits == NormalBits);
-
 	TVoxelArray<TVoxelArray<FCluster>> Pages;
 	{
 		int32 ClusterIndex = 0;
@@ -171,20 +384,38 @@ TUniquePtr<FStaticMeshRenderData> FVoxelNaniteBuilder::CreateRenderData()
 		check(ClusterIndex == AllClusters.Num());
 	}
 
-	TVoxelChunkedArray<uint8> RootData;
-
-	int32 VertexOffset = 0;
-	int32 ClusterIndexOffset = 0;
-	for (int32 PageIndex = 0; PageIndex < Pages.Num(); PageIndex++)
+	TVoxelArray<int32> PageVertexOffsets;
+	TVoxelArray<int32> PageClusterIndexOffsets;
 	{
-		TVoxelArray<FCluster>& Clusters = Pages[PageIndex];
-		ON_SCOPE_EXIT
+		int32 VertexOffset = 0;
+		int32 ClusterIndexOffset = 0;
+		for (const TVoxelArray<FCluster>& Clusters : Pages)
 		{
+			PageVertexOffsets.Add(VertexOffset);
+			PageClusterIndexOffsets.Add(ClusterIndexOffset);
+
+			for (const FCluster& Cluster : Clusters)
+			{
+				VertexOffset += Cluster.NumVertices();
+			}
 			ClusterIndexOffset += Clusters.Num();
-		};
+		}
+	}
 
-		Nanite::FPageStreamingState PageStreamingState{};
-		PageStreamingState.BulkOffset = RootData.Num();
+	struct FPageData
+	{
+		// Fixup chunk followed by the page itself
+		TVoxelChunkedArray<uint8> Data;
+		int32 PageSize = 0;
+	};
+	TVoxelArray<FPageData> PageDatas;
+	PageDatas.SetNum(Pages.Num());
+
+	// Pages don't reference each other's data, pack them in parallel and concatenate them after
+	const bool bPagesBuilt = ParallelFor_Cancellable(MakeVoxelArrayView(Pages), CancellationToken, [&](TVoxelArray<FCluster>& Clusters, const int32 PageIndex)
+	{
+		FPageData& PageData = PageDatas[PageIndex];
+		const int32 ClusterIndexOffset = PageClusterIndexOffsets[PageIndex];
 
 		Nanite::FFixupChunk FixupChunk;
 		FixupChunk.Header.Magic = NANITE_FIXUP_MAGIC;
@@ -214,31 +445,48 @@ TUniquePtr<FStaticMeshRenderData> FVoxelNaniteBuilder::CreateRenderData()
 				0);
 		}
 
-		RootData.Append(MakeByteVoxelArrayView(FixupChunk).LeftOf(FixupChunk.GetSize()));
+		PageData.Data.Append(MakeByteVoxelArrayView(FixupChunk).LeftOf(FixupChunk.GetSize()));
 
-		const int32 PageStartIndex = RootData.Num();
+		const int32 PageStartIndex = PageData.Data.Num();
 
+		int32 VertexOffset = PageVertexOffsets[PageIndex];
 		CreatePageData(
 			Clusters,
 			EncodingSettings,
-			RootData,
+			PageData.Data,
 			VertexOffset);
 
-		PageStreamingState.BulkSize = RootData.Num() - PageStreamingState.BulkOffset;
-		PageStreamingState.PageSize = RootData.Num() - PageStartIndex;
+		PageData.PageSize = PageData.Data.Num() - PageStartIndex;
+	});
+
+	if (!bPagesBuilt)
+	{
+		return false;
+	}
+
+	TVoxelChunkedArray<uint8> RootData;
+	for (const FPageData& PageData : PageDatas)
+	{
+		Nanite::FPageStreamingState PageStreamingState{};
+		PageStreamingState.BulkOffset = RootData.Num();
+		PageStreamingState.BulkSize = PageData.Data.Num();
+		PageStreamingState.PageSize = PageData.PageSize;
 		PageStreamingState.MaxHierarchyDepth = NANITE_MAX_CLUSTER_HIERARCHY_DEPTH;
 		Resources.PageStreamingStates.Add(PageStreamingState);
+
+		RootData.Append(PageData.Data);
 	}
+	Stats.RootDataSize = RootData.Num();
 
 	for (int32 ClusterIndex = 0; ClusterIndex < AllClusters.Num(); ClusterIndex++)
 	{
 		Nanite::FPackedHierarchyNode PackedHierarchyNode;
 		FMemory::Memzero(PackedHierarchyNode);
 
-		PackedHierarchyNode.Misc0[0].BoxBoundsCenter = FVector3f(Bounds.GetCenter());
+		PackedHierarchyNode.Misc0[0].BoxBoundsCenter = FVector3f(ClusterBounds[ClusterIndex].GetCenter());
 		PackedHierarchyNode.Misc0[0].MinLODError_MaxParentLODError = FFloat16(-1).Encoded | (FFloat16(1e10f).Encoded << 16);
 
-		PackedHierarchyNode.Misc1[0].BoxBoundsExtent = FVector3f(Bounds.GetExtent());
+		PackedHierarchyNode.Misc1[0].BoxBoundsExtent = FVector3f(ClusterBounds[ClusterIndex].GetExtent());
 		PackedHierarchyNode.Misc1[0].ChildStartReference = 0xFFFFFFFFu;
 
 		const int32 PageIndexStart = 0;
@@ -253,42 +501,222 @@ TUniquePtr<FStaticMeshRenderData> FVoxelNaniteBuilder::CreateRenderData()
 	}
 
 	Resources.RootData = RootData.Array();
-	Resources.PositionPrecision = -1;
-	Resources.NormalPrecision = -1;
-	Resources.NumInputTriangles = 0;
-	Resources.NumInputVertices = Mesh.Positions.Num();
-	Resources.NumInputMeshes = 1;
-	Resources.NumInputTexCoords = Mesh.TextureCoordinates.Num();
-	Resources.NumClusters = AllClusters.Num();
-	Resources.NumRootPages = Pages.Num();
-	Resources.HierarchyRootOffsets.Add(0);
+	return true;
+}
 
-	TUniquePtr<FStaticMeshRenderData> RenderData = MakeUnique<FStaticMeshRenderData>();
-	RenderData->Bounds = Bounds.ToFBox();
-	RenderData->NumInlinedLODs = 1;
-	RenderData->NaniteResourcesPtr = MakePimpl<Nanite::FResources>(MoveTemp(Resources));
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
 
-	FStaticMeshLODResources* LODResource = new FStaticMeshLODResources();
-	LODResource->bBuffersInlined = true;
-	LODResource->Sections.Emplace();
+FVoxelHash FVoxelNaniteBuilder::GetFileCacheKey() const
+{
+	VOXEL_FUNCTION_COUNTER();
 
-	// Ensure UStaticMesh::HasValidRenderData returns true
-	LODResource->VertexBuffers.StaticMeshVertexBuffer.Init(1, 1);
-	LODResource->VertexBuffers.PositionVertexBuffer.Init(1);
-	LODResource->VertexBuffers.ColorVertexBuffer.Init(1);
+	// Bump to invalidate the render data built by previous versions
+	constexpr int32 Version = 2;
+
+	// The nanite page format isn't stable across engine versions
+	const FEngineVersion& EngineVersion = FEngineVersion::Current();
+
+	FVoxelHashBuilder Builder;
+	Builder << MAKE_TAG_64("VOXEL_NA");
+	Builder << Version;
+	Builder << EngineVersion.GetMajor();
+	Builder << EngineVersion.GetMinor();
+	Builder << EngineVersion.GetPatch();
+	Builder << EngineVersion.GetChangelist();
+	Builder << PositionPrecision;
+	Builder << NormalBits;
+	Builder << bSortTriangles;
+	Builder << Mesh.Positions.Num();
+	Builder << Mesh.Colors.Num();
+	Builder << Mesh.TextureCoordinates.Num();
+	Builder.AppendBytes(Mesh.Positions.GetData(), Mesh.Positions.Num() * sizeof(FVector3f));
+	Builder.AppendBytes(Mesh.Normals.GetData(), Mesh.Normals.Num() * sizeof(FVoxelOctahedron));
+	Builder.AppendBytes(Mesh.Colors.GetData(), Mesh.Colors.Num() * sizeof(FColor));
+
+	for (const TConstVoxelArrayView<FVector2f>& TextureCoordinate : Mesh.TextureCoordinates)
+	{
+		Builder << TextureCoordinate.Num();
+		Builder.AppendBytes(TextureCoordinate.GetData(), TextureCoordinate.Num() * sizeof(FVector2f));
+	}
 
-	RenderData->LODResources.Add(LODResource);
+	return Builder.MakeHash();
+}
 
-	RenderData->LODVertexFactories.Emplace_GetRef(GMaxRHIFeatureLevel);
+bool FVoxelNaniteBuilder::LoadFromFileCache(
+	const FVoxelHash& Key,
+	Nanite::FResources& Resources)
+{
+	VOXEL_FUNCTION_COUNTER();
 
-	return RenderData;
+	TVoxelArray64<uint8> Data;
+	if (!FVoxelFileCache::Get().Load(Key, Data))
+	{
+		return false;
+	}
+
+	FMemoryReaderView Reader(MakeMemoryView(Data.GetData(), Data.Num()));
+	SerializeResources(Reader, Resources);
+
+	if (Reader.IsError() ||
+		Reader.Tell() != Reader.TotalSize())
+	{
+		LOG_VOXEL(Warning, "Invalid nanite render data in file cache entry %s", *Key.ToString());
+		FVoxelFileCache::Get().Remove(Key);
+
+		Resources.RootData.Reset();
+		Resources.PageStreamingStates.Reset();
+		Resources.HierarchyNodes.Reset();
+		Stats = {};
+		return false;
+	}
+
+	return true;
 }
 
-UStaticMesh* FVoxelNaniteBuilder::CreateStaticMesh()
+void FVoxelNaniteBuilder::StoreInFileCache(
+	const FVoxelHash& Key,
+	Nanite::FResources& Resources)
 {
 	VOXEL_FUNCTION_COUNTER();
 
-	return CreateStaticMesh(CreateRenderData());
+	TArray64<uint8> Data;
+	{
+		FMemoryWriter64 Writer(Data);
+		SerializeResources(Writer, Resources);
+	}
+
+	FVoxelFileCache::Get().Store(Key, Data);
+}
+
+void FVoxelNaniteBuilder::SerializeResources(
+	FArchive& Ar,
+	Nanite::FResources& Resources)
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	// Only the fields set by BuildResources, the others are set by CreateRenderData
+	Ar << Stats.NumClusters;
+	Ar << Stats.AverageClusterBoundsSize;
+	Ar << Stats.RootDataSize;
+
+	Ar << Resources.RootData;
+
+	const auto SerializeNum = [&](auto& Array)
+	{
+		int32 Num = Array.Num();
+		Ar << Num;
+
+		if (!Ar.IsLoading())
+		{
+			return;
+		}
+
+		// Don't allocate garbage sizes from corrupted data
+		if (Num < 0 ||
+			Num > Ar.TotalSize())
+		{
+			Ar.SetError();
+			Num = 0;
+		}
+
+		Array.SetNum(Num);
+	};
+
+	SerializeNum(Resources.PageStreamingStates);
+
+	for (Nanite::FPageStreamingState& PageStreamingState : Resources.PageStreamingStates)
+	{
+		Ar << PageStreamingState.BulkOffset;
+		Ar << PageStreamingState.BulkSize;
+		Ar << PageStreamingState.PageSize;
+		PageStreamingState.MaxHierarchyDepth = NANITE_MAX_CLUSTER_HIERARCHY_DEPTH;
+	}
+
+	SerializeNum(Resources.HierarchyNodes);
+
+	for (Nanite::FPackedHierarchyNode& HierarchyNode : Resources.HierarchyNodes)
+	{
+		for (int32 Index = 0; Index < 4; Index++)
+		{
+			Ar << HierarchyNode.LODBounds[Index];
+			Ar << HierarchyNode.Misc0[Index].BoxBoundsCenter;
+			Ar << HierarchyNode.Misc0[Index].MinLODError_MaxParentLODError;
+			Ar << HierarchyNode.Misc1[Index].BoxBoundsExtent;
+			Ar << HierarchyNode.Misc1[Index].ChildStartReference;
+			Ar << HierarchyNode.Misc2[Index].ResourcePageIndex_NumPages_GroupPartSize;
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+bool FVoxelNaniteBuilder::SortTriangles(
+	const FVoxelBox& Bounds,
+	const FVoxelCancellationToken& CancellationToken,
+	TVoxelArray<int32>& OutSortedTriangles) const
+{
+	const int32 NumTriangles = Mesh.Positions.Num() / 3;
+	VOXEL_FUNCTION_COUNTER_NUM(NumTriangles, 1024);
+
+	FVoxelUtilities::SetNumFast(OutSortedTriangles, NumTriangles);
+
+	if (!bSortTriangles)
+	{
+		for (int32 Index = 0; Index < NumTriangles; Index++)
+		{
+			OutSortedTriangles[Index] = Index;
+		}
+		return true;
+	}
+
+	// Quantize centroids to 10 bits per axis
+	const FVector3f Offset = FVector3f(Bounds.Min);
+	const FVector3f Scale = 1023.f / FVector3f(FVoxelUtilities::ComponentMax(Bounds.Size(), FVector(KINDA_SMALL_NUMBER)));
+
+	// Morton code in the high bits, triangle index in the low bits
+	TVoxelArray<uint64> Keys;
+	FVoxelUtilities::SetNumFast(Keys, NumTriangles);
+
+	const bool bKeysBuilt = ParallelFor_Cancellable(MakeVoxelArrayView(Keys), CancellationToken, [&](uint64& Key, const int32 TriangleIndex)
+	{
+		const FVector3f Centroid =
+			(Mesh.Positions[3 * TriangleIndex + 0] +
+			Mesh.Positions[3 * TriangleIndex + 1] +
+			Mesh.Positions[3 * TriangleIndex + 2]) / 3.f;
+
+		const FVector3f Position = (Centroid - Offset) * Scale;
+
+		const uint32 X = FMath::Clamp(FMath::FloorToInt32(Position.X), 0, 1023);
+		const uint32 Y = FMath::Clamp(FMath::FloorToInt32(Position.Y), 0, 1023);
+		const uint32 Z = FMath::Clamp(FMath::FloorToInt32(Position.Z), 0, 1023);
+
+		const uint32 MortonCode =
+			(FMath::MortonCode3(X) << 0) |
+			(FMath::MortonCode3(Y) << 1) |
+			(FMath::MortonCode3(Z) << 2);
+
+		Key = (uint64(MortonCode) << 32) | uint64(TriangleIndex);
+	});
+
+	if (!bKeysBuilt)
+	{
+		return false;
+	}
+
+	{
+		VOXEL_SCOPE_COUNTER("Sort");
+		Keys.Sort();
+	}
+
+	for (int32 Index = 0; Index < NumTriangles; Index++)
+	{
+		OutSortedTriangles[Index] = int32(Keys[Index] & 0xFFFFFFFF);
+	}
+	return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -77,6 +77,11 @@ FVoxelSingletonManager::FVoxelSingletonManager()
 	for (FVoxelSingleton* Singleton : Singletons)
 	{
 		Singleton->Initialize();
+
+		if (Singleton->HasTickAsync())
+		{
+			TickAsyncSingletons.Add(Singleton);
+		}
 	}
 
 	FVoxelUtilities::DelayedCall([this]
@@ -116,10 +121,11 @@ FVoxelSingletonManager::~FVoxelSingletonManager()
 {
 	VOXEL_FUNCTION_COUNTER();
 
-	if (GraphEvent.IsValid())
+	if (GraphEvents.Num() > 0)
 	{
 		VOXEL_SCOPE_COUNTER("Wait");
-		GraphEvent->Wait();
+		FTaskGraphInterface::Get().WaitUntilTasksComplete(GraphEvents);
+		GraphEvents.Reset();
 	}
 
 	for (const FVoxelSingleton* Singleton : Singletons)
@@ -127,6 +133,7 @@ FVoxelSingletonManager::~FVoxelSingletonManager()
 		delete Singleton;
 	}
 	Singletons.Empty();
+	TickAsyncSingletons.Empty();
 
 	if (ViewExtension)
 	{
@@ -148,21 +155,21 @@ void FVoxelSingletonManager::Tick()
 		Singleton->Tick();
 	}
 
-	if (GraphEvent.IsValid())
+	if (GraphEvents.Num() > 0)
 	{
 		VOXEL_SCOPE_COUNTER("Waiting for Tick_Async");
-		GraphEvent->Wait();
+		FTaskGraphInterface::Get().WaitUntilTasksComplete(GraphEvents);
+		GraphEvents.Reset();
 	}
 
-	GraphEvent = TGraphTask<TVoxelGraphTask<ENamedThreads::AnyBackgroundThreadNormalTask>>::CreateTask().ConstructAndDispatchWhenReady([this]
+	// Tick_Async of different singletons are independent, run them in parallel
+	for (FVoxelSingleton* Singleton : TickAsyncSingletons)
 	{
-		VOXEL_SCOPE_COUNTER("FVoxelSingletonManager::Tick_Async");
-
-		for (FVoxelSingleton* Singleton : Singletons)
+		GraphEvents.Add(TGraphTask<TVoxelGraphTask<ENamedThreads::AnyBackgroundThreadNormalTask, ESubsequentsMode::TrackSubsequents>>::CreateTask().ConstructAndDispatchWhenReady([Singleton]
 		{
 			Singleton->Tick_Async();
-		}
-	});
+		}));
+	}
 
 	Voxel::RenderTask([this](FRHICommandList& RHICmdList)
 	{
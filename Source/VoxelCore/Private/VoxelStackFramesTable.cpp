@@ -0,0 +1,56 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#include "VoxelStackFramesTable.h"
+
+FVoxelStackFramesTable::FVoxelStackFramesTable()
+{
+	VOXEL_FUNCTION_COUNTER();
+	checkStatic(FMath::IsPowerOfTwo(Capacity));
+
+	Slots.SetNum(Capacity);
+}
+
+int32 FVoxelStackFramesTable::Add(const FVoxelStackFrames& StackFrames)
+{
+	const uint32 Hash = GetTypeHash(StackFrames);
+
+	for (int32 Probe = 0; Probe < MaxProbes; Probe++)
+	{
+		const int32 Index = (Hash + Probe) & (Capacity - 1);
+		FSlot& Slot = Slots[Index];
+
+		EState State = Slot.State.Get(std::memory_order_acquire);
+
+		if (State == EState::Empty)
+		{
+			if (Slot.State.CompareExchangeStrong(State, EState::Writing, std::memory_order_acquire))
+			{
+				Slot.Hash = Hash;
+				Slot.StackFrames = StackFrames;
+				Slot.State.Set(EState::Ready, std::memory_order_release);
+
+				NumAdded.Increment(std::memory_order_relaxed);
+				return Index;
+			}
+
+			// Another thread claimed the slot, State now has its value
+		}
+
+		// Only happens if two threads race for the same slot, and the write is a few instructions
+		while (State == EState::Writing)
+		{
+			FPlatformProcess::Yield();
+			State = Slot.State.Get(std::memory_order_acquire);
+		}
+		checkVoxelSlow(State == EState::Ready);
+
+		if (Slot.Hash == Hash &&
+			Slot.StackFrames == StackFrames)
+		{
+			return Index;
+		}
+	}
+
+	NumDropped.Increment(std::memory_order_relaxed);
+	return -1;
+}
@@ -1,11 +1,41 @@
 ﻿// Copyright Voxel Plugin SAS. All Rights Reserved.
 
 #include "VoxelTaskContext.h"
+#include "VoxelTaskTracer.h"
+#include "VoxelStackFramesTable.h"
+#include "VoxelMinimal/VoxelPromiseState.h"
 
 FVoxelTaskContext* GVoxelGlobalTaskContext = nullptr;
 
 DEFINE_VOXEL_INSTANCE_COUNTER(FVoxelTaskContext);
 
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, bool, GVoxelTrackTaskLatency, true,
+	"voxel.Tasks.TrackLatency",
+	"If true, task contexts created afterwards record the queue wait & run time of their tasks in histograms. See voxel.Tasks.PrintLatency");
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, int32, GVoxelPromiseCallstackSampleInterval, 0,
+	"voxel.Tasks.PromiseCallstackSampleInterval",
+	"Capture the callstack of one promise in N, to find the source of stuck promises with DumpToLog. 0 to disable. "
+	"Task contexts created with bTrackPromisesCallstacks capture all of them");
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, float, GVoxelPromiseCallstackSamplePeriod, 0.f,
+	"voxel.Tasks.PromiseCallstackSamplePeriod",
+	"Capture the callstack of at most one promise every N seconds per task context, on top of voxel.Tasks.PromiseCallstackSampleInterval. 0 to disable");
+
+// Percentiles of the tasks that completed during the last frame, all contexts & threads
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Task Queue Wait p50 (us)"), STAT_VoxelTaskQueueWait_P50, STATGROUP_VoxelCounters);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Task Queue Wait p95 (us)"), STAT_VoxelTaskQueueWait_P95, STATGROUP_VoxelCounters);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Task Queue Wait p99 (us)"), STAT_VoxelTaskQueueWait_P99, STATGROUP_VoxelCounters);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Task Scheduler Wait p50 (us)"), STAT_VoxelTaskSchedulerWait_P50, STATGROUP_VoxelCounters);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Task Scheduler Wait p95 (us)"), STAT_VoxelTaskSchedulerWait_P95, STATGROUP_VoxelCounters);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Task Scheduler Wait p99 (us)"), STAT_VoxelTaskSchedulerWait_P99, STATGROUP_VoxelCounters);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Task Run Time p50 (us)"), STAT_VoxelTaskRunTime_P50, STATGROUP_VoxelCounters);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Task Run Time p95 (us)"), STAT_VoxelTaskRunTime_P95, STATGROUP_VoxelCounters);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Task Run Time p99 (us)"), STAT_VoxelTaskRunTime_P99, STATGROUP_VoxelCounters);
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
@@ -18,6 +48,13 @@ struct FVoxelTaskContextArray
 };
 FVoxelTaskContextArray* GVoxelTaskContextArray = new FVoxelTaskContextArray();
 
+// Shared by all contexts, allocated on the first sampled promise
+FVoxelStackFramesTable& GetVoxelPromiseStackFramesTable()
+{
+	static FVoxelStackFramesTable* Table = new FVoxelStackFramesTable();
+	return *Table;
+}
+
 class FVoxelTaskContextTicker : public FVoxelSingleton
 {
 public:
@@ -37,6 +74,13 @@ public:
 
 		bool bAnyTaskProcessed;
 		ProcessGameTasks(bAnyTaskProcessed);
+
+#if STATS
+		if (FThreadStats::IsCollectingData())
+		{
+			UpdateLatencyStats();
+		}
+#endif
 	}
 	//~ End FVoxelSingleton Interface
 
@@ -60,6 +104,35 @@ public:
 			StrongRef.Context.ProcessGameTasks(bAnyTaskProcessed);
 		}
 	}
+
+#if STATS
+private:
+	FVoxelTaskLatencyStats PreviousLatencyStats;
+
+	void UpdateLatencyStats()
+	{
+		VOXEL_FUNCTION_COUNTER();
+
+		FVoxelTaskLatencyStats LatencyStats;
+		for (int32 Thread = 0; Thread < FVoxelTaskLatencyStats::NumThreads; Thread++)
+		{
+			LatencyStats.Append(FVoxelTaskLatencyStats::GetGlobal(EVoxelFutureThread(Thread)));
+		}
+
+		const FVoxelTaskLatencyStats FrameLatencyStats = LatencyStats.GetDelta(PreviousLatencyStats);
+		PreviousLatencyStats = LatencyStats;
+
+		SET_DWORD_STAT(STAT_VoxelTaskQueueWait_P50, int64(FrameLatencyStats.QueueWait.GetPercentile(0.50)));
+		SET_DWORD_STAT(STAT_VoxelTaskQueueWait_P95, int64(FrameLatencyStats.QueueWait.GetPercentile(0.95)));
+		SET_DWORD_STAT(STAT_VoxelTaskQueueWait_P99, int64(FrameLatencyStats.QueueWait.GetPercentile(0.99)));
+		SET_DWORD_STAT(STAT_VoxelTaskSchedulerWait_P50, int64(FrameLatencyStats.SchedulerWait.GetPercentile(0.50)));
+		SET_DWORD_STAT(STAT_VoxelTaskSchedulerWait_P95, int64(FrameLatencyStats.SchedulerWait.GetPercentile(0.95)));
+		SET_DWORD_STAT(STAT_VoxelTaskSchedulerWait_P99, int64(FrameLatencyStats.SchedulerWait.GetPercentile(0.99)));
+		SET_DWORD_STAT(STAT_VoxelTaskRunTime_P50, int64(FrameLatencyStats.RunTime.GetPercentile(0.50)));
+		SET_DWORD_STAT(STAT_VoxelTaskRunTime_P95, int64(FrameLatencyStats.RunTime.GetPercentile(0.95)));
+		SET_DWORD_STAT(STAT_VoxelTaskRunTime_P99, int64(FrameLatencyStats.RunTime.GetPercentile(0.99)));
+	}
+#endif
 };
 FVoxelTaskContextTicker* GVoxelTaskContextTicker = new FVoxelTaskContextTicker();
 
@@ -67,6 +140,148 @@ FVoxelTaskContextTicker* GVoxelTaskContextTicker = new FVoxelTaskContextTicker()
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
+// Stats of the contexts that were deleted, folded in by ~FVoxelTaskContext
+// Written with GVoxelTaskContextArray->CriticalSection write locked
+FVoxelTaskLatencyStats GVoxelDeletedTaskLatencyStats[FVoxelTaskLatencyStats::NumThreads];
+
+void ForeachTaskLatencyStats(TFunctionRef<void(const FString& Name, FVoxelTaskLatencyStats& Stats)> Lambda)
+{
+	VOXEL_SCOPE_READ_LOCK(GVoxelTaskContextArray->CriticalSection);
+
+	for (int32 Thread = 0; Thread < FVoxelTaskLatencyStats::NumThreads; Thread++)
+	{
+		Lambda(
+			FString("Deleted contexts ") + LexToString(EVoxelFutureThread(Thread)),
+			GVoxelDeletedTaskLatencyStats[Thread]);
+	}
+
+	for (FVoxelTaskContext* Context : GVoxelTaskContextArray->Contexts_RequiresLock)
+	{
+		const FString ContextName =
+			Context == GVoxelGlobalTaskContext
+			? FString("Global context")
+			: FString::Printf(TEXT("Context %p"), Context);
+
+		for (int32 Thread = 0; Thread < FVoxelTaskLatencyStats::NumThreads; Thread++)
+		{
+			const FVoxelTaskLatencyStats* Stats = Context->GetLatencyStats(EVoxelFutureThread(Thread));
+			if (!Stats)
+			{
+				continue;
+			}
+
+			Lambda(
+				ContextName + " " + LexToString(EVoxelFutureThread(Thread)),
+				ConstCast(*Stats));
+		}
+	}
+}
+
+VOXEL_CONSOLE_COMMAND(
+	"voxel.Tasks.PrintLatency",
+	"Log the p50/p95/p99 queue wait, scheduler wait & run time of tasks, globally and per task context & thread")
+{
+	for (int32 Thread = 0; Thread < FVoxelTaskLatencyStats::NumThreads; Thread++)
+	{
+		FVoxelTaskLatencyStats::GetGlobal(EVoxelFutureThread(Thread)).DumpToLog(
+			FString("All contexts ") + LexToString(EVoxelFutureThread(Thread)));
+	}
+
+	ForeachTaskLatencyStats([](const FString& Name, const FVoxelTaskLatencyStats& Stats)
+	{
+		Stats.DumpToLog(Name);
+	});
+}
+
+VOXEL_CONSOLE_COMMAND(
+	"voxel.Tasks.ResetLatency",
+	"Reset the task latency histograms")
+{
+	ForeachTaskLatencyStats([](const FString& Name, FVoxelTaskLatencyStats& Stats)
+	{
+		Stats.Reset();
+	});
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelTaskLatencyStats::Reset()
+{
+	QueueWait.Reset();
+	SchedulerWait.Reset();
+	RunTime.Reset();
+}
+
+void FVoxelTaskLatencyStats::Append(const FVoxelTaskLatencyStats& Other)
+{
+	QueueWait.Append(Other.QueueWait);
+	SchedulerWait.Append(Other.SchedulerWait);
+	RunTime.Append(Other.RunTime);
+}
+
+FVoxelTaskLatencyStats FVoxelTaskLatencyStats::GetDelta(const FVoxelTaskLatencyStats& Previous) const
+{
+	FVoxelTaskLatencyStats Result;
+	Result.QueueWait = QueueWait.GetDelta(Previous.QueueWait);
+	Result.SchedulerWait = SchedulerWait.GetDelta(Previous.SchedulerWait);
+	Result.RunTime = RunTime.GetDelta(Previous.RunTime);
+	return Result;
+}
+
+void FVoxelTaskLatencyStats::DumpToLog(const FString& Name) const
+{
+	const int64 Num = RunTime.Num();
+	if (Num == 0)
+	{
+		return;
+	}
+
+	const auto ToString = [](const FVoxelLatencyHistogram& Histogram)
+	{
+		if (Histogram.Num() == 0)
+		{
+			return FString("-");
+		}
+
+		return FString::Printf(TEXT("p50 %s p95 %s p99 %s"),
+			*FVoxelUtilities::SecondsToString(Histogram.GetPercentile(0.50) / 1.e6),
+			*FVoxelUtilities::SecondsToString(Histogram.GetPercentile(0.95) / 1.e6),
+			*FVoxelUtilities::SecondsToString(Histogram.GetPercentile(0.99) / 1.e6));
+	};
+
+	LOG_VOXEL(Log, "%s: %lld tasks", *Name, Num);
+	LOG_VOXEL(Log, "\tQueue wait: %s", *ToString(QueueWait));
+	LOG_VOXEL(Log, "\tScheduler wait: %s", *ToString(SchedulerWait));
+	LOG_VOXEL(Log, "\tRun time: %s", *ToString(RunTime));
+}
+
+FVoxelTaskLatencyStats FVoxelTaskLatencyStats::GetGlobal(const EVoxelFutureThread Thread)
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	FVoxelTaskLatencyStats Result;
+
+	VOXEL_SCOPE_READ_LOCK(GVoxelTaskContextArray->CriticalSection);
+
+	Result.Append(GVoxelDeletedTaskLatencyStats[int32(Thread)]);
+
+	for (const FVoxelTaskContext* Context : GVoxelTaskContextArray->Contexts_RequiresLock)
+	{
+		if (const FVoxelTaskLatencyStats* Stats = Context->GetLatencyStats(Thread))
+		{
+			Result.Append(*Stats);
+		}
+	}
+
+	return Result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
 TUniquePtr<FVoxelTaskContextStrongRef> FVoxelTaskContextWeakRef::Pin() const
 {
 	if (Index == -1)
@@ -120,6 +335,11 @@ FVoxelTaskContext::FVoxelTaskContext(
 	: bCanCancelTasks(bCanCancelTasks)
 	, bTrackPromisesCallstacks(bTrackPromisesCallstacks)
 {
+	if (GVoxelTrackTaskLatency)
+	{
+		LatencyStats = MakeUnique<FVoxelTaskLatencyStats[]>(FVoxelTaskLatencyStats::NumThreads);
+	}
+
 	VOXEL_SCOPE_WRITE_LOCK(GVoxelTaskContextArray->CriticalSection);
 
 	SelfWeakRef.Index = GVoxelTaskContextArray->Contexts_RequiresLock.Add(this);
@@ -176,7 +396,17 @@ FVoxelTaskContext::~FVoxelTaskContext()
 	check(GVoxelTaskContextArray->Contexts_RequiresLock[SelfWeakRef.Index] == this);
 	GVoxelTaskContextArray->Contexts_RequiresLock.RemoveAt(SelfWeakRef.Index);
 
+	if (LatencyStats)
+	{
+		for (int32 Thread = 0; Thread < FVoxelTaskLatencyStats::NumThreads; Thread++)
+		{
+			GVoxelDeletedTaskLatencyStats[Thread].Append(LatencyStats[Thread]);
+		}
+	}
+
 	GVoxelTaskContextArray->CriticalSection.WriteUnlock();
+
+	delete[] PromiseStackFramesCounts.Get();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -200,6 +430,22 @@ void FVoxelTaskContext::Dispatch(
 		return;
 	}
 
+	FVoxelFlightRecorder::RecordDispatch(Thread);
+
+	if (GVoxelTaskTracer->ShouldTrace(*this))
+	{
+		const uint64 FlowId = GVoxelTaskTracer->RecordDispatch(Thread);
+
+		Lambda = [Thread, FlowId, Lambda = MoveTemp(Lambda)]
+		{
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			Lambda();
+			GVoxelTaskTracer->RecordTask(Thread, FlowId, StartCycles, FPlatformTime::Cycles64());
+		};
+	}
+
+	const uint64 DispatchCycles = LatencyStats ? FPlatformTime::Cycles64() : 0;
+
 	switch (Thread)
 	{
 	default: VOXEL_ASSUME(false);
@@ -207,6 +453,11 @@ void FVoxelTaskContext::Dispatch(
 	{
 		FVoxelTaskScope Scope(*this);
 		Lambda();
+
+		if (DispatchCycles)
+		{
+			RecordLatency(Thread, DispatchCycles, 0, DispatchCycles, FPlatformTime::Cycles64());
+		}
 	}
 	break;
 	case EVoxelFutureThread::GameThread:
@@ -214,7 +465,11 @@ void FVoxelTaskContext::Dispatch(
 		NumPendingTasks.Increment();
 
 		VOXEL_SCOPE_LOCK(GameTasksCriticalSection);
-		GameTasks_RequiresLock.Add(MoveTemp(Lambda));
+		GameTasks_RequiresLock.Add(FTask
+		{
+			MoveTemp(Lambda),
+			DispatchCycles
+		});
 	}
 	break;
 	case EVoxelFutureThread::RenderThread:
@@ -223,14 +478,22 @@ void FVoxelTaskContext::Dispatch(
 		NumRenderTasks.Increment();
 
 		// One ENQUEUE_RENDER_COMMAND per call, otherwise the command ordering can be incorrect
-		ENQUEUE_RENDER_COMMAND(FVoxelTaskContext)([this, Lambda = MoveTemp(Lambda)](FRHICommandList&)
+		ENQUEUE_RENDER_COMMAND(FVoxelTaskContext)([this, Lambda = MoveTemp(Lambda), DispatchCycles](FRHICommandList&)
 		{
 			VOXEL_SCOPE_COUNTER("FVoxelTaskContext::Dispatch");
 
 			if (!ShouldCancelTasks.Get())
 			{
-				FVoxelTaskScope Scope(*this);
-				Lambda();
+				const uint64 StartCycles = DispatchCycles ? FPlatformTime::Cycles64() : 0;
+				{
+					FVoxelTaskScope Scope(*this);
+					Lambda();
+				}
+
+				if (DispatchCycles)
+				{
+					RecordLatency(EVoxelFutureThread::RenderThread, DispatchCycles, 0, StartCycles, FPlatformTime::Cycles64());
+				}
 			}
 
 			NumPendingTasks.Decrement();
@@ -242,15 +505,21 @@ void FVoxelTaskContext::Dispatch(
 	{
 		NumPendingTasks.Increment();
 
+		FTask Task
+		{
+			MoveTemp(Lambda),
+			DispatchCycles
+		};
+
 		if (NumLaunchedTasks.Get() < MaxLaunchedTasks)
 		{
-			LaunchTask(MoveTemp(Lambda));
+			LaunchTask(MoveTemp(Task));
 			return;
 		}
 
 		{
 			VOXEL_SCOPE_LOCK(AsyncTasksCriticalSection);
-			AsyncTasks_RequiresLock.Add(MoveTemp(Lambda));
+			AsyncTasks_RequiresLock.Add(MoveTemp(Task));
 		}
 
 		if (NumLaunchedTasks.Get() < MaxLaunchedTasks)
@@ -314,24 +583,43 @@ void FVoxelTaskContext::DumpToLog()
 	LOG_VOXEL(Log, "Num promises: %d", GetNumPromises());
 	LOG_VOXEL(Log, "Num pending tasks: %d", NumPendingTasks.Get());
 
-	TVoxelMap<FVoxelStackFrames, int32> StackFramesToCount;
-	StackFramesToCount.Reserve(StackFrames_RequiresLock.Num());
+	const FVoxelCounter32* Counts = PromiseStackFramesCounts.Get();
+	if (!Counts)
+	{
+		return;
+	}
+
+	const FVoxelStackFramesTable& Table = GetVoxelPromiseStackFramesTable();
 
-	for (const FVoxelStackFrames& StackFrames : StackFrames_RequiresLock)
+	if (!bTrackPromisesCallstacks)
 	{
-		StackFramesToCount.FindOrAdd(StackFrames)++;
+		LOG_VOXEL(Log, "Promise callstacks are sampled, counts are only a fraction of the promises");
+	}
+	if (Table.GetNumDropped() > 0)
+	{
+		LOG_VOXEL(Log, "%d promise callstacks dropped as the stack frames table is full", Table.GetNumDropped());
+	}
+
+	TVoxelArray<TPair<int32, int32>> StackIndexAndCounts;
+	for (int32 StackIndex = 0; StackIndex < FVoxelStackFramesTable::Capacity; StackIndex++)
+	{
+		const int32 Count = Counts[StackIndex].Get(std::memory_order_relaxed);
+		if (Count > 0)
+		{
+			StackIndexAndCounts.Add({ StackIndex, Count });
+		}
 	}
 
-	StackFramesToCount.ValueSort([](const int32 A, const int32 B)
+	StackIndexAndCounts.Sort([](const TPair<int32, int32>& A, const TPair<int32, int32>& B)
 	{
-		return A > B;
+		return A.Value > B.Value;
 	});
 
-	for (const auto& It : StackFramesToCount)
+	for (const TPair<int32, int32>& It : StackIndexAndCounts)
 	{
 		LOG_VOXEL(Log, "x%d:", It.Value);
 
-		for (const FString& Line : FVoxelUtilities::StackFramesToString(It.Key))
+		for (const FString& Line : FVoxelUtilities::StackFramesToString(Table.Get(It.Key)))
 		{
 			LOG_VOXEL(Log, "\t%s", *Line);
 		}
@@ -352,25 +640,35 @@ void FVoxelTaskContext::LaunchTasks()
 		AsyncTasks_RequiresLock.Num() > 0 &&
 		NumLaunchedTasks.Get() < MaxLaunchedTasks)
 	{
-		for (TVoxelUniqueFunction<void()>& Task : AsyncTasks_RequiresLock.PopFirstChunk())
+		for (FTask& Task : AsyncTasks_RequiresLock.PopFirstChunk())
 		{
 			LaunchTask(MoveTemp(Task));
 		}
 	}
 }
 
-void FVoxelTaskContext::LaunchTask(TVoxelUniqueFunction<void()> Task)
+void FVoxelTaskContext::LaunchTask(FTask Task)
 {
 	NumLaunchedTasks.Increment();
 
+	const uint64 LaunchCycles = Task.DispatchCycles ? FPlatformTime::Cycles64() : 0;
+
 	UE::Tasks::Launch(
 		TEXT("Voxel Task"),
-		[this, Task = MoveTemp(Task)]
+		[this, Task = MoveTemp(Task), LaunchCycles]
 		{
 			if (!ShouldCancelTasks.Get())
 			{
-				FVoxelTaskScope Scope(*this);
-				Task();
+				const uint64 StartCycles = Task.DispatchCycles ? FPlatformTime::Cycles64() : 0;
+				{
+					FVoxelTaskScope Scope(*this);
+					Task.Lambda();
+				}
+
+				if (Task.DispatchCycles)
+				{
+					RecordLatency(EVoxelFutureThread::AsyncThread, Task.DispatchCycles, LaunchCycles, StartCycles, FPlatformTime::Cycles64());
+				}
 			}
 
 			if (NumLaunchedTasks.Decrement_ReturnNew() < MaxLaunchedTasks)
@@ -393,7 +691,7 @@ void FVoxelTaskContext::ProcessGameTasks(bool& bAnyTaskProcessed)
 	VOXEL_FUNCTION_COUNTER();
 	check(IsInGameThread());
 
-	TVoxelChunkedArray<TVoxelUniqueFunction<void()>> GameTasks;
+	TVoxelChunkedArray<FTask> GameTasks;
 	{
 		VOXEL_SCOPE_LOCK(GameTasksCriticalSection);
 		GameTasks = MoveTemp(GameTasks_RequiresLock);
@@ -407,11 +705,18 @@ void FVoxelTaskContext::ProcessGameTasks(bool& bAnyTaskProcessed)
 
 	FVoxelTaskScope Scope(*this);
 
-	for (const TVoxelUniqueFunction<void()>& Task : GameTasks)
+	for (const FTask& Task : GameTasks)
 	{
 		if (!ShouldCancelTasks.Get())
 		{
-			Task();
+			const uint64 StartCycles = Task.DispatchCycles ? FPlatformTime::Cycles64() : 0;
+
+			Task.Lambda();
+
+			if (Task.DispatchCycles)
+			{
+				RecordLatency(EVoxelFutureThread::GameThread, Task.DispatchCycles, 0, StartCycles, FPlatformTime::Cycles64());
+			}
 		}
 		NumPendingTasks.Decrement();
 	}
@@ -421,4 +726,111 @@ void FVoxelTaskContext::ProcessGameTasks(bool& bAnyTaskProcessed)
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
+bool FVoxelTaskContext::ShouldSamplePromiseCallstack()
+{
+	if (bTrackPromisesCallstacks)
+	{
+		return true;
+	}
+
+	if (GVoxelPromiseCallstackSampleInterval > 0)
+	{
+		// Per thread to avoid contention, sampling doesn't need to be exact
+		static thread_local uint32 NumPromises = 0;
+		if (++NumPromises % GVoxelPromiseCallstackSampleInterval == 0)
+		{
+			return true;
+		}
+	}
+
+	if (GVoxelPromiseCallstackSamplePeriod > 0.f)
+	{
+		const uint64 Cycles = FPlatformTime::Cycles64();
+
+		int64 NextCycles = NextPromiseCallstackSampleCycles.Get(std::memory_order_relaxed);
+		if (Cycles >= uint64(NextCycles) &&
+			NextPromiseCallstackSampleCycles.CompareExchangeStrong(NextCycles, int64(Cycles + GVoxelPromiseCallstackSamplePeriod / FPlatformTime::GetSecondsPerCycle64())))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int32 FVoxelTaskContext::AddPromiseStackFrames(const FVoxelStackFrames& StackFrames)
+{
+	const int32 StackIndex = GetVoxelPromiseStackFramesTable().Add(StackFrames);
+	if (StackIndex == -1)
+	{
+		return -1;
+	}
+
+	FVoxelCounter32* Counts = PromiseStackFramesCounts.Get();
+	if (!Counts)
+	{
+		FVoxelCounter32* NewCounts = new FVoxelCounter32[FVoxelStackFramesTable::Capacity];
+
+		if (PromiseStackFramesCounts.CompareExchangeStrong(Counts, NewCounts))
+		{
+			Counts = NewCounts;
+		}
+		else
+		{
+			// Another thread allocated them first, Counts was updated
+			delete[] NewCounts;
+		}
+	}
+	checkVoxelSlow(Counts);
+
+	Counts[StackIndex].Increment(std::memory_order_relaxed);
+	return StackIndex;
+}
+
+void FVoxelTaskContext::RemovePromiseStackFrames(const int32 StackIndex)
+{
+	checkVoxelSlow(PromiseStackFramesCounts.Get());
+	PromiseStackFramesCounts.Get()[StackIndex].Decrement(std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelTaskContext::RecordLatency(
+	const EVoxelFutureThread Thread,
+	const uint64 DispatchCycles,
+	const uint64 LaunchCycles,
+	const uint64 StartCycles,
+	const uint64 EndCycles)
+{
+	checkVoxelSlow(LatencyStats);
+
+	const auto ToMicroseconds = [](const uint64 Cycles)
+	{
+		return uint64(FPlatformTime::ToMilliseconds64(Cycles) * 1000.);
+	};
+
+	FVoxelTaskLatencyStats& Stats = LatencyStats[int32(Thread)];
+
+	if (Thread != EVoxelFutureThread::AnyThread)
+	{
+		const uint64 QueueWait = ToMicroseconds((LaunchCycles ? LaunchCycles : StartCycles) - DispatchCycles);
+		Stats.QueueWait.Add(QueueWait);
+	}
+
+	if (LaunchCycles)
+	{
+		const uint64 SchedulerWait = ToMicroseconds(StartCycles - LaunchCycles);
+		Stats.SchedulerWait.Add(SchedulerWait);
+	}
+
+	const uint64 RunTime = ToMicroseconds(EndCycles - StartCycles);
+	Stats.RunTime.Add(RunTime);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
 const uint32 GVoxelTaskScopeTLS = FPlatformTLS::AllocTlsSlot();
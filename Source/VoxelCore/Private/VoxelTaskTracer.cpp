@@ -0,0 +1,321 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#include "VoxelTaskTracer.h"
+#include "VoxelChromeTraceWriter.h"
+
+FVoxelTaskTracer* GVoxelTaskTracer = new FVoxelTaskTracer();
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, int32, GVoxelTaskTracerMaxEvents, 10 * 1000 * 1000,
+	"voxel.Tasks.TraceMaxEvents",
+	"Max number of events recorded by voxel.Tasks.StartTrace, further events are dropped");
+
+VOXEL_CONSOLE_COMMAND(
+	"voxel.Tasks.StartTrace",
+	"Record task & promise events of all task contexts. Optional argument: duration in seconds after which the trace is saved")
+{
+	double Duration = 0.;
+	if (Args.Num() > 0)
+	{
+		LexFromString(Duration, *Args[0]);
+	}
+
+	GVoxelTaskTracer->Start(nullptr, Duration);
+}
+
+VOXEL_CONSOLE_COMMAND(
+	"voxel.Tasks.StopTrace",
+	"Stop recording task & promise events and save the trace to Saved/Profiling")
+{
+	GVoxelTaskTracer->Stop();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelTaskTracer::Start(
+	const FVoxelTaskContext* Context,
+	const double Duration)
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	if (IsTracing())
+	{
+		Stop();
+	}
+
+	VOXEL_SCOPE_LOCK(CriticalSection);
+
+	NumReservedEvents.Set(0);
+	NumDroppedEvents.Set(0);
+
+	TracedContextSerial.Set(Context ? Context->GetSerial() : 0);
+	TraceStartCycles = FPlatformTime::Cycles64();
+	TraceEndCycles.Set(Duration > 0. ? TraceStartCycles + uint64(Duration / FPlatformTime::GetSecondsPerCycle64()) : 0);
+
+	// Set last, ShouldTrace & AddEvent read the above without locking
+	bIsTracing.Set(true);
+
+	if (Duration > 0.)
+	{
+		LOG_VOXEL(Log, "Task trace started for %fs", Duration);
+	}
+	else
+	{
+		LOG_VOXEL(Log, "Task trace started");
+	}
+}
+
+TVoxelFuture<FString> FVoxelTaskTracer::Stop()
+{
+	VOXEL_FUNCTION_COUNTER();
+
+	TVoxelArray<TVoxelChunkedArray<FEvent>> ThreadEvents;
+	{
+		VOXEL_SCOPE_LOCK(CriticalSection);
+
+		if (!bIsTracing.Get())
+		{
+			return FString();
+		}
+		bIsTracing.Set(false);
+
+		for (FThread* Thread : Threads_RequiresLock)
+		{
+			VOXEL_SCOPE_LOCK(Thread->CriticalSection);
+
+			Thread->NumReservedEvents_RequiresLock = 0;
+
+			if (Thread->Events_RequiresLock.Num() > 0)
+			{
+				ThreadEvents.Add(MoveTemp(Thread->Events_RequiresLock));
+			}
+		}
+	}
+
+	const int32 NumDropped = NumDroppedEvents.Get();
+
+	// Traces can have millions of events, don't convert them on the calling thread
+	return Voxel::AsyncTask([StartCycles = TraceStartCycles, NumDropped, ThreadEvents = MoveTemp(ThreadEvents)]
+	{
+		VOXEL_SCOPE_COUNTER("FVoxelTaskTracer::Stop Write");
+
+		FVoxelChromeTraceWriter Writer("VoxelTaskTrace", StartCycles);
+
+		int64 NumEvents = 0;
+		for (const TVoxelChunkedArray<FEvent>& Events : ThreadEvents)
+		{
+			NumEvents += Events.Num();
+
+			for (const FEvent& Event : Events)
+			{
+				switch (Event.Type)
+				{
+				default: VOXEL_ASSUME(false);
+				case FEvent::EType::PromiseCreated:
+				{
+					Writer.AddAsyncBegin(Event.ThreadId, TEXT("Promise"), TEXT("Promise"), Event.Id, Event.StartCycles);
+				}
+				break;
+				case FEvent::EType::PromiseSet:
+				{
+					Writer.AddAsyncEnd(Event.ThreadId, TEXT("Promise"), TEXT("Promise"), Event.Id, Event.StartCycles);
+					Writer.AddSlice(Event.ThreadId, TEXT("Promise"), "Set Promise", Event.StartCycles, Event.EndCycles);
+				}
+				break;
+				case FEvent::EType::Dispatch:
+				{
+					// Zero-length slice so that the flow always has something to bind to
+					Writer.AddSlice(Event.ThreadId, TEXT("Task"), FString("Dispatch to ") + LexToString(Event.Thread), Event.StartCycles, Event.StartCycles);
+					Writer.AddFlowStart(Event.ThreadId, TEXT("Task"), Event.Id, Event.StartCycles);
+				}
+				break;
+				case FEvent::EType::Task:
+				{
+					Writer.AddSlice(Event.ThreadId, TEXT("Task"), FString("Task on ") + LexToString(Event.Thread), Event.StartCycles, Event.EndCycles);
+					Writer.AddFlowEnd(Event.ThreadId, TEXT("Task"), Event.Id, Event.StartCycles);
+				}
+				break;
+				}
+			}
+		}
+
+		const FString Path = Writer.Finish();
+		if (Path.IsEmpty())
+		{
+			return FString();
+		}
+
+		if (NumDropped > 0)
+		{
+			LOG_VOXEL(Warning, "Task trace: %d events dropped, see voxel.Tasks.TraceMaxEvents", NumDropped);
+		}
+
+		LOG_VOXEL(Log, "Task trace with %lld events saved to %s", NumEvents, *Path);
+		return Path;
+	});
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelTaskTracer::RecordPromiseCreated(const void* Promise)
+{
+	FEvent Event;
+	Event.Type = FEvent::EType::PromiseCreated;
+	Event.Id = uint64(Promise);
+	Event.StartCycles = FPlatformTime::Cycles64();
+	AddEvent(Event);
+}
+
+void FVoxelTaskTracer::RecordPromiseSet(
+	const void* Promise,
+	const uint64 StartCycles,
+	const uint64 EndCycles)
+{
+	FEvent Event;
+	Event.Type = FEvent::EType::PromiseSet;
+	Event.Id = uint64(Promise);
+	Event.StartCycles = StartCycles;
+	Event.EndCycles = EndCycles;
+	AddEvent(Event);
+}
+
+uint64 FVoxelTaskTracer::RecordDispatch(const EVoxelFutureThread Thread)
+{
+	FEvent Event;
+	Event.Type = FEvent::EType::Dispatch;
+	Event.Thread = Thread;
+	Event.Id = FlowIdCounter.Increment_ReturnNew();
+	Event.StartCycles = FPlatformTime::Cycles64();
+	AddEvent(Event);
+
+	return Event.Id;
+}
+
+void FVoxelTaskTracer::RecordTask(
+	const EVoxelFutureThread Thread,
+	const uint64 FlowId,
+	const uint64 StartCycles,
+	const uint64 EndCycles)
+{
+	FEvent Event;
+	Event.Type = FEvent::EType::Task;
+	Event.Thread = Thread;
+	Event.Id = FlowId;
+	Event.StartCycles = StartCycles;
+	Event.EndCycles = EndCycles;
+	AddEvent(Event);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelTaskTracer::Tick()
+{
+	if (!IsTracing() ||
+		TraceEndCycles.Get() == 0 ||
+		FPlatformTime::Cycles64() < TraceEndCycles.Get())
+	{
+		return;
+	}
+
+	Stop();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+struct FVoxelTaskTracer::FThread
+{
+	// Only contended while Stop takes the events
+	FVoxelCriticalSection CriticalSection;
+	// Events keep their own thread id: a buffer can be reused by another thread
+	TVoxelChunkedArray<FEvent> Events_RequiresLock;
+	// Events this thread can still add before reserving more from NumReservedEvents
+	int32 NumReservedEvents_RequiresLock = 0;
+};
+
+struct FVoxelTaskTracerThreadLocal
+{
+	FVoxelTaskTracer::FThread* Thread = nullptr;
+
+	~FVoxelTaskTracerThreadLocal()
+	{
+		if (!Thread)
+		{
+			return;
+		}
+
+		VOXEL_SCOPE_LOCK(GVoxelTaskTracer->CriticalSection);
+		GVoxelTaskTracer->FreeThreads_RequiresLock.Add(Thread);
+	}
+};
+thread_local FVoxelTaskTracerThreadLocal GVoxelTaskTracerThread;
+
+FVoxelTaskTracer::FThread& FVoxelTaskTracer::GetThread()
+{
+	if (GVoxelTaskTracerThread.Thread)
+	{
+		return *GVoxelTaskTracerThread.Thread;
+	}
+
+	VOXEL_SCOPE_LOCK(CriticalSection);
+
+	FThread* Thread;
+	if (FreeThreads_RequiresLock.Num() > 0)
+	{
+		Thread = FreeThreads_RequiresLock.Pop();
+	}
+	else
+	{
+		Thread = new FThread();
+		Threads_RequiresLock.Add(Thread);
+	}
+
+	GVoxelTaskTracerThread.Thread = Thread;
+	return *Thread;
+}
+
+void FVoxelTaskTracer::AddEvent(FEvent Event)
+{
+	Event.ThreadId = FPlatformTLS::GetCurrentThreadId();
+
+	FThread& Thread = GetThread();
+	VOXEL_SCOPE_LOCK(Thread.CriticalSection);
+
+	// Tracing might have been stopped since ShouldTrace
+	// Stop clears bIsTracing before taking the thread locks, so no event is added once it took them
+	if (!bIsTracing.Get())
+	{
+		return;
+	}
+
+	const uint64 EndCycles = TraceEndCycles.Get();
+	if (EndCycles != 0 &&
+		Event.StartCycles > EndCycles)
+	{
+		return;
+	}
+
+	if (Thread.NumReservedEvents_RequiresLock == 0)
+	{
+		constexpr int32 NumEventsPerReservation = 1024;
+
+		if (NumReservedEvents.Get() >= GVoxelTaskTracerMaxEvents ||
+			NumReservedEvents.Add_ReturnOld(NumEventsPerReservation) >= GVoxelTaskTracerMaxEvents)
+		{
+			NumDroppedEvents.Increment();
+			return;
+		}
+
+		Thread.NumReservedEvents_RequiresLock = NumEventsPerReservation;
+	}
+
+	Thread.NumReservedEvents_RequiresLock--;
+	Thread.Events_RequiresLock.Add(Event);
+}
@@ -87,40 +87,111 @@ void FVoxelTransformRefImpl::Update_GameThread()
 	VOXEL_FUNCTION_COUNTER();
 	check(IsInGameThread());
 
-	FMatrix NewTransform = FMatrix::Identity;
+	FVoxelTransformRefComponentTransforms ComponentTransforms;
+	GatherComponentTransforms_GameThread(ComponentTransforms);
+
+	if (!SetTransform_GameThread(ComputeTransform(ComponentTransforms)))
+	{
+		return;
+	}
+
+	BroadcastOnChanged_GameThread();
+}
+
+void FVoxelTransformRefImpl::AddOnChanged(const FOnChanged& OnChanged)
+{
+	VOXEL_SCOPE_LOCK(CriticalSection);
+	OnChangedDelegates_RequiresLock.Add(MakeSharedCopy(OnChanged));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FVoxelTransformRefImpl::GatherComponentTransforms_GameThread(FVoxelTransformRefComponentTransforms& ComponentTransforms) const
+{
+	check(IsInGameThread());
+
 	for (const FVoxelTransformRefNode& Node : Nodes)
 	{
-		FMatrix LocalTransform;
 		if (Node.Provider.IsConstant())
 		{
-			LocalTransform = Node.Provider.GetLocalToWorld();
+			continue;
 		}
-		else
+
+		const FObjectKey Key = MakeObjectKey(Node.Provider.GetWeakComponent());
+		if (ComponentTransforms.Contains(Key))
 		{
-			const USceneComponent* Component = Node.Provider.GetWeakComponent().Get();
-			if (!/*ensureVoxelSlow*/(Component))
+			continue;
+		}
+
+		const USceneComponent* Component = Node.Provider.GetWeakComponent().Get();
+		if (!/*ensureVoxelSlow*/(Component))
+		{
+			continue;
+		}
+
+		FVoxelTransformRefComponentTransform& ComponentTransform = ComponentTransforms.Add_CheckNew(Key);
+		ComponentTransform.LocalToWorld = Component->GetComponentTransform().ToMatrixWithScale();
+		ComponentTransform.WorldToLocal = ComponentTransform.LocalToWorld.Inverse();
+	}
+}
+
+FMatrix FVoxelTransformRefImpl::ComputeTransform(const FVoxelTransformRefComponentTransforms& ComponentTransforms) const
+{
+	FMatrix NewTransform = FMatrix::Identity;
+	for (const FVoxelTransformRefNode& Node : Nodes)
+	{
+		if (Node.Provider.IsConstant())
+		{
+			if (Node.bIsInverted)
 			{
-				continue;
+				NewTransform *= Node.Provider.GetLocalToWorld().Inverse();
+			}
+			else
+			{
+				NewTransform *= Node.Provider.GetLocalToWorld();
 			}
+			continue;
+		}
 
-			LocalTransform = Component->GetComponentTransform().ToMatrixWithScale();
+		const FVoxelTransformRefComponentTransform* ComponentTransform = ComponentTransforms.Find(MakeObjectKey(Node.Provider.GetWeakComponent()));
+		if (!ComponentTransform)
+		{
+			// Component was destroyed
+			continue;
 		}
 
 		if (Node.bIsInverted)
 		{
-			LocalTransform = LocalTransform.Inverse();
+			NewTransform *= ComponentTransform->WorldToLocal;
+		}
+		else
+		{
+			NewTransform *= ComponentTransform->LocalToWorld;
 		}
-
-		NewTransform *= LocalTransform;
 	}
+	return NewTransform;
+}
+
+bool FVoxelTransformRefImpl::SetTransform_GameThread(const FMatrix& NewTransform)
+{
+	check(IsInGameThread());
 
 	if (Transform.Equals(NewTransform))
 	{
-		return;
+		return false;
 	}
 
 	Transform = NewTransform;
 	Dependency->Invalidate();
+	return true;
+}
+
+void FVoxelTransformRefImpl::BroadcastOnChanged_GameThread()
+{
+	VOXEL_FUNCTION_COUNTER();
+	check(IsInGameThread());
 
 	TVoxelArray<TSharedPtr<const FOnChanged>> OnChangedDelegates;
 	{
@@ -146,12 +217,6 @@ void FVoxelTransformRefImpl::Update_GameThread()
 	}
 }
 
-void FVoxelTransformRefImpl::AddOnChanged(const FOnChanged& OnChanged)
-{
-	VOXEL_SCOPE_LOCK(CriticalSection);
-	OnChangedDelegates_RequiresLock.Add(MakeSharedCopy(OnChanged));
-}
-
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
@@ -145,6 +145,18 @@ private:
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
+struct FVoxelTransformRefComponentTransform
+{
+	FMatrix LocalToWorld;
+	FMatrix WorldToLocal;
+};
+// Component transforms read once on the game thread, shared by all the transform refs updated in the same batch
+using FVoxelTransformRefComponentTransforms = TVoxelMap<FObjectKey, FVoxelTransformRefComponentTransform>;
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
 class FVoxelTransformRefImpl : public TSharedFromThis<FVoxelTransformRefImpl>
 {
 public:
@@ -165,6 +177,15 @@ public:
 	void Update_GameThread();
 	void AddOnChanged(const FOnChanged& OnChanged);
 
+public:
+	void GatherComponentTransforms_GameThread(FVoxelTransformRefComponentTransforms& ComponentTransforms) const;
+	// Thread safe, only reads ComponentTransforms
+	FMatrix ComputeTransform(const FVoxelTransformRefComponentTransforms& ComponentTransforms) const;
+	// Returns true if the transform changed, in which case Dependency is invalidated
+	bool SetTransform_GameThread(const FMatrix& NewTransform);
+	void BroadcastOnChanged_GameThread();
+
+public:
 	TSharedPtr<FVoxelTransformRefImpl> Multiply_AnyThread(
 		const FVoxelTransformRefImpl& Other,
 		bool bIsInverted,
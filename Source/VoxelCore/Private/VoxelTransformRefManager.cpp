@@ -1,6 +1,17 @@
 ﻿// Copyright Voxel Plugin SAS. All Rights Reserved.
 
 #include "VoxelTransformRefManager.h"
+#include "VoxelDependency.h"
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, bool, GVoxelTransformRefBatchUpdates, true,
+	"voxel.TransformRef.BatchUpdates",
+	"If true, component transform changes are accumulated and transform refs are updated once per frame. If false, they are updated immediately");
+
+VOXEL_CONSOLE_VARIABLE(
+	VOXELCORE_API, int32, GVoxelTransformRefParallelThreshold, 64,
+	"voxel.TransformRef.ParallelThreshold",
+	"Number of transform refs to update above which their transforms are computed in parallel");
 
 FVoxelTransformRefManager* GVoxelTransformRefManager = new FVoxelTransformRefManager();
 
@@ -75,24 +86,118 @@ void FVoxelTransformRefManager::NotifyTransformChanged(const USceneComponent& Co
 		return;
 	}
 
-	VOXEL_SCOPE_LOCK(CriticalSection);
+	{
+		VOXEL_SCOPE_LOCK(CriticalSection);
+
+		const FObjectKey Key = MakeObjectKey(&Component);
+		if (!ComponentToWeakTransformRefs_RequiresLock.Contains(Key))
+		{
+			return;
+		}
+
+		DirtyComponents_RequiresLock.Add(Key);
+	}
 
-	TVoxelSet<TWeakPtr<FVoxelTransformRefImpl>>* WeakTransformRefs = ComponentToWeakTransformRefs_RequiresLock.Find(&Component);
-	if (!WeakTransformRefs)
+	if (!GVoxelTransformRefBatchUpdates)
 	{
-		return;
+		FlushDirtyComponents_GameThread();
 	}
+}
+
+void FVoxelTransformRefManager::FlushDirtyComponents_GameThread()
+{
+	VOXEL_FUNCTION_COUNTER();
+	check(IsInGameThread());
 
-	for (auto It = WeakTransformRefs->CreateIterator(); It; ++It)
+	TVoxelArray<TSharedPtr<FVoxelTransformRefImpl>> TransformRefs;
 	{
-		const TSharedPtr<FVoxelTransformRefImpl> TransformRef = It->Pin();
-		if (!TransformRef)
+		VOXEL_SCOPE_LOCK(CriticalSection);
+
+		if (DirtyComponents_RequiresLock.Num() == 0)
 		{
-			It.RemoveCurrent();
-			continue;
+			return;
 		}
 
-		TransformRef->Update_GameThread();
+		// A transform ref can depend on several dirty components, only update it once
+		TVoxelSet<const FVoxelTransformRefImpl*> VisitedTransformRefs;
+
+		for (const FObjectKey& Component : DirtyComponents_RequiresLock)
+		{
+			TVoxelSet<TWeakPtr<FVoxelTransformRefImpl>>* WeakTransformRefs = ComponentToWeakTransformRefs_RequiresLock.Find(Component);
+			if (!WeakTransformRefs)
+			{
+				continue;
+			}
+
+			for (auto It = WeakTransformRefs->CreateIterator(); It; ++It)
+			{
+				TSharedPtr<FVoxelTransformRefImpl> TransformRef = It->Pin();
+				if (!TransformRef)
+				{
+					It.RemoveCurrent();
+					continue;
+				}
+
+				bool bIsInSet = false;
+				VisitedTransformRefs.FindOrAdd(TransformRef.Get(), bIsInSet);
+
+				if (!bIsInSet)
+				{
+					TransformRefs.Add(MoveTemp(TransformRef));
+				}
+			}
+		}
+
+		DirtyComponents_RequiresLock.Reset();
+	}
+
+	VOXEL_SCOPE_COUNTER_FORMAT("Update %d transform refs", TransformRefs.Num());
+
+	// Transform refs are flattened lists of nodes and never depend on each other,
+	// so once the component transforms are read they can all be computed independently
+	FVoxelTransformRefComponentTransforms ComponentTransforms;
+	for (const TSharedPtr<FVoxelTransformRefImpl>& TransformRef : TransformRefs)
+	{
+		TransformRef->GatherComponentTransforms_GameThread(ComponentTransforms);
+	}
+
+	TVoxelArray<FMatrix> NewTransforms;
+	FVoxelUtilities::SetNumFast(NewTransforms, TransformRefs.Num());
+
+	if (TransformRefs.Num() < GVoxelTransformRefParallelThreshold)
+	{
+		for (int32 Index = 0; Index < TransformRefs.Num(); Index++)
+		{
+			NewTransforms[Index] = TransformRefs[Index]->ComputeTransform(ComponentTransforms);
+		}
+	}
+	else
+	{
+		ParallelFor(TransformRefs, [&](const TSharedPtr<FVoxelTransformRefImpl>& TransformRef, const int32 Index)
+		{
+			NewTransforms[Index] = TransformRef->ComputeTransform(ComponentTransforms);
+		});
+	}
+
+	TVoxelArray<FVoxelTransformRefImpl*> ChangedTransformRefs;
+	{
+		VOXEL_SCOPE_COUNTER("Invalidate");
+
+		// Flush all the dependency invalidations at once
+		FVoxelDependencyInvalidationScope InvalidationScope;
+
+		for (int32 Index = 0; Index < TransformRefs.Num(); Index++)
+		{
+			if (TransformRefs[Index]->SetTransform_GameThread(NewTransforms[Index]))
+			{
+				ChangedTransformRefs.Add(TransformRefs[Index].Get());
+			}
+		}
+	}
+
+	for (FVoxelTransformRefImpl* TransformRef : ChangedTransformRefs)
+	{
+		TransformRef->BroadcastOnChanged_GameThread();
 	}
 }
 
@@ -100,6 +205,8 @@ void FVoxelTransformRefManager::Tick()
 {
 	VOXEL_FUNCTION_COUNTER();
 
+	FlushDirtyComponents_GameThread();
+
 	const double Time = FPlatformTime::Seconds();
 	if (LastClearTime + 10. > Time)
 	{
@@ -11,7 +11,10 @@ public:
 	TSharedRef<FVoxelTransformRefImpl> Make_AnyThread(TConstVoxelArrayView<FVoxelTransformRefNode> Nodes);
 	TSharedPtr<FVoxelTransformRefImpl> Find_AnyThread_RequiresLock(const FVoxelTransformRefNodeArray& NodeArray) const;
 
+	// Only marks the component as dirty, transform refs are updated in FlushDirtyComponents_GameThread
 	void NotifyTransformChanged(const USceneComponent& Component);
+	// Recompute every transform ref depending on a dirty component once
+	void FlushDirtyComponents_GameThread();
 
 	//~ Begin FVoxelSingleton Interface
 	virtual void Tick() override;
@@ -25,5 +28,6 @@ private:
 	TVoxelArray<TSharedPtr<FVoxelTransformRefImpl>> SharedTransformRefs_RequiresLock;
 	TVoxelMap<FObjectKey, TVoxelSet<TWeakPtr<FVoxelTransformRefImpl>>> ComponentToWeakTransformRefs_RequiresLock;
 	TVoxelMap<FVoxelTransformRefNodeArray, TWeakPtr<FVoxelTransformRefImpl>> NodeArrayToWeakTransformRef_RequiresLock;
+	TVoxelSet<FObjectKey> DirtyComponents_RequiresLock;
 };
 extern FVoxelTransformRefManager* GVoxelTransformRefManager;
\ No newline at end of file
@@ -99,6 +99,21 @@ void FVoxelZipWriter::WriteCompressed_Oodle(
 	WriteImpl(Path, CompressedData, MZ_NO_COMPRESSION);
 }
 
+void FVoxelZipWriter::WriteCompressed_Oodle(
+	const FString& Path,
+	const TConstVoxelArrayView64<uint8> Data,
+	const FVoxelCompressionFilters& Filters,
+	const bool bAllowParallel,
+	const FOodleDataCompression::ECompressor Compressor,
+	const FOodleDataCompression::ECompressionLevel CompressionLevel)
+{
+	VOXEL_SCOPE_COUNTER_FORMAT("FVoxelZipWriter::WriteCompressed_Oodle %s %lldB", *Path, Data.Num());
+
+	const TVoxelArray64<uint8> CompressedData = FVoxelUtilities::Compress(Data, Filters, bAllowParallel, Compressor, CompressionLevel);
+
+	WriteImpl(Path, CompressedData, MZ_NO_COMPRESSION);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
@@ -4,15 +4,100 @@
 
 #include "VoxelMinimal.h"
 
+class FVoxelBufferRef;
 class FVoxelBufferPoolBase;
 class FVoxelBufferPool;
 class FVoxelTextureBufferPool;
 
-class VOXELCORE_API FVoxelBufferRef
+// Index allocator shared by a pool and its buffer refs
+// Buffer refs keep it alive, so they can safely be released after their pool
+class VOXELCORE_API FVoxelBufferAllocator : public TVoxelRefCountBase<FVoxelBufferAllocator>
+{
+public:
+	const int32 BytesPerElement;
+
+	FVoxelCounter64 BufferCount;
+	FVoxelCounter64 UsedMemory;
+	FVoxelCounter64 PaddingMemory;
+
+	explicit FVoxelBufferAllocator(int32 BytesPerElement);
+
+	TVoxelIntrusiveRef<FVoxelBufferRef> Allocate(int64 Num);
+
+private:
+	struct FAllocationPool
+	{
+	public:
+		const int64 PoolSize;
+
+		explicit FAllocationPool(const int32 PoolIndex)
+			: PoolSize(GetPoolSize(PoolIndex))
+		{
+		}
+
+		int64 Allocate(FVoxelBufferAllocator& Allocator);
+		void Free(int64 Index);
+
+	private:
+		FVoxelCriticalSection_NoPadding CriticalSection;
+		TVoxelArray<int64> FreeIndices_RequiresLock;
+	};
+
+	FVoxelCriticalSection PoolIndexToPool_CriticalSection;
+	TVoxelArray<FAllocationPool> PoolIndexToPool_RequiresLock;
+
+	void Free(int32 PoolIndex, int64 Index);
+
+	FORCEINLINE static int32 NumToPoolIndex(const int64 Num)
+	{
+		const int32 PoolIndex = INLINE_LAMBDA -> int32
+		{
+			// 0 <= PoolIndex <= 10
+			if (Num <= 1024)
+			{
+				return FMath::CeilLogTwo(Num);
+			}
+
+			if (Num <= 64 * 1024)
+			{
+				// 11 <= PoolIndex <= 73
+				return 10 + FVoxelUtilities::DivideCeil_Positive<int64>(Num, 1024) - 1;
+			}
+
+			// 74 <= PoolIndex
+			// Some pools will be empty but it makes the math easier
+			return 74 + FMath::CeilLogTwo(Num);
+		};
+		checkVoxelSlow(PoolIndex == 0 || GetPoolSize(PoolIndex - 1) < Num);
+		checkVoxelSlow(Num <= GetPoolSize(PoolIndex));
+
+		return PoolIndex;
+	}
+	FORCEINLINE static int64 GetPoolSize(const int32 PoolIndex)
+	{
+		checkVoxelSlow(PoolIndex >= 0);
+
+		if (PoolIndex <= 10)
+		{
+			return int64(1) << PoolIndex;
+		}
+
+		if (PoolIndex <= 73)
+		{
+			return (PoolIndex - 10 + 1) * 1024;
+		}
+
+		return int64(1) << (PoolIndex - 74);
+	}
+
+	friend FVoxelBufferRef;
+};
+
+class VOXELCORE_API FVoxelBufferRef : public TVoxelRefCountBase<FVoxelBufferRef>
 {
 public:
 	FVoxelBufferRef(
-		FVoxelBufferPoolBase& Pool,
+		FVoxelBufferAllocator& Allocator,
 		int32 PoolIndex,
 		int64 Index,
 		int64 Num);
@@ -31,7 +116,7 @@ public:
 	}
 
 private:
-	const TWeakPtr<FVoxelBufferPoolBase> WeakPool;
+	const TVoxelIntrusiveRef<FVoxelBufferAllocator> Allocator;
 	const int32 PoolIndex;
 	const int64 Index;
 	const int64 PrivateNum;
@@ -41,6 +126,10 @@ private:
 	friend FVoxelTextureBufferPool;
 };
 
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
 class VOXELCORE_API FVoxelBufferPoolBase : public TSharedFromThis<FVoxelBufferPoolBase>
 {
 public:
@@ -61,11 +150,11 @@ public:
 	}
 	FORCEINLINE int64 GetUsedMemory() const
 	{
-		return UsedMemory.Get();
+		return Allocator->UsedMemory.Get();
 	}
 	FORCEINLINE int64 GetPaddingMemory() const
 	{
-		return PaddingMemory.Get();
+		return Allocator->PaddingMemory.Get();
 	}
 
 protected:
@@ -73,9 +162,10 @@ protected:
 	const FName UsedMemory_Name;
 	const FName PaddingMemory_Name;
 
+	const TVoxelIntrusiveRef<FVoxelBufferAllocator> Allocator;
+
 	FVoxelCounter64 AllocatedMemory;
-	FVoxelCounter64 UsedMemory;
-	FVoxelCounter64 PaddingMemory;
+	FDelegateHandle MemoryBudgetHandle;
 
 	FVoxelCounter64 AllocatedMemory_Reported;
 	FVoxelCounter64 UsedMemory_Reported;
@@ -84,17 +174,19 @@ protected:
 	void UpdateStats();
 
 public:
-	TSharedRef<FVoxelBufferRef> Allocate_AnyThread(int64 Num);
+	TVoxelIntrusiveRef<FVoxelBufferRef> Allocate_AnyThread(int64 Num);
 
-	TVoxelFuture<FVoxelBufferRef> Upload_AnyThread(
+	// The returned future completes once the data is uploaded
+	// BufferRef must be allocated from this pool with Allocate_AnyThread and its size must match Data
+	FVoxelFuture Upload_AnyThread(
 		const FSharedVoidPtr& Owner,
 		TConstVoxelArrayView64<uint8> Data,
-		const TSharedPtr<FVoxelBufferRef>& ExistingBufferRef = nullptr);
+		const TVoxelIntrusiveRef<FVoxelBufferRef>& BufferRef);
 
 	template<typename T>
-	TVoxelFuture<FVoxelBufferRef> Upload_AnyThread(
+	FVoxelFuture Upload_AnyThread(
 		TVoxelArray<T> Data,
-		const TSharedPtr<FVoxelBufferRef>& ExistingBufferRef = nullptr)
+		const TVoxelIntrusiveRef<FVoxelBufferRef>& BufferRef)
 	{
 		check(sizeof(T) == BytesPerElement);
 
@@ -103,84 +195,17 @@ public:
 		return this->Upload_AnyThread(
 			MakeSharedVoidRef(SharedData),
 			MakeByteVoxelArrayView(*SharedData),
-			ExistingBufferRef);
+			BufferRef);
 	}
 
-protected:
-	struct FAllocationPool
-	{
-	public:
-		const int64 PoolSize;
-
-		explicit FAllocationPool(const int32 PoolIndex)
-			: PoolSize(GetPoolSize(PoolIndex))
-		{
-		}
-
-		int64 Allocate(FVoxelBufferPoolBase& Pool);
-		void Free(int64 Index);
-
-	private:
-		FVoxelCriticalSection_NoPadding CriticalSection;
-		TVoxelArray<int64> FreeIndices_RequiresLock;
-	};
-
-	FORCEINLINE static int32 NumToPoolIndex(const int64 Num)
-	{
-		const int32 PoolIndex = INLINE_LAMBDA -> int32
-		{
-			// 0 <= PoolIndex <= 10
-			if (Num <= 1024)
-			{
-				return FMath::CeilLogTwo(Num);
-			}
-
-			if (Num <= 64 * 1024)
-			{
-				// 11 <= PoolIndex <= 73
-				return 10 + FVoxelUtilities::DivideCeil_Positive<int64>(Num, 1024) - 1;
-			}
-
-			// 74 <= PoolIndex
-			// Some pools will be empty but it makes the math easier
-			return 74 + FMath::CeilLogTwo(Num);
-		};
-		checkVoxelSlow(PoolIndex == 0 || GetPoolSize(PoolIndex - 1) < Num);
-		checkVoxelSlow(Num <= GetPoolSize(PoolIndex));
-
-		return PoolIndex;
-	}
-	FORCEINLINE static int64 GetPoolSize(const int32 PoolIndex)
-	{
-		checkVoxelSlow(PoolIndex >= 0);
-
-		if (PoolIndex <= 10)
-		{
-			return int64(1) << PoolIndex;
-		}
-
-		if (PoolIndex <= 73)
-		{
-			return (PoolIndex - 10 + 1) * 1024;
-		}
-
-		return int64(1) << (PoolIndex - 74);
-	}
-
-	FVoxelCounter64 BufferCount;
-
-	FVoxelCriticalSection PoolIndexToPool_CriticalSection;
-	TVoxelArray<FAllocationPool> PoolIndexToPool_RequiresLock;
-
-	friend FVoxelBufferRef;
-
 protected:
 	struct FUpload
 	{
 		FSharedVoidPtr Owner;
 		TConstVoxelArrayView64<uint8> Data;
-		TSharedPtr<FVoxelBufferRef> BufferRef;
-		TSharedPtr<TVoxelPromise<FVoxelBufferRef>> BufferRefPromise;
+		TVoxelRefCountPtr<FVoxelBufferRef> BufferRef;
+		// TQueue default constructs its elements, don't allocate a promise state for them
+		TOptional<FVoxelPromise> Promise;
 
 		FORCEINLINE int64 NumBytes() const
 		{
@@ -231,8 +256,8 @@ private:
 private:
 	struct FCopyInfo
 	{
-		TSharedPtr<FVoxelBufferRef> BufferRef;
-		TSharedPtr<TVoxelPromise<FVoxelBufferRef>> BufferRefPromise;
+		TVoxelRefCountPtr<FVoxelBufferRef> BufferRef;
+		FVoxelPromise Promise;
 		FBufferRHIRef SourceBuffer;
 		int64 SourceOffset = 0;
 	};
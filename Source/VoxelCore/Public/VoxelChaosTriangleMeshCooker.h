@@ -4,6 +4,8 @@
 
 #include "VoxelMinimal.h"
 
+DECLARE_VOXEL_MEMORY_STAT(VOXELCORE_API, STAT_VoxelCollisionCookCache, "Collision Cook Cache");
+
 struct VOXELCORE_API FVoxelChaosTriangleMeshCooker
 {
 	static TRefCountPtr<Chaos::FTriangleMeshImplicitObject> Create(
@@ -12,4 +14,7 @@ struct VOXELCORE_API FVoxelChaosTriangleMeshCooker
 		TConstVoxelArrayView<uint16> FaceMaterials);
 
 	static int64 GetAllocatedSize(const Chaos::FTriangleMeshImplicitObject& TriangleMesh);
+
+	// Meshes returned by Create can be shared with other identical meshes, and must not be modified
+	static void ClearCache();
 };
\ No newline at end of file
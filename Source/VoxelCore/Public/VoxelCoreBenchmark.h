@@ -24,4 +24,9 @@ private:
 	static void RunInnerBenchmark(
 		int32 NumRuns,
 		LambdaType Lambda);
+
+	// Average number of heap allocations made by Lambda on the calling thread
+	static double CountAllocations(
+		int32 NumRuns,
+		TFunctionRef<void()> Lambda);
 };
\ No newline at end of file
@@ -13,14 +13,19 @@ public:
 	class VOXELCORE_API FMip
 	{
 	public:
+		FMip() = default;
+		~FMip();
+		UE_NONCOPYABLE(FMip);
+
 		void Initialize(const FVoxelDistanceFieldWrapper& Wrapper);
 
+		// Thread safe and lock free as long as threads write to distinct positions
 		FBrick* FindBrick(const FIntVector& Position);
 		FBrick& FindOrAddBrick(const FIntVector& Position);
 
 		void AddBrick(
 			const FIntVector& Position,
-			const TSharedRef<FBrick>& Brick);
+			FBrick&& Brick);
 
 		FORCEINLINE uint8 QuantizeDistance(const float Distance) const
 		{
@@ -34,17 +39,45 @@ public:
 		}
 
 	private:
+		static constexpr int32 NumBricksPerChunk = 64;
+		// Brick index of a cell while its brick is being allocated
+		static constexpr int32 PendingBrickIndex = -2;
+
+		using FBrickChunk = TVoxelStaticArray<FBrick, NumBricksPerChunk>;
+
 		float LocalToVolumeScale = 0.f;
 		FVector2D DistanceFieldToVolumeScaleBias = FVector2D::ZeroVector;
 		FIntVector IndirectionSize = FIntVector::ZeroValue;
-		TVoxelArray<TSharedPtr<FBrick>> Bricks;
+		// Brick index of each indirection cell, -1 if there's no brick
+		// Claimed with a compare exchange by the thread allocating the brick, then published with release semantics
+		TVoxelArray<TVoxelAtomic<int32>> BrickIndices;
+		FVoxelCounter32 NumBricks;
+		// One chunk every NumBricksPerChunk bricks, enough for a brick in every indirection cell
+		// Chunks are allocated on demand and never moved, so that references returned by FindOrAddBrick stay valid
+		TVoxelArray<TVoxelAtomic<FBrickChunk*>> BrickChunks;
+
+		void Reset(int32 NumCells);
+		int32 AllocateBrick();
+
+		FORCEINLINE FBrick& GetBrick(const int32 BrickIndex) const
+		{
+			checkVoxelSlow(0 <= BrickIndex && BrickIndex < NumBricks.Get());
+
+			FBrickChunk* Chunk = BrickChunks[BrickIndex / NumBricksPerChunk].Get(std::memory_order_acquire);
+			checkVoxelSlow(Chunk);
+			return (*Chunk)[BrickIndex % NumBricksPerChunk];
+		}
+
+		void Build(
+			TVoxelArray<uint32>& OutIndirectionTable,
+			TVoxelArray<uint8>& OutBrickData) const;
 
 		friend class FVoxelDistanceFieldWrapper;
 	};
 
 	const FBox LocalSpaceMeshBounds;
 
-	TVoxelStaticArray<FMip, DistanceField::NumMips> Mips{ ForceInit };
+	TVoxelStaticArray<FMip, DistanceField::NumMips> Mips;
 
 	explicit FVoxelDistanceFieldWrapper(
 		const FBox& LocalSpaceMeshBounds)
@@ -53,5 +86,12 @@ public:
 	}
 
 	void SetSize(const FIntVector& Mip0IndirectionSize);
-	TSharedRef<FDistanceFieldVolumeData> Build() const;
+
+	// If FileCacheKey is set, the result is persisted in FVoxelFileCache and can be loaded by LoadFromFileCache in the next sessions
+	// FileCacheKey should hash everything the bricks are computed from
+	TSharedRef<FDistanceFieldVolumeData> Build(const TOptional<FVoxelHash>& FileCacheKey = {}) const;
+
+	// Call before computing the bricks: that's the expensive part, Build itself is mostly copies
+	// Returns null if FileCacheKey isn't cached
+	static TSharedPtr<FDistanceFieldVolumeData> LoadFromFileCache(const FVoxelHash& FileCacheKey);
 };
\ No newline at end of file
@@ -0,0 +1,109 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#pragma once
+
+#include "VoxelMinimal.h"
+
+// Persistent content-addressed cache of blobs, used to skip recomputing expensive data on cold starts
+// Entries are written to a temp file and then renamed, so readers never see partial files
+// The LRU index is kept in memory and persisted as a snapshot plus an append-only journal,
+// so startup only lists the directory and stats the files missing from the index
+// Only index updates are done under lock: loads and stores can run concurrently
+class VOXELCORE_API FVoxelFileCache
+{
+public:
+	// Shared cache in FVoxelUtilities::GetAppDataCache(), size set by voxel.FileCache.MaxSizeMB
+	static FVoxelFileCache& Get();
+
+	FVoxelFileCache(
+		const FString& Directory,
+		int64 MaxSize);
+	~FVoxelFileCache();
+	UE_NONCOPYABLE(FVoxelFileCache);
+
+	bool Load(const FVoxelHash& Key, TVoxelArray64<uint8>& OutData);
+	// No-op if Key is already cached
+	void Store(const FVoxelHash& Key, TConstVoxelArrayView64<uint8> Data);
+	void Remove(const FVoxelHash& Key);
+
+	// Delete all the entries
+	void Clear();
+	// Persist pending index updates
+	void Flush();
+
+	void SetMaxSize(int64 NewMaxSize);
+	int64 GetMaxSize() const;
+	int64 GetTotalSize() const;
+	int32 NumEntries() const;
+
+private:
+	struct FEntry
+	{
+		int64 Size = 0;
+		int64 LastAccessTime = 0;
+	};
+	// Size is -1 for removed entries
+	struct FRecord
+	{
+		FVoxelHash Key;
+		int64 Size = 0;
+		int64 LastAccessTime = 0;
+
+		static constexpr int64 SerializedSize = 20 + sizeof(int64) + sizeof(int64);
+
+		friend FArchive& operator<<(FArchive& Ar, FRecord& Record)
+		{
+			Ar << Record.Key;
+			Ar << Record.Size;
+			Ar << Record.LastAccessTime;
+			return Ar;
+		}
+	};
+	struct FIndexHeader
+	{
+		uint64 Tag = MAKE_TAG_64("VOXEL_FC");
+		int32 Version = 2;
+		int32 NumRecords = 0;
+
+		static constexpr int64 SerializedSize = sizeof(uint64) + sizeof(int32) + sizeof(int32);
+
+		friend FArchive& operator<<(FArchive& Ar, FIndexHeader& Header)
+		{
+			Ar << Header.Tag;
+			Ar << Header.Version;
+			Ar << Header.NumRecords;
+			return Ar;
+		}
+	};
+
+	const FString Directory;
+	FVoxelCounter64 MaxSize;
+	FVoxelCounter32 IsEnforcingSize;
+
+	mutable FVoxelCriticalSection CriticalSection;
+	TVoxelMap<FVoxelHash, FEntry> Entries_RequiresLock;
+	TVoxelArray<FRecord> PendingRecords_RequiresLock;
+	int64 TotalSize_RequiresLock = 0;
+
+	// Serializes writes to the index files, held during file IO
+	// Always locked before CriticalSection
+	FVoxelCriticalSection IndexCriticalSection;
+	int32 NumJournalRecords_RequiresLock = 0;
+
+	FString GetEntryPath(const FVoxelHash& Key) const;
+	FString GetIndexPath() const;
+	FString GetJournalPath() const;
+
+	void LoadIndex();
+	// Add the files missing from the index and remove the entries missing from the directory
+	// Returns true if the index changed
+	bool ReconcileIndex();
+	void WriteSnapshot();
+
+	void SetEntry_RequiresLock(const FVoxelHash& Key, const FEntry& Entry);
+	void RemoveEntry_RequiresLock(const FVoxelHash& Key);
+
+	// Delete the least recently used entries if needed and flush the index, in the background
+	void EnforceSizeAsync();
+	void EnforceSize();
+};
\ No newline at end of file
@@ -4,6 +4,17 @@
 
 #include "VoxelMinimal.h"
 
+struct FVoxelHeightmapTile
+{
+	// In pixels
+	FIntPoint Start{ ForceInit };
+	FIntPoint Size{ ForceInit };
+	// Size.X * Size.Y row-major pixels, 1 or 2 bytes each depending on BitDepth
+	TVoxelArray<uint8> Data;
+	int32 Min = 0;
+	int32 Max = 0;
+};
+
 class VOXELCORE_API FVoxelHeightmapImporter
 {
 public:
@@ -13,16 +24,44 @@ public:
 	int32 BitDepth = 0;
 	TArray64<uint8> Data;
 
+	// Called as soon as a tile is ready, possibly from several threads at once
+	using FOnTile = TFunction<void(FVoxelHeightmapTile&& Tile)>;
+
 	explicit FVoxelHeightmapImporter(const FString& Path)
 		: Path(Path)
 	{
 	}
 	virtual ~FVoxelHeightmapImporter() = default;
 
-	virtual bool Import() = 0;
+	// Only reads enough of the file to set Size and BitDepth
+	virtual bool ReadHeader() = 0;
+	// Stream the file as TileSize x TileSize tiles without ever loading it entirely
+	// Size and BitDepth are set before the first tile is emitted
+	virtual bool ImportTiles(int32 TileSize, const FOnTile& OnTile) = 0;
+
+	// Import the whole file into Data
+	bool Import();
 
 	static TSharedPtr<FVoxelHeightmapImporter> MakeImporter(const FString& Path);
 	static bool Import(const FString& Path, FString& OutError, FIntPoint& OutSize, int32& OutBitDepth, TArray64<uint8>& OutData);
+
+protected:
+	int32 GetBytesPerPixel() const
+	{
+		checkVoxelSlow(BitDepth == 8 || BitDepth == 16);
+		return BitDepth / 8;
+	}
+
+	// Split a band of full rows into tiles and emit them in parallel
+	// BandData is row-major, Size.X pixels per row
+	// If bSwapBytes, 16 bit pixels are converted from big-endian when copied into the tiles
+	void EmitBandTiles(
+		int32 TileSize,
+		int32 StartY,
+		int32 NumRows,
+		TConstVoxelArrayView<uint8> BandData,
+		bool bSwapBytes,
+		const FOnTile& OnTile) const;
 };
 
 class VOXELCORE_API FVoxelHeightmapImporter_PNG : public FVoxelHeightmapImporter
@@ -30,7 +69,14 @@ class VOXELCORE_API FVoxelHeightmapImporter_PNG : public FVoxelHeightmapImporter
 public:
 	using FVoxelHeightmapImporter::FVoxelHeightmapImporter;
 
-	virtual bool Import() override;
+	//~ Begin FVoxelHeightmapImporter Interface
+	virtual bool ReadHeader() override;
+	virtual bool ImportTiles(int32 TileSize, const FOnTile& OnTile) override;
+	//~ End FVoxelHeightmapImporter Interface
+
+private:
+	// Interlaced pngs can't be decoded row by row
+	bool ImportTiles_ImageWrapper(int32 TileSize, const FOnTile& OnTile);
 };
 
 class VOXELCORE_API FVoxelHeightmapImporter_Raw : public FVoxelHeightmapImporter
@@ -38,5 +84,8 @@ class VOXELCORE_API FVoxelHeightmapImporter_Raw : public FVoxelHeightmapImporter
 public:
 	using FVoxelHeightmapImporter::FVoxelHeightmapImporter;
 
-	virtual bool Import() override;
+	//~ Begin FVoxelHeightmapImporter Interface
+	virtual bool ReadHeader() override;
+	virtual bool ImportTiles(int32 TileSize, const FOnTile& OnTile) override;
+	//~ End FVoxelHeightmapImporter Interface
 };
\ No newline at end of file
@@ -0,0 +1,100 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#pragma once
+
+#include "VoxelMinimal.h"
+
+// Tracks the chunks overlapped by a set of invokers across updates
+// Invokers are rasterized per Z slab into X runs, and the new runs are diffed against the previous ones
+// so that only the chunks that actually changed are returned
+class VOXELCORE_API FVoxelInvokerChunkTracker
+{
+public:
+	FVoxelInvokerChunkTracker() = default;
+
+	// Returns false if the invokers cover more than MaxNumChunks chunks
+	// In that case the tracked chunks are left unchanged and nothing is added or removed
+	bool Update(
+		TConstVoxelArrayView<FSphere> Invokers,
+		const FMatrix& LocalToWorld,
+		double ChunkSize,
+		int32 MaxNumChunks,
+		TVoxelArray<FIntVector>& OutAddedChunks,
+		TVoxelArray<FIntVector>& OutRemovedChunks);
+
+	// Forget all tracked chunks, the next update will add all its chunks
+	void Reset();
+
+public:
+	FORCEINLINE int64 NumChunks() const
+	{
+		return PrivateNumChunks;
+	}
+
+	bool Contains(const FIntVector& Chunk) const;
+	void GetChunks(TVoxelSet<FIntVector>& OutChunks) const;
+
+	template<typename LambdaType>
+	void ForeachChunk(LambdaType&& Lambda) const
+	{
+		for (const FRun& Run : Runs)
+		{
+			for (int32 X = Run.MinX; X <= Run.MaxX; X++)
+			{
+				Lambda(FIntVector(X, Run.Y, Run.Z));
+			}
+		}
+	}
+
+private:
+	struct FChunkedInvoker
+	{
+		FVector Center;
+		double RadiusInChunks = 0;
+
+		FORCEINLINE bool operator==(const FChunkedInvoker& Other) const
+		{
+			return
+				Center == Other.Center &&
+				RadiusInChunks == Other.RadiusInChunks;
+		}
+	};
+
+	// Inclusive range of chunks along X
+	struct FRun
+	{
+		int32 Y = 0;
+		int32 Z = 0;
+		int32 MinX = 0;
+		int32 MaxX = 0;
+
+		FORCEINLINE int64 GetRowKey() const
+		{
+			return (int64(Z) << 32) | uint32(Y);
+		}
+		FORCEINLINE int32 Num() const
+		{
+			return MaxX - MinX + 1;
+		}
+	};
+
+	TVoxelArray<FChunkedInvoker> LastInvokers;
+	// Sorted by row then MinX, non-overlapping and non-adjacent within a row
+	TVoxelArray<FRun> Runs;
+	int64 PrivateNumChunks = 0;
+
+	static void RemoveContainedInvokers(TVoxelArray<FChunkedInvoker>& Invokers);
+
+	static bool RasterizeInvoker(
+		const FChunkedInvoker& Invoker,
+		int32 MaxNumChunks,
+		TVoxelArray<FRun>& OutRuns);
+
+	static int64 SortAndMergeRuns(TVoxelArray<FRun>& InOutRuns);
+
+	template<typename LambdaType>
+	static void SubtractRuns(
+		TConstVoxelArrayView<FRun> Runs,
+		TConstVoxelArrayView<FRun> RunsToSubtract,
+		LambdaType&& Lambda);
+};
@@ -7,14 +7,17 @@
 struct VOXELCORE_API FVoxelJumpFlood
 {
 public:
-	static void JumpFlood2D(
+	// Returns false if the current task was cancelled, in which case InOutClosestPosition is partially flooded
+	// and must be discarded
+	static bool JumpFlood2D(
 		const FIntPoint& Size,
 		TVoxelArrayView<FIntPoint> InOutClosestPosition);
 
 private:
-	static void JumpFlood2DImpl(
+	static bool JumpFlood2DImpl(
 		const FIntPoint& Size,
 		TConstVoxelArrayView<FIntPoint> InData,
 		TVoxelArrayView<FIntPoint> OutData,
-		int32 Step);
+		int32 Step,
+		const FVoxelCancellationToken& CancellationToken);
 };
\ No newline at end of file
@@ -0,0 +1,146 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#pragma once
+
+#include "VoxelMinimal.h"
+
+// Log-linear histogram of durations in microseconds
+// Values below 8us are exact, above that each power of two is split in 8 linear buckets (12.5% max relative error)
+// Add is a single relaxed atomic increment and can be called from any thread
+class FVoxelLatencyHistogram
+{
+public:
+	static constexpr int32 NumSubBucketsLog2 = 3;
+	static constexpr int32 NumSubBuckets = 1 << NumSubBucketsLog2;
+	// Values are clamped to 2^32us, ~71 minutes
+	static constexpr int32 NumBuckets = NumSubBuckets + (32 - NumSubBucketsLog2) * NumSubBuckets;
+
+	FVoxelLatencyHistogram() = default;
+
+	FORCEINLINE static int32 GetBucket(uint64 Microseconds)
+	{
+		Microseconds = FMath::Min<uint64>(Microseconds, MAX_uint32);
+
+		if (Microseconds < NumSubBuckets)
+		{
+			return int32(Microseconds);
+		}
+
+		const int32 Exponent = FMath::FloorLog2_64(Microseconds);
+		const int32 Shift = Exponent - NumSubBucketsLog2;
+		const int32 SubBucket = int32(Microseconds >> Shift) - NumSubBuckets;
+
+		const int32 Bucket = NumSubBuckets + Shift * NumSubBuckets + SubBucket;
+		checkVoxelSlow(0 <= Bucket && Bucket < NumBuckets);
+		return Bucket;
+	}
+	// Inclusive min, exclusive max
+	static void GetBucketRange(
+		const int32 Bucket,
+		uint64& OutMin,
+		uint64& OutMax)
+	{
+		checkVoxelSlow(0 <= Bucket && Bucket < NumBuckets);
+
+		if (Bucket < NumSubBuckets)
+		{
+			OutMin = Bucket;
+			OutMax = Bucket + 1;
+			return;
+		}
+
+		const int32 Shift = (Bucket - NumSubBuckets) / NumSubBuckets;
+		const int32 SubBucket = (Bucket - NumSubBuckets) % NumSubBuckets;
+
+		OutMin = uint64(NumSubBuckets + SubBucket) << Shift;
+		OutMax = OutMin + (uint64(1) << Shift);
+	}
+
+public:
+	FORCEINLINE void Add(const uint64 Microseconds)
+	{
+		Buckets[GetBucket(Microseconds)].Increment(std::memory_order_relaxed);
+	}
+	void Reset()
+	{
+		for (FVoxelCounter32& Bucket : Buckets)
+		{
+			Bucket.Set(0, std::memory_order_relaxed);
+		}
+	}
+	void Append(const FVoxelLatencyHistogram& Other)
+	{
+		for (int32 Index = 0; Index < NumBuckets; Index++)
+		{
+			const int32 Count = Other.Buckets[Index].Get(std::memory_order_relaxed);
+			if (Count != 0)
+			{
+				Buckets[Index].Add(Count, std::memory_order_relaxed);
+			}
+		}
+	}
+	// Values added since Previous was copied from this histogram
+	// Buckets that went down, eg after a Reset, are considered empty
+	FVoxelLatencyHistogram GetDelta(const FVoxelLatencyHistogram& Previous) const
+	{
+		FVoxelLatencyHistogram Result;
+		for (int32 Index = 0; Index < NumBuckets; Index++)
+		{
+			Result.Buckets[Index].Set(
+				FMath::Max(0, Buckets[Index].Get(std::memory_order_relaxed) - Previous.Buckets[Index].Get(std::memory_order_relaxed)),
+				std::memory_order_relaxed);
+		}
+		return Result;
+	}
+
+	int64 Num() const
+	{
+		int64 Result = 0;
+		for (const FVoxelCounter32& Bucket : Buckets)
+		{
+			Result += Bucket.Get(std::memory_order_relaxed);
+		}
+		return Result;
+	}
+
+	// Percentile is between 0 and 1
+	// Returns the middle of the bucket the percentile falls in, 0 if empty
+	// Not a snapshot: values added concurrently might or might not be taken into account
+	double GetPercentile(const double Percentile) const
+	{
+		int32 Counts[NumBuckets];
+		int64 Total = 0;
+		for (int32 Index = 0; Index < NumBuckets; Index++)
+		{
+			Counts[Index] = Buckets[Index].Get(std::memory_order_relaxed);
+			Total += Counts[Index];
+		}
+
+		if (Total == 0)
+		{
+			return 0.;
+		}
+
+		const int64 Target = FMath::Clamp<int64>(FMath::CeilToInt64(Percentile * Total), 1, Total);
+
+		int64 Sum = 0;
+		for (int32 Index = 0; Index < NumBuckets; Index++)
+		{
+			Sum += Counts[Index];
+
+			if (Sum >= Target)
+			{
+				uint64 Min;
+				uint64 Max;
+				GetBucketRange(Index, Min, Max);
+				return (Min + Max - 1) / 2.;
+			}
+		}
+
+		ensureVoxelSlow(false);
+		return 0.;
+	}
+
+private:
+	FVoxelCounter32 Buckets[NumBuckets];
+};
@@ -0,0 +1,109 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#pragma once
+
+#include "VoxelMinimal.h"
+
+// Central memory budget acting on the memory reported by the different voxel systems
+// Systems register cost providers reporting their usage and evictors freeing memory, both tied to a named budget
+// Usage is polled in Tick_Async: when a budget or the total is above its soft limit, evictors are called
+// by increasing priority until usage is back under the soft limit
+// Producers should check GetHeadroom before allocating and throttle when it reaches zero
+// Built-in budgets: ChunkPool (free TVoxelChunkedArray chunks, stops retaining them when out of headroom)
+// and BufferPool (GPU memory handed out by the FVoxelBufferPoolBase pools)
+class VOXELCORE_API FVoxelMemoryBudget : public FVoxelSingleton
+{
+public:
+	virtual ~FVoxelMemoryBudget() override;
+
+	// Returns the memory used, in bytes. Called from a background thread
+	using FCostProvider = TFunction<int64()>;
+	// Should free at least BytesToFree bytes if possible, returns the number of bytes freed. Called from a background thread
+	using FEvictor = TFunction<int64(int64 BytesToFree)>;
+
+	FDelegateHandle AddCostProvider(
+		FName Budget,
+		FCostProvider CostProvider);
+
+	// Evictors with the lowest priority are called first, typically caches that are cheap to rebuild
+	FDelegateHandle AddEvictor(
+		FName Budget,
+		int32 Priority,
+		FEvictor Evictor);
+
+	void Remove(FDelegateHandle Handle);
+
+	// 0 means unlimited. The total limits are set by voxel.MemoryBudget.SoftLimitMB and voxel.MemoryBudget.HardLimitMB
+	void SetLimits(
+		FName Budget,
+		int64 SoftLimit,
+		int64 HardLimit);
+
+public:
+	// Usage as of the last update
+	int64 GetUsage(FName Budget) const;
+	int64 GetTotalUsage() const;
+
+	// Bytes that can still be allocated in this budget before reaching its hard limit or the total hard limit
+	// MAX_int64 if unlimited, can be negative if over budget
+	int64 GetHeadroom(FName Budget) const;
+
+	FORCEINLINE bool CanAllocate(const FName Budget, const int64 Size) const
+	{
+		return GetHeadroom(Budget) >= Size;
+	}
+
+	// Poll the cost providers and run evictors if needed, on the calling thread
+	void Update();
+	void LogUsage() const;
+
+public:
+	//~ Begin FVoxelSingleton Interface
+	virtual void Initialize() override;
+	virtual void Tick_Async() override;
+	virtual bool HasTickAsync() const override
+	{
+		return true;
+	}
+	//~ End FVoxelSingleton Interface
+
+private:
+	struct FBudget
+	{
+		FVoxelCounter64 SoftLimit;
+		FVoxelCounter64 HardLimit;
+		FVoxelCounter64 Usage;
+	};
+	struct FCostProviderInfo
+	{
+		FDelegateHandle Handle;
+		FName Budget;
+		TSharedPtr<FCostProvider> CostProvider;
+	};
+	struct FEvictorInfo
+	{
+		FDelegateHandle Handle;
+		FName Budget;
+		int32 Priority = 0;
+		TSharedPtr<FEvictor> Evictor;
+	};
+
+	FVoxelCounter64 TotalUsage;
+	FVoxelCounter32 IsUpdating;
+	double LastUpdateTime = 0;
+
+	mutable FVoxelCriticalSection CriticalSection;
+	TVoxelMap<FName, TSharedPtr<FBudget>> Budgets_RequiresLock;
+	TVoxelArray<FCostProviderInfo> CostProviders_RequiresLock;
+	// Sorted by priority
+	TVoxelArray<FEvictorInfo> Evictors_RequiresLock;
+
+	FBudget& FindOrAddBudget_RequiresLock(FName Budget);
+
+	// Returns the number of bytes freed
+	static int64 Evict(
+		TConstVoxelArrayView<FEvictorInfo> Evictors,
+		int64 BytesToFree);
+};
+// Null once destroyed
+extern VOXELCORE_API FVoxelMemoryBudget* GVoxelMemoryBudget;
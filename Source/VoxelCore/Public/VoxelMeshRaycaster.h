@@ -0,0 +1,89 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#pragma once
+
+#include "VoxelMinimal.h"
+#include "VoxelFastAABBTree.h"
+
+struct FVoxelMeshRaycastHit
+{
+	int32 TriangleIndex = -1;
+	float Distance = 0.f;
+	// Weights of the triangle vertices
+	FVector3f Barycentrics = FVector3f(ForceInit);
+
+	FORCEINLINE bool IsValid() const
+	{
+		return TriangleIndex != -1;
+	}
+};
+
+// CPU raycasts against a triangle mesh, for picking, AO baking or line of sight checks
+// Triangles are stored SoA in the leaves of a FVoxelFastAABBTree and are intersected a full ISPC register at a time
+// Immutable once initialized, queries are thread-safe
+class VOXELCORE_API FVoxelMeshRaycaster
+{
+public:
+	FVoxelMeshRaycaster() = default;
+
+	// Indices is a triangle list
+	void Initialize(
+		TConstVoxelArrayView<FVector3f> Vertices,
+		TConstVoxelArrayView<int32> Indices);
+
+	int64 GetAllocatedSize() const;
+
+	FORCEINLINE int32 NumTriangles() const
+	{
+		return TriangleIndices.Num();
+	}
+
+public:
+	// Direction must be normalized. Triangles are hit from both sides
+	bool Raycast(
+		const FVector3f& Origin,
+		const FVector3f& Direction,
+		float MaxDistance,
+		FVoxelMeshRaycastHit& OutHit) const;
+
+	// Faster than Raycast as it stops at the first triangle hit
+	bool AnyHit(
+		const FVector3f& Origin,
+		const FVector3f& Direction,
+		float MaxDistance) const;
+
+	// Rays are split across threads
+	void RaycastBulk(
+		TConstVoxelArrayView<FVector3f> Origins,
+		TConstVoxelArrayView<FVector3f> Directions,
+		float MaxDistance,
+		TVoxelArrayView<FVoxelMeshRaycastHit> OutHits) const;
+
+	void AnyHitBulk(
+		TConstVoxelArrayView<FVector3f> Origins,
+		TConstVoxelArrayView<FVector3f> Directions,
+		float MaxDistance,
+		TVoxelArrayView<bool> OutHits) const;
+
+private:
+	struct FLeaf
+	{
+		// Index in TriangleIndices, triangle data is at 12 * Start in TriangleData
+		int32 Start = 0;
+		int32 Num = 0;
+	};
+
+	TVoxelArray<FVoxelFastAABBTree::FNode> Nodes;
+	TVoxelArray<FLeaf> Leaves;
+	// Leaf by leaf: A.X, A.Y, A.Z, Edge1.X, ..., Edge2.X, ..., Normal.X, ... each as Leaf.Num floats
+	TVoxelArray<float> TriangleData;
+	// Original index of the triangles, in leaf order
+	TVoxelArray<int32> TriangleIndices;
+
+	template<bool bAnyHit>
+	bool Trace(
+		const FVector3f& Origin,
+		const FVector3f& Direction,
+		float MaxDistance,
+		FVoxelMeshRaycastHit& OutHit) const;
+};
@@ -36,12 +36,15 @@
 #include "VoxelCoreMinimal.h"
 
 #include "VoxelMinimal/VoxelArchive.h"
+#include "VoxelMinimal/VoxelArenaAllocator.h"
 #include "VoxelMinimal/VoxelAtomic.h"
 #include "VoxelMinimal/VoxelAutoFactoryInterface.h"
 #include "VoxelMinimal/VoxelAxis.h"
+#include "VoxelMinimal/VoxelBitReader.h"
 #include "VoxelMinimal/VoxelBitWriter.h"
 #include "VoxelMinimal/VoxelBox.h"
 #include "VoxelMinimal/VoxelBox2D.h"
+#include "VoxelMinimal/VoxelCancellationToken.h"
 #include "VoxelMinimal/VoxelChunkedRef.h"
 #include "VoxelMinimal/VoxelColor3.h"
 #include "VoxelMinimal/VoxelCriticalSection.h"
@@ -100,6 +103,7 @@
 #include "VoxelMinimal/Utilities/VoxelMathUtilities.h"
 #include "VoxelMinimal/Utilities/VoxelObjectUtilities.h"
 #include "VoxelMinimal/Utilities/VoxelRenderUtilities.h"
+#include "VoxelMinimal/Utilities/VoxelSortUtilities.h"
 #include "VoxelMinimal/Utilities/VoxelStringUtilities.h"
 #include "VoxelMinimal/Utilities/VoxelSystemUtilities.h"
 #include "VoxelMinimal/Utilities/VoxelTextureUtilities.h"
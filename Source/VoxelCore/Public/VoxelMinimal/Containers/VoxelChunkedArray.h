@@ -3,6 +3,7 @@
 #pragma once
 
 #include "VoxelCoreMinimal.h"
+#include "VoxelMinimal/VoxelCriticalSection.h"
 #include "VoxelMinimal/Containers/VoxelArray.h"
 #include "VoxelMinimal/Containers/VoxelStaticArray.h"
 #include "VoxelMinimal/Utilities/VoxelMathUtilities.h"
@@ -12,6 +13,44 @@
 // Matches FVoxelBufferStorage's chunk size for float/int32
 constexpr int32 GVoxelDefaultAllocationSize = 1 << 14;
 
+DECLARE_VOXEL_MEMORY_STAT(VOXELCORE_API, STAT_VoxelChunkPoolMemory, "Chunk Pool Memory");
+
+extern VOXELCORE_API bool GVoxelChunkPoolEnabled;
+extern VOXELCORE_API int32 GVoxelChunkPoolMaxRetainedSizeMB;
+
+// Global free list of fixed-size chunks, with a small per-thread cache in front of it
+// Used by TVoxelChunkedArray to avoid hitting the allocator every time a chunk is added or popped
+class VOXELCORE_API FVoxelChunkPool
+{
+public:
+	const int64 ChunkSize;
+	const int32 Alignment;
+	const int32 PoolIndex;
+
+	// Pools are never destroyed, callers are expected to cache the result
+	static FVoxelChunkPool& Get(int64 ChunkSize, int32 Alignment);
+	// Free all the chunks retained by the global free lists
+	static void TrimAll();
+	// Size of the free chunks retained by the pools, including the thread caches
+	static int64 GetRetainedSize();
+
+	void* Allocate();
+	void Free(void* Chunk);
+
+private:
+	FVoxelCriticalSection CriticalSection;
+	TVoxelArray<void*> Chunks_RequiresLock;
+
+	FVoxelChunkPool(
+		int64 ChunkSize,
+		int32 Alignment,
+		int32 PoolIndex);
+
+	void Trim();
+
+	friend struct FVoxelChunkPoolThreadCache;
+};
+
 template<typename Type, int32 MaxBytesPerChunk = GVoxelDefaultAllocationSize>
 class TVoxelChunkedArray
 {
@@ -20,7 +59,17 @@ public:
 	static constexpr int32 NumPerChunk = 1 << NumPerChunkLog2;
 
 	using FChunk = TVoxelStaticArray<TTypeCompatibleBytes<Type>, NumPerChunk>;
-	using FChunkArray = TVoxelInlineArray<TUniquePtr<FChunk>, 1>;
+
+	struct FChunkDeleter
+	{
+		FORCEINLINE void operator()(FChunk* Chunk) const
+		{
+			checkStatic(std::is_trivially_destructible_v<FChunk>);
+			GetChunkPool().Free(Chunk);
+		}
+	};
+	using FChunkPtr = TUniquePtr<FChunk, FChunkDeleter>;
+	using FChunkArray = TVoxelInlineArray<FChunkPtr, 1>;
 
 	TVoxelChunkedArray() = default;
 	FORCEINLINE TVoxelChunkedArray(TVoxelChunkedArray&& Other)
@@ -294,6 +343,7 @@ public:
 
 	FORCEINLINE int32 Num() const
 	{
+		checkVoxelSlow(ConcurrentArrayNum.Get(std::memory_order_relaxed) == -1);
 		return ArrayNum;
 	}
 	FORCEINLINE int64 GetAllocatedSize() const
@@ -413,6 +463,8 @@ public:
 public:
 	FORCEINLINE int32 AddUninitialized()
 	{
+		checkVoxelSlow(ConcurrentArrayNum.Get(std::memory_order_relaxed) == -1);
+
 		if (ArrayNum % NumPerChunk == 0)
 		{
 			AllocateNewChunk();
@@ -422,6 +474,7 @@ public:
 	FORCEINLINE int32 AddUninitialized(const int32 Count)
 	{
 		checkVoxelSlow(Count >= 0);
+		checkVoxelSlow(ConcurrentArrayNum.Get(std::memory_order_relaxed) == -1);
 
 		const int32 OldNum = ArrayNum;
 		ArrayNum += Count;
@@ -632,6 +685,58 @@ public:
 		}
 	}
 
+public:
+	// Concurrent append mode: preallocates the chunks needed for MaxNumToAdd new elements,
+	// after which any thread can call AddConcurrent/AddUninitialized_Concurrent without locking
+	// No other function can be called until EndConcurrentAdd, Num doesn't include the new elements until then
+	void BeginConcurrentAdd(const int32 MaxNumToAdd)
+	{
+		VOXEL_FUNCTION_COUNTER_NUM(MaxNumToAdd, 1024);
+		checkVoxelSlow(MaxNumToAdd >= 0);
+		checkVoxelSlow(ConcurrentArrayNum.Get() == -1);
+		checkVoxelSlow(PrivateChunks.Num() == FVoxelUtilities::DivideCeil_Positive(ArrayNum, NumPerChunk));
+
+		const int32 NewNumChunks = FVoxelUtilities::DivideCeil_Positive(ArrayNum + MaxNumToAdd, NumPerChunk);
+		PrivateChunks.Reserve(NewNumChunks);
+
+		while (PrivateChunks.Num() < NewNumChunks)
+		{
+			AllocateNewChunk();
+		}
+
+		ConcurrentArrayNum.Set(ArrayNum);
+	}
+	// Release the chunks that were not used
+	void EndConcurrentAdd()
+	{
+		VOXEL_FUNCTION_COUNTER();
+		checkVoxelSlow(ConcurrentArrayNum.Get() != -1);
+
+		ArrayNum = ConcurrentArrayNum.Exchange_ReturnOld(-1);
+
+		const int32 NumChunks = FVoxelUtilities::DivideCeil_Positive(ArrayNum, NumPerChunk);
+		checkVoxelSlow(PrivateChunks.Num() >= NumChunks);
+		PrivateChunks.SetNum(NumChunks);
+	}
+
+	// The new elements can only be accessed with operator[] after EndConcurrentAdd, use AddConcurrent to construct them in place
+	FORCEINLINE int32 AddUninitialized_Concurrent(const int32 Count)
+	{
+		checkVoxelSlow(Count >= 0);
+		checkVoxelSlow(ConcurrentArrayNum.Get(std::memory_order_relaxed) != -1);
+
+		const int32 Index = ConcurrentArrayNum.Add_ReturnOld(Count);
+		checkf(Index + Count <= PrivateChunks.Num() * NumPerChunk, TEXT("More elements added than reserved in BeginConcurrentAdd"));
+		return Index;
+	}
+	template<typename... ArgsType>
+	FORCEINLINE int32 AddConcurrent(ArgsType&&... Args)
+	{
+		const int32 Index = AddUninitialized_Concurrent(1);
+		new (&GetChunkView(FVoxelUtilities::GetChunkIndex<NumPerChunk>(Index))[FVoxelUtilities::GetChunkOffset<NumPerChunk>(Index)]) Type(Forward<ArgsType>(Args)...);
+		return Index;
+	}
+
 public:
 	class FChunkView : public TVoxelArrayView<Type>
 	{
@@ -648,10 +753,10 @@ public:
 		}
 
 	private:
-		const TUniquePtr<FChunk> Chunk;
+		const FChunkPtr Chunk;
 
 		FChunkView(
-			TUniquePtr<FChunk> Chunk,
+			FChunkPtr Chunk,
 			const int32 Num)
 			: TVoxelArrayView<Type>(ReinterpretCastPtr<Type>(Chunk->GetData()), Num)
 			, Chunk(MoveTemp(Chunk))
@@ -665,7 +770,7 @@ public:
 		VOXEL_FUNCTION_COUNTER();
 		checkVoxelSlow(Num() > 0);
 
-		TUniquePtr<FChunk> Chunk = MoveTemp(PrivateChunks[0]);
+		FChunkPtr Chunk = MoveTemp(PrivateChunks[0]);
 		const int32 NumRemoved = FMath::Min(NumPerChunk, Num());
 
 		ArrayNum -= NumRemoved;
@@ -690,8 +795,8 @@ public:
 	struct TIterator
 	{
 		Type* Value = nullptr;
-		const TUniquePtr<FChunk>* ChunkIterator = nullptr;
-		const TUniquePtr<FChunk>* ChunkIteratorEnd = nullptr;
+		const FChunkPtr* ChunkIterator = nullptr;
+		const FChunkPtr* ChunkIteratorEnd = nullptr;
 
 		FORCEINLINE InType& operator*() const
 		{
@@ -760,12 +865,20 @@ public:
 	}
 
 private:
+	// Only written outside of concurrent add
 	int32 ArrayNum = 0;
+	// Num while in concurrent add, -1 otherwise. Fits in the padding before PrivateChunks
+	TVoxelAtomic<int32> ConcurrentArrayNum = -1;
 	FChunkArray PrivateChunks;
 
 	FORCENOINLINE void AllocateNewChunk()
 	{
-		PrivateChunks.Add(MakeUnique<FChunk>(NoInit));
+		PrivateChunks.Add(FChunkPtr(new (GetChunkPool().Allocate()) FChunk(NoInit)));
+	}
+	FORCEINLINE static FVoxelChunkPool& GetChunkPool()
+	{
+		static FVoxelChunkPool& Pool = FVoxelChunkPool::Get(sizeof(FChunk), alignof(FChunk));
+		return Pool;
 	}
 	FORCEINLINE TVoxelArrayView<Type> GetChunkView(const int32 ChunkIndex)
 	{
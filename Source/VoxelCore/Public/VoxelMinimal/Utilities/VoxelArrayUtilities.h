@@ -8,6 +8,9 @@
 #include "VoxelMinimal/Containers/VoxelArray.h"
 #include "VoxelMinimal/Containers/VoxelArrayView.h"
 
+struct FVoxelOctahedron;
+struct FVoxelOctahedron16;
+
 template<typename T, typename = void>
 struct TVoxelCanBulkSerialize
 {
@@ -20,6 +23,29 @@ struct TVoxelCanBulkSerialize<T, std::enable_if_t<std::is_arithmetic_v<T>>>
 	static constexpr bool Value = true;
 };
 
+enum class EVoxelCompressionFilter : uint8
+{
+	None = 0,
+	// Map floats to integers with the same ordering, requires ElementSize 4
+	FloatToSortable = 1 << 0,
+	// Store the difference with the previous element of the row, requires ElementSize 1, 2 or 4
+	Delta = 1 << 1,
+	// Store the first byte of all elements, then the second byte...
+	ByteShuffle = 1 << 2,
+};
+ENUM_CLASS_FLAGS(EVoxelCompressionFilter);
+
+// Reversible transforms applied before compressing arrays of typed values
+// They group similar bytes together, making the data much easier to compress
+struct FVoxelCompressionFilters
+{
+	EVoxelCompressionFilter Filters = EVoxelCompressionFilter::None;
+	// Size in bytes of the elements
+	int32 ElementSize = 1;
+	// Number of elements per row for Delta, eg the size of a brick along X. 0 for a single row
+	int32 RowSize = 0;
+};
+
 namespace FVoxelUtilities
 {
 	FORCEINLINE bool MemoryEqual(const void* Buf1, const void* Buf2, const SIZE_T Count)
@@ -477,10 +503,118 @@ namespace FVoxelUtilities
 	//////////////////////////////////////////////////////////////////////////////
 	//////////////////////////////////////////////////////////////////////////////
 
+	// All the conversions below are split across threads above voxel.Conversion.ParallelThreshold elements
+
 	VOXELCORE_API void Memcpy_Convert(
 		TVoxelArrayView<double> Dest,
 		TConstVoxelArrayView<float> Src);
 
+	VOXELCORE_API void Memcpy_Convert(
+		TVoxelArrayView<float> Dest,
+		TConstVoxelArrayView<double> Src);
+
+	// Round to nearest even, like FFloat16::Set
+	VOXELCORE_API void Memcpy_Convert(
+		TVoxelArrayView<FFloat16> Dest,
+		TConstVoxelArrayView<float> Src);
+
+	VOXELCORE_API void Memcpy_Convert(
+		TVoxelArrayView<float> Dest,
+		TConstVoxelArrayView<FFloat16> Src);
+
+	VOXELCORE_API void Memcpy_Convert(
+		TVoxelArrayView<float> Dest,
+		TConstVoxelArrayView<int32> Src);
+
+	// Rounds toward zero, like a cast. Values must fit in an int32
+	VOXELCORE_API void Memcpy_Convert(
+		TVoxelArrayView<int32> Dest,
+		TConstVoxelArrayView<float> Src);
+
+	// Clamp to [0, 1] and round to nearest, like GPUs do
+	// Unlike FloatToUINT8 which floors, 0.5f / 255 is encoded as 1
+	VOXELCORE_API void FloatToUnorm(
+		TVoxelArrayView<uint8> Dest,
+		TConstVoxelArrayView<float> Src);
+
+	VOXELCORE_API void FloatToUnorm(
+		TVoxelArrayView<uint16> Dest,
+		TConstVoxelArrayView<float> Src);
+
+	// Clamp to [-1, 1] and round to nearest. -128 and -32768 are never produced
+	VOXELCORE_API void FloatToSnorm(
+		TVoxelArrayView<int8> Dest,
+		TConstVoxelArrayView<float> Src);
+
+	VOXELCORE_API void FloatToSnorm(
+		TVoxelArrayView<int16> Dest,
+		TConstVoxelArrayView<float> Src);
+
+	VOXELCORE_API void UnormToFloat(
+		TVoxelArrayView<float> Dest,
+		TConstVoxelArrayView<uint8> Src);
+
+	VOXELCORE_API void UnormToFloat(
+		TVoxelArrayView<float> Dest,
+		TConstVoxelArrayView<uint16> Src);
+
+	// -128 and -32768 are decoded as -1
+	VOXELCORE_API void SnormToFloat(
+		TVoxelArrayView<float> Dest,
+		TConstVoxelArrayView<int8> Src);
+
+	VOXELCORE_API void SnormToFloat(
+		TVoxelArrayView<float> Dest,
+		TConstVoxelArrayView<int16> Src);
+
+	// Same results as FLinearColor::ToFColorSRGB if bSRGB, FLinearColor::ToFColor(false) otherwise
+	VOXELCORE_API void ConvertColors(
+		TVoxelArrayView<FColor> Dest,
+		TConstVoxelArrayView<FLinearColor> Src,
+		bool bSRGB);
+
+	// Same results as FLinearColor(FColor) if bSRGB, FColor::ReinterpretAsLinear otherwise
+	VOXELCORE_API void ConvertColors(
+		TVoxelArrayView<FLinearColor> Dest,
+		TConstVoxelArrayView<FColor> Src,
+		bool bSRGB);
+
+	// AoS to SoA
+	VOXELCORE_API void SplitVectors(
+		TConstVoxelArrayView<FVector3f> Vectors,
+		TVoxelArrayView<float> OutX,
+		TVoxelArrayView<float> OutY,
+		TVoxelArrayView<float> OutZ);
+
+	// SoA to AoS
+	VOXELCORE_API void MergeVectors(
+		TConstVoxelArrayView<float> X,
+		TConstVoxelArrayView<float> Y,
+		TConstVoxelArrayView<float> Z,
+		TVoxelArrayView<FVector3f> OutVectors);
+
+	// Same results as FVoxelOctahedron(FVector3f)
+	// If bPrecise, the four neighboring quantized values are tested and the one decoding closest to the input is kept
+	// About 4x slower, but noticeably reduces the quantization error
+	VOXELCORE_API void UnitVectorsToOctahedrons(
+		TConstVoxelArrayView<FVector3f> UnitVectors,
+		TVoxelArrayView<FVoxelOctahedron> OutOctahedrons,
+		bool bPrecise = false);
+
+	VOXELCORE_API void UnitVectorsToOctahedrons(
+		TConstVoxelArrayView<FVector3f> UnitVectors,
+		TVoxelArrayView<FVoxelOctahedron16> OutOctahedrons,
+		bool bPrecise = false);
+
+	// Same results as FVoxelOctahedron::GetUnitVector
+	VOXELCORE_API void OctahedronsToUnitVectors(
+		TConstVoxelArrayView<FVoxelOctahedron> Octahedrons,
+		TVoxelArrayView<FVector3f> OutUnitVectors);
+
+	VOXELCORE_API void OctahedronsToUnitVectors(
+		TConstVoxelArrayView<FVoxelOctahedron16> Octahedrons,
+		TVoxelArrayView<FVector3f> OutUnitVectors);
+
 	//////////////////////////////////////////////////////////////////////////////
 	//////////////////////////////////////////////////////////////////////////////
 	//////////////////////////////////////////////////////////////////////////////
@@ -528,6 +662,9 @@ namespace FVoxelUtilities
 	// Will replace -0 by +0
 	VOXELCORE_API void FixupSignBit(TVoxelArrayView<float> Data);
 
+	// Swap the bytes of each value in-place, eg to convert big-endian data
+	VOXELCORE_API void ByteSwap(TVoxelArrayView<uint16> Data);
+
 	VOXELCORE_API int64 CountSetBits(TConstVoxelArrayView<uint32> Data);
 
 	//////////////////////////////////////////////////////////////////////////////
@@ -546,4 +683,35 @@ namespace FVoxelUtilities
 		TConstVoxelArrayView64<uint8> CompressedData,
 		TVoxelArray64<uint8>& OutData,
 		bool bAllowParallel = true);
+
+	// Filters are recorded in the header and undone by Decompress
+	VOXELCORE_API TVoxelArray64<uint8> Compress(
+		TConstVoxelArrayView64<uint8> Data,
+		const FVoxelCompressionFilters& Filters,
+		bool bAllowParallel = true,
+		FOodleDataCompression::ECompressor Compressor = FOodleDataCompression::ECompressor::Leviathan,
+		FOodleDataCompression::ECompressionLevel CompressionLevel = FOodleDataCompression::ECompressionLevel::Optimal3);
+
+	// Compress Data as independently compressed blocks of BlockSize bytes, with a block offset table
+	// The result can be decompressed with Decompress, or partially with DecompressRange
+	// Returns false if the current task is cancelled, OutCompressedData must then be discarded
+	VOXELCORE_API bool CompressFramed(
+		TConstVoxelArrayView64<uint8> Data,
+		TVoxelArray64<uint8>& OutCompressedData,
+		int32 BlockSize = 256 * 1024,
+		bool bAllowParallel = true,
+		FOodleDataCompression::ECompressor Compressor = FOodleDataCompression::ECompressor::Leviathan,
+		FOodleDataCompression::ECompressionLevel CompressionLevel = FOodleDataCompression::ECompressionLevel::Optimal3);
+
+	VOXELCORE_API bool GetUncompressedSize(
+		TConstVoxelArrayView64<uint8> CompressedData,
+		int64& OutUncompressedSize);
+
+	// Decompress the uncompressed bytes [Offset, Offset + OutData.Num())
+	// Framed data only decodes the blocks overlapping the range, other data is fully decompressed
+	VOXELCORE_API bool DecompressRange(
+		TConstVoxelArrayView64<uint8> CompressedData,
+		int64 Offset,
+		TVoxelArrayView64<uint8> OutData,
+		bool bAllowParallel = true);
 }
\ No newline at end of file
@@ -16,9 +16,10 @@ namespace FVoxelUtilities
 	//////////////////////////////////////////////////////////////////////////////
 	//////////////////////////////////////////////////////////////////////////////
 
+	// Stateless version of FVoxelInvokerChunkTracker, prefer using a tracker when invokers are updated every frame
 	VOXELCORE_API bool ComputeInvokerChunks(
 		TVoxelSet<FIntVector>& OutChunks,
-		TVoxelArray<FSphere> Invokers,
+		TConstVoxelArrayView<FSphere> Invokers,
 		const FMatrix& LocalToWorld,
 		double ChunkSize,
 		int32 MaxNumChunks);
@@ -0,0 +1,146 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#pragma once
+
+#include "VoxelCoreMinimal.h"
+#include "VoxelMinimal/Containers/VoxelArray.h"
+#include "VoxelMinimal/Containers/VoxelBitArray.h"
+#include "VoxelMinimal/Utilities/VoxelThreadingUtilities.h"
+
+// Data-parallel primitives: scan, compaction, histogram and radix sort
+// Large inputs are split in chunks processed in parallel when bAllowParallel is true
+namespace FVoxelUtilities
+{
+	// OutData[Index] = Data[0] + ... + Data[Index - 1]
+	// Data and OutData can be the same array. Returns the sum of all the values
+	VOXELCORE_API int32 ExclusiveScan(
+		TConstVoxelArrayView<int32> Data,
+		TVoxelArrayView<int32> OutData,
+		bool bAllowParallel = true);
+
+	VOXELCORE_API int64 ExclusiveScan(
+		TConstVoxelArrayView<int64> Data,
+		TVoxelArrayView<int64> OutData,
+		bool bAllowParallel = true);
+
+	// OutCounts[Value] = number of elements equal to Value
+	// OutCounts is reset first, values must be less than OutCounts.Num()
+	VOXELCORE_API void Histogram(
+		TConstVoxelArrayView<uint8> Data,
+		TVoxelArrayView<int32> OutCounts,
+		bool bAllowParallel = true);
+
+	VOXELCORE_API void Histogram(
+		TConstVoxelArrayView<uint16> Data,
+		TVoxelArrayView<int32> OutCounts,
+		bool bAllowParallel = true);
+
+	VOXELCORE_API void Histogram(
+		TConstVoxelArrayView<uint32> Data,
+		TVoxelArrayView<int32> OutCounts,
+		bool bAllowParallel = true);
+
+	// Stable LSD radix sort, 8 bits per pass. Passes where all the keys have the same digit are skipped
+	// Signed or float keys need to be made sortable first, eg with FloatToSortable
+	VOXELCORE_API void RadixSort(
+		TVoxelArrayView<uint32> Keys,
+		bool bAllowParallel = true);
+
+	VOXELCORE_API void RadixSort(
+		TVoxelArrayView<uint64> Keys,
+		bool bAllowParallel = true);
+
+	// Values are moved along with their keys, typically indices into another array
+	VOXELCORE_API void RadixSort(
+		TVoxelArrayView<uint32> Keys,
+		TVoxelArrayView<uint32> Values,
+		bool bAllowParallel = true);
+
+	VOXELCORE_API void RadixSort(
+		TVoxelArrayView<uint64> Keys,
+		TVoxelArrayView<uint32> Values,
+		bool bAllowParallel = true);
+
+	// Use CompactByMask instead
+	// OutData must have room for as many elements as there are bits set in MaskWords
+	VOXELCORE_API int32 CompactByMaskImpl(
+		const void* Data,
+		int32 TypeSize,
+		int32 Num,
+		TConstVoxelArrayView<uint32> MaskWords,
+		void* OutData,
+		bool bAllowParallel);
+
+	// Copy the elements whose bit is set in Mask, preserving their order
+	template<typename T>
+	TVoxelArray<T> CompactByMask(
+		const TConstVoxelArrayView<T> Data,
+		const FVoxelBitArray& Mask,
+		const bool bAllowParallel = true)
+	{
+		checkStatic(std::is_trivially_copyable_v<T>);
+		check(Data.Num() == Mask.Num());
+
+		TVoxelArray<T> Result;
+		FVoxelUtilities::SetNumFast(Result, Mask.CountSetBits());
+
+		if (Result.Num() == 0)
+		{
+			return Result;
+		}
+
+		const int32 Num = CompactByMaskImpl(
+			Data.GetData(),
+			sizeof(T),
+			Data.Num(),
+			Mask.GetWordView(),
+			Result.GetData(),
+			bAllowParallel);
+
+		checkVoxelSlow(Num == Result.Num());
+		return Result;
+	}
+
+	// Copy the elements for which Predicate returns true, preserving their order
+	// Predicate is called exactly once per element, from any thread if bAllowParallel is true
+	template<typename T, typename PredicateType>
+	TVoxelArray<T> CompactIf(
+		const TConstVoxelArrayView<T> Data,
+		PredicateType&& Predicate,
+		const bool bAllowParallel = true)
+	{
+		VOXEL_FUNCTION_COUNTER_NUM(Data.Num(), 1024);
+
+		FVoxelBitArray Mask;
+		Mask.SetNumZeroed(Data.Num());
+
+		const auto BuildWord = [&](uint32& Word, const int32 WordIndex)
+		{
+			const int32 StartIndex = WordIndex * 32;
+			const int32 EndIndex = FMath::Min(StartIndex + 32, Data.Num());
+
+			uint32 NewWord = 0;
+			for (int32 Index = StartIndex; Index < EndIndex; Index++)
+			{
+				NewWord |= uint32(Predicate(Data[Index]) ? 1 : 0) << (Index - StartIndex);
+			}
+			Word = NewWord;
+		};
+
+		const TVoxelArrayView<uint32> Words = Mask.GetWordView();
+		if (bAllowParallel &&
+			Words.Num() > 1024)
+		{
+			ParallelFor(Words, BuildWord);
+		}
+		else
+		{
+			for (int32 WordIndex = 0; WordIndex < Words.Num(); WordIndex++)
+			{
+				BuildWord(Words[WordIndex], WordIndex);
+			}
+		}
+
+		return FVoxelUtilities::CompactByMask(Data, Mask, bAllowParallel);
+	}
+}
@@ -5,6 +5,7 @@
 #include "VoxelCoreMinimal.h"
 #include "Async/ParallelFor.h"
 #include "VoxelMinimal/VoxelFuture.h"
+#include "VoxelMinimal/VoxelCancellationToken.h"
 #include "VoxelMinimal/Containers/VoxelMap.h"
 #include "VoxelMinimal/Containers/VoxelArray.h"
 #include "VoxelMinimal/Containers/VoxelArrayView.h"
@@ -200,6 +201,9 @@ TSharedRef<T> MakeShared_RenderThread(ArgTypes&&... Args)
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
+// Returns false if CancellationToken was cancelled, in which case some elements were skipped
+// and the caller should discard the whole result
+// Workers don't inherit the task scope: pass FVoxelCancellationToken::Get() from the calling thread
 template<
 	typename Type,
 	typename SizeType,
@@ -211,15 +215,16 @@ template<
 		LambdaHasSignature_V<LambdaType, void(const Type&)> ||
 		LambdaHasSignature_V<LambdaType, void(Type&, SizeType)> ||
 		LambdaHasSignature_V<LambdaType, void(const Type&, SizeType)>>>
-void ParallelFor(
+bool ParallelFor_Cancellable(
 	const TVoxelArrayView<Type, SizeType> ArrayView,
+	const FVoxelCancellationToken& CancellationToken,
 	LambdaType Lambda)
 {
 	VOXEL_FUNCTION_COUNTER();
 
 	if (ArrayView.Num() == 0)
 	{
-		return;
+		return !CancellationToken.IsCancelled();
 	}
 
 	const SizeType NumThreads = FMath::Clamp<SizeType>(FPlatformMisc::NumberOfCoresIncludingHyperthreads(), 1, ArrayView.Num());
@@ -236,6 +241,11 @@ void ParallelFor(
 			return;
 		}
 
+		if (CancellationToken.IsCancelled())
+		{
+			return;
+		}
+
 		if constexpr (
 			LambdaHasSignature_V<LambdaType, void(TVoxelArrayView<Type, SizeType>)> ||
 			LambdaHasSignature_V<LambdaType, void(TVoxelArrayView<const Type, SizeType>)>)
@@ -248,6 +258,12 @@ void ParallelFor(
 		{
 			for (SizeType Index = StartIndex; Index < EndIndex; Index++)
 			{
+				if ((Index & 255) == 0 &&
+					CancellationToken.IsCancelled())
+				{
+					return;
+				}
+
 				Lambda(ArrayView[Index]);
 			}
 		}
@@ -257,6 +273,12 @@ void ParallelFor(
 		{
 			for (SizeType Index = StartIndex; Index < EndIndex; Index++)
 			{
+				if ((Index & 255) == 0 &&
+					CancellationToken.IsCancelled())
+				{
+					return;
+				}
+
 				Lambda(ArrayView[Index], Index);
 			}
 		}
@@ -265,6 +287,30 @@ void ParallelFor(
 			checkStatic(std::is_same_v<LambdaType, void>);
 		}
 	});
+
+	return !CancellationToken.IsCancelled();
+}
+
+// Always processes all elements, see ParallelFor_Cancellable
+template<
+	typename Type,
+	typename SizeType,
+	typename LambdaType,
+	typename = std::enable_if_t<
+		LambdaHasSignature_V<LambdaType, void(TVoxelArrayView<Type, SizeType>)> ||
+		LambdaHasSignature_V<LambdaType, void(TVoxelArrayView<const Type, SizeType>)> ||
+		LambdaHasSignature_V<LambdaType, void(Type&)> ||
+		LambdaHasSignature_V<LambdaType, void(const Type&)> ||
+		LambdaHasSignature_V<LambdaType, void(Type&, SizeType)> ||
+		LambdaHasSignature_V<LambdaType, void(const Type&, SizeType)>>>
+void ParallelFor(
+	const TVoxelArrayView<Type, SizeType> ArrayView,
+	LambdaType Lambda)
+{
+	ParallelFor_Cancellable(
+		ArrayView,
+		FVoxelCancellationToken(),
+		MoveTemp(Lambda));
 }
 
 ///////////////////////////////////////////////////////////////////////////////
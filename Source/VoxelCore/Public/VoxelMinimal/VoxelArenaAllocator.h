@@ -0,0 +1,384 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#pragma once
+
+#include "VoxelCoreMinimal.h"
+#include "VoxelMinimal/VoxelAtomic.h"
+
+DECLARE_VOXEL_MEMORY_STAT(VOXELCORE_API, STAT_VoxelArenaMemory, "Arena Memory");
+DECLARE_VOXEL_MEMORY_STAT(VOXELCORE_API, STAT_VoxelArenaPeakUsage, "Arena Peak Usage");
+
+extern VOXELCORE_API int32 GVoxelArenaBlockSize;
+extern VOXELCORE_API int32 GVoxelArenaMaxRetainedSize;
+
+// Thread-local bump allocator
+// Opt-in with FVoxelArenaScope: everything allocated in the scope is released in bulk when the outermost scope on this thread exits
+// Memory allocated from an arena must NOT outlive the scope that allocated it
+class VOXELCORE_API FVoxelArena
+{
+public:
+	// Will return null if there is no arena scope on this thread
+	FORCEINLINE static FVoxelArena* GetActive()
+	{
+		FVoxelArena* Arena = static_cast<FVoxelArena*>(FPlatformTLS::GetTlsValue(TLSSlot));
+		if (!Arena ||
+			Arena->ScopeDepth == 0)
+		{
+			return nullptr;
+		}
+		return Arena;
+	}
+
+	static void EnterScope();
+	static void ExitScope();
+
+public:
+	FORCEINLINE void* Allocate(const int64 Size, const uint32 Alignment)
+	{
+		checkVoxelSlow(Size > 0);
+		checkVoxelSlow(FMath::IsPowerOfTwo(Alignment));
+		checkVoxelSlow(IsInScope());
+		checkVoxelSlow(FPlatformTLS::GetTlsValue(TLSSlot) == this);
+
+#if VOXEL_DEBUG
+		return Allocate_Debug(Size, Alignment);
+#else
+		return AllocateImpl(Size, Alignment);
+#endif
+	}
+	// Try to grow or shrink the last allocation in-place
+	FORCEINLINE bool TryResize(void* Data, const int64 OldSize, const int64 NewSize)
+	{
+		checkVoxelSlow(IsInScope());
+		checkVoxelSlow(FPlatformTLS::GetTlsValue(TLSSlot) == this);
+
+#if VOXEL_DEBUG
+		return TryResize_Debug(Data, OldSize, NewSize);
+#else
+		return TryResizeImpl(Data, OldSize, NewSize);
+#endif
+	}
+	FORCEINLINE void Free(void* Data, const int64 Size)
+	{
+		if (!IsInScope() ||
+			FPlatformTLS::GetTlsValue(TLSSlot) != this)
+		{
+			// Freed from another thread or after the scope exited,
+			// will be reclaimed when the owning arena is reset
+			return;
+		}
+
+#if VOXEL_DEBUG
+		Free_Debug(Data, Size);
+#else
+		FreeImpl(Data, Size);
+#endif
+	}
+
+public:
+	FORCEINLINE bool IsInScope() const
+	{
+		return ScopeDepth > 0;
+	}
+	FORCEINLINE int64 GetPeakUsage() const
+	{
+		return PeakUsage;
+	}
+
+private:
+	struct FBlock
+	{
+		uint8* Data = nullptr;
+		int64 Size = 0;
+	};
+
+	static const uint32 TLSSlot;
+
+	int32 ScopeDepth = 0;
+
+	uint8* Current = nullptr;
+	uint8* End = nullptr;
+	// Highest value Current reached in the current block, used for peak usage
+	uint8* HighWater = nullptr;
+
+	int32 BlockIndex = -1;
+	TArray<FBlock, TInlineAllocator<4>> Blocks;
+
+	// Bytes used in blocks before the current one
+	int64 PreviousBlocksUsage = 0;
+	int64 PeakUsage = 0;
+
+	FVoxelArena() = default;
+	~FVoxelArena();
+
+	FORCEINLINE void* AllocateImpl(const int64 Size, const uint32 Alignment)
+	{
+		uint8* Result = Align(Current, Alignment);
+		if (End - Result < Size)
+		{
+			return AllocateSlow(Size, Alignment);
+		}
+
+		Current = Result + Size;
+		return Result;
+	}
+	FORCEINLINE bool TryResizeImpl(void* Data, const int64 OldSize, const int64 NewSize)
+	{
+		if (static_cast<uint8*>(Data) + OldSize != Current ||
+			End - static_cast<uint8*>(Data) < NewSize)
+		{
+			return false;
+		}
+
+		HighWater = FMath::Max(HighWater, Current);
+		Current = static_cast<uint8*>(Data) + NewSize;
+		return true;
+	}
+	FORCEINLINE void FreeImpl(void* Data, const int64 Size)
+	{
+		// Pop the allocation if it's the last one, otherwise it's released on reset
+		if (static_cast<uint8*>(Data) + Size == Current)
+		{
+			HighWater = FMath::Max(HighWater, Current);
+			Current = static_cast<uint8*>(Data);
+		}
+	}
+
+	void* AllocateSlow(int64 Size, uint32 Alignment);
+	int64 GetUsage() const;
+	void UpdatePeakUsage();
+	void Reset();
+
+#if VOXEL_DEBUG
+	struct FDebugAllocation
+	{
+		uint8* Data = nullptr;
+		int64 Size = 0;
+	};
+	TArray<FDebugAllocation> DebugAllocations;
+
+	void* Allocate_Debug(int64 Size, uint32 Alignment);
+	bool TryResize_Debug(void* Data, int64 OldSize, int64 NewSize);
+	void Free_Debug(void* Data, int64 Size);
+
+	int32 FindDebugAllocation(const void* Data) const;
+	static void WriteGuard(const FDebugAllocation& Allocation);
+	static void CheckGuard(const FDebugAllocation& Allocation);
+#endif
+
+	friend struct FVoxelArenaThreadData;
+};
+
+class FVoxelArenaScope
+{
+public:
+	FORCEINLINE FVoxelArenaScope()
+	{
+		FVoxelArena::EnterScope();
+	}
+	FORCEINLINE ~FVoxelArenaScope()
+	{
+		FVoxelArena::ExitScope();
+	}
+	UE_NONCOPYABLE(FVoxelArenaScope);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Allocator policy for short-lived scratch containers, eg TVoxelArray<T, FVoxelArenaAllocator>
+// Uses the thread arena active when the container is constructed, otherwise falls back to the heap
+// Containers using this must be destroyed before the FVoxelArenaScope they were constructed in exits
+class FVoxelArenaAllocator
+{
+public:
+	using SizeType = int32;
+
+	enum { NeedsElementType = false };
+	enum { RequireRangeCheck = true };
+
+	class ForAnyElementType
+	{
+	public:
+		// A container created outside of an arena scope must not take memory from a nested scope:
+		// it would dangle once that scope resets the arena
+		FORCEINLINE ForAnyElementType()
+			: BoundArena(FVoxelArena::GetActive())
+		{
+		}
+		ForAnyElementType(const ForAnyElementType&) = delete;
+		ForAnyElementType& operator=(const ForAnyElementType&) = delete;
+
+		FORCEINLINE ~ForAnyElementType()
+		{
+			FreeAllocation();
+		}
+
+		FORCEINLINE void MoveToEmpty(ForAnyElementType& Other)
+		{
+			checkVoxelSlow(this != &Other);
+
+			FreeAllocation();
+
+			Data = Other.Data;
+			Arena = Other.Arena;
+			AllocatedSize = Other.AllocatedSize;
+
+			Other.Data = nullptr;
+			Other.Arena = nullptr;
+			Other.AllocatedSize = 0;
+		}
+
+		FORCEINLINE FScriptContainerElement* GetAllocation() const
+		{
+			return Data;
+		}
+		FORCEINLINE bool HasAllocation() const
+		{
+			return Data != nullptr;
+		}
+		FORCEINLINE SizeType GetInitialCapacity() const
+		{
+			return 0;
+		}
+		FORCEINLINE SIZE_T GetAllocatedSize(SizeType CurrentMax, SIZE_T NumBytesPerElement) const
+		{
+			return CurrentMax * NumBytesPerElement;
+		}
+
+		FORCEINLINE void ResizeAllocation(
+			const SizeType CurrentNum,
+			const SizeType NewMax,
+			const SIZE_T NumBytesPerElement)
+		{
+			ResizeAllocation(CurrentNum, NewMax, NumBytesPerElement, DEFAULT_ALIGNMENT);
+		}
+		void ResizeAllocation(
+			const SizeType CurrentNum,
+			const SizeType NewMax,
+			const SIZE_T NumBytesPerElement,
+			const uint32 AlignmentOfElement)
+		{
+			const int64 NewSize = int64(NewMax) * NumBytesPerElement;
+			const uint32 Alignment = FMath::Max<uint32>(AlignmentOfElement, 16);
+
+			if (NewSize == 0)
+			{
+				FreeAllocation();
+				return;
+			}
+
+			if (Data)
+			{
+				if (!Arena)
+				{
+					Data = static_cast<FScriptContainerElement*>(FMemory::Realloc(Data, NewSize, Alignment));
+					AllocatedSize = NewSize;
+					return;
+				}
+
+				if (Arena == FVoxelArena::GetActive() &&
+					Arena->TryResize(Data, AllocatedSize, NewSize))
+				{
+					AllocatedSize = NewSize;
+					return;
+				}
+			}
+
+			FVoxelArena* NewArena = nullptr;
+			if (BoundArena &&
+				BoundArena == FVoxelArena::GetActive())
+			{
+				NewArena = BoundArena;
+			}
+
+			void* NewData = NewArena
+				? NewArena->Allocate(NewSize, Alignment)
+				: FMemory::Malloc(NewSize, Alignment);
+
+			if (Data)
+			{
+				FMemory::Memcpy(NewData, Data, FMath::Min<int64>(int64(CurrentNum) * NumBytesPerElement, NewSize));
+				FreeAllocation();
+			}
+
+			Data = static_cast<FScriptContainerElement*>(NewData);
+			Arena = NewArena;
+			AllocatedSize = NewSize;
+		}
+
+		FORCEINLINE SizeType CalculateSlackReserve(const SizeType NewMax, const SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackReserve(NewMax, NumBytesPerElement, false);
+		}
+		FORCEINLINE SizeType CalculateSlackReserve(const SizeType NewMax, const SIZE_T NumBytesPerElement, const uint32 AlignmentOfElement) const
+		{
+			return DefaultCalculateSlackReserve(NewMax, NumBytesPerElement, false, AlignmentOfElement);
+		}
+		FORCEINLINE SizeType CalculateSlackShrink(const SizeType NewMax, const SizeType CurrentMax, const SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackShrink(NewMax, CurrentMax, NumBytesPerElement, false);
+		}
+		FORCEINLINE SizeType CalculateSlackShrink(const SizeType NewMax, const SizeType CurrentMax, const SIZE_T NumBytesPerElement, const uint32 AlignmentOfElement) const
+		{
+			return DefaultCalculateSlackShrink(NewMax, CurrentMax, NumBytesPerElement, false, AlignmentOfElement);
+		}
+		FORCEINLINE SizeType CalculateSlackGrow(const SizeType NewMax, const SizeType CurrentMax, const SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackGrow(NewMax, CurrentMax, NumBytesPerElement, false);
+		}
+		FORCEINLINE SizeType CalculateSlackGrow(const SizeType NewMax, const SizeType CurrentMax, const SIZE_T NumBytesPerElement, const uint32 AlignmentOfElement) const
+		{
+			return DefaultCalculateSlackGrow(NewMax, CurrentMax, NumBytesPerElement, false, AlignmentOfElement);
+		}
+
+	private:
+		FScriptContainerElement* Data = nullptr;
+		// Arena owning Data, null if heap allocated
+		FVoxelArena* Arena = nullptr;
+		int64 AllocatedSize = 0;
+		// Arena active when the container was constructed, new allocations only use this one
+		FVoxelArena* const BoundArena;
+
+		FORCEINLINE void FreeAllocation()
+		{
+			if (!Data)
+			{
+				return;
+			}
+
+			if (Arena)
+			{
+				Arena->Free(Data, AllocatedSize);
+			}
+			else
+			{
+				FMemory::Free(Data);
+			}
+
+			Data = nullptr;
+			Arena = nullptr;
+			AllocatedSize = 0;
+		}
+	};
+
+	template<typename ElementType>
+	class ForElementType : public ForAnyElementType
+	{
+	public:
+		ForElementType() = default;
+
+		FORCEINLINE ElementType* GetAllocation() const
+		{
+			return reinterpret_cast<ElementType*>(ForAnyElementType::GetAllocation());
+		}
+	};
+};
+
+template<>
+struct TAllocatorTraits<FVoxelArenaAllocator> : TAllocatorTraitsBase<FVoxelArenaAllocator>
+{
+	enum { SupportsMove = true };
+	enum { SupportsElementAlignment = true };
+};
@@ -0,0 +1,75 @@
+﻿// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#pragma once
+
+#include "VoxelCoreMinimal.h"
+#include "VoxelMinimal/Containers/VoxelArrayView.h"
+
+// Reads bit streams written by FVoxelBitWriter
+// Bits are buffered in a 64 bit accumulator refilled with unaligned 8 byte loads
+// Reading past the end returns 0s, GetBitOffset can then be greater than GetNumBits
+class VOXELCORE_API FVoxelBitReader
+{
+public:
+	FVoxelBitReader() = default;
+	explicit FVoxelBitReader(const TConstVoxelArrayView<uint8> Data)
+		: Data(Data)
+	{
+	}
+
+	FORCEINLINE int64 GetBitOffset() const
+	{
+		return int64(ByteOffset) * 8 - NumBufferedBits;
+	}
+	FORCEINLINE int64 GetNumBits() const
+	{
+		return int64(Data.Num()) * 8;
+	}
+
+	FORCEINLINE uint32 Read(const uint32 NumBits)
+	{
+		checkVoxelSlow(NumBits <= 32);
+
+		if (NumBufferedBits < int32(NumBits))
+		{
+			// Fills with 0s past the end
+			Refill();
+		}
+
+		const uint32 Bits = uint32(BufferedBits & ((1ull << NumBits) - 1));
+		BufferedBits >>= NumBits;
+		NumBufferedBits -= NumBits;
+		return Bits;
+	}
+	// Read NumBits bits into each value
+	void ReadN(TVoxelArrayView<uint32> OutValues, uint32 NumBits);
+
+	// Can seek past the end, next reads will return 0s
+	void Seek(int64 BitOffset);
+	// Skip bits until the end of the current byte/word depending on Alignment
+	void Align(uint32 Alignment);
+
+private:
+	TConstVoxelArrayView<uint8> Data;
+	int32 ByteOffset = 0;
+	uint64 BufferedBits = 0;
+	int32 NumBufferedBits = 0;
+
+	FORCEINLINE void Refill()
+	{
+		if (ByteOffset + int32(sizeof(uint64)) <= Data.Num())
+		{
+			uint64 Bits;
+			FMemory::Memcpy(&Bits, &Data[ByteOffset], sizeof(uint64));
+
+			// Bits above NumBufferedBits are the same bytes as in the previous load, ORing them again is a no-op
+			BufferedBits |= Bits << NumBufferedBits;
+			ByteOffset += (63 - NumBufferedBits) >> 3;
+			NumBufferedBits |= 56;
+			return;
+		}
+
+		RefillSlow();
+	}
+	void RefillSlow();
+};
\ No newline at end of file
@@ -6,6 +6,8 @@
 #include "VoxelMinimal/Containers/VoxelArray.h"
 #include "VoxelMinimal/Containers/VoxelArrayView.h"
 
+// Little-endian bit stream, bits are accumulated 64 at a time
+// Read with FVoxelBitReader
 class VOXELCORE_API FVoxelBitWriter
 {
 public:
@@ -20,7 +22,15 @@ public:
 		PendingBits = 0;
 		NumPendingBits = 0;
 	}
+	FORCEINLINE void Reserve(const int64 NumBits)
+	{
+		Buffer.Reserve(FMath::DivideAndRoundUp<int64>(NumBits, 64) * 8);
+	}
 
+	FORCEINLINE int64 GetNumBits() const
+	{
+		return int64(Buffer.Num()) * 8 + NumPendingBits;
+	}
 	FORCEINLINE TConstVoxelArrayView<uint8> GetByteData() const
 	{
 		checkVoxelSlow(NumPendingBits == 0);
@@ -35,27 +45,39 @@ public:
 
 	FORCEINLINE void Append(const uint32 Bits, const uint32 NumBits)
 	{
-		checkVoxelSlow(NumPendingBits < 8);
+		checkVoxelSlow(NumPendingBits < 64);
+		checkVoxelSlow(NumBits <= 32);
 		checkVoxelSlow(uint64(Bits) < (1ull << NumBits));
 
 		PendingBits |= uint64(Bits) << NumPendingBits;
-		NumPendingBits += NumBits;
 
-		while (NumPendingBits >= 8)
+		if (NumPendingBits + NumBits < 64)
 		{
-			Buffer.Add(uint8(PendingBits));
-			PendingBits >>= 8;
-			NumPendingBits -= 8;
+			NumPendingBits += NumBits;
+			return;
 		}
+
+		const int32 Index = Buffer.AddUninitialized(sizeof(uint64));
+		FMemory::Memcpy(&Buffer[Index], &PendingBits, sizeof(uint64));
+
+		// NumPendingBits > 0 here, so the shift is at most 63
+		PendingBits = uint64(Bits) >> (64 - NumPendingBits);
+		NumPendingBits = NumPendingBits + NumBits - 64;
 	}
+	// Append NumBits bits of each value
+	void AppendN(TConstVoxelArrayView<uint32> Values, uint32 NumBits);
+
 	// Will append 0s until the end of the current byte/word depending on Alignment
 	FORCEINLINE void Flush(const uint32 Alignment)
 	{
-		checkVoxelSlow(NumPendingBits < 8);
+		checkVoxelSlow(NumPendingBits < 64);
 
-		if (NumPendingBits > 0)
+		const int32 NumPendingBytes = FMath::DivideAndRoundUp(NumPendingBits, 8);
+		if (NumPendingBytes > 0)
 		{
-			Buffer.Add(uint8(PendingBits));
+			const int32 Index = Buffer.AddUninitialized(NumPendingBytes);
+			FMemory::Memcpy(&Buffer[Index], &PendingBits, NumPendingBytes);
+
 			PendingBits = 0;
 			NumPendingBits = 0;
 		}
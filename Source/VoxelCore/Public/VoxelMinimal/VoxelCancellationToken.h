@@ -0,0 +1,40 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#pragma once
+
+#include "VoxelCoreMinimal.h"
+#include "VoxelMinimal/VoxelAtomic.h"
+
+// Set when the task context of a running task is being destroyed
+// Long loops should poll IsCancelled and return early: their result will be discarded anyway,
+// and the context destructor is waiting for them
+// Cheap to copy & poll, a default token is never cancelled
+// Only valid while the task that got it is running
+class FVoxelCancellationToken
+{
+public:
+	FVoxelCancellationToken() = default;
+	FORCEINLINE explicit FVoxelCancellationToken(const TVoxelAtomic_WithPadding<bool>& ShouldCancel)
+		: ShouldCancel(&ShouldCancel)
+	{
+	}
+
+	// Token of the current FVoxelTaskScope context
+	// Task scopes aren't propagated to ParallelFor workers: get the token before the ParallelFor
+	VOXELCORE_API static FVoxelCancellationToken Get();
+
+public:
+	FORCEINLINE bool IsCancelled() const
+	{
+		return
+			ShouldCancel &&
+			ShouldCancel->Get(std::memory_order_relaxed);
+	}
+	FORCEINLINE bool CanBeCancelled() const
+	{
+		return ShouldCancel != nullptr;
+	}
+
+private:
+	const TVoxelAtomic_WithPadding<bool>* ShouldCancel = nullptr;
+};
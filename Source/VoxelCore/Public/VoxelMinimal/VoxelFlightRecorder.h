@@ -0,0 +1,60 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VoxelMacros.h"
+
+enum class EVoxelFutureThread : uint8;
+
+// Always-on recorder of the last events of each thread, for hitch forensics when Insights isn't running
+// Every thread writes VOXEL_SCOPE_COUNTER begins & ends, contended VOXEL_SCOPE_LOCKs and task dispatches
+// to its own fixed-size ring buffer, without any lock
+// When a game thread frame exceeds voxel.FlightRecorder.HitchThresholdMs the rings are saved as a Chrome trace in Saved/Profiling
+extern VOXELCORE_API bool GVoxelFlightRecorderEnabled;
+
+struct FVoxelFlightRecorderSite
+{
+	// Null for scopes with dynamic names, file & line are used instead
+	const FString* Name = nullptr;
+	const ANSICHAR* File = nullptr;
+	int32 Line = 0;
+};
+
+namespace FVoxelFlightRecorder
+{
+	// Site must be static
+	VOXELCORE_API void BeginScope(const FVoxelFlightRecorderSite& Site);
+	VOXELCORE_API void EndScope();
+	VOXELCORE_API void RecordDispatch(EVoxelFutureThread Thread);
+
+	// Saves the last voxel.FlightRecorder.DumpDuration seconds of all threads, the file is written asynchronously
+	VOXELCORE_API void Dump(const FString& Reason);
+}
+
+#define VOXEL_FLIGHT_RECORDER_SCOPE_IMPL(Condition, ...) \
+	const bool VOXEL_APPEND_LINE(__bFlightRecorderEnabled) = GVoxelFlightRecorderEnabled && (Condition); \
+	if (VOXEL_APPEND_LINE(__bFlightRecorderEnabled)) \
+	{ \
+		__VA_ARGS__ \
+	} \
+	ON_SCOPE_EXIT_IMPL(FlightRecorder) \
+	{ \
+		if (VOXEL_APPEND_LINE(__bFlightRecorderEnabled)) \
+		{ \
+			FVoxelFlightRecorder::EndScope(); \
+		} \
+	};
+
+// Description is only evaluated once
+#define VOXEL_FLIGHT_RECORDER_SCOPE(Condition, Description) \
+	VOXEL_FLIGHT_RECORDER_SCOPE_IMPL(Condition, \
+		static const FString StaticFlightRecorderName = Description; \
+		static const FVoxelFlightRecorderSite StaticFlightRecorderSite{ &StaticFlightRecorderName, __FILE__, __LINE__ }; \
+		FVoxelFlightRecorder::BeginScope(StaticFlightRecorderSite);)
+
+// For dynamic names: too expensive to compute when Insights isn't running, the scope is named after its file & line
+#define VOXEL_FLIGHT_RECORDER_SCOPE_DYNAMIC(Condition) \
+	VOXEL_FLIGHT_RECORDER_SCOPE_IMPL(Condition, \
+		static const FVoxelFlightRecorderSite StaticFlightRecorderSite{ nullptr, __FILE__, __LINE__ }; \
+		FVoxelFlightRecorder::BeginScope(StaticFlightRecorderSite);)
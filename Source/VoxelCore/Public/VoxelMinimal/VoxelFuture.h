@@ -3,6 +3,7 @@
 #pragma once
 
 #include "VoxelCoreMinimal.h"
+#include "VoxelMinimal/VoxelSharedPtr.h"
 #include "VoxelMinimal/VoxelUniqueFunction.h"
 
 class FVoxelFuture;
@@ -79,21 +80,43 @@ enum class EVoxelFutureThread : uint8
 	AsyncThread,
 };
 
+FORCEINLINE const TCHAR* LexToString(const EVoxelFutureThread Thread)
+{
+	switch (Thread)
+	{
+	default: VOXEL_ASSUME(false);
+	case EVoxelFutureThread::AnyThread: return TEXT("AnyThread");
+	case EVoxelFutureThread::GameThread: return TEXT("GameThread");
+	case EVoxelFutureThread::RenderThread: return TEXT("RenderThread");
+	case EVoxelFutureThread::AsyncThread: return TEXT("AsyncThread");
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
-class VOXELCORE_API IVoxelPromiseState
+// Intrusively ref counted: creating a future is a single allocation with no separate control block
+class VOXELCORE_API IVoxelPromiseState : public TVoxelRefCountBase<IVoxelPromiseState>
 {
 public:
-	static TSharedRef<IVoxelPromiseState> New(
+	static TVoxelIntrusiveRef<IVoxelPromiseState> New(
 		FVoxelTaskContext* ContextOverride,
 		bool bWithValue);
 
-	static TSharedRef<IVoxelPromiseState> New(const FSharedVoidRef& Value);
+	static TVoxelIntrusiveRef<IVoxelPromiseState> New(const FSharedVoidRef& Value);
 
 	UE_NONCOPYABLE(IVoxelPromiseState);
 
+	// No virtual destructor, always delete the FVoxelPromiseState
+	FORCEINLINE void Release() const
+	{
+		if (ReleaseRef_ReturnIsLast())
+		{
+			Destroy();
+		}
+	}
+
 public:
 	FORCEINLINE bool IsComplete() const
 	{
@@ -135,9 +158,11 @@ protected:
 	{
 	}
 
+	void Destroy() const;
+
 	friend FVoxelPromiseState;
 };
-checkStatic(sizeof(IVoxelPromiseState) == 24);
+checkStatic(sizeof(IVoxelPromiseState) == 32);
 
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
@@ -295,9 +320,9 @@ public:
 	}
 
 protected:
-	TSharedPtr<IVoxelPromiseState> PromiseState;
+	TVoxelRefCountPtr<IVoxelPromiseState> PromiseState;
 
-	FORCEINLINE explicit FVoxelFuture(const TSharedRef<IVoxelPromiseState>& PromiseState)
+	FORCEINLINE explicit FVoxelFuture(const TVoxelIntrusiveRef<IVoxelPromiseState>& PromiseState)
 		: PromiseState(PromiseState)
 	{
 	}
@@ -488,7 +513,7 @@ public:
 	}
 
 protected:
-	FORCEINLINE explicit TVoxelFuture(const TSharedRef<IVoxelPromiseState>& PromiseState)
+	FORCEINLINE explicit TVoxelFuture(const TVoxelIntrusiveRef<IVoxelPromiseState>& PromiseState)
 		: FVoxelFuture(PromiseState)
 	{
 	}
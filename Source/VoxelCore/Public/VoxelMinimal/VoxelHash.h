@@ -17,6 +17,22 @@ public:
 		return AB == Other.AB && CD == Other.CD && EF == Other.EF;
 	}
 
+	FString ToString() const
+	{
+		return BytesToHex(Raw, 20);
+	}
+
+	friend uint32 GetTypeHash(const FVoxelHash& Hash)
+	{
+		return uint32(Hash.AB);
+	}
+
+	friend FArchive& operator<<(FArchive& Ar, FVoxelHash& Hash)
+	{
+		Ar.Serialize(Hash.Raw, 20);
+		return Ar;
+	}
+
 private:
 	union
 	{
@@ -60,6 +76,13 @@ public:
 		return *this;
 	}
 
+	FVoxelHashBuilder& AppendBytes(const void* Data, const int64 Num)
+	{
+		VOXEL_FUNCTION_COUNTER_NUM(Num, 1024);
+		Sha.Update(static_cast<const uint8*>(Data), Num);
+		return *this;
+	}
+
 	FVoxelHash MakeHash()
 	{
 		VOXEL_FUNCTION_COUNTER();
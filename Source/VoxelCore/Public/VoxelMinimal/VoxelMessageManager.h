@@ -3,6 +3,8 @@
 #pragma once
 
 #include "VoxelCoreMinimal.h"
+#include "Containers/Queue.h"
+#include "VoxelMinimal/VoxelAtomic.h"
 #include "VoxelMinimal/VoxelSingleton.h"
 #include "VoxelMinimal/VoxelMessageFactory.h"
 
@@ -48,19 +50,65 @@ private:
 
 extern VOXELCORE_API FVoxelMessageManager* GVoxelMessageManager;
 
+DECLARE_VOXEL_COUNTER(VOXELCORE_API, STAT_VoxelNumMessagesCoalesced, "Num Messages Coalesced");
+DECLARE_VOXEL_COUNTER(VOXELCORE_API, STAT_VoxelNumMessagesDropped, "Num Messages Dropped");
+
+// Messages can be logged from any thread: they are queued and drained once per tick on the game thread
+// Identical messages are coalesced, and each message is rate limited by a token bucket keyed by its hash
 class VOXELCORE_API FVoxelMessageManager : public FVoxelSingleton
 {
 public:
 	DECLARE_MULTICAST_DELEGATE_OneParam(FOnMessageLogged, const TSharedRef<FVoxelMessage>&);
 	FOnMessageLogged OnMessageLogged;
 
+	// Not called for occurrences of a message that is currently rate limited, as they will most likely be suppressed
 	using FGatherCallstack = TFunction<void(const TSharedRef<FVoxelMessage>& Message)>;
 	TVoxelArray<FGatherCallstack> GatherCallstacks;
 
 public:
-	void LogMessage(const TSharedRef<FVoxelMessage>& Message) const;
+	void LogMessage(const TSharedRef<FVoxelMessage>& Message);
+
+	// Identical messages merged into a single one in the same tick
+	FORCEINLINE int64 GetNumCoalescedMessages() const
+	{
+		return NumCoalescedMessages.Get();
+	}
+	// Messages not displayed because of the rate limit
+	FORCEINLINE int64 GetNumDroppedMessages() const
+	{
+		return NumDroppedMessages.Get();
+	}
+
+	//~ Begin FVoxelSingleton Interface
+	virtual void Tick() override;
+	//~ End FVoxelSingleton Interface
 
 private:
+	struct FQueuedMessage
+	{
+		TSharedPtr<FVoxelMessage> Message;
+		TSharedPtr<IVoxelMessageConsumer> MessageConsumer;
+		uint64 Hash = 0;
+		bool bGatheredCallstacks = false;
+	};
+
+	TQueue<FQueuedMessage, EQueueMode::Mpsc> Queue;
+	FVoxelCounter32 IsDrainScheduled;
+	FVoxelCounter64 NumCoalescedMessages;
+	FVoxelCounter64 NumDroppedMessages;
+
+	// Messages out of rate limit tokens, read from any thread to skip gathering callstacks for occurrences that will be suppressed
+	// Hash and EndTime are not updated atomically together: a hash collision can at worst gather or skip one callstack too many
+	struct FRateLimitedHash
+	{
+		TVoxelAtomic<uint64> Hash;
+		// FPlatformTime::Seconds at which the next token is available
+		TVoxelAtomic<double> EndTime;
+	};
+	static constexpr int32 NumRateLimitedHashes = 256;
+	FRateLimitedHash RateLimitedHashes[NumRateLimitedHashes];
+
+	void DrainQueue_GameThread();
 	void LogMessage_GameThread(const TSharedRef<FVoxelMessage>& Message) const;
 
 public:
@@ -90,7 +138,7 @@ private:
 	void InternalLogMessageFormat(
 		EVoxelMessageSeverity Severity,
 		const TCHAR* Format,
-		TConstVoxelArrayView<TSharedRef<FVoxelMessageToken>> Tokens) const;
+		TConstVoxelArrayView<TSharedRef<FVoxelMessageToken>> Tokens);
 };
 
 #define INTERNAL_CHECK_ARG(Name) static_assert(std::is_same_v<decltype(FVoxelMessageTokenFactory::CreateToken(Name	)), TSharedRef<FVoxelMessageToken>>, "Invalid arg passed to VOXEL_MESSAGE: " #Name);
@@ -47,6 +47,7 @@ namespace FVoxelUtilities
 }
 
 #define __ISPC_STRUCT_FVoxelOctahedron__
+#define __ISPC_STRUCT_FVoxelOctahedron16__
 
 namespace ispc
 {
@@ -55,6 +56,11 @@ namespace ispc
 		uint8 X;
 		uint8 Y;
 	};
+	struct FVoxelOctahedron16
+	{
+		uint16 X;
+		uint16 Y;
+	};
 }
 
 struct FVoxelOctahedron : ispc::FVoxelOctahedron
@@ -97,4 +103,47 @@ struct FVoxelOctahedron : ispc::FVoxelOctahedron
 		Ar << Octahedron.Y;
 		return Ar;
 	}
+};
+
+// 16 bits per axis, for when 8 bits normals show banding
+struct FVoxelOctahedron16 : ispc::FVoxelOctahedron16
+{
+	FVoxelOctahedron16() = default;
+	FORCEINLINE explicit FVoxelOctahedron16(EForceInit)
+	{
+		X = 0;
+		Y = 0;
+	}
+	FORCEINLINE explicit FVoxelOctahedron16(const FVector2f& Octahedron)
+	{
+		X = FVoxelUtilities::FloatToUINT16(Octahedron.X);
+		Y = FVoxelUtilities::FloatToUINT16(Octahedron.Y);
+
+		ensureVoxelSlow(0 <= Octahedron.X && Octahedron.X <= 1);
+		ensureVoxelSlow(0 <= Octahedron.Y && Octahedron.Y <= 1);
+	}
+	FORCEINLINE explicit FVoxelOctahedron16(const FVector3f& UnitVector)
+		: FVoxelOctahedron16(FVoxelUtilities::UnitVectorToOctahedron(UnitVector))
+	{
+	}
+
+	FORCEINLINE FVector2f GetOctahedron() const
+	{
+		return
+		{
+				FVoxelUtilities::UINT16ToFloat(X),
+				FVoxelUtilities::UINT16ToFloat(Y)
+		};
+	}
+	FORCEINLINE FVector3f GetUnitVector() const
+	{
+		return FVoxelUtilities::OctahedronToUnitVector(GetOctahedron());
+	}
+
+	FORCEINLINE friend FArchive& operator<<(FArchive& Ar, FVoxelOctahedron16& Octahedron)
+	{
+		Ar << Octahedron.X;
+		Ar << Octahedron.Y;
+		return Ar;
+	}
 };
\ No newline at end of file
@@ -264,4 +264,297 @@ FORCEINLINE const FSharedVoidRef& MakeSharedVoidRef(const TSharedRef<T>& Ptr)
 FORCEINLINE FSharedVoidRef MakeSharedVoid()
 {
 	return MakeSharedVoidRef(MakeShared<int32>());
-}
\ No newline at end of file
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+template<typename>
+class TVoxelRefCountPtr;
+
+template<typename>
+class TVoxelIntrusiveRef;
+
+// Intrusive reference count, stored in the object itself
+// Cheaper than TSharedPtr for hot objects: no separate control block, no weak count, a single atomic per copy
+// No weak references - use TSharedPtr if you need them
+// NotThreadSafe mode skips atomics entirely, only use it for objects that never leave their thread
+template<typename Derived, ESPMode Mode = ESPMode::ThreadSafe>
+class TVoxelRefCountBase
+{
+public:
+	TVoxelRefCountBase() = default;
+	UE_NONCOPYABLE(TVoxelRefCountBase);
+
+	FORCEINLINE void AddRef() const
+	{
+		if constexpr (Mode == ESPMode::ThreadSafe)
+		{
+			NumRefs.fetch_add(1, std::memory_order_relaxed);
+		}
+		else
+		{
+			NumRefs++;
+		}
+	}
+	FORCEINLINE void Release() const
+	{
+		if (ReleaseRef_ReturnIsLast())
+		{
+			delete static_cast<const Derived*>(this);
+		}
+	}
+	FORCEINLINE int32 GetRefCount() const
+	{
+		if constexpr (Mode == ESPMode::ThreadSafe)
+		{
+			return NumRefs.load(std::memory_order_relaxed);
+		}
+		else
+		{
+			return NumRefs;
+		}
+	}
+
+	FORCEINLINE TVoxelIntrusiveRef<Derived> AsIntrusiveRef()
+	{
+		return TVoxelIntrusiveRef<Derived>(static_cast<Derived&>(*this));
+	}
+	FORCEINLINE TVoxelIntrusiveRef<const Derived> AsIntrusiveRef() const
+	{
+		return TVoxelIntrusiveRef<const Derived>(static_cast<const Derived&>(*this));
+	}
+
+protected:
+	// Use this if Release needs to be implemented manually, eg if Derived is an interface without a virtual destructor
+	FORCEINLINE bool ReleaseRef_ReturnIsLast() const
+	{
+		checkVoxelSlow(GetRefCount() > 0);
+
+		if constexpr (Mode == ESPMode::ThreadSafe)
+		{
+			return NumRefs.fetch_sub(1, std::memory_order_acq_rel) == 1;
+		}
+		else
+		{
+			return --NumRefs == 0;
+		}
+	}
+
+private:
+	mutable std::conditional_t<Mode == ESPMode::ThreadSafe, std::atomic<int32>, int32> NumRefs{ 0 };
+};
+
+// Nullable pointer to an object implementing AddRef/Release, typically through TVoxelRefCountBase
+// Works with forward declared types as long as AddRef/Release are visible where the pointer is copied or destroyed
+template<typename T>
+class TVoxelRefCountPtr
+{
+public:
+	TVoxelRefCountPtr() = default;
+	FORCEINLINE TVoxelRefCountPtr(decltype(nullptr))
+	{
+	}
+	FORCEINLINE explicit TVoxelRefCountPtr(T* Ptr)
+		: Object(Ptr)
+	{
+		if (Object)
+		{
+			Object->AddRef();
+		}
+	}
+	FORCEINLINE ~TVoxelRefCountPtr()
+	{
+		if (Object)
+		{
+			Object->Release();
+		}
+	}
+
+	FORCEINLINE TVoxelRefCountPtr(const TVoxelRefCountPtr& Other)
+		: TVoxelRefCountPtr(Other.Object)
+	{
+	}
+	FORCEINLINE TVoxelRefCountPtr(TVoxelRefCountPtr&& Other)
+		: Object(Other.Object)
+	{
+		Other.Object = nullptr;
+	}
+
+	template<typename OtherType, typename = std::enable_if_t<std::is_convertible_v<OtherType*, T*>>>
+	FORCEINLINE TVoxelRefCountPtr(const TVoxelRefCountPtr<OtherType>& Other)
+		: TVoxelRefCountPtr(Other.Object)
+	{
+	}
+	template<typename OtherType, typename = std::enable_if_t<std::is_convertible_v<OtherType*, T*>>>
+	FORCEINLINE TVoxelRefCountPtr(TVoxelRefCountPtr<OtherType>&& Other)
+		: Object(Other.Object)
+	{
+		Other.Object = nullptr;
+	}
+	template<typename OtherType, typename = std::enable_if_t<std::is_convertible_v<OtherType*, T*>>>
+	FORCEINLINE TVoxelRefCountPtr(const TVoxelIntrusiveRef<OtherType>& Other)
+		: TVoxelRefCountPtr(&Other.Get())
+	{
+	}
+
+	FORCEINLINE TVoxelRefCountPtr& operator=(const TVoxelRefCountPtr& Other)
+	{
+		TVoxelRefCountPtr(Other).Swap(*this);
+		return *this;
+	}
+	FORCEINLINE TVoxelRefCountPtr& operator=(TVoxelRefCountPtr&& Other)
+	{
+		TVoxelRefCountPtr(MoveTemp(Other)).Swap(*this);
+		return *this;
+	}
+	FORCEINLINE TVoxelRefCountPtr& operator=(decltype(nullptr))
+	{
+		Reset();
+		return *this;
+	}
+
+public:
+	FORCEINLINE T* Get() const
+	{
+		return Object;
+	}
+	FORCEINLINE bool IsValid() const
+	{
+		return Object != nullptr;
+	}
+	FORCEINLINE explicit operator bool() const
+	{
+		return Object != nullptr;
+	}
+	FORCEINLINE T* operator->() const
+	{
+		checkVoxelSlow(Object);
+		return Object;
+	}
+	FORCEINLINE T& operator*() const
+	{
+		checkVoxelSlow(Object);
+		return *Object;
+	}
+
+	FORCEINLINE void Reset()
+	{
+		TVoxelRefCountPtr().Swap(*this);
+	}
+	FORCEINLINE void Swap(TVoxelRefCountPtr& Other)
+	{
+		::Swap(Object, Other.Object);
+	}
+
+	FORCEINLINE const TVoxelIntrusiveRef<T>& ToIntrusiveRef() const
+	{
+		checkVoxelSlow(Object);
+		return ReinterpretCastRef<TVoxelIntrusiveRef<T>>(*this);
+	}
+
+public:
+	FORCEINLINE bool operator==(const TVoxelRefCountPtr& Other) const
+	{
+		return Object == Other.Object;
+	}
+	FORCEINLINE bool operator!=(const TVoxelRefCountPtr& Other) const
+	{
+		return Object != Other.Object;
+	}
+	FORCEINLINE bool operator==(decltype(nullptr)) const
+	{
+		return Object == nullptr;
+	}
+	FORCEINLINE bool operator!=(decltype(nullptr)) const
+	{
+		return Object != nullptr;
+	}
+
+	FORCEINLINE friend uint32 GetTypeHash(const TVoxelRefCountPtr& Ptr)
+	{
+		return GetTypeHash(Ptr.Object);
+	}
+
+private:
+	T* Object = nullptr;
+
+	template<typename>
+	friend class TVoxelRefCountPtr;
+};
+
+// Non-nullable version of TVoxelRefCountPtr, same layout
+template<typename T>
+class TVoxelIntrusiveRef
+{
+public:
+	FORCEINLINE explicit TVoxelIntrusiveRef(T& Object)
+		: Ptr(&Object)
+	{
+	}
+
+	TVoxelIntrusiveRef(const TVoxelIntrusiveRef&) = default;
+	TVoxelIntrusiveRef& operator=(const TVoxelIntrusiveRef&) = default;
+
+	template<typename OtherType, typename = std::enable_if_t<std::is_convertible_v<OtherType*, T*>>>
+	FORCEINLINE TVoxelIntrusiveRef(const TVoxelIntrusiveRef<OtherType>& Other)
+		: Ptr(Other.Ptr)
+	{
+	}
+
+public:
+	FORCEINLINE T& Get() const
+	{
+		return *Ptr;
+	}
+	FORCEINLINE T* operator->() const
+	{
+		return Ptr.Get();
+	}
+	FORCEINLINE T& operator*() const
+	{
+		return *Ptr;
+	}
+
+	FORCEINLINE const TVoxelRefCountPtr<T>& ToRefCountPtr() const
+	{
+		return Ptr;
+	}
+
+public:
+	FORCEINLINE bool operator==(const TVoxelIntrusiveRef& Other) const
+	{
+		return Ptr == Other.Ptr;
+	}
+	FORCEINLINE bool operator!=(const TVoxelIntrusiveRef& Other) const
+	{
+		return Ptr != Other.Ptr;
+	}
+
+	FORCEINLINE friend uint32 GetTypeHash(const TVoxelIntrusiveRef& Ref)
+	{
+		return GetTypeHash(Ref.Ptr);
+	}
+
+private:
+	TVoxelRefCountPtr<T> Ptr;
+
+	template<typename>
+	friend class TVoxelIntrusiveRef;
+};
+checkStatic(sizeof(TVoxelRefCountPtr<int32>) == sizeof(void*));
+
+template<typename T, typename... ArgTypes>
+FORCEINLINE TVoxelIntrusiveRef<T> MakeVoxelIntrusive(ArgTypes&&... Args)
+{
+	return TVoxelIntrusiveRef<T>(*new T(Forward<ArgTypes>(Args)...));
+}
+
+template<typename To, typename From>
+FORCEINLINE const TVoxelIntrusiveRef<To>& StaticCastIntrusiveRef(const TVoxelIntrusiveRef<From>& Ref)
+{
+	checkStatic(std::is_base_of_v<From, To> || std::is_base_of_v<To, From>);
+	checkVoxelSlow(static_cast<const void*>(static_cast<To*>(&Ref.Get())) == static_cast<const void*>(&Ref.Get()));
+	return ReinterpretCastRef<TVoxelIntrusiveRef<To>>(Ref);
+}
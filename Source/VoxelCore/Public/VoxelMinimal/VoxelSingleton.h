@@ -15,11 +15,14 @@ public:
 	virtual void Initialize() {}
 
 	virtual void Tick() {}
+	// Only called if HasTickAsync returns true
 	virtual void Tick_Async() {}
 	virtual void Tick_RenderThread(FRHICommandList& RHICmdList) {}
 
 	virtual void AddReferencedObjects(FReferenceCollector& Collector) {}
 	virtual bool IsEditorOnly() const { return false; }
+	// Queried once after Initialize
+	virtual bool HasTickAsync() const { return false; }
 
 private:
 	bool bIsRenderSingleton = false;
@@ -6,6 +6,7 @@
 #include "Stats/Stats.h"
 #include "Stats/StatsMisc.h"
 #include "VoxelMacros.h"
+#include "VoxelFlightRecorder.h"
 #include "HAL/LowLevelMemStats.h"
 
 UE_TRACE_CHANNEL_EXTERN(VoxelChannel, VOXELCORE_API);
@@ -50,6 +51,7 @@ FORCEINLINE bool AreVoxelStatsEnabled()
 
 #define VOXEL_SCOPE_COUNTER_COND(Condition, Description) \
 	VOXEL_LLM_SCOPE(); \
+	VOXEL_FLIGHT_RECORDER_SCOPE(Condition, Description); \
 	const bool VOXEL_TRACE_ENABLED = AreVoxelStatsEnabled() && (Condition); \
 	if (VOXEL_TRACE_ENABLED) \
 	{ \
@@ -67,6 +69,7 @@ FORCEINLINE bool AreVoxelStatsEnabled()
 
 #define VOXEL_SCOPE_COUNTER_FNAME_COND(Condition, Description) \
 	VOXEL_LLM_SCOPE(); \
+	VOXEL_FLIGHT_RECORDER_SCOPE_DYNAMIC(Condition); \
 	const bool VOXEL_TRACE_ENABLED = AreVoxelStatsEnabled() && (Condition); \
 	if (VOXEL_TRACE_ENABLED) \
 	{ \
@@ -87,8 +90,8 @@ FORCEINLINE bool AreVoxelStatsEnabled()
 	return false;
 }
 
-#define VOXEL_SCOPE_COUNTER_COND(Condition, Description)
-#define VOXEL_SCOPE_COUNTER_FNAME_COND(Condition, Description)
+#define VOXEL_SCOPE_COUNTER_COND(Condition, Description) VOXEL_FLIGHT_RECORDER_SCOPE(Condition, Description)
+#define VOXEL_SCOPE_COUNTER_FNAME_COND(Condition, Description) VOXEL_FLIGHT_RECORDER_SCOPE_DYNAMIC(Condition)
 #endif
 
 VOXELCORE_API FString VoxelStats_CleanupFunctionName(const FString& FunctionName);
@@ -12,6 +12,7 @@ public:
 	struct FMesh
 	{
 		TConstVoxelArrayView<FVector3f> Positions;
+		// Use FVoxelUtilities::UnitVectorsToOctahedrons with bPrecise = true for best quality
 		TConstVoxelArrayView<FVoxelOctahedron> Normals;
 		// Optional
 		TConstVoxelArrayView<FColor> Colors;
@@ -24,6 +25,24 @@ public:
 	int32 PositionPrecision = 4;
 	static constexpr int32 NormalBits = 8;
 
+	// If true, triangles are sorted along a Morton curve before being split into clusters
+	// Mesher output is usually not spatially coherent, this gives clusters much tighter bounds
+	bool bSortTriangles = true;
+
+	// If true and voxel.Nanite.FileCache is set, the render data is persisted in FVoxelFileCache, keyed by the mesh content
+	bool bUseFileCache = true;
+
+	struct FStats
+	{
+		int32 NumClusters = 0;
+		// Average length of the diagonal of the cluster bounds
+		double AverageClusterBoundsSize = 0;
+		int64 RootDataSize = 0;
+	};
+	// Filled by CreateRenderData
+	FStats Stats;
+
+	// Returns null if the current task was cancelled
 	TUniquePtr<FStaticMeshRenderData> CreateRenderData();
 	UStaticMesh* CreateStaticMesh();
 
@@ -33,4 +52,25 @@ public:
 		TUniquePtr<FStaticMeshRenderData> RenderData);
 
 	static UStaticMesh* CreateStaticMesh(TUniquePtr<FStaticMeshRenderData> RenderData);
+
+private:
+	bool BuildResources(
+		const FVoxelBox& Bounds,
+		Nanite::FResources& Resources);
+
+	FVoxelHash GetFileCacheKey() const;
+	bool LoadFromFileCache(
+		const FVoxelHash& Key,
+		Nanite::FResources& Resources);
+	void StoreInFileCache(
+		const FVoxelHash& Key,
+		Nanite::FResources& Resources);
+	void SerializeResources(
+		FArchive& Ar,
+		Nanite::FResources& Resources);
+
+	bool SortTriangles(
+		const FVoxelBox& Bounds,
+		const FVoxelCancellationToken& CancellationToken,
+		TVoxelArray<int32>& OutSortedTriangles) const;
 };
\ No newline at end of file
@@ -30,8 +30,10 @@ public:
 	//~ End FGCObject Interface
 
 private:
-	FGraphEventRef GraphEvent;
+	FGraphEventArray GraphEvents;
 	TVoxelArray<FVoxelSingleton*> Singletons;
+	// Singletons returning true in HasTickAsync
+	TVoxelArray<FVoxelSingleton*> TickAsyncSingletons;
 	TSharedPtr<FVoxelSingletonSceneViewExtension> ViewExtension;
 };
 extern VOXELCORE_API FVoxelSingletonManager* GVoxelSingletonManager;
\ No newline at end of file
@@ -0,0 +1,55 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#pragma once
+
+#include "VoxelMinimal.h"
+
+// Interns stack frames: identical callstacks are stored once and share the same index
+// Lock-free open addressing with a fixed capacity, Add returns -1 once full
+// Indices are never invalidated
+class VOXELCORE_API FVoxelStackFramesTable
+{
+public:
+	static constexpr int32 Capacity = 1 << 14;
+	// Past this, the table is considered full
+	static constexpr int32 MaxProbes = 64;
+
+	FVoxelStackFramesTable();
+	UE_NONCOPYABLE(FVoxelStackFramesTable);
+
+	int32 Add(const FVoxelStackFrames& StackFrames);
+
+	// Index must have been returned by Add
+	FORCEINLINE const FVoxelStackFrames& Get(const int32 Index) const
+	{
+		checkVoxelSlow(Slots[Index].State.Get() == EState::Ready);
+		return Slots[Index].StackFrames;
+	}
+	FORCEINLINE int32 Num() const
+	{
+		return NumAdded.Get();
+	}
+	FORCEINLINE int32 GetNumDropped() const
+	{
+		return NumDropped.Get();
+	}
+
+private:
+	enum class EState : uint8
+	{
+		Empty,
+		Writing,
+		Ready
+	};
+
+	struct FSlot
+	{
+		TVoxelAtomic<EState> State = EState::Empty;
+		uint32 Hash = 0;
+		FVoxelStackFrames StackFrames;
+	};
+	TVoxelArray<FSlot> Slots;
+
+	FVoxelCounter32 NumAdded;
+	FVoxelCounter32 NumDropped;
+};
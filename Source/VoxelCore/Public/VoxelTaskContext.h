@@ -3,8 +3,31 @@
 #pragma once
 
 #include "VoxelMinimal.h"
+#include "VoxelLatencyHistogram.h"
 
 extern VOXELCORE_API FVoxelTaskContext* GVoxelGlobalTaskContext;
+extern VOXELCORE_API bool GVoxelTrackTaskLatency;
+
+struct VOXELCORE_API FVoxelTaskLatencyStats
+{
+	static constexpr int32 NumThreads = 4;
+
+	// Time between Dispatch and the task being started (game & render thread) or handed to the scheduler (async thread)
+	// For async tasks this is the time spent waiting for MaxLaunchedTasks
+	FVoxelLatencyHistogram QueueWait;
+	// Time between the task being handed to the scheduler and it starting to run, async tasks only
+	FVoxelLatencyHistogram SchedulerWait;
+	FVoxelLatencyHistogram RunTime;
+
+	void Reset();
+	void Append(const FVoxelTaskLatencyStats& Other);
+	FVoxelTaskLatencyStats GetDelta(const FVoxelTaskLatencyStats& Previous) const;
+	void DumpToLog(const FString& Name) const;
+
+	// Summed over all task contexts, including deleted ones
+	// Built on demand: recording a task only touches the stats of its own context
+	static FVoxelTaskLatencyStats GetGlobal(EVoxelFutureThread Thread);
+};
 
 class VOXELCORE_API FVoxelTaskContextStrongRef
 {
@@ -33,6 +56,8 @@ class VOXELCORE_API FVoxelTaskContext
 {
 public:
 	const bool bCanCancelTasks;
+	// If true, the callstack of every promise is captured
+	// Otherwise they are sampled according to voxel.Tasks.PromiseCallstackSampleInterval & voxel.Tasks.PromiseCallstackSamplePeriod
 	const bool bTrackPromisesCallstacks;
 
 	FVoxelTaskContext(
@@ -55,6 +80,15 @@ public:
 	{
 		return ShouldCancelTasks.Get();
 	}
+	// Never cancelled if !bCanCancelTasks
+	FORCEINLINE FVoxelCancellationToken GetCancellationToken() const
+	{
+		if (!bCanCancelTasks)
+		{
+			return {};
+		}
+		return FVoxelCancellationToken(ShouldCancelTasks);
+	}
 	FORCEINLINE bool IsComplete() const
 	{
 		return
@@ -69,6 +103,15 @@ public:
 	{
 		return NumPendingTasks.Get();
 	}
+	// Null if voxel.Tasks.TrackLatency was false when this context was created
+	FORCEINLINE const FVoxelTaskLatencyStats* GetLatencyStats(const EVoxelFutureThread Thread) const
+	{
+		if (!LatencyStats)
+		{
+			return nullptr;
+		}
+		return &LatencyStats[int32(Thread)];
+	}
 
 public:
 	// Wrap another future created in a different task context
@@ -92,6 +135,11 @@ public:
 	{
 		return SelfWeakRef;
 	}
+	// Unique among all the contexts ever created, unlike the context address. Always positive
+	FORCEINLINE int32 GetSerial() const
+	{
+		return SelfWeakRef.Serial;
+	}
 
 private:
 	FVoxelTaskContextWeakRef SelfWeakRef;
@@ -103,24 +151,52 @@ private:
 	TVoxelAtomic_WithPadding<bool> ShouldCancelTasks = false;
 
 private:
+	struct FTask
+	{
+		TVoxelUniqueFunction<void()> Lambda;
+		// FPlatformTime::Cycles64 when dispatched, 0 if latency isn't tracked
+		uint64 DispatchCycles = 0;
+	};
+
 	static constexpr int32 MaxLaunchedTasks = 256;
-	using FTaskArray = TVoxelChunkedArray<TVoxelUniqueFunction<void()>, MaxLaunchedTasks * sizeof(TVoxelUniqueFunction<void()>) / 2>;
+	using FTaskArray = TVoxelChunkedArray<FTask, MaxLaunchedTasks * sizeof(FTask) / 2>;
 
 	FVoxelCriticalSection GameTasksCriticalSection;
-	TVoxelChunkedArray<TVoxelUniqueFunction<void()>> GameTasks_RequiresLock;
+	TVoxelChunkedArray<FTask> GameTasks_RequiresLock;
 
 	FVoxelCriticalSection AsyncTasksCriticalSection;
 	FTaskArray AsyncTasks_RequiresLock;
 
 	void LaunchTasks();
-	void LaunchTask(TVoxelUniqueFunction<void()> Task);
+	void LaunchTask(FTask Task);
 
 	void ProcessGameTasks(bool& bAnyTaskProcessed);
 
+private:
+	TUniquePtr<FVoxelTaskLatencyStats[]> LatencyStats;
+
+	// LaunchCycles is 0 if the task was not handed to a scheduler
+	void RecordLatency(
+		EVoxelFutureThread Thread,
+		uint64 DispatchCycles,
+		uint64 LaunchCycles,
+		uint64 StartCycles,
+		uint64 EndCycles);
+
 private:
 	FVoxelCriticalSection CriticalSection;
-	TVoxelSparseArray<FVoxelStackFrames> StackFrames_RequiresLock;
-	TVoxelChunkedSparseArray<TSharedPtr<FVoxelPromiseState>> PromisesToKeepAlive_RequiresLock;
+	TVoxelChunkedSparseArray<TVoxelRefCountPtr<FVoxelPromiseState>> PromisesToKeepAlive_RequiresLock;
+
+private:
+	// Number of pending promises per index in the global promise stack frames table
+	// Allocated on the first sampled promise
+	TVoxelAtomic<FVoxelCounter32*> PromiseStackFramesCounts = nullptr;
+	FVoxelCounter64 NextPromiseCallstackSampleCycles;
+
+	bool ShouldSamplePromiseCallstack();
+	// Returns the stack index to pass to RemovePromiseStackFrames, -1 if not tracked
+	int32 AddPromiseStackFrames(const FVoxelStackFrames& StackFrames);
+	void RemovePromiseStackFrames(int32 StackIndex);
 
 	friend FVoxelPromiseState;
 	friend FVoxelTaskContextWeakRef;
@@ -158,6 +234,10 @@ public:
 
 		return *GVoxelGlobalTaskContext;
 	}
+	FORCEINLINE static FVoxelCancellationToken GetCancellationToken()
+	{
+		return GetContext().GetCancellationToken();
+	}
 
 public:
 	// Call the lambda in the global task context, avoiding any task leak or weird dependencies
@@ -0,0 +1,110 @@
+// Copyright Voxel Plugin SAS. All Rights Reserved.
+
+#pragma once
+
+#include "VoxelMinimal.h"
+#include "VoxelTaskContext.h"
+
+class FVoxelTaskTracer;
+
+extern VOXELCORE_API FVoxelTaskTracer* GVoxelTaskTracer;
+
+// Optional recorder of task & promise lifetime events, saved as a Chrome trace JSON to find critical paths and needless thread hops
+// Each promise is an async slice from its creation to it being set, each task a slice on the thread running it
+// Flow arrows go from where a task is dispatched, typically a promise being set, to where the task runs
+// Use voxel.Tasks.StartTrace & voxel.Tasks.StopTrace, or Start/Stop to only record a single task context
+class VOXELCORE_API FVoxelTaskTracer : public FVoxelSingleton
+{
+public:
+	// If Context is not null, only events of this context are recorded
+	// If Duration is positive, the trace is stopped & saved after Duration seconds
+	void Start(
+		const FVoxelTaskContext* Context,
+		double Duration);
+
+	// Events are converted & written async
+	// Returns the path of the saved trace, empty if not tracing or if saving failed
+	TVoxelFuture<FString> Stop();
+
+	FORCEINLINE bool IsTracing() const
+	{
+		return bIsTracing.Get();
+	}
+	FORCEINLINE bool ShouldTrace(const FVoxelTaskContext& Context) const
+	{
+		if (!bIsTracing.Get())
+		{
+			return false;
+		}
+
+		const int32 Serial = TracedContextSerial.Get(std::memory_order_relaxed);
+		return
+			Serial == 0 ||
+			Serial == Context.GetSerial();
+	}
+
+public:
+	void RecordPromiseCreated(const void* Promise);
+	void RecordPromiseSet(
+		const void* Promise,
+		uint64 StartCycles,
+		uint64 EndCycles);
+
+	// Returns the flow id to pass to RecordTask
+	uint64 RecordDispatch(EVoxelFutureThread Thread);
+	void RecordTask(
+		EVoxelFutureThread Thread,
+		uint64 FlowId,
+		uint64 StartCycles,
+		uint64 EndCycles);
+
+public:
+	//~ Begin FVoxelSingleton Interface
+	virtual void Tick() override;
+	//~ End FVoxelSingleton Interface
+
+private:
+	struct FEvent
+	{
+		enum class EType : uint8
+		{
+			PromiseCreated,
+			PromiseSet,
+			Dispatch,
+			Task
+		};
+
+		EType Type = {};
+		EVoxelFutureThread Thread = {};
+		uint32 ThreadId = 0;
+		// Promise pointer or flow id
+		uint64 Id = 0;
+		uint64 StartCycles = 0;
+		uint64 EndCycles = 0;
+	};
+
+	TVoxelAtomic<bool> bIsTracing = false;
+	// Serial of the traced context, 0 to trace all contexts
+	// Not the context pointer: it is read from any thread and its address could be reused by a new context
+	TVoxelAtomic<int32> TracedContextSerial = 0;
+	uint64 TraceStartCycles = 0;
+	// 0 if no duration
+	TVoxelAtomic<uint64> TraceEndCycles = 0;
+	FVoxelCounter64 FlowIdCounter;
+	// Events are reserved by batches so that threads don't all hit this counter
+	FVoxelCounter32 NumReservedEvents;
+	FVoxelCounter32 NumDroppedEvents;
+
+	// Per-thread event buffer, see VoxelTaskTracer.cpp
+	struct FThread;
+
+	FVoxelCriticalSection CriticalSection;
+	// Never freed, buffers of exited threads are reused by new threads
+	TVoxelArray<FThread*> Threads_RequiresLock;
+	TVoxelArray<FThread*> FreeThreads_RequiresLock;
+
+	FThread& GetThread();
+	void AddEvent(FEvent Event);
+
+	friend struct FVoxelTaskTracerThreadLocal;
+};
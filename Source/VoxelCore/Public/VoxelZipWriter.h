@@ -36,6 +36,15 @@ public:
 		FOodleDataCompression::ECompressor Compressor = FOodleDataCompression::ECompressor::Leviathan,
 		FOodleDataCompression::ECompressionLevel CompressionLevel = FOodleDataCompression::ECompressionLevel::Optimal3);
 
+	// Filters are undone transparently by FVoxelZipReader
+	void WriteCompressed_Oodle(
+		const FString& Path,
+		TConstVoxelArrayView64<uint8> Data,
+		const FVoxelCompressionFilters& Filters,
+		bool bAllowParallel = true,
+		FOodleDataCompression::ECompressor Compressor = FOodleDataCompression::ECompressor::Leviathan,
+		FOodleDataCompression::ECompressionLevel CompressionLevel = FOodleDataCompression::ECompressionLevel::Optimal3);
+
 private:
 	const FWriteLambda WriteLambda;
 